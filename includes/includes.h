@@ -9,6 +9,15 @@
 #include <stdlib.h>
 #include <memory.h>
 #include <vector>
+#include <deque>
+#include <unordered_map>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+#include <algorithm>
+#include <chrono>
 
 // If Linux
 #ifdef __linux__
@@ -16,6 +25,19 @@
 #include <sys/time.h>
 #endif
 
+// Memory mapped files
+#if defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// SIMD intrinsics, the kernels using them are compiled per function with target attributes
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 // If Windows
 #ifdef _WIN32
 // Nothing to include
@@ -53,6 +75,9 @@ typedef double f64;
 
 #define ArrayCount(Array) (sizeof(Array) / sizeof((Array)[0]))
 
+#define Min(A, B) (((A) < (B)) ? (A) : (B))
+#define Max(A, B) (((A) > (B)) ? (A) : (B))
+
 #define Kilobytes(Value) ((Value) * 1024LL)
 #define Megabytes(Value) (Kilobytes(Value) * 1024LL)
 #define Gigabytes(Value) (Megabytes(Value) * 1024LL)
@@ -31,6 +31,19 @@ uniform Light lights[MAX_LIGHTS];
 uniform vec4 ambient;
 uniform vec3 viewPos;
 
+// Point lights binned into clusters on the CPU (see src/light_clusters.cpp), the same numbers
+#define     CLUSTERS_X              16
+#define     CLUSTERS_Y              9
+#define     CLUSTERS_Z              24
+#define     CLUSTER_INDEX_WIDTH     4096
+
+uniform sampler2D lightData;        // 2 texels per light: position and radius, color
+uniform sampler2D clusterGrid;      // Offset and count of the cluster's lights, x: screen tile, y: slice
+uniform sampler2D clusterLights;    // Light index lists of all the clusters
+uniform vec2 clusterScale;          // Screen tiles per pixel
+uniform vec2 clusterDepth;          // x: view depth the slices start at, y: slices per log of the depth
+uniform vec3 viewForward;
+
 void main()
 {
     // Fetch texel color from the diffuse texture
@@ -75,6 +88,49 @@ void main()
         }
     }
 
+    // The point lights of the cluster the fragment is in
+    ivec2 tile = min(ivec2(gl_FragCoord.xy * clusterScale), ivec2(CLUSTERS_X - 1, CLUSTERS_Y - 1));
+    float depth = dot(fragPosition - viewPos, viewForward);
+    int slice = 0;
+
+    if (depth > clusterDepth.x)
+    {
+        slice = min(int(log(depth / clusterDepth.x) * clusterDepth.y), CLUSTERS_Z - 1);
+    }
+
+    vec2 cluster = texelFetch(clusterGrid, ivec2(tile.x + tile.y * CLUSTERS_X, slice), 0).xy;
+    int first = int(cluster.x);
+    int count = int(cluster.y);
+
+    for (int i = first; i < first + count; i++)
+    {
+        int light = int(texelFetch(clusterLights, ivec2(i % CLUSTER_INDEX_WIDTH, i / CLUSTER_INDEX_WIDTH), 0).r);
+        vec4 positionRadius = texelFetch(lightData, ivec2(light * 2, 0), 0);
+
+        vec3 toLight = positionRadius.xyz - fragPosition;
+        float distance = length(toLight);
+
+        if (distance < positionRadius.w)
+        {
+            vec3 lightColor = texelFetch(lightData, ivec2(light * 2 + 1, 0), 0).rgb;
+            vec3 lightDir = toLight / max(distance, 0.0001);
+
+            // Fades out to nothing at the radius
+            float falloff = 1.0 - distance / positionRadius.w;
+            falloff *= falloff;
+
+            float NdotL = max(dot(normal, lightDir), 0.0);
+            lightDot += lightColor * NdotL * falloff;
+
+            if (NdotL > 0.0)
+            {
+                vec3 reflectDir = reflect(-lightDir, normal);
+                float specCo = pow(max(dot(viewD, reflectDir), 0.0), shininess);
+                specular += specCo * specularMapColor * falloff;
+            }
+        }
+    }
+
     // Combine the texel color with lighting and specular
     finalColor = (texelColor * (colDiffuse + vec4(specular, 1.0)) * vec4(lightDot, 1.0));
     
@@ -5,12 +5,26 @@ in vec3 vertexPosition;
 in vec2 vertexTexCoord;
 in vec3 vertexNormal;
 
-in mat4 instanceTransform;
+// Packed tile record (see src/ground_terrain.cpp), read as two unsigned shorts:
+// x: tile x | material bits 0-2 << 13, y: tile z | material bits 3-5 << 13
+in vec2 instanceTile;
 
 // Input uniform values
 uniform mat4 mvp;
 uniform mat4 matNormal;
 
+// Terrain layout, the same for every tile
+uniform mat4 tileBasis;     // Tile scale and rotation, no translation
+uniform float squareSize;
+uniform float mapSize;
+uniform float atlasColumns;
+uniform float atlasRows;
+uniform float atlasInset;   // Half a texel of an atlas cell
+
+// Elevation of every tile in the store, the store starts at world tile storeOrigin
+uniform sampler2D elevationMap;
+uniform vec2 storeOrigin;
+
 // Output vertex attributes (to fragment shader)
 out vec3 fragPosition;
 out vec2 fragTexCoord;
@@ -19,14 +33,25 @@ out vec3 fragNormal;
 
 void main()
 {
-    // Compute MVP for current instance
-    mat4 mvpi = mvp*instanceTransform;
+    // Unpack the record, the shorts arrive as exact floats
+    float tileX = mod(instanceTile.x, 8192.0);
+    float tileZ = mod(instanceTile.y, 8192.0);
+    float material = floor(instanceTile.x / 8192.0) + floor(instanceTile.y / 8192.0) * 8.0;
+
+    // Rebuild the tile transform
+    float elevation = texelFetch(elevationMap, ivec2(tileZ - storeOrigin.y, tileX - storeOrigin.x), 0).r;
+    vec3 offset = vec3((tileX - mapSize / 2.0 + 0.5) * squareSize, elevation, (tileZ - mapSize / 2.0 + 0.5) * squareSize);
+    vec4 worldPosition = vec4((tileBasis * vec4(vertexPosition, 1.0)).xyz + offset, 1.0);
+
+    // Pick the material's cell in the atlas
+    vec2 cell = vec2(mod(material, atlasColumns), floor(material / atlasColumns));
+    vec2 cellTexCoord = clamp(vertexTexCoord, vec2(atlasInset), vec2(1.0 - atlasInset));
 
     // Send vertex attributes to fragment shader
-    fragPosition = vec3(mvpi*vec4(vertexPosition, 1.0));
-    fragTexCoord = vertexTexCoord;
-    fragNormal = normalize(vec3(matNormal*vec4(vertexNormal, 1.0)));
+    fragPosition = worldPosition.xyz;
+    fragTexCoord = (cell + cellTexCoord) / vec2(atlasColumns, atlasRows);
+    fragNormal = normalize(vec3(matNormal*vec4(mat3(tileBasis)*vertexNormal, 1.0)));
 
     // Calculate final vertex position
-    gl_Position = mvpi*vec4(vertexPosition, 1.0);
-}
\ No newline at end of file
+    gl_Position = mvp*worldPosition;
+}
@@ -0,0 +1,33 @@
+#version 330
+
+// Input vertex attributes
+in vec3 vertexPosition;
+in vec2 vertexTexCoord;
+in vec3 vertexNormal;
+
+// Model transform of the instance, set up by DrawMeshInstanced (see src/track_batches.cpp)
+in mat4 instanceTransform;
+
+// Input uniform values
+uniform mat4 mvp;
+uniform mat4 matNormal;
+
+// Output vertex attributes (to fragment shader)
+out vec3 fragPosition;
+out vec2 fragTexCoord;
+out vec4 fragColor;
+out vec3 fragNormal;
+
+void main()
+{
+    vec4 worldPosition = instanceTransform*vec4(vertexPosition, 1.0);
+
+    // Send vertex attributes to fragment shader, the placed models are only rotated around y
+    // and scaled evenly, so the instance transform also works for the normals
+    fragPosition = vec3(worldPosition);
+    fragTexCoord = vertexTexCoord;
+    fragNormal = normalize(vec3(matNormal*vec4(mat3(instanceTransform)*vertexNormal, 1.0)));
+
+    // Calculate final vertex position
+    gl_Position = mvp*worldPosition;
+}
@@ -0,0 +1,704 @@
+// Asset loader ----------------------------------------------
+// Loads textures, fonts and models without holding up the frames. An asset goes
+//      decoding -> uploading -> ready (or failed)
+// Reading the file and decoding it (PNG, glyph rasterizing, GLB parsing, see model_glb.cpp) is
+// done by ASSET_LOADER_THREADS threads of their own, so they never take a worker away from a
+// ParallelFor. Only the upload needs the OpenGL context: PumpAssetLoader runs on the main thread
+// once a frame and uploads decoded assets until ASSET_UPLOAD_BUDGET is spent, the rest waits
+// for the next frame.
+//
+// The asset table belongs to the main thread. The loader threads only see jobs (what to decode)
+// and hand back the decoded data, both through queues behind one mutex.
+//
+// Until an asset is ready its getter hands out a placeholder: a flat texture, the default font or
+// a cube. The game draws from the first frame and swaps the real assets in when Version changes.
+// A model waits for the textures its materials use, models sharing a texture share one upload.
+//
+// Models come out of the model cache when it has them (see model_cache.cpp), their meshes point
+// into the mapped file. When any model had to be decoded from its GLB the cache is cooked again
+// once everything is loaded, on a loader thread, for the next start.
+const u32 ASSET_LOADER_THREADS = 2;
+const f64 ASSET_UPLOAD_BUDGET = 0.002; // Seconds of uploads per frame, at least one asset goes up every frame
+const i32 ASSET_FONT_PADDING = 4;      // Around every glyph in the font atlas, same as LoadFontEx
+const u32 ASSET_NONE = 0xFFFFFFFF;
+
+typedef u32 AssetHandle;
+
+// Builds an image on a loader thread, for textures that are more than one file
+typedef Image AssetImageBuilder(const void *Data);
+
+enum AssetKind : u8
+{
+    ASSET_TEXTURE,
+    ASSET_FONT,
+    ASSET_MODEL,
+    ASSET_MODEL_CACHE, // Only a job, cooks the model cache. Never in the asset table
+};
+
+enum AssetState : u8
+{
+    ASSET_DECODING,
+    ASSET_UPLOADING, // Decoded, waiting for its turn or for the textures of its materials
+    ASSET_READY,
+    ASSET_FAILED,
+};
+
+struct AssetJob
+{
+    AssetHandle Handle;
+    AssetKind Kind;
+    std::string Path;
+    AssetImageBuilder *Build; // Textures built from more than one file, NULL to load Path
+    const void *BuildData;
+    i32 FontSize;
+    i32 GlyphCount;
+};
+
+// What a loader thread hands back
+struct AssetDecoded
+{
+    AssetHandle Handle;
+    bool Ok;
+    Image Pixels;      // Textures, and the glyph atlas of fonts
+    GlyphInfo *Glyphs; // Fonts
+    Rectangle *Recs;
+    i32 GlyphCount;
+    GlbModel Geometry; // Models
+    bool CacheMiss;    // Models, decoded from the GLB because the model cache did not have it
+    f64 Seconds;       // Spent reading and decoding
+};
+
+struct Asset
+{
+    AssetKind Kind;
+    AssetState State;
+    std::string Path;
+    i32 FontSize;
+    i32 GlyphCount;
+
+    AssetDecoded Decoded;              // While uploading
+    std::vector<AssetHandle> Textures; // Models, the texture of every material or ASSET_NONE
+
+    Texture2D Texture;
+    Font GlyphFont;
+    Model LoadedModel;
+    bool Mapped; // The mesh arrays of LoadedModel are in the model cache
+};
+
+struct AssetLoader
+{
+    std::vector<Asset> Assets;                            // The handle is the index
+    std::unordered_map<std::string, AssetHandle> ByPath; // Textures are shared between models
+    std::vector<AssetHandle> Uploads;                     // Decoded, in the order they came back
+
+    // Shared with the loader threads
+    std::mutex Lock;
+    std::condition_variable WakeUp;
+    std::deque<AssetJob> Jobs;
+    std::vector<AssetDecoded> Done;
+    bool Quit;
+    std::thread Threads[ASSET_LOADER_THREADS];
+
+    Texture2D PlaceholderTexture;
+    Model PlaceholderModel;
+
+    ModelCache Models; // Open for as long as the loader, the loaded models point into it
+    u32 CacheHits;
+    u32 CacheMisses;
+
+    u32 ReadyCount;
+    u32 FailedCount;
+    u64 Version; // Bumped every time an asset becomes ready
+
+    // Timings, printed once everything queued is in
+    f64 StartTime;
+    f64 FirstFrameTime;
+    f64 DecodeSeconds;
+    f64 UploadSeconds;
+    u32 UploadFrames;
+    bool Reported;
+};
+
+internal void
+FreeAssetDecoded(AssetDecoded *Decoded)
+{
+    if (Decoded->Pixels.data != NULL)
+    {
+        UnloadImage(Decoded->Pixels);
+    }
+
+    if (Decoded->Glyphs != NULL)
+    {
+        UnloadFontData(Decoded->Glyphs, Decoded->GlyphCount);
+        MemFree(Decoded->Recs);
+    }
+
+    FreeGlbModel(&Decoded->Geometry);
+
+    Decoded->Pixels = {0};
+    Decoded->Glyphs = NULL;
+    Decoded->Recs = NULL;
+}
+
+// Runs on a loader thread, only touches the CPU
+internal void
+DecodeAsset(const ModelCache *Cache, const AssetJob *Job, AssetDecoded *Result)
+{
+    Result->Handle = Job->Handle;
+
+    switch (Job->Kind)
+    {
+    case ASSET_TEXTURE:
+    {
+        Result->Pixels = (Job->Build != NULL) ? Job->Build(Job->BuildData) : LoadImage(Job->Path.c_str());
+        Result->Ok = Result->Pixels.data != NULL;
+    }
+    break;
+
+    case ASSET_FONT:
+    {
+        std::vector<u8> Bytes;
+        if (!ReadAssetFile(Job->Path.c_str(), &Bytes))
+        {
+            break;
+        }
+
+        // What LoadFontEx does, without the texture upload at the end
+        Result->Glyphs = LoadFontData(Bytes.data(), (i32)Bytes.size(), Job->FontSize, NULL, Job->GlyphCount, FONT_DEFAULT);
+        if (Result->Glyphs == NULL)
+        {
+            break;
+        }
+        Result->GlyphCount = Job->GlyphCount;
+
+        Result->Pixels = GenImageFontAtlas(Result->Glyphs, &Result->Recs, Job->GlyphCount, Job->FontSize, ASSET_FONT_PADDING, 0);
+
+        // The glyph images are kept for ImageText, raylib replaces them with cut outs of the atlas
+        for (i32 g = 0; g < Job->GlyphCount; ++g)
+        {
+            UnloadImage(Result->Glyphs[g].image);
+            Result->Glyphs[g].image = ImageFromImage(Result->Pixels, Result->Recs[g]);
+        }
+
+        Result->Ok = Result->Pixels.data != NULL;
+    }
+    break;
+
+    case ASSET_MODEL:
+    {
+        // An unchanged GLB is not even read
+        const ModelCacheEntry *Entry = FindModelCacheEntry(Cache, Job->Path.c_str());
+        if (Entry != NULL && !HasModelSourceChanged(Entry, Job->Path.c_str()) && MapCachedModel(Cache, Entry, &Result->Geometry))
+        {
+            Result->Ok = true;
+            break;
+        }
+
+        std::vector<u8> Bytes;
+        if (!ReadAssetFile(Job->Path.c_str(), &Bytes))
+        {
+            break;
+        }
+
+        // Touched but with the same content, the cache is still good
+        if (Entry != NULL && Entry->ContentHash == HashModelSource(Bytes.data(), Bytes.size()) && MapCachedModel(Cache, Entry, &Result->Geometry))
+        {
+            Result->Ok = true;
+            break;
+        }
+
+        const std::string Directory = Job->Path.substr(0, Job->Path.find_last_of('/'));
+        Result->Ok = DecodeGlbModel(Bytes.data(), Bytes.size(), Directory.c_str(), &Result->Geometry);
+        Result->CacheMiss = true;
+    }
+    break;
+
+    case ASSET_MODEL_CACHE:
+    {
+        Result->Ok = CookModelCache(Job->Path.c_str(), MODEL_CACHE_SOURCE);
+    }
+    break;
+    }
+}
+
+internal void
+AssetLoaderThreadMain(AssetLoader *Loader)
+{
+    for (;;)
+    {
+        AssetJob Job;
+
+        {
+            std::unique_lock<std::mutex> Lock(Loader->Lock);
+            Loader->WakeUp.wait(Lock, [Loader]
+                                { return !Loader->Jobs.empty() || Loader->Quit; });
+
+            if (Loader->Quit)
+            {
+                return;
+            }
+
+            Job = std::move(Loader->Jobs.front());
+            Loader->Jobs.pop_front();
+        }
+
+        const auto Start = std::chrono::steady_clock::now();
+
+        AssetDecoded Decoded = {};
+        DecodeAsset(&Loader->Models, &Job, &Decoded);
+
+        Decoded.Seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - Start).count();
+
+        {
+            std::lock_guard<std::mutex> Lock(Loader->Lock);
+            Loader->Done.push_back(std::move(Decoded));
+        }
+    }
+}
+
+// Needs the OpenGL context for the placeholders
+internal void
+InitAssetLoader(AssetLoader *Loader)
+{
+    Loader->Quit = false;
+    Loader->StartTime = GetTime();
+
+    Image Flat = GenImageColor(1, 1, LIGHTGRAY);
+    Loader->PlaceholderTexture = LoadTextureFromImage(Flat);
+    UnloadImage(Flat);
+
+    Loader->PlaceholderModel = LoadModelFromMesh(GenMeshCube(1.0f, 1.0f, 1.0f));
+
+    // Before the threads, they only ever read it
+    OpenModelCache(&Loader->Models, MODEL_CACHE_PATH);
+
+    for (u32 t = 0; t < ASSET_LOADER_THREADS; ++t)
+    {
+        Loader->Threads[t] = std::thread(AssetLoaderThreadMain, Loader);
+    }
+}
+
+// Needs the OpenGL context, assets that are not done yet are dropped
+internal void
+FreeAssetLoader(AssetLoader *Loader)
+{
+    {
+        std::lock_guard<std::mutex> Lock(Loader->Lock);
+        Loader->Quit = true;
+    }
+    Loader->WakeUp.notify_all();
+
+    for (u32 t = 0; t < ASSET_LOADER_THREADS; ++t)
+    {
+        if (Loader->Threads[t].joinable())
+        {
+            Loader->Threads[t].join();
+        }
+    }
+
+    for (AssetDecoded &Decoded : Loader->Done)
+    {
+        FreeAssetDecoded(&Decoded);
+    }
+
+    for (Asset &Item : Loader->Assets)
+    {
+        FreeAssetDecoded(&Item.Decoded);
+
+        if (Item.State != ASSET_READY)
+        {
+            continue;
+        }
+
+        switch (Item.Kind)
+        {
+        case ASSET_TEXTURE:
+            UnloadTexture(Item.Texture);
+            break;
+        case ASSET_FONT:
+            UnloadFont(Item.GlyphFont);
+            break;
+        case ASSET_MODEL:
+            if (Item.Mapped)
+            {
+                // UnloadModel frees the mesh arrays, these belong to the model cache
+                for (i32 i = 0; i < Item.LoadedModel.meshCount; ++i)
+                {
+                    Mesh *MeshData = &Item.LoadedModel.meshes[i];
+                    MeshData->vertices = MeshData->normals = MeshData->tangents = MeshData->texcoords = NULL;
+                    MeshData->indices = NULL;
+                }
+            }
+            UnloadModel(Item.LoadedModel); // Only frees the material maps, the textures are assets of their own
+            break;
+        case ASSET_MODEL_CACHE:
+            break;
+        }
+    }
+
+    UnloadTexture(Loader->PlaceholderTexture);
+    UnloadModel(Loader->PlaceholderModel);
+    CloseModelCache(&Loader->Models); // After the models that point into it
+
+    Loader->Assets = std::vector<Asset>();
+    Loader->ByPath.clear();
+    Loader->Uploads = std::vector<AssetHandle>();
+    Loader->Jobs.clear();
+    Loader->Done = std::vector<AssetDecoded>();
+}
+
+internal AssetHandle
+QueueAsset(AssetLoader *Loader, AssetKind Kind, const char *Path, AssetImageBuilder *Build, const void *BuildData, i32 FontSize, i32 GlyphCount)
+{
+    const AssetHandle Handle = (AssetHandle)Loader->Assets.size();
+
+    Asset NewAsset = {};
+    NewAsset.Kind = Kind;
+    NewAsset.State = ASSET_DECODING;
+    NewAsset.Path = Path;
+    NewAsset.FontSize = FontSize;
+    NewAsset.GlyphCount = GlyphCount;
+    Loader->Assets.push_back(std::move(NewAsset));
+
+    AssetJob Job = {};
+    Job.Handle = Handle;
+    Job.Kind = Kind;
+    Job.Path = Path;
+    Job.Build = Build;
+    Job.BuildData = BuildData;
+    Job.FontSize = FontSize;
+    Job.GlyphCount = GlyphCount;
+
+    {
+        std::lock_guard<std::mutex> Lock(Loader->Lock);
+        Loader->Jobs.push_back(std::move(Job));
+    }
+    Loader->WakeUp.notify_one();
+
+    return Handle;
+}
+
+// Texture of an image file, queued once however many times it is asked for
+internal AssetHandle
+QueueTextureAsset(AssetLoader *Loader, const char *Path)
+{
+    const auto Found = Loader->ByPath.find(Path);
+    if (Found != Loader->ByPath.end())
+    {
+        return Found->second;
+    }
+
+    const AssetHandle Handle = QueueAsset(Loader, ASSET_TEXTURE, Path, NULL, NULL, 0, 0);
+    Loader->ByPath[Path] = Handle;
+
+    return Handle;
+}
+
+// Texture of the image Build makes on a loader thread, BuildData has to live until it is ready.
+// Name is only used in messages
+internal AssetHandle
+QueueBuiltTextureAsset(AssetLoader *Loader, const char *Name, AssetImageBuilder *Build, const void *BuildData)
+{
+    return QueueAsset(Loader, ASSET_TEXTURE, Name, Build, BuildData, 0, 0);
+}
+
+// Glyphs 32 up to 32 + GlyphCount, like LoadFontEx(Path, FontSize, NULL, GlyphCount)
+internal AssetHandle
+QueueFontAsset(AssetLoader *Loader, const char *Path, i32 FontSize, i32 GlyphCount)
+{
+    return QueueAsset(Loader, ASSET_FONT, Path, NULL, NULL, FontSize, GlyphCount);
+}
+
+internal AssetHandle
+QueueModelAsset(AssetLoader *Loader, const char *Path)
+{
+    return QueueAsset(Loader, ASSET_MODEL, Path, NULL, NULL, 0, 0);
+}
+
+internal bool
+IsAssetPending(const AssetLoader *Loader, AssetHandle Handle)
+{
+    return Loader->Assets[Handle].State == ASSET_DECODING || Loader->Assets[Handle].State == ASSET_UPLOADING;
+}
+
+internal u32
+GetPendingAssetCount(const AssetLoader *Loader)
+{
+    return (u32)Loader->Assets.size() - Loader->ReadyCount - Loader->FailedCount;
+}
+
+internal Texture2D
+GetAssetTexture(const AssetLoader *Loader, AssetHandle Handle)
+{
+    const Asset *Item = &Loader->Assets[Handle];
+
+    return (Item->State == ASSET_READY) ? Item->Texture : Loader->PlaceholderTexture;
+}
+
+internal Font
+GetAssetFont(const AssetLoader *Loader, AssetHandle Handle)
+{
+    const Asset *Item = &Loader->Assets[Handle];
+
+    return (Item->State == ASSET_READY) ? Item->GlyphFont : GetFontDefault();
+}
+
+internal Model
+GetAssetModel(const AssetLoader *Loader, AssetHandle Handle)
+{
+    const Asset *Item = &Loader->Assets[Handle];
+
+    return (Item->State == ASSET_READY) ? Item->LoadedModel : Loader->PlaceholderModel;
+}
+
+// Builds the model from its decoded meshes, materials 1 and up are the ones of the file like
+// LoadModel makes them
+internal Model
+UploadAssetModel(AssetLoader *Loader, Asset *Item)
+{
+    GlbModel *Geometry = &Item->Decoded.Geometry;
+
+    Model Result = {0};
+    Result.transform = MatrixIdentity();
+
+    Result.meshCount = (i32)Geometry->Meshes.size();
+    Result.meshes = (Mesh *)MemAlloc(Result.meshCount * sizeof(Mesh));
+    Result.meshMaterial = (i32 *)MemAlloc(Result.meshCount * sizeof(i32));
+
+    Result.materialCount = (i32)Geometry->Materials.size() + 1;
+    Result.materials = (Material *)MemAlloc(Result.materialCount * sizeof(Material));
+    Result.materials[0] = LoadMaterialDefault();
+
+    for (usize m = 0; m < Geometry->Materials.size(); ++m)
+    {
+        Material *Mat = &Result.materials[m + 1];
+        *Mat = LoadMaterialDefault();
+        Mat->maps[MATERIAL_MAP_ALBEDO].color = Geometry->Materials[m].BaseColor;
+
+        const AssetHandle Texture = Item->Textures[m];
+        if (Texture != ASSET_NONE && Loader->Assets[Texture].State == ASSET_READY)
+        {
+            Mat->maps[MATERIAL_MAP_ALBEDO].texture = Loader->Assets[Texture].Texture;
+        }
+    }
+
+    for (i32 i = 0; i < Result.meshCount; ++i)
+    {
+        Result.meshes[i] = Geometry->Meshes[i];
+        Result.meshMaterial[i] = (Geometry->MeshMaterial[i] != GLB_NONE) ? (i32)Geometry->MeshMaterial[i] + 1 : 0;
+
+        UploadMesh(&Result.meshes[i], false);
+    }
+
+    // The mesh arrays belong to the model now, or stay in the model cache
+    Item->Mapped = Geometry->Mapped;
+    Geometry->Meshes.clear();
+
+    return Result;
+}
+
+// Uploads a decoded asset, false when it has to wait for the textures of its materials
+internal bool
+UploadAsset(AssetLoader *Loader, AssetHandle Handle)
+{
+    Asset *Item = &Loader->Assets[Handle];
+
+    for (AssetHandle Texture : Item->Textures)
+    {
+        if (Texture != ASSET_NONE && IsAssetPending(Loader, Texture))
+        {
+            return false;
+        }
+    }
+
+    switch (Item->Kind)
+    {
+    case ASSET_TEXTURE:
+    {
+        Item->Texture = LoadTextureFromImage(Item->Decoded.Pixels);
+    }
+    break;
+
+    case ASSET_FONT:
+    {
+        Item->GlyphFont.baseSize = Item->FontSize;
+        Item->GlyphFont.glyphCount = Item->GlyphCount;
+        Item->GlyphFont.glyphPadding = ASSET_FONT_PADDING;
+        Item->GlyphFont.texture = LoadTextureFromImage(Item->Decoded.Pixels);
+        Item->GlyphFont.recs = Item->Decoded.Recs;
+        Item->GlyphFont.glyphs = Item->Decoded.Glyphs;
+
+        Item->Decoded.Recs = NULL;
+        Item->Decoded.Glyphs = NULL;
+    }
+    break;
+
+    case ASSET_MODEL:
+    {
+        Item->LoadedModel = UploadAssetModel(Loader, Item);
+    }
+    break;
+
+    case ASSET_MODEL_CACHE:
+        break;
+    }
+
+    FreeAssetDecoded(&Item->Decoded);
+
+    Item->State = ASSET_READY;
+    Loader->ReadyCount++;
+    Loader->Version++;
+
+    return true;
+}
+
+internal void
+FailAsset(AssetLoader *Loader, AssetHandle Handle)
+{
+    Asset *Item = &Loader->Assets[Handle];
+
+    printf("\tERROR: Could not load %s\n", Item->Path.c_str());
+
+    FreeAssetDecoded(&Item->Decoded);
+
+    Item->State = ASSET_FAILED;
+    Loader->FailedCount++;
+    Loader->Version++; // Whatever waits on it can go ahead with the placeholder
+}
+
+// Once a frame on the main thread: takes in what the loader threads decoded and uploads as much
+// of it as fits in ASSET_UPLOAD_BUDGET
+internal void
+PumpAssetLoader(AssetLoader *Loader)
+{
+    ProfileZone("PumpAssetLoader");
+
+    const f64 Start = GetTime();
+
+    if (Loader->FirstFrameTime == 0.0)
+    {
+        Loader->FirstFrameTime = Start;
+    }
+
+    std::vector<AssetDecoded> Done;
+    {
+        std::lock_guard<std::mutex> Lock(Loader->Lock);
+        Done.swap(Loader->Done);
+    }
+
+    for (AssetDecoded &Decoded : Done)
+    {
+        if (Decoded.Handle == ASSET_NONE)
+        {
+            printf("\t%s the model cache in %.1f ms\n", Decoded.Ok ? "Cooked" : "Could not cook", Decoded.Seconds * 1000.0);
+            continue;
+        }
+
+        Asset *Item = &Loader->Assets[Decoded.Handle];
+        Loader->DecodeSeconds += Decoded.Seconds;
+
+        if (Item->Kind == ASSET_MODEL && Decoded.Ok)
+        {
+            if (Decoded.CacheMiss)
+            {
+                Loader->CacheMisses++;
+            }
+            else
+            {
+                Loader->CacheHits++;
+            }
+        }
+
+        if (!Decoded.Ok)
+        {
+            Item->Decoded = std::move(Decoded);
+            FailAsset(Loader, Item->Decoded.Handle);
+            continue;
+        }
+
+        // A model waits for its textures, they are only queued now that the file says which
+        if (Item->Kind == ASSET_MODEL)
+        {
+            for (const GlbMaterial &Mat : Decoded.Geometry.Materials)
+            {
+                const AssetHandle Texture = Mat.TexturePath.empty() ? ASSET_NONE : QueueTextureAsset(Loader, Mat.TexturePath.c_str());
+                Loader->Assets[Decoded.Handle].Textures.push_back(Texture);
+            }
+
+            Item = &Loader->Assets[Decoded.Handle]; // Queueing a texture can move the table
+        }
+
+        Item->Decoded = std::move(Decoded);
+        Item->State = ASSET_UPLOADING;
+        Loader->Uploads.push_back(Item->Decoded.Handle);
+    }
+
+    // In order, skipping the models that still wait for a texture
+    bool Uploaded = false;
+    for (usize u = 0; u < Loader->Uploads.size();)
+    {
+        if (Uploaded && GetTime() - Start > ASSET_UPLOAD_BUDGET)
+        {
+            break;
+        }
+
+        if (UploadAsset(Loader, Loader->Uploads[u]))
+        {
+            Loader->Uploads.erase(Loader->Uploads.begin() + u);
+            Uploaded = true;
+        }
+        else
+        {
+            ++u;
+        }
+    }
+
+    if (Uploaded)
+    {
+        Loader->UploadSeconds += GetTime() - Start;
+        Loader->UploadFrames++;
+    }
+
+    if (!Loader->Reported && !Loader->Assets.empty() && GetPendingAssetCount(Loader) == 0)
+    {
+        Loader->Reported = true;
+
+        printf("\n\tAssets: %u loaded, %u failed, first frame after %.1f ms, all loaded after %.1f ms\n",
+               Loader->ReadyCount, Loader->FailedCount, (Loader->FirstFrameTime - Loader->StartTime) * 1000.0, (GetTime() - Loader->StartTime) * 1000.0);
+        printf("\t%.1f ms decoding on %u loader threads, %.1f ms uploading spread over %u frames\n",
+               Loader->DecodeSeconds * 1000.0, ASSET_LOADER_THREADS, Loader->UploadSeconds * 1000.0, Loader->UploadFrames);
+        printf("\t%u models from the model cache, %u decoded from their GLB\n", Loader->CacheHits, Loader->CacheMisses);
+
+        // Stale or missing entries, the next start gets them from the cache
+        if (Loader->CacheMisses > 0)
+        {
+            AssetJob Job = {};
+            Job.Handle = ASSET_NONE;
+            Job.Kind = ASSET_MODEL_CACHE;
+            Job.Path = MODEL_CACHE_PATH;
+
+            {
+                std::lock_guard<std::mutex> Lock(Loader->Lock);
+                Loader->Jobs.push_back(std::move(Job));
+            }
+            Loader->WakeUp.notify_one();
+        }
+    }
+}
+
+// Progress bar while anything is still loading
+internal void
+DrawAssetLoaderProgress(const AssetLoader *Loader, i32 X, i32 Y, i32 Width)
+{
+    const u32 Total = (u32)Loader->Assets.size();
+    const u32 Done = Total - GetPendingAssetCount(Loader);
+
+    if (Done == Total)
+    {
+        return;
+    }
+
+    DrawRectangle(X, Y, Width, 12, Fade(BLACK, 0.5f));
+    DrawRectangle(X + 2, Y + 2, (i32)((Width - 4) * (f32)Done / (f32)Total), 8, WHITE);
+    DrawText(TextFormat("Loading assets %u/%u", Done, Total), X, Y + 16, 10, WHITE);
+}
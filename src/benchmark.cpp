@@ -0,0 +1,1823 @@
+// Includes --------------------------------------------------
+#include "includes.h"
+#include "raylib_includes.h"
+
+#include "frustum.cpp"
+#include "job_system.cpp"
+
+// Variables -------------------------------------------------
+// Headless benchmarks of the ground and track hot paths on synthetic maps, no window is opened.
+// Run with `meson test --benchmark` or straight from the build directory:
+//      ./raylib_orthographic_benchmark [--json <path>] [--baseline <path>] [--models <directory> [--model-cache <path>]] [map sizes...]
+// Every result is reported per operation and per map tile, the JSON output has one result
+// per line so CI can diff it against a stored baseline with --baseline. With --models every .glb
+// below the directory is cooked into a model cache and loading them both ways is compared.
+const i64 SQUARE_SIZE = 32;
+const i32 BENCH_SCREEN_WIDTH = 640 * 2;
+const i32 BENCH_SCREEN_HEIGHT = 360 * 2;
+
+const f64 BENCH_MIN_SECONDS = 0.25;     // Every benchmark runs at least this long
+const u32 BENCH_VIEW_COUNT = 64;        // Camera views culled per map size
+const u32 BENCH_RAY_COUNT = 4096;       // Picking rays per map size
+const u32 BENCH_FOOTPRINT_VIEWS = 1000; // Random cameras the footprint culling is checked with
+const u32 BENCH_PICK_CHECK_RAYS = 100000; // Random rays the pyramid picking is checked with against the grid walk
+const u32 BENCH_LIGHT_COUNT = 1000;     // Point lights in view of the light binning benchmark
+const u32 BENCH_LIGHT_VIEWS = 16;       // Random cameras the light clusters are checked with
+const u32 BENCH_LIGHT_POINTS = 256;     // Random points inside every light that have to find it in their cluster
+const f64 BENCH_LIGHT_BUDGET_MS = 0.5;  // Most the binning of BENCH_LIGHT_COUNT lights may take
+const u32 BENCH_TRACK_SPACING = 8;      // Tiles between the rails of the benchmark track lattice
+const u32 BENCH_TRACK_HOLE_ODDS = 80;   // About one in this many pieces is taken out of the lattice, so routes have to go around
+const u32 BENCH_ROUTE_PAIRS = 256;      // Origin and destination pairs of the cached route benchmark
+const u32 BENCH_TRACK_LINK_EDITS = 20000; // Random places and removes the track links are checked after
+const u32 BENCH_ROUTE_CHECKS = 3000;    // Random routes checked against breadth first search
+const u32 BENCH_ROUTE_EDITS = 64;       // Cached routes cut in the middle to check they are found again
+const u32 BENCH_FRAME_CYCLE = 64;       // Frames of pans, zooms and edits the allocation check repeats
+const u32 BENCH_ALLOCATION_FRAMES = 256; // Frames after the first cycle that may not touch the heap
+const u32 BENCH_CARRIAGES = 10000;      // Carriages driving around the lattice in the train benchmark
+const u32 BENCH_TRAIN_LENGTH = 5;       // Carriages per train, the locomotive included
+const f32 BENCH_TICK = 1.0f / 60.0f;
+const u32 BENCH_DETERMINISM_TICKS = 600;
+const u32 BenchDeterminismWorkers[] = {1, 2, 3, 8}; // Job system sizes the train ticks have to agree on
+const f64 BENCH_SIM_SECONDS = 0.5;     // The simulation thread check runs this long at 4x speed
+const u32 BENCH_SIM_WORKERS = 4;        // Job system size of that check, so the workers steal from its queue
+const u32 BENCH_SIM_EDITS = 16;         // Pieces replaced and trains spawned while the simulation thread runs
+const f64 BENCH_REGRESSION_LIMIT = 1.25; // Slower than this times the baseline fails the run
+
+std::atomic<u64> CPUMemory(0); // Written by the main thread, the job system workers and the simulation thread
+
+// The zones in the ground code would be measured along with it
+#define PROFILER 0
+#include "profiler.cpp"
+#include "frame_arena.cpp"
+
+#include "ground_tiles.cpp"
+#include "picking.cpp"
+#include "frustum_simd.cpp"
+#include "ground_quadtree.cpp"
+#include "ground_footprint.cpp"
+#include "ground_terrain.cpp"
+#include "ground_lod.cpp"
+#include "ground_batches.cpp"
+
+#include "track_network.cpp"
+#include "track_routes.cpp"
+#include "track_blocks.cpp"
+#include "track_batches.cpp"
+#include "train_sim.cpp"
+#include "sim_thread.cpp"
+#include "train_batches.cpp"
+
+#include "mapped_file.cpp"
+#include "model_glb.cpp"
+#include "model_cache.cpp"
+
+#include "light_clusters.cpp"
+
+struct BenchResult
+{
+    std::string Name;
+    i64 MapSize;
+    u64 Iterations;
+    f64 NsPerOp;
+    const char *Unit; // What an op is made of, the tiles of the map unless said otherwise
+    f64 NsPerUnit;
+    f64 UnitsPerSecond;
+};
+
+global_variable std::vector<BenchResult> BenchResults;
+global_variable u32 BenchWorkerCount = 0;
+global_variable FrameArena BenchArena; // Reset before every op that builds frame data
+
+// Every operator new of the benchmark is counted, so CheckFrameAllocations can tell whether a
+// frame touched the heap. The frame arena's own calloc shows up in its Grows instead
+global_variable std::atomic<u64> BenchHeapAllocations(0);
+
+void *
+operator new(usize Size)
+{
+    BenchHeapAllocations.fetch_add(1, std::memory_order_relaxed);
+
+    void *Result = malloc(Max(Size, (usize)1));
+    if (Result == NULL)
+    {
+        throw std::bad_alloc();
+    }
+
+    return Result;
+}
+
+void
+operator delete(void *Memory) noexcept
+{
+    free(Memory);
+}
+
+void
+operator delete(void *Memory, usize Size) noexcept
+{
+    free(Memory);
+}
+
+// Deterministic, so every run benchmarks the same maps, views and rays
+global_variable u32 BenchRandomState = 0x9E3779B9;
+
+internal u32
+BenchRandom(void)
+{
+    BenchRandomState ^= BenchRandomState << 13;
+    BenchRandomState ^= BenchRandomState >> 17;
+    BenchRandomState ^= BenchRandomState << 5;
+
+    return BenchRandomState;
+}
+
+internal f32
+BenchRandomRange(f32 Min, f32 Max)
+{
+    return Min + (Max - Min) * ((f32)(BenchRandom() & 0xFFFFFF) / (f32)0xFFFFFF);
+}
+
+// "256^2", or nothing for the benchmarks that do not run on a map
+internal void
+FormatBenchMapSize(char *Text, usize TextSize, i64 MapSize)
+{
+    Text[0] = 0;
+    if (MapSize > 0)
+    {
+        snprintf(Text, TextSize, "%ld^2", MapSize);
+    }
+}
+
+// Calls Body(Iteration) until BENCH_MIN_SECONDS have passed, OpsPerCall is how many
+// operations one call does and one operation handles UnitsPerOp of Unit. MapSize is 0 for
+// benchmarks that do not run on a map
+template <typename F>
+internal BenchResult
+RunBenchmarkPer(const char *Name, i64 MapSize, u64 OpsPerCall, const char *Unit, u64 UnitsPerOp, F &&Body)
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Warm up the caches and the job system
+    Body(0);
+
+    u64 Calls = 0;
+    const Clock::time_point Start = Clock::now();
+    f64 Seconds = 0.0;
+
+    do
+    {
+        Body(Calls + 1);
+        ++Calls;
+
+        Seconds = std::chrono::duration<f64>(Clock::now() - Start).count();
+    } while (Seconds < BENCH_MIN_SECONDS);
+
+    BenchResult Result = {};
+    Result.Name = Name;
+    Result.MapSize = MapSize;
+    Result.Iterations = Calls * OpsPerCall;
+    Result.NsPerOp = Seconds * 1e9 / (f64)Result.Iterations;
+    Result.Unit = Unit;
+    Result.NsPerUnit = Result.NsPerOp / (f64)UnitsPerOp;
+    Result.UnitsPerSecond = (f64)UnitsPerOp / (Result.NsPerOp * 1e-9);
+
+    BenchResults.push_back(Result);
+
+    char Size[16];
+    FormatBenchMapSize(Size, sizeof(Size), MapSize);
+
+    printf("\t%-16s %7s %12.1f ns/op %10.4f ns/%s %14.0f %ss/s (%lu ops)\n",
+           Name, Size, Result.NsPerOp, Result.NsPerUnit, Unit, Result.UnitsPerSecond, Unit, Result.Iterations);
+
+    return Result;
+}
+
+// Timed per tile of the map
+template <typename F>
+internal void
+RunBenchmark(const char *Name, i64 MapSize, u64 OpsPerCall, F &&Body)
+{
+    RunBenchmarkPer(Name, MapSize, OpsPerCall, "tile", (u64)(MapSize * MapSize), Body);
+}
+
+// Same steps as SetupGroundTiles, minus everything that needs a window
+internal void
+SetupBenchWorld(GroundTileStore *Tiles, GroundQuadtree *Tree, i64 MapSize)
+{
+    AllocateGroundTileStore(Tiles, MapSize, (f32)SQUARE_SIZE);
+
+    ParallelFor(MapSize, 8, [&](usize RowBegin, usize RowEnd, u32 Worker)
+                {
+                    for (usize Id = RowBegin * MapSize; Id < RowEnd * MapSize; ++Id)
+                    {
+                        SetGroundTileGeometry(Tiles, Id, 0.0f);
+                    }
+                });
+
+    for (usize Id = 0; Id < Tiles->Count; ++Id)
+    {
+        Tiles->MaterialIndex[Id] = (u8)(BenchRandom() % GROUND_MATERIAL_COUNT);
+    }
+
+    UpdateGroundSurfaceRange(Tiles);
+    BuildGroundQuadtree(Tree, Tiles);
+}
+
+// Puts the flat bench world on the heightmap the game uses
+internal void
+RaiseBenchHills(GroundTileStore *Tiles, GroundQuadtree *Tree)
+{
+    ParallelFor(Tiles->MapSize, 8, [&](usize RowBegin, usize RowEnd, u32 Worker)
+                {
+                    for (usize Id = RowBegin * Tiles->MapSize; Id < RowEnd * Tiles->MapSize; ++Id)
+                    {
+                        SetGroundTileGeometry(Tiles, Id, GetGroundElevation(Id / Tiles->MapSize, Id % Tiles->MapSize));
+                    }
+                });
+
+    UpdateGroundSurfaceRange(Tiles);
+    RefitGroundQuadtree(Tree, Tiles);
+}
+
+// The game camera looking at a random spot of the map, from zoomed in to zoomed out
+internal Camera3D
+MakeBenchCamera(const GroundTileStore *Tiles, u32 View)
+{
+    const f32 Extent = Tiles->MapSize * Tiles->TileSize / 2.0f * 0.9f;
+    const u32 ZoomSteps[3] = {0, 4, 7}; // Mouse wheel steps out from the start camera
+    const u32 Zoom = ZoomSteps[View % 3];
+
+    Camera3D Camera = {};
+    Camera.target = (Vector3){BenchRandomRange(-Extent, Extent), 0.0f, BenchRandomRange(-Extent, Extent)};
+    Camera.position = Vector3Add(Camera.target, (Vector3){180.0f, 360.0f + 80.0f * Zoom, 180.0f});
+    Camera.up = (Vector3){0.0f, 1.0f, 0.0f};
+    Camera.fovy = 75.0f + 5.0f * Zoom;
+    Camera.projection = CAMERA_PERSPECTIVE;
+
+    return Camera;
+}
+
+// A dense lattice of track with crossings where the rails meet, the worst case for the router:
+// every cluster has a portal on every rail that crosses its border
+internal void
+SetupBenchTracks(TrackNetwork *Network, u32 WorldSize)
+{
+    InitTrackNetwork(Network, WorldSize);
+
+    for (u32 i = 0; i < WorldSize; ++i)
+    {
+        for (u32 j = 0; j < WorldSize; ++j)
+        {
+            const bool RailI = (i % BENCH_TRACK_SPACING == 0);
+            const bool RailJ = (j % BENCH_TRACK_SPACING == 0);
+
+            if (RailI && RailJ)
+            {
+                PlaceTrackPiece(Network, i, j, TRACK_MODEL_CROSSING, 0);
+            }
+            else if (RailI)
+            {
+                PlaceTrackPiece(Network, i, j, TRACK_MODEL_STRAIGHT, 0); // North to south
+            }
+            else if (RailJ)
+            {
+                PlaceTrackPiece(Network, i, j, TRACK_MODEL_STRAIGHT, 1); // East to west
+            }
+        }
+    }
+
+    const usize HoleCount = Network->Pieces.size() / BENCH_TRACK_HOLE_ODDS;
+
+    for (usize h = 0; h < HoleCount; ++h)
+    {
+        const u32 Tile = Network->Pieces[BenchRandom() % Network->Pieces.size()].Tile;
+        RemoveTrackPiece(Network, Tile / WorldSize, Tile % WorldSize);
+    }
+}
+
+// Random places, replacements and removes on a small world against a plain array of what
+// should be on every tile. After every edit each tile has to find its piece and each piece its
+// tile, and the links UpdateTrackLinks keeps have to be the ones worked out from the four
+// neighbours by brute force. The world is not a whole number of pages, so the last page is cut
+internal bool
+CheckTrackLinks(void)
+{
+    const u32 WorldSize = 40;
+    const u32 TileCount = WorldSize * WorldSize;
+
+    TrackNetwork Network = {};
+    InitTrackNetwork(&Network, WorldSize);
+
+    // Model + 1 and the rotation of the piece on every tile, 0 for none
+    std::vector<u8> Expected(TileCount, 0);
+    std::vector<u8> Rotations(TileCount, 0);
+
+    usize WrongPieces = 0;
+    usize WrongLinks = 0;
+    usize MostPieces = 0;
+
+    for (u32 Edit = 0; Edit < BENCH_TRACK_LINK_EDITS; ++Edit)
+    {
+        const u32 I = BenchRandom() % WorldSize;
+        const u32 J = BenchRandom() % WorldSize;
+        const u32 Tile = I * WorldSize + J;
+
+        // Fill up to about two thirds, then keep the count there
+        if (BenchRandom() % 3 == 0)
+        {
+            const bool Removed = RemoveTrackPiece(&Network, I, J);
+            WrongPieces += (Removed != (Expected[Tile] != 0));
+            Expected[Tile] = 0;
+        }
+        else
+        {
+            const TrackModelHandle Model = (TrackModelHandle)(BenchRandom() % TRACK_MODEL_COUNT);
+            const u8 Rotation = (u8)(BenchRandom() % 4);
+
+            PlaceTrackPiece(&Network, I, J, Model, Rotation);
+            Expected[Tile] = (u8)(Model + 1);
+            Rotations[Tile] = Rotation;
+        }
+
+        MostPieces = Max(MostPieces, Network.Pieces.size());
+
+        usize Found = 0;
+        for (u32 t = 0; t < TileCount; ++t)
+        {
+            const u32 Index = FindTrackPiece(&Network, t / WorldSize, t % WorldSize);
+
+            if (Index == TRACK_NO_PIECE)
+            {
+                WrongPieces += (Expected[t] != 0);
+                continue;
+            }
+
+            const TrackPiece *Piece = &Network.Pieces[Index];
+            WrongPieces += (Piece->Tile != t) || (Piece->Model + 1 != Expected[t]) || (Piece->Rotation != Rotations[t]) ||
+                           (Piece->Edges != RotateTrackEdges(TrackModelInfos[Piece->Model].Edges, Piece->Rotation));
+            Found++;
+
+            u8 Links = 0;
+            for (u32 e = 0; e < 4; ++e)
+            {
+                const u32 Neighbour = FindTrackPiece(&Network, (i64)(t / WorldSize) + TrackEdgeOffsetI[e], (i64)(t % WorldSize) + TrackEdgeOffsetJ[e]);
+
+                if (Neighbour != TRACK_NO_PIECE && (Piece->Edges & (1 << e)) && (Network.Pieces[Neighbour].Edges & GetOppositeTrackEdge(e)))
+                {
+                    Links |= (u8)(1 << e);
+                }
+            }
+
+            WrongLinks += (Piece->Links != Links);
+        }
+
+        WrongPieces += (Found != Network.Pieces.size());
+    }
+
+    printf("\ttrack links: %u edits on %ux%u tiles, up to %zu pieces, %zu wrong pieces, %zu wrong links\n",
+           BENCH_TRACK_LINK_EDITS, WorldSize, WorldSize, MostPieces, WrongPieces, WrongLinks);
+
+    FreeTrackNetwork(&Network);
+
+    return WrongPieces == 0 && WrongLinks == 0;
+}
+
+// Steps along the links from the piece on tile From to the one on To by breadth first search
+// over the whole network, UINT32_MAX when To cannot be reached
+internal u32
+GetBenchTrackDistance(const TrackNetwork *Network, u32 From, u32 To, std::vector<u32> *Distance, std::vector<u32> *Queue)
+{
+    const u32 WorldSize = Network->WorldSize;
+
+    Distance->assign((usize)WorldSize * WorldSize, UINT32_MAX);
+    Queue->clear();
+
+    (*Distance)[From] = 0;
+    Queue->push_back(From);
+
+    for (usize q = 0; q < Queue->size(); ++q)
+    {
+        const u32 Tile = (*Queue)[q];
+
+        if (Tile == To)
+        {
+            return (*Distance)[Tile];
+        }
+
+        const TrackPiece *Piece = &Network->Pieces[FindTrackPiece(Network, Tile / WorldSize, Tile % WorldSize)];
+
+        for (u32 e = 0; e < 4; ++e)
+        {
+            if ((Piece->Links & (1 << e)) == 0)
+            {
+                continue;
+            }
+
+            const u32 Next = (u32)((i64)Tile + (i64)TrackEdgeOffsetI[e] * WorldSize + TrackEdgeOffsetJ[e]);
+
+            if ((*Distance)[Next] == UINT32_MAX)
+            {
+                (*Distance)[Next] = (*Distance)[Tile] + 1;
+                Queue->push_back(Next);
+            }
+        }
+    }
+
+    return UINT32_MAX;
+}
+
+// The route starts on From, ends on To and every step goes over a link of the network
+internal bool
+IsBenchRouteDrivable(const TrackNetwork *Network, const std::vector<u32> *Route, u32 From, u32 To)
+{
+    const u32 WorldSize = Network->WorldSize;
+
+    if (Route->empty() || Route->front() != From || Route->back() != To)
+    {
+        return false;
+    }
+
+    for (usize t = 1; t < Route->size(); ++t)
+    {
+        const u32 Tile = (*Route)[t - 1];
+        const u32 Index = FindTrackPiece(Network, Tile / WorldSize, Tile % WorldSize);
+
+        bool Linked = false;
+        for (u32 e = 0; e < 4 && Index != TRACK_NO_PIECE; ++e)
+        {
+            const u32 Next = (u32)((i64)Tile + (i64)TrackEdgeOffsetI[e] * WorldSize + TrackEdgeOffsetJ[e]);
+            Linked = Linked || ((Network->Pieces[Index].Links & (1 << e)) && Next == (*Route)[t]);
+        }
+
+        if (!Linked)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Routes between random pieces against breadth first search over the whole network: a route
+// has to be found exactly when the search reaches the goal, be drivable and be as short. The
+// lattice is cut in two along a column of tiles, so some pairs cannot be connected. Then
+// pieces in the middle of cached routes are removed, asking for the route again may not give
+// back the cached one and has to match the search on the edited network
+internal bool
+CheckTrackRoutes(void)
+{
+    const u32 WorldSize = 256;
+    const u32 CutJ = 100;
+
+    TrackNetwork Network = {};
+    SetupBenchTracks(&Network, WorldSize);
+
+    for (u32 i = 0; i < WorldSize; ++i)
+    {
+        RemoveTrackPiece(&Network, i, CutJ);
+    }
+
+    TrackRouter Router = {};
+    InitTrackRouter(&Router, &Network);
+
+    std::vector<u32> Distance;
+    std::vector<u32> Queue;
+
+    usize Connected = 0;
+    usize Wrong = 0;
+
+    for (u32 r = 0; r < BENCH_ROUTE_CHECKS; ++r)
+    {
+        const u32 From = Network.Pieces[BenchRandom() % Network.Pieces.size()].Tile;
+        const u32 To = Network.Pieces[BenchRandom() % Network.Pieces.size()].Tile;
+
+        const std::vector<u32> *Route = FindTrackRoute(&Router, &Network, From / WorldSize, From % WorldSize, To / WorldSize, To % WorldSize);
+        const u32 Expected = GetBenchTrackDistance(&Network, From, To, &Distance, &Queue);
+
+        if (Expected == UINT32_MAX)
+        {
+            Wrong += (Route != NULL);
+            continue;
+        }
+
+        Connected++;
+        Wrong += (Route == NULL) || !IsBenchRouteDrivable(&Network, Route, From, To) || (Route->size() - 1 != Expected);
+    }
+
+    // Cache a route, cut it in the middle and ask again
+    usize Edits = 0;
+    usize Stale = 0;
+
+    while (Edits < BENCH_ROUTE_EDITS)
+    {
+        const u32 From = Network.Pieces[BenchRandom() % Network.Pieces.size()].Tile;
+        const u32 To = Network.Pieces[BenchRandom() % Network.Pieces.size()].Tile;
+
+        const std::vector<u32> *Route = FindTrackRoute(&Router, &Network, From / WorldSize, From % WorldSize, To / WorldSize, To % WorldSize);
+
+        if (Route == NULL || Route->size() < 3)
+        {
+            continue;
+        }
+
+        const u32 Cut = (*Route)[Route->size() / 2];
+        RemoveTrackPiece(&Network, Cut / WorldSize, Cut % WorldSize);
+        InvalidateTrackRouteTile(&Router, Cut / WorldSize, Cut % WorldSize);
+        Edits++;
+
+        const u64 CacheHits = Router.CacheHits;
+        Route = FindTrackRoute(&Router, &Network, From / WorldSize, From % WorldSize, To / WorldSize, To % WorldSize);
+        const u32 Expected = GetBenchTrackDistance(&Network, From, To, &Distance, &Queue);
+
+        Stale += (Router.CacheHits != CacheHits);
+
+        if (Expected == UINT32_MAX)
+        {
+            Wrong += (Route != NULL);
+        }
+        else
+        {
+            Wrong += (Route == NULL) || !IsBenchRouteDrivable(&Network, Route, From, To) || (Route->size() - 1 != Expected);
+        }
+    }
+
+    printf("\ttrack routes: %u routes, %zu connected, %u cached routes cut, %zu served stale, %zu wrong\n",
+           BENCH_ROUTE_CHECKS, Connected, BENCH_ROUTE_EDITS, Stale, Wrong);
+
+    FreeTrackRouter(&Router);
+    FreeTrackNetwork(&Network);
+
+    return Wrong == 0 && Stale == 0;
+}
+
+// Up to BENCH_CARRIAGES carriages, small maps run out of free blocks before that
+internal void
+SpawnBenchTrains(TrainSim *Sim, const TrackNetwork *Network, TrackBlocks *Blocks)
+{
+    InitTrainSim(Sim, (f32)SQUARE_SIZE);
+
+    for (u32 Attempt = 0; Attempt < BENCH_CARRIAGES && GetTrainCarriageCount(Sim) < BENCH_CARRIAGES; ++Attempt)
+    {
+        const u32 Tile = Network->Pieces[BenchRandom() % Network->Pieces.size()].Tile;
+        const f32 Speed = 2.0f + (f32)(BenchRandom() % 8);
+
+        SpawnTrain(Sim, Network, Blocks, Tile / Network->WorldSize, Tile % Network->WorldSize, BENCH_TRAIN_LENGTH, Speed);
+    }
+}
+
+// Carriages on a block their train does not hold, or blocks held by a train no carriage of
+// which is on or behind them. Either means two trains could end up on the same tile
+internal usize
+CountTrainBlockErrors(TrainSim *Sim, const TrackNetwork *Network, const TrackBlocks *Blocks)
+{
+    usize Errors = 0;
+
+    for (usize Train = 0; Train < GetTrainCount(Sim); ++Train)
+    {
+        const usize First = Sim->FirstCarriage[Train];
+
+        for (usize c = First; c < First + Sim->CarriageCount[Train]; ++c)
+        {
+            Errors += (GetTrackBlockOwner(Blocks, GetTrainCarriageBlock(Sim, Network, c)) != Train + 1);
+        }
+
+        for (u32 k = 0; k < Sim->BlockCount[Train]; ++k)
+        {
+            Errors += (GetTrackBlockOwner(Blocks, *GetTrainBlock(Sim, Train, k)) != Train + 1);
+        }
+
+        Errors += (*GetTrainBlock(Sim, Train, 0) != GetTrainCarriageBlock(Sim, Network, GetTrainBack(Sim, Train)));
+    }
+
+    return Errors;
+}
+
+// Runs the same trains with every job system size in BenchDeterminismWorkers, the carriages
+// have to end up in the same spot to the bit and no train may ever be on a block it does not
+// hold. Restarts the job system, leaves it with BenchWorkerCount workers
+internal bool
+CheckTrainTicks(void)
+{
+    const u32 MapSize = 1024;
+    bool Passed = true;
+
+    TrainSim Reference = {};
+
+    for (u32 Workers : BenchDeterminismWorkers)
+    {
+        JobSystemShutdown();
+        JobSystemInit(Workers);
+
+        BenchRandomState = 0x9E3779B9;
+
+        TrackNetwork Network = {};
+        SetupBenchTracks(&Network, MapSize);
+
+        TrackBlocks Blocks = {};
+        TrainSim Sim = {};
+        SpawnBenchTrains(&Sim, &Network, &Blocks);
+
+        usize Errors = 0;
+
+        for (u32 t = 0; t < BENCH_DETERMINISM_TICKS; ++t)
+        {
+            TickTrainSim(&Sim, &Network, &Blocks, BENCH_TICK);
+            Errors += CountTrainBlockErrors(&Sim, &Network, &Blocks);
+        }
+
+        usize Waiting = 0;
+        for (usize Train = 0; Train < GetTrainCount(&Sim); ++Train)
+        {
+            Waiting += (Sim.WaitingFor[Train] != TRAIN_NOT_WAITING);
+        }
+
+        printf("\ttrain blocks: %u workers, %zu trains, %zu waiting, %zu block errors, %lu deadlocks broken\n",
+               Workers, GetTrainCount(&Sim), Waiting, Errors, Sim.Deadlocks);
+
+        Passed = Passed && Errors == 0;
+
+        if (Workers == BenchDeterminismWorkers[0])
+        {
+            Reference = Sim;
+        }
+        else
+        {
+            const usize Bytes = GetTrainCarriageCount(&Sim) * sizeof(f32);
+            const bool Same = GetTrainCarriageCount(&Sim) == GetTrainCarriageCount(&Reference) &&
+                              Sim.Tile == Reference.Tile &&
+                              Sim.Path == Reference.Path &&
+                              memcmp(Sim.Distance.data(), Reference.Distance.data(), Bytes) == 0 &&
+                              memcmp(Sim.PositionX.data(), Reference.PositionX.data(), Bytes) == 0 &&
+                              memcmp(Sim.PositionZ.data(), Reference.PositionZ.data(), Bytes) == 0;
+
+            printf("\ttrain determinism: %u workers %s %u workers after %u ticks\n",
+                   Workers, Same ? "match" : "DIFFER FROM", BenchDeterminismWorkers[0], BENCH_DETERMINISM_TICKS);
+
+            Passed = Passed && Same;
+        }
+
+        FreeTrainSim(&Sim);
+        FreeTrackBlocks(&Blocks);
+        FreeTrackNetwork(&Network);
+    }
+
+    FreeTrainSim(&Reference);
+
+    JobSystemShutdown();
+    JobSystemInit(BenchWorkerCount);
+
+    return Passed;
+}
+
+// Runs the lattice trains on the simulation thread at 4x speed while a render loop draws them
+// from the snapshots and, a few frames in, removes and places pieces and spawns trains like the
+// game does. Then ticks the same start state as many times on the main thread, with the edits
+// before the tick the thread applied them at. Both have to end up in the same place, and the
+// snapshots the render loop sees must never go back. The render loop never waits for a tick,
+// its slowest frame and its slowest edit are printed next to the slowest tick. It reads the
+// snapshot with a ParallelFor like a frame culls, and may never run a range of the ticks
+internal bool
+CheckSimThread(void)
+{
+    const u32 MapSize = 1024;
+
+    JobSystemShutdown();
+    JobSystemInit(BENCH_SIM_WORKERS);
+
+    TrackNetwork Network = {};
+    SetupBenchTracks(&Network, MapSize);
+
+    TrackNetwork ReferenceNetwork = {};
+    CopyTrackNetwork(&ReferenceNetwork, &Network);
+
+    BenchRandomState = 0x9E3779B9;
+    TrackBlocks Blocks = {};
+    TrainSim Sim = {};
+    SpawnBenchTrains(&Sim, &Network, &Blocks);
+
+    SimEdit Edits[BENCH_SIM_EDITS * 3];
+    u32 EditCount = 0;
+
+    SimThread Simulation;
+    StartSimThread(&Simulation, &Sim, &Network, &Blocks);
+    Simulation.SpeedIndex = 2; // 4x
+
+    u64 Frames = 0;
+    u64 LastTick = 0;
+    bool Ordered = true;
+    f64 SlowestFrame = 0.0;
+    f64 SlowestEdit = 0.0;
+    f32 SlowestTick = 0.0f;
+    volatile f32 Sink = 0.0f;
+
+    const f64 Start = GetSimClock(&Simulation);
+    while (GetSimClock(&Simulation) - Start < BENCH_SIM_SECONDS)
+    {
+        const f64 FrameStart = GetSimClock(&Simulation);
+
+        const TrainSnapshot *Snapshot = AcquireTrainSnapshot(&Simulation);
+        const f32 Blend = GetTrainSnapshotBlend(Snapshot, FrameStart);
+
+        std::atomic<u64> Seen(0);
+        ParallelFor(GetTrainSnapshotCarriageCount(Snapshot), 256, [&](usize Begin, usize End, u32 Worker)
+                    {
+                        f32 Sum = 0.0f;
+                        for (usize c = Begin; c < End; ++c)
+                        {
+                            const Vector3 Position = GetTrainSnapshotPosition(Snapshot, c, Blend);
+                            const Vector2 Direction = GetTrainSnapshotDirection(Snapshot, c, Blend);
+                            Sum += Position.x + Position.z + Direction.x;
+                        }
+                        Seen.fetch_add((Sum != 0.0f), std::memory_order_relaxed);
+                    });
+        Sink = Sink + (f32)Seen.load();
+
+        // Edits go to the game's network right away and are queued for the thread, like in GameUpdate
+        if (Frames == 8)
+        {
+            for (u32 e = 0; e < BENCH_SIM_EDITS; ++e)
+            {
+                const TrackPiece Removed = Network.Pieces[BenchRandom() % Network.Pieces.size()];
+                const u32 I = Removed.Tile / Network.WorldSize;
+                const u32 J = Removed.Tile % Network.WorldSize;
+                const u32 Spawn = Network.Pieces[BenchRandom() % Network.Pieces.size()].Tile;
+
+                Edits[EditCount++] = {SIM_EDIT_REMOVE_TRACK, 0, 0, I, J, 0, 0.0f};
+                Edits[EditCount++] = {SIM_EDIT_PLACE_TRACK, TRACK_MODEL_CROSSING, 0, I, J, 0, 0.0f};
+                Edits[EditCount++] = {SIM_EDIT_SPAWN_TRAIN, 0, 0, Spawn / Network.WorldSize, Spawn % Network.WorldSize, BENCH_TRAIN_LENGTH, 4.0f};
+
+                RemoveTrackPiece(&Network, I, J);
+                PlaceTrackPiece(&Network, I, J, TRACK_MODEL_CROSSING, 0);
+            }
+
+            const f64 EditStart = GetSimClock(&Simulation);
+            QueueSimEdits(&Simulation, Edits, EditCount);
+            SlowestEdit = GetSimClock(&Simulation) - EditStart;
+        }
+
+        Ordered = Ordered && Snapshot->Tick >= LastTick && Snapshot->From.X.size() == Snapshot->To.X.size() && Blend >= 0.0f && Blend <= 1.0f;
+        LastTick = Snapshot->Tick;
+        SlowestTick = Max(SlowestTick, Snapshot->TickSeconds);
+        SlowestFrame = Max(SlowestFrame, GetSimClock(&Simulation) - FrameStart);
+        Frames++;
+
+        // About a 144 Hz frame
+        std::this_thread::sleep_for(std::chrono::milliseconds(7));
+    }
+
+    const u64 EditTick = Simulation.LastEditTick;
+    StopSimThread(&Simulation);
+
+    const u64 RangesOnMain = Jobs.AddedRangesOnMain.load();
+
+    const u64 Ticks = Sim.Ticks;
+    const bool Edited = EditTick > 0;
+
+    BenchRandomState = 0x9E3779B9;
+    TrackBlocks ReferenceBlocks = {};
+    TrainSim Reference = {};
+    SpawnBenchTrains(&Reference, &ReferenceNetwork, &ReferenceBlocks);
+
+    for (u64 t = 0; t < Ticks; ++t)
+    {
+        if (t == EditTick)
+        {
+            for (u32 e = 0; e < EditCount; ++e)
+            {
+                ApplySimEdit(&Reference, &ReferenceNetwork, &ReferenceBlocks, &Edits[e]);
+            }
+        }
+
+        TickTrainSim(&Reference, &ReferenceNetwork, &ReferenceBlocks, SIM_TICK_SECONDS);
+    }
+
+    const usize Bytes = GetTrainCarriageCount(&Sim) * sizeof(f32);
+    const bool Same = GetTrainCarriageCount(&Sim) == GetTrainCarriageCount(&Reference) &&
+                      Sim.Tile == Reference.Tile &&
+                      Sim.Path == Reference.Path &&
+                      memcmp(Sim.Distance.data(), Reference.Distance.data(), Bytes) == 0 &&
+                      memcmp(Sim.PositionX.data(), Reference.PositionX.data(), Bytes) == 0 &&
+                      memcmp(Sim.PositionZ.data(), Reference.PositionZ.data(), Bytes) == 0;
+
+    printf("\tsim thread: %lu ticks in %.2f s at 4x (%.0f per second, %.0f due), %lu frames, slowest tick %.3f ms, slowest frame %.3f ms\n",
+           Ticks, BENCH_SIM_SECONDS, Ticks / BENCH_SIM_SECONDS, 4.0 / SIM_TICK_SECONDS, Frames, SlowestTick * 1000.0f, SlowestFrame * 1000.0);
+    printf("\tsim thread: %s ticking on the main thread, snapshots %s, %u edits %s before tick %lu, queued in %.3f ms, %lu tick ranges run by the main thread\n",
+           Same ? "matches" : "DIFFERS FROM", Ordered ? "in order" : "OUT OF ORDER", EditCount, Edited ? "applied" : "NOT APPLIED", EditTick + 1, SlowestEdit * 1000.0, RangesOnMain);
+
+    FreeTrainSim(&Sim);
+    FreeTrackBlocks(&Blocks);
+    FreeTrainSim(&Reference);
+    FreeTrackBlocks(&ReferenceBlocks);
+    FreeTrackNetwork(&ReferenceNetwork);
+    FreeTrackNetwork(&Network);
+
+    JobSystemShutdown();
+    JobSystemInit(BenchWorkerCount);
+
+    return Same && Ordered && Edited && RangesOnMain == 0;
+}
+
+internal void
+BenchmarkTracks(i64 MapSize)
+{
+    TrackNetwork Network = {};
+    SetupBenchTracks(&Network, (u32)MapSize);
+
+    TrackRouter Router = {};
+    InitTrackRouter(&Router, &Network);
+
+    RunBenchmark("route_clusters", MapSize, 1, [&](u64 Iteration)
+                 {
+                     for (usize c = 0; c < Router.Clusters.size(); ++c)
+                     {
+                         MarkTrackClusterDirty(&Router, (u32)c);
+                     }
+
+                     UpdateTrackRouter(&Router, &Network);
+                 });
+
+    // Random pieces, so nearly every route is a cache miss
+    volatile u64 Sink = 0;
+
+    RunBenchmark("route_search", MapSize, 64, [&](u64 Iteration)
+                 {
+                     for (u32 r = 0; r < 64; ++r)
+                     {
+                         const u32 From = Network.Pieces[BenchRandom() % Network.Pieces.size()].Tile;
+                         const u32 To = Network.Pieces[BenchRandom() % Network.Pieces.size()].Tile;
+
+                         const std::vector<u32> *Route = FindTrackRoute(&Router, &Network, From / Network.WorldSize, From % Network.WorldSize, To / Network.WorldSize, To % Network.WorldSize);
+                         Sink = Sink + ((Route != NULL) ? Route->size() : 0);
+                     }
+                 });
+
+    // The same few pairs over and over, like trains running their timetables
+    std::vector<u32> Pairs(BENCH_ROUTE_PAIRS * 2);
+    for (u32 &Tile : Pairs)
+    {
+        Tile = Network.Pieces[BenchRandom() % Network.Pieces.size()].Tile;
+    }
+
+    RunBenchmark("route_cached", MapSize, BENCH_ROUTE_PAIRS, [&](u64 Iteration)
+                 {
+                     for (u32 p = 0; p < BENCH_ROUTE_PAIRS; ++p)
+                     {
+                         const u32 From = Pairs[p * 2];
+                         const u32 To = Pairs[p * 2 + 1];
+
+                         const std::vector<u32> *Route = FindTrackRoute(&Router, &Network, From / Network.WorldSize, From % Network.WorldSize, To / Network.WorldSize, To % Network.WorldSize);
+                         Sink = Sink + ((Route != NULL) ? Route->size() : 0);
+                     }
+                 });
+
+    FreeTrackRouter(&Router);
+
+    // Trains of a locomotive and 4 carriages on random pieces, one tick is one op
+    TrackBlocks Blocks = {};
+    TrainSim Sim = {};
+    SpawnBenchTrains(&Sim, &Network, &Blocks);
+
+    RunBenchmark("train_tick", MapSize, 1, [&](u64 Iteration)
+                 {
+                     TickTrainSim(&Sim, &Network, &Blocks, BENCH_TICK);
+                 });
+
+    FreeTrainSim(&Sim);
+    FreeTrackBlocks(&Blocks);
+    FreeTrackNetwork(&Network);
+}
+
+// The footprint culling against IsBoxInFrustum on every tile, for random cameras anywhere over
+// the map looking anywhere below the horizon. On flat ground the tiles have to be the same, with
+// random heights the footprint may only keep more
+internal bool
+CheckGroundFootprint(void)
+{
+    const i64 MapSize = 256;
+    const f32 Aspect = (f32)BENCH_SCREEN_WIDTH / (f32)BENCH_SCREEN_HEIGHT;
+    bool Passed = true;
+
+    GroundTileStore Tiles = {0};
+    GroundQuadtree Tree = {0};
+    SetupBenchWorld(&Tiles, &Tree, MapSize);
+
+    GroundFootprint Footprint = {};
+    FrameArray<u32> VisibleTileIds = {0};
+    std::vector<u8> Reference(Tiles.Count);
+
+    for (u32 Hills = 0; Hills < 2; ++Hills)
+    {
+        if (Hills)
+        {
+            for (usize Id = 0; Id < Tiles.Count; ++Id)
+            {
+                SetGroundTileGeometry(&Tiles, Id, BenchRandomRange(0.0f, 12.0f));
+            }
+            UpdateGroundSurfaceRange(&Tiles);
+        }
+
+        usize Missing = 0;
+        usize Extra = 0;
+        usize Visible = 0;
+
+        for (u32 v = 0; v < BENCH_FOOTPRINT_VIEWS; ++v)
+        {
+            const f32 Extent = MapSize * Tiles.TileSize * 0.75f;
+
+            Camera3D Camera = {};
+            Camera.position = (Vector3){BenchRandomRange(-Extent, Extent), BenchRandomRange(40.0f, 1200.0f), BenchRandomRange(-Extent, Extent)};
+            Camera.target = (Vector3){BenchRandomRange(-Extent, Extent), BenchRandomRange(-200.0f, 0.0f), BenchRandomRange(-Extent, Extent)};
+            Camera.up = (Vector3){0.0f, 1.0f, 0.0f};
+            Camera.fovy = BenchRandomRange(30.0f, 110.0f);
+            Camera.projection = CAMERA_PERSPECTIVE;
+
+            const Frustum CameraFrustum = CalculateFrustumAspect(Camera, Aspect);
+
+            usize Expected = 0;
+            for (usize Id = 0; Id < Tiles.Count; ++Id)
+            {
+                const BoundingBox Box = GetTileBoundingBox(&Tiles, Id);
+                Reference[Id] = (u8)IsBoxInFrustum(&CameraFrustum, &Box);
+                Expected += Reference[Id];
+            }
+
+            ResetFrameArena(&BenchArena);
+            VisibleTileIds = MakeFrameArray<u32>(&BenchArena, VisibleTileIds.Count);
+            CullGroundFootprint(&Footprint, &Tiles, &CameraFrustum, &VisibleTileIds);
+
+            usize Found = 0;
+            for (usize i = 0; i < VisibleTileIds.Count; ++i)
+            {
+                Found += Reference[VisibleTileIds[i]];
+                Extra += !Reference[VisibleTileIds[i]];
+            }
+
+            Missing += Expected - Found;
+            Visible += Expected;
+        }
+
+        printf("\tground footprint: %s, %u views, %zu tiles in view, %zu missing, %zu extra\n",
+               Hills ? "hills" : "flat", BENCH_FOOTPRINT_VIEWS, Visible, Missing, Extra);
+
+        Passed = Passed && Missing == 0 && (Hills || Extra == 0);
+    }
+
+    FreeGroundQuadtree(&Tree);
+    FreeGroundTileStore(&Tiles);
+
+    return Passed;
+}
+
+// The shader rebuilds the tile transforms from the packed records, every tile of the heightmap
+// has to come back with its own grid position, material and transform. The materials run
+// through all TERRAIN_MAX_MATERIALS so every bit of the record is used
+internal bool
+CheckTerrainInstancePacking(void)
+{
+    const i64 MapSize = 256;
+
+    GroundTileStore Tiles = {0};
+    GroundQuadtree Tree = {0};
+    SetupBenchWorld(&Tiles, &Tree, MapSize);
+    RaiseBenchHills(&Tiles, &Tree);
+
+    for (usize Id = 0; Id < Tiles.Count; ++Id)
+    {
+        Tiles.MaterialIndex[Id] = (u8)(Id % TERRAIN_MAX_MATERIALS);
+    }
+
+    const TerrainLayout Layout = MakeTerrainLayout(&Tiles);
+
+    usize WrongTiles = 0;
+    usize WrongTransforms = 0;
+
+    for (usize Id = 0; Id < Tiles.Count; ++Id)
+    {
+        const u32 Packed = PackGroundTile(&Tiles, Id);
+
+        u32 X, Z, Material;
+        UnpackTileInstance(Packed, &X, &Z, &Material);
+        WrongTiles += ((usize)((X - Tiles.OriginI) * Tiles.MapSize + (Z - Tiles.OriginJ)) != Id) || (Material != Tiles.MaterialIndex[Id]);
+
+        const Matrix Reconstructed = ReconstructTileTransform(&Layout, Packed, GetTilePosition(&Tiles, Id).y);
+        const f32 *A = (const f32 *)&Reconstructed;
+        const f32 *B = (const f32 *)&Tiles.Transforms[Id];
+
+        bool Same = true;
+        for (u32 e = 0; e < 16; ++e)
+        {
+            Same = Same && fabsf(A[e] - B[e]) <= 0.001f;
+        }
+        WrongTransforms += !Same;
+    }
+
+    printf("\tterrain packing: %zu tiles, %zu with the wrong position or material, %zu with the wrong transform\n",
+           Tiles.Count, WrongTiles, WrongTransforms);
+
+    FreeGroundQuadtree(&Tree);
+    FreeGroundTileStore(&Tiles);
+
+    return WrongTiles == 0 && WrongTransforms == 0;
+}
+
+// A random ray from above the map down to a spot on it, some of them start out over the edge
+internal Ray
+MakeBenchPickRay(const GroundTileStore *Tiles)
+{
+    const f32 Extent = Tiles->MapSize * Tiles->TileSize * 0.6f;
+
+    const Vector3 Eye = {BenchRandomRange(-Extent, Extent), BenchRandomRange(20.0f, 1200.0f), BenchRandomRange(-Extent, Extent)};
+    const Vector3 Spot = {BenchRandomRange(-Extent, Extent), BenchRandomRange(-50.0f, 50.0f), BenchRandomRange(-Extent, Extent)};
+
+    Ray Result;
+    Result.position = Eye;
+    Result.direction = Vector3Normalize(Vector3Subtract(Spot, Eye));
+
+    return Result;
+}
+
+// Walking the pyramid has to hit the same tiles as walking every cell under the ray, on the
+// heightmap and on random elevations where every tile is its own hill. The quadtree leaves
+// take their heights from the pyramid, so they are checked against the tiles too
+internal bool
+CheckGroundPicking(void)
+{
+    const i64 MapSize = 256;
+    bool Passed = true;
+
+    GroundTileStore Tiles = {0};
+    GroundQuadtree Tree = {0};
+    SetupBenchWorld(&Tiles, &Tree, MapSize);
+
+    for (u32 Terrain = 0; Terrain < 3; ++Terrain)
+    {
+        if (Terrain == 1)
+        {
+            RaiseBenchHills(&Tiles, &Tree);
+        }
+        else if (Terrain == 2)
+        {
+            for (usize Id = 0; Id < Tiles.Count; ++Id)
+            {
+                SetGroundTileGeometry(&Tiles, Id, (f32)(BenchRandom() % 8) * GROUND_TERRACE_HEIGHT);
+            }
+            UpdateGroundSurfaceRange(&Tiles);
+            RefitGroundQuadtree(&Tree, &Tiles);
+        }
+
+        usize Hits = 0;
+        usize Mismatches = 0;
+
+        for (u32 r = 0; r < BENCH_PICK_CHECK_RAYS; ++r)
+        {
+            const Ray PickRay = MakeBenchPickRay(&Tiles);
+            const TilePick Pyramid = PickTile(&Tiles, PickRay);
+            const TilePick Grid = PickTileGrid(&Tiles, PickRay);
+
+            Hits += (Grid.Id != -1);
+            // Both walks take the tile borders from the same math and break ties at edges and
+            // corners the same way, so they have to hit the very same tile, also right on a border
+            const f32 Tolerance = 0.01f + Grid.Collision.distance * 1e-5f;
+            const bool SameDistance = fabsf(Pyramid.Collision.distance - Grid.Collision.distance) <= Tolerance;
+
+            Mismatches += (Pyramid.Id != Grid.Id) || !SameDistance;
+        }
+
+        usize LooseLeaves = 0;
+        for (usize n = 0; n < Tree.NodeCount; ++n)
+        {
+            const QuadtreeNode *Node = &Tree.Nodes[n];
+            if (Node->ChildCount > 0)
+            {
+                continue;
+            }
+
+            f32 MinY = FLT_MAX;
+            f32 MaxY = -FLT_MAX;
+            for (u32 i = Node->I0; i < Node->I1; ++i)
+            {
+                for (u32 j = Node->J0; j < Node->J1; ++j)
+                {
+                    MinY = Min(MinY, Tiles.MinY[i * MapSize + j]);
+                    MaxY = Max(MaxY, Tiles.MaxY[i * MapSize + j]);
+                }
+            }
+
+            LooseLeaves += (Node->BoundingVolume.min.y != MinY) || (Node->BoundingVolume.max.y != MaxY);
+        }
+
+        const char *TerrainNames[3] = {"flat", "hills", "random"};
+        printf("\tground picking: %s, %u rays, %zu hits, %zu mismatches, %zu leaves with wrong heights\n",
+               TerrainNames[Terrain], BENCH_PICK_CHECK_RAYS, Hits, Mismatches, LooseLeaves);
+
+        Passed = Passed && Mismatches == 0 && LooseLeaves == 0;
+    }
+
+    FreeGroundQuadtree(&Tree);
+    FreeGroundTileStore(&Tiles);
+
+    return Passed;
+}
+
+// BENCH_LIGHT_COUNT lights in view of the camera, around the ground it looks at
+internal void
+SetupBenchLights(LightClusters *Clusters, const Camera3D *Camera, f32 Aspect)
+{
+    const Frustum CameraFrustum = CalculateFrustumAspect(*Camera, Aspect);
+    const f32 Extent = Vector3Distance(Camera->position, Camera->target) * 2.0f;
+
+    ResetFrameArena(&BenchArena);
+    BeginLightClusters(Clusters, &BenchArena);
+
+    while (Clusters->Lights.Count < BENCH_LIGHT_COUNT)
+    {
+        const Vector3 Position = {
+            Camera->target.x + BenchRandomRange(-Extent, Extent),
+            BenchRandomRange(2.0f, 48.0f),
+            Camera->target.z + BenchRandomRange(-Extent, Extent),
+        };
+
+        AddPointLight(Clusters, &CameraFrustum, Position, BenchRandomRange(32.0f, 128.0f), WHITE);
+    }
+}
+
+// Bins the lights of random views and looks the lights up like the fragment shader does, for
+// random points inside every light: the cluster a lit point is in has to list the light. Then
+// times the binning of BENCH_LIGHT_COUNT lights, one bin of all of them is one op, and fails
+// when it takes longer than BENCH_LIGHT_BUDGET_MS
+internal bool
+BenchmarkLightClusters(void)
+{
+    const f32 Aspect = (f32)BENCH_SCREEN_WIDTH / (f32)BENCH_SCREEN_HEIGHT;
+
+    LightClusters Lights = {};
+    LightClusters *Clusters = &Lights;
+    std::vector<u8> Listed;
+
+    usize Missing = 0;
+    usize Points = 0;
+    usize Total = 0;
+    u32 Dropped = 0;
+
+    for (u32 v = 0; v < BENCH_LIGHT_VIEWS; ++v)
+    {
+        Camera3D Camera = {};
+        Camera.target = (Vector3){BenchRandomRange(-2000.0f, 2000.0f), 0.0f, BenchRandomRange(-2000.0f, 2000.0f)};
+        Camera.position = Vector3Add(Camera.target, (Vector3){BenchRandomRange(-400.0f, 400.0f), BenchRandomRange(40.0f, 900.0f), BenchRandomRange(-400.0f, 400.0f)});
+        Camera.up = (Vector3){0.0f, 1.0f, 0.0f};
+        Camera.fovy = BenchRandomRange(45.0f, 100.0f);
+        Camera.projection = CAMERA_PERSPECTIVE;
+
+        SetupBenchLights(Clusters, &Camera, Aspect);
+        BinLightClusters(Clusters, &Camera, Aspect);
+
+        const usize LightCount = Clusters->Lights.Count;
+        Listed.assign(LightCount * LIGHT_CLUSTER_COUNT, 0);
+
+        for (u32 c = 0; c < LIGHT_CLUSTER_COUNT; ++c)
+        {
+            for (u32 i = 0; i < Clusters->Count[c]; ++i)
+            {
+                Listed[Clusters->Indices[Clusters->Offset[c] + i] * LIGHT_CLUSTER_COUNT + c] = 1;
+            }
+        }
+
+        for (usize l = 0; l < LightCount; ++l)
+        {
+            const PointLight *Light = &Clusters->Lights[l];
+
+            for (u32 p = 0; p < BENCH_LIGHT_POINTS; ++p)
+            {
+                Vector3 Offset;
+                do
+                {
+                    Offset = (Vector3){BenchRandomRange(-1.0f, 1.0f), BenchRandomRange(-1.0f, 1.0f), BenchRandomRange(-1.0f, 1.0f)};
+                } while (Vector3Length(Offset) >= 1.0f);
+
+                const Vector3 Point = Vector3Transform(Vector3Add(Light->Position, Vector3Scale(Offset, Light->Radius)), Clusters->View);
+                const f32 Depth = -Point.z;
+                const f32 X = Point.x / (Depth * Clusters->TanX);
+                const f32 Y = Point.y / (Depth * Clusters->TanY);
+
+                // Only points on screen are drawn
+                if (Depth < LIGHT_CLUSTER_CAMERA_NEAR || Depth > LIGHT_CLUSTER_FAR || fabsf(X) > 1.0f || fabsf(Y) > 1.0f)
+                {
+                    continue;
+                }
+
+                const u32 c = GetLightClusterIndex(GetLightClusterTile(X, LIGHT_CLUSTERS_X), GetLightClusterTile(Y, LIGHT_CLUSTERS_Y), GetLightClusterSlice(Clusters, Depth));
+
+                Missing += !Listed[l * LIGHT_CLUSTER_COUNT + c];
+                Points++;
+            }
+        }
+
+        Total += Clusters->Indices.Count;
+        Dropped += Clusters->Dropped;
+    }
+
+    printf("\tlight clusters: %u views, %u lights, %.1f lights per cluster, %zu lit points, %zu missing, %u dropped\n",
+           BENCH_LIGHT_VIEWS, BENCH_LIGHT_COUNT, (f64)Total / (BENCH_LIGHT_VIEWS * LIGHT_CLUSTER_COUNT), Points, Missing, Dropped);
+
+    // The game camera
+    Camera3D Camera = {};
+    Camera.target = (Vector3){0.0f, 0.0f, 0.0f};
+    Camera.position = (Vector3){180.0f, 360.0f, 180.0f};
+    Camera.up = (Vector3){0.0f, 1.0f, 0.0f};
+    Camera.fovy = 75.0f;
+    Camera.projection = CAMERA_PERSPECTIVE;
+
+    SetupBenchLights(Clusters, &Camera, Aspect);
+
+    // The lights stay where they are, only what BinLightClusters makes is reset
+    const usize LightsUsed = BenchArena.Used;
+
+    const BenchResult Binning = RunBenchmarkPer("light_binning", 0, 1, "light", BENCH_LIGHT_COUNT, [&](u64 Iteration)
+                                                {
+                                                    BenchArena.Used = LightsUsed;
+                                                    BinLightClusters(Clusters, &Camera, Aspect);
+                                                });
+
+    const f64 BinningMs = Binning.NsPerOp * 1e-6;
+    printf("\tlight binning: %.3f ms for %u lights, %s the %.1f ms budget\n",
+           BinningMs, BENCH_LIGHT_COUNT, (BinningMs <= BENCH_LIGHT_BUDGET_MS) ? "within" : "OVER", BENCH_LIGHT_BUDGET_MS);
+
+    FreeLightClusters(Clusters);
+
+    return Missing == 0 && Dropped == 0 && BinningMs <= BENCH_LIGHT_BUDGET_MS;
+}
+
+// Runs the game's frame without a window over a cycle of pans, zoom steps and tile edits:
+// the ground instance list, a tick of the trains and their snapshot, the train transforms and
+// the point lights. After the first cycle the frames may not allocate anything: no operator
+// new, no overflow block from the frame arena and no growing it. Only operator new is counted
+// on the heap, malloc, calloc and raylib's MemAlloc called directly do not show up here
+internal bool
+CheckFrameAllocations(void)
+{
+    const i64 MapSize = 256;
+    const f32 Aspect = (f32)BENCH_SCREEN_WIDTH / (f32)BENCH_SCREEN_HEIGHT;
+
+    GroundTileStore Tiles = {0};
+    GroundQuadtree Tree = {0};
+    SetupBenchWorld(&Tiles, &Tree, MapSize);
+
+    GroundBatches Batches = {};
+    InitGroundBatches(&Batches, &Tree, &Tiles);
+    Batches.UseFootprint = true;
+
+    TrackNetwork Network = {};
+    SetupBenchTracks(&Network, (u32)MapSize);
+
+    TrackBlocks Blocks = {};
+    TrainSim Sim = {};
+    SpawnBenchTrains(&Sim, &Network, &Blocks);
+
+    TrainSnapshot Snapshot = {};
+    WriteTrainSnapshot(&Snapshot, &Sim);
+
+    TrainBatches Trains = {};
+    for (u32 m = 0; m < TRAIN_MODEL_COUNT; ++m)
+    {
+        Trains.Basis[m] = MatrixIdentity();
+    }
+
+    LightClusters Lights = {};
+
+    // A fresh arena, so it has to find its size on its own
+    FrameArena Arena;
+    InitFrameArena(&Arena, FRAME_ARENA_GRANULARITY);
+
+    // A few views a zoom step apart, panned around between the steps
+    Camera3D Views[4];
+    for (u32 v = 0; v < ArrayCount(Views); ++v)
+    {
+        Views[v] = MakeBenchCamera(&Tiles, v);
+        Views[v].target = (Vector3){0.0f, 0.0f, 0.0f};
+        Views[v].position = (Vector3){180.0f, Views[v].position.y, 180.0f};
+    }
+
+    const u32 FramesPerView = BENCH_FRAME_CYCLE / ArrayCount(Views);
+
+    u64 Allocations = 0;
+    u64 Overflows = 0;
+    u64 Grows = 0;
+
+    for (u32 Frame = 0; Frame < BENCH_FRAME_CYCLE + BENCH_ALLOCATION_FRAMES; ++Frame)
+    {
+        if (Frame == BENCH_FRAME_CYCLE)
+        {
+            Allocations = BenchHeapAllocations.load();
+            Overflows = Arena.OverflowBlocks;
+            Grows = Arena.Grows;
+        }
+
+        ResetFrameArena(&Arena);
+
+        const u32 Step = Frame % BENCH_FRAME_CYCLE;
+        const f32 Pan = (f32)(Step % FramesPerView) * 12.0f;
+
+        Camera3D Camera = Views[Step / FramesPerView];
+        Camera.position = Vector3Add(Camera.position, (Vector3){Pan, 0.0f, Pan});
+        Camera.target = Vector3Add(Camera.target, (Vector3){Pan, 0.0f, Pan});
+
+        const Frustum CameraFrustum = CalculateFrustumAspect(Camera, Aspect);
+
+        if (Step % 8 == 0)
+        {
+            const usize Id = BenchRandom() % Tiles.Count;
+            Tiles.MaterialIndex[Id] = (u8)(BenchRandom() % GROUND_MATERIAL_COUNT);
+            InvalidateGroundTile(&Batches, Id);
+        }
+
+        UpdateGroundBatches(&Batches, &Tree, &Tiles, &CameraFrustum, NULL, &Camera, BENCH_SCREEN_WIDTH, BENCH_SCREEN_HEIGHT, &Arena);
+
+        // What the simulation thread does for every tick
+        CopyTrainPoses(&Snapshot.From, &Sim);
+        TickTrainSim(&Sim, &Network, &Blocks, SIM_TICK_SECONDS);
+        WriteTrainSnapshot(&Snapshot, &Sim);
+
+        BuildTrainBatches(&Trains, &Snapshot, 0.5f, &CameraFrustum, &Arena);
+
+        // Headlights and a lamp on every fourth piece, like the game
+        BeginLightClusters(&Lights, &Arena);
+
+        for (const u32 Front : Snapshot.Front)
+        {
+            AddPointLight(&Lights, &CameraFrustum, GetTrainSnapshotPosition(&Snapshot, Front, 0.5f), 96.0f, WHITE);
+        }
+
+        for (const TrackPiece &Piece : Network.Pieces)
+        {
+            if ((Piece.Tile / Network.WorldSize + Piece.Tile % Network.WorldSize) % 4 == 0)
+            {
+                AddPointLight(&Lights, &CameraFrustum, GetTrackPieceCenter(&Network, Tiles.TileSize, Piece.Tile), 80.0f, WHITE);
+            }
+        }
+
+        BinLightClusters(&Lights, &Camera, Aspect);
+    }
+
+    // The last frame only shows up in the arena on the next reset
+    ResetFrameArena(&Arena);
+
+    Allocations = BenchHeapAllocations.load() - Allocations;
+    Overflows = Arena.OverflowBlocks - Overflows;
+    Grows = Arena.Grows - Grows;
+
+    printf("\tframe allocations: %u frames, %lu heap allocations, %lu frame arena overflow blocks, frame arena grew %lu times, %zu KB used at most (%zu KB block)\n",
+           BENCH_ALLOCATION_FRAMES, Allocations, Overflows, Grows, Arena.HighWater / 1024, Arena.Size / 1024);
+
+    FreeFrameArena(&Arena);
+    FreeLightClusters(&Lights);
+    FreeTrainBatches(&Trains);
+    FreeGroundBatches(&Batches);
+    FreeTrainSim(&Sim);
+    FreeTrackBlocks(&Blocks);
+    FreeTrackNetwork(&Network);
+    FreeGroundQuadtree(&Tree);
+    FreeGroundTileStore(&Tiles);
+
+    return Allocations == 0 && Overflows == 0 && Grows == 0;
+}
+
+// Loading every model from its GLB against loading it from the model cache, loading all of them
+// is one op and the time is also given per model.
+// False when a cached model is not the one decoded from its GLB
+internal bool
+BenchmarkModels(const char *SourceDirectory, const char *CachePath)
+{
+    if (!CookModelCache(CachePath, SourceDirectory))
+    {
+        return false;
+    }
+
+    ModelCache Cache = {};
+    if (!OpenModelCache(&Cache, CachePath))
+    {
+        return false;
+    }
+
+    const u32 ModelCount = Cache.Header->EntryCount;
+    bool Passed = ModelCount > 0;
+
+    for (u32 e = 0; e < ModelCount; ++e)
+    {
+        const char *Path = Cache.Entries[e].Path;
+        const std::string Directory = std::string(Path).substr(0, std::string(Path).find_last_of('/'));
+
+        std::vector<u8> Bytes;
+        GlbModel Decoded;
+        GlbModel Mapped;
+
+        bool Same = ReadAssetFile(Path, &Bytes) && DecodeGlbModel(Bytes.data(), Bytes.size(), Directory.c_str(), &Decoded) &&
+                    MapCachedModel(&Cache, &Cache.Entries[e], &Mapped) && Decoded.Meshes.size() == Mapped.Meshes.size() &&
+                    Decoded.Materials.size() == Mapped.Materials.size() && Decoded.MeshMaterial == Mapped.MeshMaterial;
+
+        for (usize i = 0; Same && i < Decoded.Meshes.size(); ++i)
+        {
+            const Mesh *A = &Decoded.Meshes[i];
+            const Mesh *B = &Mapped.Meshes[i];
+
+            Same = A->vertexCount == B->vertexCount && A->triangleCount == B->triangleCount &&
+                   memcmp(A->vertices, B->vertices, A->vertexCount * 3 * sizeof(f32)) == 0 &&
+                   (A->indices == NULL || memcmp(A->indices, B->indices, A->triangleCount * 3 * sizeof(u16)) == 0);
+        }
+
+        if (!Same)
+        {
+            printf("\tERROR: The cached %s is not the one in the GLB\n", Path);
+            Passed = false;
+        }
+
+        FreeGlbModel(&Decoded);
+        FreeGlbModel(&Mapped);
+    }
+
+    RunBenchmarkPer("model_glb", 0, 1, "model", ModelCount, [&](u64 Iteration)
+                    {
+                        for (u32 e = 0; e < ModelCount; ++e)
+                        {
+                            const char *Path = Cache.Entries[e].Path;
+                            const std::string Directory = std::string(Path).substr(0, std::string(Path).find_last_of('/'));
+
+                            std::vector<u8> Bytes;
+                            GlbModel Model;
+                            ReadAssetFile(Path, &Bytes);
+                            DecodeGlbModel(Bytes.data(), Bytes.size(), Directory.c_str(), &Model);
+                            FreeGlbModel(&Model);
+                        }
+                    });
+
+    // What the asset loader does for an unchanged GLB
+    RunBenchmarkPer("model_cache", 0, 1, "model", ModelCount, [&](u64 Iteration)
+                    {
+                        for (u32 e = 0; e < ModelCount; ++e)
+                        {
+                            const char *Path = Cache.Entries[e].Path;
+                            const ModelCacheEntry *Entry = FindModelCacheEntry(&Cache, Path);
+
+                            GlbModel Model;
+                            if (Entry != NULL && !HasModelSourceChanged(Entry, Path))
+                            {
+                                MapCachedModel(&Cache, Entry, &Model);
+                            }
+                            FreeGlbModel(&Model);
+                        }
+                    });
+
+    CloseModelCache(&Cache);
+
+    return Passed;
+}
+
+internal void
+BenchmarkMapSize(i64 MapSize)
+{
+    RunBenchmark("world_setup", MapSize, 1, [&](u64 Iteration)
+                 {
+                     GroundTileStore NewTiles = {0};
+                     GroundQuadtree NewTree = {0};
+                     SetupBenchWorld(&NewTiles, &NewTree, MapSize);
+
+                     FreeGroundQuadtree(&NewTree);
+                     FreeGroundTileStore(&NewTiles);
+                 });
+
+    GroundTileStore Tiles = {0};
+    GroundQuadtree Tree = {0};
+    SetupBenchWorld(&Tiles, &Tree, MapSize);
+
+    const f32 Aspect = (f32)BENCH_SCREEN_WIDTH / (f32)BENCH_SCREEN_HEIGHT;
+
+    Camera3D Cameras[BENCH_VIEW_COUNT];
+    for (u32 v = 0; v < BENCH_VIEW_COUNT; ++v)
+    {
+        Cameras[v] = MakeBenchCamera(&Tiles, v);
+    }
+
+    // Culling the way the game started out: frustum from the camera, then every tile
+    volatile u64 Sink = 0;
+
+    RunBenchmark("cull_brute", MapSize, 1, [&](u64 Iteration)
+                 {
+                     const Frustum CameraFrustum = CalculateFrustumAspect(Cameras[Iteration % BENCH_VIEW_COUNT], Aspect);
+
+                     u64 Visible = 0;
+                     for (usize Id = 0; Id < Tiles.Count; ++Id)
+                     {
+                         const BoundingBox Box = GetTileBoundingBox(&Tiles, Id);
+                         Visible += IsBoxInFrustum(&CameraFrustum, &Box);
+                     }
+
+                     Sink = Sink + Visible;
+                 });
+
+    FrameArray<u32> VisibleTileIds = {0};
+
+    RunBenchmark("cull_quadtree", MapSize, 1, [&](u64 Iteration)
+                 {
+                     ResetFrameArena(&BenchArena);
+                     VisibleTileIds = MakeFrameArray<u32>(&BenchArena, VisibleTileIds.Count);
+
+                     const Frustum CameraFrustum = CalculateFrustumAspect(Cameras[Iteration % BENCH_VIEW_COUNT], Aspect);
+                     CullGroundQuadtree(&Tree, &Tiles, &CameraFrustum, &VisibleTileIds);
+
+                     Sink = Sink + VisibleTileIds.Count;
+                 });
+
+    GroundFootprint Footprint = {};
+
+    RunBenchmark("cull_footprint", MapSize, 1, [&](u64 Iteration)
+                 {
+                     ResetFrameArena(&BenchArena);
+                     VisibleTileIds = MakeFrameArray<u32>(&BenchArena, VisibleTileIds.Count);
+
+                     const Frustum CameraFrustum = CalculateFrustumAspect(Cameras[Iteration % BENCH_VIEW_COUNT], Aspect);
+                     CullGroundFootprint(&Footprint, &Tiles, &CameraFrustum, &VisibleTileIds);
+
+                     Sink = Sink + VisibleTileIds.Count;
+                 });
+
+    // Instance list building, a full rebuild for a new view and the incremental update for a pan
+    GroundBatches Batches = {};
+    InitGroundBatches(&Batches, &Tree, &Tiles);
+
+    RunBenchmark("batches_full", MapSize, 1, [&](u64 Iteration)
+                 {
+                     ResetFrameArena(&BenchArena);
+
+                     const Frustum CameraFrustum = CalculateFrustumAspect(Cameras[Iteration % BENCH_VIEW_COUNT], Aspect);
+                     BuildGroundBatches(&Batches, &Tree, &Tiles, &CameraFrustum, NULL, &BenchArena);
+
+                     Sink = Sink + Batches.InViewCount;
+                 });
+
+    Batches.UseFootprint = true;
+
+    RunBenchmark("batches_spans", MapSize, 1, [&](u64 Iteration)
+                 {
+                     ResetFrameArena(&BenchArena);
+
+                     const Frustum CameraFrustum = CalculateFrustumAspect(Cameras[Iteration % BENCH_VIEW_COUNT], Aspect);
+                     BuildGroundBatches(&Batches, &Tree, &Tiles, &CameraFrustum, NULL, &BenchArena);
+
+                     Sink = Sink + Batches.InViewCount;
+                 });
+
+    Batches.UseFootprint = false;
+
+    {
+        Camera3D Camera = Cameras[0];
+        Batches.Valid = false;
+
+        RunBenchmark("batches_pan", MapSize, 1, [&](u64 Iteration)
+                     {
+                         // Back and forth like dragging with the right mouse button
+                         const f32 Delta = ((Iteration / 64) % 2 == 0) ? 12.0f : -12.0f;
+                         Camera.position.x += Delta;
+                         Camera.target.x += Delta;
+                         Camera.position.z += Delta;
+                         Camera.target.z += Delta;
+
+                         ResetFrameArena(&BenchArena);
+
+                         const Frustum CameraFrustum = CalculateFrustumAspect(Camera, Aspect);
+                         UpdateGroundBatches(&Batches, &Tree, &Tiles, &CameraFrustum, NULL, &Camera, BENCH_SCREEN_WIDTH, BENCH_SCREEN_HEIGHT, &BenchArena);
+
+                         Sink = Sink + Batches.InViewCount;
+                     });
+    }
+
+    FreeGroundBatches(&Batches);
+
+    // Picking, mouse rays from the camera to random spots around its target
+    std::vector<Ray> Rays(BENCH_RAY_COUNT);
+    for (u32 r = 0; r < BENCH_RAY_COUNT; ++r)
+    {
+        const Camera3D *Camera = &Cameras[r % BENCH_VIEW_COUNT];
+        const Vector3 Spot = Vector3Add(Camera->target, (Vector3){BenchRandomRange(-600.0f, 600.0f), 0.0f, BenchRandomRange(-600.0f, 600.0f)});
+
+        Rays[r].position = Camera->position;
+        Rays[r].direction = Vector3Normalize(Vector3Subtract(Spot, Camera->position));
+    }
+
+    RunBenchmark("pick", MapSize, BENCH_RAY_COUNT, [&](u64 Iteration)
+                 {
+                     i64 Hits = 0;
+                     for (u32 r = 0; r < BENCH_RAY_COUNT; ++r)
+                     {
+                         Hits += (PickTile(&Tiles, Rays[r]).Id != -1);
+                     }
+
+                     Sink = Sink + Hits;
+                 });
+
+    // The same views and rays over the heightmap, they should cost about what the flat map does
+    RaiseBenchHills(&Tiles, &Tree);
+
+    RunBenchmark("cull_quadtree_hills", MapSize, 1, [&](u64 Iteration)
+                 {
+                     ResetFrameArena(&BenchArena);
+                     VisibleTileIds = MakeFrameArray<u32>(&BenchArena, VisibleTileIds.Count);
+
+                     const Frustum CameraFrustum = CalculateFrustumAspect(Cameras[Iteration % BENCH_VIEW_COUNT], Aspect);
+                     CullGroundQuadtree(&Tree, &Tiles, &CameraFrustum, &VisibleTileIds);
+
+                     Sink = Sink + VisibleTileIds.Count;
+                 });
+
+    RunBenchmark("pick_hills", MapSize, BENCH_RAY_COUNT, [&](u64 Iteration)
+                 {
+                     i64 Hits = 0;
+                     for (u32 r = 0; r < BENCH_RAY_COUNT; ++r)
+                     {
+                         Hits += (PickTile(&Tiles, Rays[r]).Id != -1);
+                     }
+
+                     Sink = Sink + Hits;
+                 });
+
+    RunBenchmark("pick_grid_hills", MapSize, BENCH_RAY_COUNT, [&](u64 Iteration)
+                 {
+                     i64 Hits = 0;
+                     for (u32 r = 0; r < BENCH_RAY_COUNT; ++r)
+                     {
+                         Hits += (PickTileGrid(&Tiles, Rays[r]).Id != -1);
+                     }
+
+                     Sink = Sink + Hits;
+                 });
+
+    FreeGroundQuadtree(&Tree);
+    FreeGroundTileStore(&Tiles);
+
+    BenchmarkTracks(MapSize);
+}
+
+internal bool
+WriteBenchResults(const char *Path)
+{
+    FILE *File = fopen(Path, "w");
+    if (File == NULL)
+    {
+        printf("\tERROR: Could not open %s for writing\n", Path);
+        return false;
+    }
+
+    fprintf(File, "{\n  \"workers\": %u,\n  \"cull_kernel\": \"%s\",\n  \"results\": [\n", BenchWorkerCount, CullTileRunName);
+
+    for (usize r = 0; r < BenchResults.size(); ++r)
+    {
+        const BenchResult *Result = &BenchResults[r];
+
+        fprintf(File, "    {\"name\": \"%s\", \"map_size\": %ld, \"iterations\": %lu, \"ns_per_op\": %.3f, \"ns_per_%s\": %.6f, \"%ss_per_second\": %.0f}%s\n",
+                Result->Name.c_str(), Result->MapSize, Result->Iterations, Result->NsPerOp, Result->Unit, Result->NsPerUnit, Result->Unit, Result->UnitsPerSecond,
+                (r + 1 < BenchResults.size()) ? "," : "");
+    }
+
+    fprintf(File, "  ]\n}\n");
+    fclose(File);
+
+    printf("\n\tWrote %s\n", Path);
+
+    return true;
+}
+
+// Reads a file written by WriteBenchResults and compares the ns/op of the results both runs
+// have. Returns false when one got slower than BENCH_REGRESSION_LIMIT allows
+internal bool
+CompareBenchResults(const char *Path)
+{
+    FILE *File = fopen(Path, "r");
+    if (File == NULL)
+    {
+        printf("\tERROR: Could not open baseline %s\n", Path);
+        return false;
+    }
+
+    printf("\n\tCompared to %s\n", Path);
+
+    bool Passed = true;
+    char Line[512];
+
+    while (fgets(Line, sizeof(Line), File) != NULL)
+    {
+        char Name[64];
+        i64 MapSize = 0;
+        u64 Iterations = 0;
+        f64 NsPerOp = 0.0;
+
+        if (sscanf(Line, " {\"name\": \"%63[^\"]\", \"map_size\": %ld, \"iterations\": %lu, \"ns_per_op\": %lf", Name, &MapSize, &Iterations, &NsPerOp) != 4)
+        {
+            continue;
+        }
+
+        for (const BenchResult &Result : BenchResults)
+        {
+            if (Result.Name != Name || Result.MapSize != MapSize)
+            {
+                continue;
+            }
+
+            const f64 Ratio = Result.NsPerOp / NsPerOp;
+            const bool Regressed = Ratio > BENCH_REGRESSION_LIMIT;
+            Passed = Passed && !Regressed;
+
+            char Size[16];
+            FormatBenchMapSize(Size, sizeof(Size), MapSize);
+
+            printf("\t%-16s %7s %8.2fx %s\n", Name, Size, Ratio, Regressed ? "REGRESSED" : "ok");
+        }
+    }
+
+    fclose(File);
+
+    return Passed;
+}
+
+i32 main(i32 argc, char **argv)
+{
+    const char *JsonPath = NULL;
+    const char *BaselinePath = NULL;
+    const char *ModelsPath = NULL;
+    const char *ModelCachePath = "models.cache";
+    std::vector<i64> MapSizes;
+
+    for (i32 i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+        {
+            JsonPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+        {
+            BaselinePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--models") == 0 && i + 1 < argc)
+        {
+            ModelsPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--model-cache") == 0 && i + 1 < argc)
+        {
+            ModelCachePath = argv[++i];
+        }
+        else if (atoi(argv[i]) > 0)
+        {
+            MapSizes.push_back(atoi(argv[i]));
+        }
+    }
+
+    if (MapSizes.empty())
+    {
+        MapSizes = {256, 1024, 4096};
+    }
+
+    SetupFrustumCullingKernel();
+    JobSystemInit(0);
+    BenchWorkerCount = Jobs.WorkerCount;
+    InitFrameArena(&BenchArena, Megabytes(1));
+
+    printf("\tHello from the raylib_orthographic benchmarks!\n");
+    printf("\tJob system workers: %u, frustum culling kernel: %s\n\n", Jobs.WorkerCount, CullTileRunName);
+
+    for (i64 MapSize : MapSizes)
+    {
+        BenchmarkMapSize(MapSize);
+        printf("\n");
+    }
+
+    bool Passed = CheckTrackLinks();
+    Passed = CheckTrackRoutes() && Passed;
+    Passed = CheckTrainTicks() && Passed;
+    Passed = CheckSimThread() && Passed;
+    Passed = CheckGroundFootprint() && Passed;
+    Passed = CheckTerrainInstancePacking() && Passed;
+    Passed = CheckGroundPicking() && Passed;
+    Passed = BenchmarkLightClusters() && Passed;
+    Passed = CheckFrameAllocations() && Passed;
+
+    if (ModelsPath != NULL)
+    {
+        printf("\n");
+        Passed = BenchmarkModels(ModelsPath, ModelCachePath) && Passed;
+    }
+
+    JobSystemShutdown();
+    FreeFrameArena(&BenchArena);
+
+    // @Note(Victor): There should be no allocated memory left
+    Assert(CPUMemory == 0);
+
+    if (JsonPath != NULL)
+    {
+        Passed = WriteBenchResults(JsonPath) && Passed;
+    }
+
+    if (BaselinePath != NULL)
+    {
+        Passed = CompareBenchResults(BaselinePath) && Passed;
+    }
+
+    return Passed ? 0 : 1;
+}
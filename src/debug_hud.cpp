@@ -0,0 +1,311 @@
+// Debug HUD -------------------------------------------------
+// Retained text for the debug overlay, it stays on in the QA builds so it has to stay out of the
+// frame times. A label keeps its text and the glyph quads laid out from it. SetHudLabel formats
+// into a scratch buffer and only marks the label when the text is not the one it already has,
+// DrawHud lays the marked labels out again and rebuilds the quads when anything changed.
+//
+// Every quad lives in one dynamic mesh with the font texture, the shadows of all the labels first
+// and then their texts, so the whole HUD is one DrawMesh instead of two DrawTextEx per label.
+// The layout is the one DrawTextEx does, without newlines.
+const u32 HUD_MAX_TEXT = 128;
+const u32 HUD_MAX_QUADS = 4096; // Glyphs of all the labels, shadows included. 4 vertices each, raylib meshes use 16-bit indices
+const f32 HUD_SHADOW_OFFSET = 3.0f;
+
+struct HudGlyph
+{
+    Rectangle Dest;   // Pixels from the label position
+    Rectangle Source; // Texture coordinates in the font atlas
+};
+
+struct HudLabel
+{
+    Vector2 Position; // Of the shadow, the text is HUD_SHADOW_OFFSET down and right
+    f32 FontSize;
+    f32 Spacing;
+    bool Visible;
+    bool Stale; // The glyphs are not laid out from Text
+    char Text[HUD_MAX_TEXT];
+    std::vector<HudGlyph> Glyphs;
+};
+
+struct DebugHud
+{
+    std::vector<HudLabel> Labels;
+    u32 FontTexture; // Font the glyphs were laid out with
+    bool Stale;      // The quads are not built from the labels
+    u32 QuadCount;
+    u64 Layouts; // Labels laid out so far
+
+    Mesh Quads; // The vertex arrays are kept, they are where the quads are built
+    Material HudMaterial;
+};
+
+// Needs the OpenGL context
+internal void
+InitDebugHud(DebugHud *Hud, u32 LabelCount)
+{
+    Hud->Labels.resize(LabelCount);
+    Hud->FontTexture = 0;
+    Hud->Stale = true;
+    Hud->QuadCount = 0;
+    Hud->Layouts = 0;
+
+    Mesh *Quads = &Hud->Quads;
+    *Quads = {0};
+    Quads->vertexCount = HUD_MAX_QUADS * 4;
+    Quads->triangleCount = HUD_MAX_QUADS * 2;
+    Quads->vertices = (f32 *)MemAlloc(Quads->vertexCount * 3 * sizeof(f32));
+    Quads->texcoords = (f32 *)MemAlloc(Quads->vertexCount * 2 * sizeof(f32));
+    Quads->colors = (u8 *)MemAlloc(Quads->vertexCount * 4 * sizeof(u8));
+    Quads->indices = (u16 *)MemAlloc(Quads->triangleCount * 3 * sizeof(u16));
+
+    // Same order as rlgl turns its quads into triangles, so they face the 2D camera
+    for (u32 q = 0; q < HUD_MAX_QUADS; ++q)
+    {
+        u16 *Index = &Quads->indices[q * 6];
+        const u16 First = (u16)(q * 4);
+
+        Index[0] = First;
+        Index[1] = First + 1;
+        Index[2] = First + 2;
+        Index[3] = First;
+        Index[4] = First + 2;
+        Index[5] = First + 3;
+    }
+
+    UploadMesh(Quads, true);
+
+    Hud->HudMaterial = LoadMaterialDefault();
+}
+
+internal void
+PlaceHudLabel(DebugHud *Hud, u32 Label, Vector2 Position, f32 FontSize, f32 Spacing)
+{
+    HudLabel *Entry = &Hud->Labels[Label];
+    Entry->Position = Position;
+    Entry->FontSize = FontSize;
+    Entry->Spacing = Spacing;
+    Entry->Visible = false;
+    Entry->Stale = true;
+    Entry->Text[0] = 0;
+}
+
+// Shows the label with the formatted text, free when the text did not change
+internal void
+SetHudLabel(DebugHud *Hud, u32 Label, const char *Format, ...)
+{
+    char Text[HUD_MAX_TEXT];
+
+    va_list Args;
+    va_start(Args, Format);
+    vsnprintf(Text, sizeof(Text), Format, Args);
+    va_end(Args);
+
+    HudLabel *Entry = &Hud->Labels[Label];
+
+    if (Entry->Visible && strcmp(Entry->Text, Text) == 0)
+    {
+        return;
+    }
+
+    memcpy(Entry->Text, Text, sizeof(Text));
+    Entry->Visible = true;
+    Entry->Stale = true;
+    Hud->Stale = true;
+}
+
+internal void
+HideHudLabel(DebugHud *Hud, u32 Label)
+{
+    HudLabel *Entry = &Hud->Labels[Label];
+
+    if (Entry->Visible)
+    {
+        Entry->Visible = false;
+        Hud->Stale = true;
+    }
+}
+
+// DrawTextEx without the drawing
+internal void
+LayoutHudLabel(HudLabel *Label, const Font *font)
+{
+    Label->Glyphs.clear();
+
+    const f32 Scale = Label->FontSize / (f32)font->baseSize;
+    const f32 Padding = (f32)font->glyphPadding;
+    const f32 TexelWidth = 1.0f / (f32)font->texture.width;
+    const f32 TexelHeight = 1.0f / (f32)font->texture.height;
+
+    f32 OffsetX = 0.0f;
+
+    for (i32 i = 0; Label->Text[i] != 0;)
+    {
+        i32 CodepointSize = 0;
+        const i32 Codepoint = GetCodepointNext(&Label->Text[i], &CodepointSize);
+        const i32 Index = GetGlyphIndex(*font, Codepoint);
+        const Rectangle Rec = font->recs[Index];
+        const GlyphInfo *Info = &font->glyphs[Index];
+
+        i += CodepointSize;
+
+        if (Codepoint != ' ' && Codepoint != '\t')
+        {
+            HudGlyph Glyph;
+            Glyph.Dest = (Rectangle){
+                OffsetX + ((f32)Info->offsetX - Padding) * Scale,
+                ((f32)Info->offsetY - Padding) * Scale,
+                (Rec.width + 2.0f * Padding) * Scale,
+                (Rec.height + 2.0f * Padding) * Scale,
+            };
+            Glyph.Source = (Rectangle){
+                (Rec.x - Padding) * TexelWidth,
+                (Rec.y - Padding) * TexelHeight,
+                (Rec.width + 2.0f * Padding) * TexelWidth,
+                (Rec.height + 2.0f * Padding) * TexelHeight,
+            };
+
+            Label->Glyphs.push_back(Glyph);
+        }
+
+        const f32 Advance = (Info->advanceX == 0) ? Rec.width : (f32)Info->advanceX;
+        OffsetX += Advance * Scale + Label->Spacing;
+    }
+
+    Label->Stale = false;
+}
+
+internal void
+AddHudQuad(Mesh *Quads, u32 Quad, const HudGlyph *Glyph, Vector2 Position, Color Tint)
+{
+    const f32 Left = Position.x + Glyph->Dest.x;
+    const f32 Top = Position.y + Glyph->Dest.y;
+    const f32 Right = Left + Glyph->Dest.width;
+    const f32 Bottom = Top + Glyph->Dest.height;
+
+    const f32 U0 = Glyph->Source.x;
+    const f32 V0 = Glyph->Source.y;
+    const f32 U1 = U0 + Glyph->Source.width;
+    const f32 V1 = V0 + Glyph->Source.height;
+
+    // Top left, bottom left, bottom right, top right
+    const f32 Vertices[12] = {Left, Top, 0.0f, Left, Bottom, 0.0f, Right, Bottom, 0.0f, Right, Top, 0.0f};
+    const f32 TexCoords[8] = {U0, V0, U0, V1, U1, V1, U1, V0};
+
+    memcpy(&Quads->vertices[Quad * 12], Vertices, sizeof(Vertices));
+    memcpy(&Quads->texcoords[Quad * 8], TexCoords, sizeof(TexCoords));
+
+    for (u32 v = 0; v < 4; ++v)
+    {
+        memcpy(&Quads->colors[(Quad * 4 + v) * 4], &Tint, sizeof(Color));
+    }
+}
+
+// The shadows of every label, then the texts
+internal void
+BuildHudQuads(DebugHud *Hud)
+{
+    ProfileZone("BuildHudQuads");
+
+    u32 QuadCount = 0;
+
+    for (u32 Pass = 0; Pass < 2; ++Pass)
+    {
+        const f32 Offset = (Pass == 0) ? 0.0f : HUD_SHADOW_OFFSET;
+        const Color Tint = (Pass == 0) ? BLACK : WHITE;
+
+        for (const HudLabel &Label : Hud->Labels)
+        {
+            if (!Label.Visible)
+            {
+                continue;
+            }
+
+            const Vector2 Position = {Label.Position.x + Offset, Label.Position.y + Offset};
+
+            for (const HudGlyph &Glyph : Label.Glyphs)
+            {
+                if (QuadCount == HUD_MAX_QUADS)
+                {
+                    break;
+                }
+
+                AddHudQuad(&Hud->Quads, QuadCount++, &Glyph, Position, Tint);
+            }
+        }
+    }
+
+    if (QuadCount > 0)
+    {
+        UpdateMeshBuffer(Hud->Quads, 0, Hud->Quads.vertices, (i32)(QuadCount * 12 * sizeof(f32)), 0);
+        UpdateMeshBuffer(Hud->Quads, 1, Hud->Quads.texcoords, (i32)(QuadCount * 8 * sizeof(f32)), 0);
+        UpdateMeshBuffer(Hud->Quads, 3, Hud->Quads.colors, (i32)(QuadCount * 16 * sizeof(u8)), 0);
+    }
+
+    Hud->QuadCount = QuadCount;
+    Hud->Stale = false;
+}
+
+// In 2D mode, after EndMode3D
+internal void
+DrawHud(DebugHud *Hud, Font font)
+{
+    ProfileZone("DrawHud");
+
+    if (font.texture.id == 0)
+    {
+        return;
+    }
+
+    // The loaded font replaced the placeholder, every glyph moved
+    if (font.texture.id != Hud->FontTexture)
+    {
+        for (HudLabel &Label : Hud->Labels)
+        {
+            Label.Stale = true;
+        }
+
+        Hud->FontTexture = font.texture.id;
+        Hud->Stale = true;
+    }
+
+    if (Hud->Stale)
+    {
+        for (HudLabel &Label : Hud->Labels)
+        {
+            if (Label.Visible && Label.Stale)
+            {
+                LayoutHudLabel(&Label, &font);
+                Hud->Layouts++;
+            }
+        }
+
+        BuildHudQuads(Hud);
+    }
+
+    if (Hud->QuadCount == 0)
+    {
+        return;
+    }
+
+    // Whatever raylib batched so far goes under the HUD
+    rlDrawRenderBatchActive();
+
+    Hud->HudMaterial.maps[MATERIAL_MAP_DIFFUSE].texture = font.texture;
+    Hud->Quads.triangleCount = (i32)(Hud->QuadCount * 2);
+
+    DrawMesh(Hud->Quads, Hud->HudMaterial, MatrixIdentity());
+}
+
+// Needs the OpenGL context
+internal void
+FreeDebugHud(DebugHud *Hud)
+{
+    UnloadMesh(Hud->Quads);
+
+    // The font texture belongs to the asset loader
+    Hud->HudMaterial.maps[MATERIAL_MAP_DIFFUSE].texture.id = rlGetTextureIdDefault();
+    UnloadMaterial(Hud->HudMaterial);
+
+    Hud->Labels = std::vector<HudLabel>();
+}
@@ -0,0 +1,230 @@
+// Frame arena -----------------------------------------------
+// Bump allocator for the data that only lives for one frame: culling output, instance
+// transforms, light lists and upload staging. ResetFrameArena at the start of a frame hands the
+// whole block out again, nothing is freed one by one.
+//
+// The block is sized from what the frames asked for. Every reset looks at the bytes the frame
+// before used and makes the block bigger when they did not fit, so after the first frames a
+// frame never touches the heap. Allocations that do not fit are bumped from overflow blocks
+// at least the size of the main one, chained in a list until the next reset frees them.
+//
+// Allocating is one atomic add, the workers of a ParallelFor can allocate at the same time. A
+// FrameArray is only grown by one thread at a time. Nothing from the arena lives past the next
+// ResetFrameArena, a list kept across frames can only use the Count of the last one to size
+// the next.
+const usize FRAME_ARENA_ALIGNMENT = 64; // Every allocation starts on its own cache line
+const usize FRAME_ARENA_GRANULARITY = Kilobytes(64);
+
+// Header of an overflow block, the bytes handed out follow it from Base on
+struct FrameArenaOverflow
+{
+    FrameArenaOverflow *Next;
+    u8 *Base;
+    usize Size;
+    usize Used;
+};
+
+struct FrameArena
+{
+    u8 *Memory; // Calloc'ed, Base is the first aligned byte in it
+    u8 *Base;
+    usize Size;
+    std::atomic<usize> Used; // Bytes asked for this frame, runs past Size when they did not fit
+
+    usize LastUsed;  // By the frame before
+    usize HighWater; // Most bytes any frame used
+    u64 Grows;       // Times the block was allocated
+
+    std::mutex OverflowLock;
+    FrameArenaOverflow *Overflows; // The newest block first, the only one still bumped from
+    u32 OverflowCount;             // Blocks allocated this frame
+    u64 OverflowBlocks;            // Blocks allocated by all frames
+};
+
+internal void
+AllocateFrameArenaBlock(FrameArena *Arena, usize Size)
+{
+    Size = (Size + FRAME_ARENA_GRANULARITY - 1) / FRAME_ARENA_GRANULARITY * FRAME_ARENA_GRANULARITY;
+
+    Arena->Memory = (u8 *)calloc(Size + FRAME_ARENA_ALIGNMENT, 1);
+    Assert(Arena->Memory != NULL);
+    CPUMemory += Size + FRAME_ARENA_ALIGNMENT;
+
+    Arena->Base = (u8 *)(((uintptr_t)Arena->Memory + FRAME_ARENA_ALIGNMENT - 1) & ~(uintptr_t)(FRAME_ARENA_ALIGNMENT - 1));
+    Arena->Size = Size;
+    Arena->Grows++;
+}
+
+internal void
+FreeFrameArenaBlock(FrameArena *Arena)
+{
+    if (Arena->Memory != NULL)
+    {
+        free(Arena->Memory);
+        CPUMemory -= Arena->Size + FRAME_ARENA_ALIGNMENT;
+    }
+
+    Arena->Memory = NULL;
+    Arena->Base = NULL;
+    Arena->Size = 0;
+}
+
+internal void
+FreeFrameArenaOverflows(FrameArena *Arena)
+{
+    while (Arena->Overflows != NULL)
+    {
+        FrameArenaOverflow *Block = Arena->Overflows;
+        Arena->Overflows = Block->Next;
+
+        CPUMemory -= sizeof(FrameArenaOverflow) + Block->Size + FRAME_ARENA_ALIGNMENT;
+        free(Block);
+    }
+
+    Arena->OverflowCount = 0;
+}
+
+internal void
+InitFrameArena(FrameArena *Arena, usize Size)
+{
+    Arena->Memory = NULL;
+    Arena->Grows = 0;
+    Arena->Overflows = NULL;
+    Arena->OverflowCount = 0;
+    Arena->OverflowBlocks = 0;
+    Arena->Used = 0;
+    Arena->LastUsed = 0;
+    Arena->HighWater = 0;
+
+    AllocateFrameArenaBlock(Arena, Size);
+}
+
+internal void
+FreeFrameArena(FrameArena *Arena)
+{
+    FreeFrameArenaOverflows(Arena);
+    FreeFrameArenaBlock(Arena);
+}
+
+// Start of a frame, everything handed out before is gone
+internal void
+ResetFrameArena(FrameArena *Arena)
+{
+    Arena->LastUsed = Arena->Used.load(std::memory_order_relaxed);
+    Arena->HighWater = Max(Arena->HighWater, Arena->LastUsed);
+
+    FreeFrameArenaOverflows(Arena);
+
+    // A quarter more than the last frame used, so a frame a bit busier still fits
+    if (Arena->LastUsed > Arena->Size)
+    {
+        FreeFrameArenaBlock(Arena);
+        AllocateFrameArenaBlock(Arena, Arena->LastUsed + Arena->LastUsed / 4);
+    }
+
+    Arena->Used = 0;
+}
+
+// Not cleared, whatever the last frame left there
+internal void *
+PushFrameBytes(FrameArena *Arena, usize Bytes)
+{
+    Bytes = (Bytes + FRAME_ARENA_ALIGNMENT - 1) & ~(FRAME_ARENA_ALIGNMENT - 1);
+
+    const usize Offset = Arena->Used.fetch_add(Bytes, std::memory_order_relaxed);
+
+    if (Offset + Bytes <= Arena->Size)
+    {
+        return Arena->Base + Offset;
+    }
+
+    // Out of room, this frame bumps from overflow blocks and the next reset grows the block
+    std::lock_guard<std::mutex> Lock(Arena->OverflowLock);
+
+    FrameArenaOverflow *Block = Arena->Overflows;
+
+    if (Block == NULL || Block->Used + Bytes > Block->Size)
+    {
+        const usize Size = Max(Bytes, Arena->Size);
+
+        Block = (FrameArenaOverflow *)calloc(sizeof(FrameArenaOverflow) + Size + FRAME_ARENA_ALIGNMENT, 1);
+        Assert(Block != NULL);
+        CPUMemory += sizeof(FrameArenaOverflow) + Size + FRAME_ARENA_ALIGNMENT;
+
+        Block->Base = (u8 *)(((uintptr_t)(Block + 1) + FRAME_ARENA_ALIGNMENT - 1) & ~(uintptr_t)(FRAME_ARENA_ALIGNMENT - 1));
+        Block->Size = Size;
+        Block->Used = 0;
+        Block->Next = Arena->Overflows;
+
+        Arena->Overflows = Block;
+        Arena->OverflowCount++;
+        Arena->OverflowBlocks++;
+    }
+
+    u8 *Result = Block->Base + Block->Used;
+    Block->Used += Bytes;
+
+    return Result;
+}
+
+template <typename T>
+internal T *
+PushFrameArray(FrameArena *Arena, usize Count)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Frame arrays are copied with memcpy and never destructed");
+
+    return (T *)PushFrameBytes(Arena, Max(Count, (usize)1) * sizeof(T));
+}
+
+// A list that grows inside the arena: a full one moves to twice the room and leaves the old
+// room behind until the next reset
+template <typename T>
+struct FrameArray
+{
+    T *Items;
+    usize Count;
+    usize Capacity;
+    FrameArena *Arena;
+
+    T &operator[](usize Index) { return Items[Index]; }
+    const T &operator[](usize Index) const { return Items[Index]; }
+};
+
+template <typename T>
+internal FrameArray<T>
+MakeFrameArray(FrameArena *Arena, usize Capacity)
+{
+    FrameArray<T> Result;
+    Result.Capacity = Max(Capacity, (usize)16);
+    Result.Items = PushFrameArray<T>(Arena, Result.Capacity);
+    Result.Count = 0;
+    Result.Arena = Arena;
+
+    return Result;
+}
+
+template <typename T>
+internal void
+ReserveFrameArray(FrameArray<T> *Array, usize Capacity)
+{
+    if (Capacity <= Array->Capacity)
+    {
+        return;
+    }
+
+    Capacity = Max(Capacity, Array->Capacity * 2);
+
+    T *Items = PushFrameArray<T>(Array->Arena, Capacity);
+    memcpy(Items, Array->Items, Array->Count * sizeof(T));
+
+    Array->Items = Items;
+    Array->Capacity = Capacity;
+}
+
+template <typename T>
+internal void
+AppendFrameArray(FrameArray<T> *Array, const T &Item)
+{
+    ReserveFrameArray(Array, Array->Count + 1);
+    Array->Items[Array->Count++] = Item;
+}
@@ -0,0 +1,117 @@
+// Frustum ---------------------------------------------------
+struct Plane
+{
+    Vector3 normal; // Normal of the plane
+    f32 distance;   // Distance from the origin to the plane
+};
+
+struct Frustum
+{
+    Plane planes[6]; // Define the 6 planes of the frustum
+};
+
+enum FrustumTestResult
+{
+    FRUSTUM_OUTSIDE = 0,
+    FRUSTUM_INTERSECTS,
+    FRUSTUM_INSIDE,
+};
+
+// Bit set of the planes a box still has to be tested against, all 6 planes set
+const u32 FRUSTUM_ALL_PLANES = 0x3F;
+
+internal int
+IsBoxInFrustum(const Frustum *frustum, const BoundingBox *box)
+{
+    for (i32 i = 0; i < 6; ++i)
+    {
+        Vector3 normal = frustum->planes[i].normal;
+        f32 distance = frustum->planes[i].distance;
+
+        // Find the most positive vertex (the farthest point along the normal)
+        Vector3 positiveVertex = (Vector3){
+            (normal.x > 0.0f) ? box->max.x : box->min.x,
+            (normal.y > 0.0f) ? box->max.y : box->min.y,
+            (normal.z > 0.0f) ? box->max.z : box->min.z};
+
+        // If the positive vertex is behind the plane, the box is outside
+        if ((normal.x * positiveVertex.x + normal.y * positiveVertex.y + normal.z * positiveVertex.z + distance) < 0.0f)
+        {
+            return 0; // Box is outside the frustum
+        }
+    }
+
+    return 1; // Box is inside or intersects the frustum
+}
+
+// Like IsBoxInFrustum, but also tells apart boxes that are completely inside the frustum.
+// Only the planes set in PlaneMask are tested, planes the box is fully in front of are
+// cleared from the mask so children of the box never have to test them again.
+internal FrustumTestResult
+ClassifyBoxInFrustum(const Frustum *frustum, const BoundingBox *box, u32 *PlaneMask)
+{
+    for (i32 i = 0; i < 6; ++i)
+    {
+        if ((*PlaneMask & (1u << i)) == 0)
+        {
+            continue;
+        }
+
+        Vector3 normal = frustum->planes[i].normal;
+        f32 distance = frustum->planes[i].distance;
+
+        // Find the most positive vertex (the farthest point along the normal)
+        Vector3 positiveVertex = (Vector3){
+            (normal.x > 0.0f) ? box->max.x : box->min.x,
+            (normal.y > 0.0f) ? box->max.y : box->min.y,
+            (normal.z > 0.0f) ? box->max.z : box->min.z};
+
+        // If the positive vertex is behind the plane, the box is outside
+        if ((normal.x * positiveVertex.x + normal.y * positiveVertex.y + normal.z * positiveVertex.z + distance) < 0.0f)
+        {
+            return FRUSTUM_OUTSIDE;
+        }
+
+        // Find the most negative vertex (the nearest point along the normal)
+        Vector3 negativeVertex = (Vector3){
+            (normal.x < 0.0f) ? box->max.x : box->min.x,
+            (normal.y < 0.0f) ? box->max.y : box->min.y,
+            (normal.z < 0.0f) ? box->max.z : box->min.z};
+
+        // If even the negative vertex is in front of the plane, the whole box is
+        if ((normal.x * negativeVertex.x + normal.y * negativeVertex.y + normal.z * negativeVertex.z + distance) >= 0.0f)
+        {
+            *PlaneMask &= ~(1u << i);
+        }
+    }
+
+    return (*PlaneMask == 0) ? FRUSTUM_INSIDE : FRUSTUM_INTERSECTS;
+}
+
+// Frustum for a given aspect ratio, does not need a window
+internal Frustum
+CalculateFrustumAspect(Camera3D camera, f32 aspect)
+{
+    Frustum frustum;
+    Matrix viewMatrix = MatrixLookAt(camera.position, camera.target, camera.up);
+    f32 top = tanf(camera.fovy * 0.5f * DEG2RAD);
+    f32 right = top * aspect;
+    Matrix projectionMatrix = MatrixPerspective(camera.fovy * DEG2RAD, aspect, 0.01f, 4000.0f);
+    Matrix viewProjMatrix = MatrixMultiply(viewMatrix, projectionMatrix);
+
+    // Extract frustum planes (left, right, bottom, top, near, far)
+    frustum.planes[0] = (Plane){.normal = {viewProjMatrix.m3 + viewProjMatrix.m0, viewProjMatrix.m7 + viewProjMatrix.m4, viewProjMatrix.m11 + viewProjMatrix.m8}, .distance = viewProjMatrix.m15 + viewProjMatrix.m12};  // Left
+    frustum.planes[1] = (Plane){.normal = {viewProjMatrix.m3 - viewProjMatrix.m0, viewProjMatrix.m7 - viewProjMatrix.m4, viewProjMatrix.m11 - viewProjMatrix.m8}, .distance = viewProjMatrix.m15 - viewProjMatrix.m12};  // Right
+    frustum.planes[2] = (Plane){.normal = {viewProjMatrix.m3 + viewProjMatrix.m1, viewProjMatrix.m7 + viewProjMatrix.m5, viewProjMatrix.m11 + viewProjMatrix.m9}, .distance = viewProjMatrix.m15 + viewProjMatrix.m13};  // Bottom
+    frustum.planes[3] = (Plane){.normal = {viewProjMatrix.m3 - viewProjMatrix.m1, viewProjMatrix.m7 - viewProjMatrix.m5, viewProjMatrix.m11 - viewProjMatrix.m9}, .distance = viewProjMatrix.m15 - viewProjMatrix.m13};  // Top
+    frustum.planes[4] = (Plane){.normal = {viewProjMatrix.m3 + viewProjMatrix.m2, viewProjMatrix.m7 + viewProjMatrix.m6, viewProjMatrix.m11 + viewProjMatrix.m10}, .distance = viewProjMatrix.m15 + viewProjMatrix.m14}; // Near
+    frustum.planes[5] = (Plane){.normal = {viewProjMatrix.m3 - viewProjMatrix.m2, viewProjMatrix.m7 - viewProjMatrix.m6, viewProjMatrix.m11 - viewProjMatrix.m10}, .distance = viewProjMatrix.m15 - viewProjMatrix.m14}; // Far
+
+    return frustum;
+}
+
+internal Frustum
+CalculateFrustum(Camera3D camera)
+{
+    return CalculateFrustumAspect(camera, (f32)GetScreenWidth() / (f32)GetScreenHeight());
+}
@@ -0,0 +1,164 @@
+// Frustum culling kernels -----------------------------------
+// Batch versions of IsBoxInFrustum that test a run of consecutive tiles straight from the
+// GroundTileStore min/max arrays and write the Ids of the visible ones to a compacted list.
+// The AVX2 (8 boxes) and SSE4.1 (4 boxes) kernels do the exact same float math as the
+// scalar test, so all of them return the same tiles. The kernel is picked once at startup
+// from what the CPU supports.
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define FRUSTUM_SIMD_X86 1
+#else
+#define FRUSTUM_SIMD_X86 0
+#endif
+
+// Returns how many Ids were written to OutIds, OutIds must have room for Count Ids
+typedef usize (*CullTileRunFunction)(const Frustum *frustum, u32 PlaneMask, const GroundTileStore *Tiles, usize FirstId, usize Count, u32 *OutIds);
+
+internal usize
+CullTileRunScalar(const Frustum *frustum, u32 PlaneMask, const GroundTileStore *Tiles, usize FirstId, usize Count, u32 *OutIds)
+{
+    usize VisibleCount = 0;
+
+    for (usize Id = FirstId; Id < FirstId + Count; ++Id)
+    {
+        bool Visible = true;
+
+        for (i32 p = 0; p < 6 && Visible; ++p)
+        {
+            if ((PlaneMask & (1u << p)) == 0)
+            {
+                continue;
+            }
+
+            const Vector3 normal = frustum->planes[p].normal;
+
+            // Most positive vertex along the plane normal
+            const f32 X = (normal.x > 0.0f) ? Tiles->MaxX[Id] : Tiles->MinX[Id];
+            const f32 Y = (normal.y > 0.0f) ? Tiles->MaxY[Id] : Tiles->MinY[Id];
+            const f32 Z = (normal.z > 0.0f) ? Tiles->MaxZ[Id] : Tiles->MinZ[Id];
+
+            Visible = (normal.x * X + normal.y * Y + normal.z * Z + frustum->planes[p].distance) >= 0.0f;
+        }
+
+        OutIds[VisibleCount] = (u32)Id;
+        VisibleCount += Visible;
+    }
+
+    return VisibleCount;
+}
+
+#if FRUSTUM_SIMD_X86
+__attribute__((target("sse4.1"))) internal usize
+CullTileRunSSE4(const Frustum *frustum, u32 PlaneMask, const GroundTileStore *Tiles, usize FirstId, usize Count, u32 *OutIds)
+{
+    usize VisibleCount = 0;
+    usize Id = FirstId;
+    const usize End = FirstId + Count;
+
+    for (; Id + 4 <= End; Id += 4)
+    {
+        __m128 Visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+        for (i32 p = 0; p < 6; ++p)
+        {
+            if ((PlaneMask & (1u << p)) == 0)
+            {
+                continue;
+            }
+
+            const Vector3 normal = frustum->planes[p].normal;
+
+            // The positive vertex only depends on the sign of the normal, so pick the array once per plane
+            const __m128 X = _mm_loadu_ps((normal.x > 0.0f) ? &Tiles->MaxX[Id] : &Tiles->MinX[Id]);
+            const __m128 Y = _mm_loadu_ps((normal.y > 0.0f) ? &Tiles->MaxY[Id] : &Tiles->MinY[Id]);
+            const __m128 Z = _mm_loadu_ps((normal.z > 0.0f) ? &Tiles->MaxZ[Id] : &Tiles->MinZ[Id]);
+
+            __m128 Distance = _mm_mul_ps(_mm_set1_ps(normal.x), X);
+            Distance = _mm_add_ps(Distance, _mm_mul_ps(_mm_set1_ps(normal.y), Y));
+            Distance = _mm_add_ps(Distance, _mm_mul_ps(_mm_set1_ps(normal.z), Z));
+            Distance = _mm_add_ps(Distance, _mm_set1_ps(frustum->planes[p].distance));
+
+            Visible = _mm_and_ps(Visible, _mm_cmpge_ps(Distance, _mm_setzero_ps()));
+        }
+
+        u32 Bits = (u32)_mm_movemask_ps(Visible);
+        while (Bits)
+        {
+            OutIds[VisibleCount++] = (u32)(Id + __builtin_ctz(Bits));
+            Bits &= Bits - 1;
+        }
+    }
+
+    return VisibleCount + CullTileRunScalar(frustum, PlaneMask, Tiles, Id, End - Id, OutIds + VisibleCount);
+}
+
+__attribute__((target("avx2"))) internal usize
+CullTileRunAVX2(const Frustum *frustum, u32 PlaneMask, const GroundTileStore *Tiles, usize FirstId, usize Count, u32 *OutIds)
+{
+    usize VisibleCount = 0;
+    usize Id = FirstId;
+    const usize End = FirstId + Count;
+
+    for (; Id + 8 <= End; Id += 8)
+    {
+        __m256 Visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+        for (i32 p = 0; p < 6; ++p)
+        {
+            if ((PlaneMask & (1u << p)) == 0)
+            {
+                continue;
+            }
+
+            const Vector3 normal = frustum->planes[p].normal;
+
+            const __m256 X = _mm256_loadu_ps((normal.x > 0.0f) ? &Tiles->MaxX[Id] : &Tiles->MinX[Id]);
+            const __m256 Y = _mm256_loadu_ps((normal.y > 0.0f) ? &Tiles->MaxY[Id] : &Tiles->MinY[Id]);
+            const __m256 Z = _mm256_loadu_ps((normal.z > 0.0f) ? &Tiles->MaxZ[Id] : &Tiles->MinZ[Id]);
+
+            __m256 Distance = _mm256_mul_ps(_mm256_set1_ps(normal.x), X);
+            Distance = _mm256_add_ps(Distance, _mm256_mul_ps(_mm256_set1_ps(normal.y), Y));
+            Distance = _mm256_add_ps(Distance, _mm256_mul_ps(_mm256_set1_ps(normal.z), Z));
+            Distance = _mm256_add_ps(Distance, _mm256_set1_ps(frustum->planes[p].distance));
+
+            Visible = _mm256_and_ps(Visible, _mm256_cmp_ps(Distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+
+        u32 Bits = (u32)_mm256_movemask_ps(Visible);
+        while (Bits)
+        {
+            OutIds[VisibleCount++] = (u32)(Id + __builtin_ctz(Bits));
+            Bits &= Bits - 1;
+        }
+    }
+
+    // The upper halves of the ymm registers are dirty and GCC emits no vzeroupper for this
+    // function. Without it every non-VEX SSE instruction after the culling pays for them, the
+    // light binning ran 3.5 times slower after a cull
+    _mm256_zeroupper();
+
+    // Less than 8 left, let the 4 wide kernel (and the scalar one after it) finish
+    return VisibleCount + CullTileRunSSE4(frustum, PlaneMask, Tiles, Id, End - Id, OutIds + VisibleCount);
+}
+#endif
+
+CullTileRunFunction CullTileRun = CullTileRunScalar;
+const char *CullTileRunName = "Scalar";
+
+internal void
+SetupFrustumCullingKernel(void)
+{
+#if FRUSTUM_SIMD_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+        CullTileRun = CullTileRunAVX2;
+        CullTileRunName = "AVX2";
+    }
+    else if (__builtin_cpu_supports("sse4.1"))
+    {
+        CullTileRun = CullTileRunSSE4;
+        CullTileRunName = "SSE4.1";
+    }
+#endif
+}
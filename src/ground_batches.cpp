@@ -0,0 +1,451 @@
+// Ground batches --------------------------------------------
+// Instance list of the tiles in view, kept across frames. Every instance is a packed tile
+// record (see ground_terrain.cpp), all materials go into the same list and one draw call.
+//
+// Every tile in view knows its slot in the list, so it can be added or swap-removed on its
+// own. UpdateGroundBatches picks the cheapest way to bring the list up to date:
+//  - nothing changed: nothing to do
+//  - the camera only moved: walk the quadtree and only look at the nodes that changed
+//    classification or cross the frustum border, which is the strip of tiles entering or
+//    leaving the view
+//  - zoom, rotation or window size changed: rebuild everything on the job system
+// Edited tiles are queued with InvalidateGroundTile and fixed up on the next update.
+//
+// Leaves that are far enough away to be drawn with a baked chunk mesh (see ground_lod.cpp)
+// keep their tiles out of the list, the level picked for every leaf is kept next to its state.
+//
+// The full rebuild walks the tree once to classify the nodes, then culls the visible leaves on
+// the job system into per-worker lists and merges them into one array. Each worker copies its
+// part to an offset that is known up front from the list sizes, so the merge needs no locks.
+//
+// With UseFootprint the partially visible leaves take their tiles from the rows of the frustum
+// footprint (see ground_footprint.cpp) instead of testing every tile.
+//
+// The leaf list and the per-worker lists of the rebuild come from the frame arena, each starts
+// with room for what it held in the last rebuild.
+const u32 GROUND_NOT_IN_VIEW = 0xFFFFFFFF;
+
+struct GroundBatches
+{
+    std::vector<u32> InstancesInView; // Packed tile records
+    std::vector<u32> TileIdsInView;   // Tile Id of every instance above
+    u64 InViewCount;
+
+    // Per tile, index into the lists or GROUND_NOT_IN_VIEW
+    usize TileCount;
+    u32 *InViewSlot;
+
+    // Per quadtree node, classification and level of detail at the last update
+    usize NodeCount;
+    u8 *NodeState;
+    u8 *NodeLod;
+
+    FrameArray<u64> InstancedLeaves; // Node index | plane mask << 32, scratch for the full rebuild
+
+    std::vector<u32> DirtyTileIds;
+
+    bool UseFootprint;
+    GroundFootprint Footprint; // Of the last update, when UseFootprint is set
+
+    // View the lists were built for
+    bool Valid;
+    Camera3D Camera;
+    i32 ScreenWidth;
+    i32 ScreenHeight;
+};
+
+struct alignas(64) WorkerGroundBatch
+{
+    FrameArray<u32> VisibleTileIds;
+    FrameArray<u32> Instances;
+
+    usize MergeOffset;
+};
+
+global_variable WorkerGroundBatch WorkerGroundBatches[MAX_WORKERS];
+
+internal void
+InitGroundBatches(GroundBatches *Batches, const GroundQuadtree *Tree, const GroundTileStore *Tiles)
+{
+    Batches->TileCount = Tiles->Count;
+    Batches->InViewSlot = (u32 *)AllocateTileArray(Tiles->Count, sizeof(u32));
+    memset(Batches->InViewSlot, 0xFF, Tiles->Count * sizeof(u32));
+
+    // Calloc leaves every node FRUSTUM_OUTSIDE, which matches the empty lists
+    Batches->NodeCount = Tree->NodeCount;
+    Batches->NodeState = (u8 *)AllocateTileArray(Tree->NodeCount, sizeof(u8));
+    Batches->NodeLod = (u8 *)AllocateTileArray(Tree->NodeCount, sizeof(u8));
+
+    Batches->InstancedLeaves = {0};
+    Batches->InViewCount = 0;
+    Batches->Valid = false;
+}
+
+internal void
+FreeGroundBatches(GroundBatches *Batches)
+{
+    FreeTileArray(Batches->InViewSlot, Batches->TileCount, sizeof(u32));
+    FreeTileArray(Batches->NodeState, Batches->NodeCount, sizeof(u8));
+    FreeTileArray(Batches->NodeLod, Batches->NodeCount, sizeof(u8));
+
+    Batches->InViewSlot = NULL;
+    Batches->NodeState = NULL;
+    Batches->NodeLod = NULL;
+    Batches->Valid = false;
+}
+
+// Forgets everything in view, call after the tiles in the store were replaced. The next update rebuilds the lists
+internal void
+ResetGroundBatches(GroundBatches *Batches)
+{
+    memset(Batches->InViewSlot, 0xFF, Batches->TileCount * sizeof(u32));
+    memset(Batches->NodeState, 0, Batches->NodeCount * sizeof(u8));
+    memset(Batches->NodeLod, 0, Batches->NodeCount * sizeof(u8));
+
+    Batches->InstancesInView.clear();
+    Batches->TileIdsInView.clear();
+    Batches->DirtyTileIds.clear();
+    Batches->InViewCount = 0;
+    Batches->Valid = false;
+}
+
+// Call after changing the material of a tile, it is fixed up on the next update
+internal void
+InvalidateGroundTile(GroundBatches *Batches, usize Id)
+{
+    Batches->DirtyTileIds.push_back((u32)Id);
+}
+
+internal void
+AddTileToView(GroundBatches *Batches, const GroundTileStore *Tiles, usize Id)
+{
+    Batches->InViewSlot[Id] = (u32)Batches->TileIdsInView.size();
+
+    Batches->InstancesInView.push_back(PackGroundTile(Tiles, Id));
+    Batches->TileIdsInView.push_back((u32)Id);
+    Batches->InViewCount++;
+}
+
+// Swap-removes the tile, the last instance takes its slot
+internal void
+RemoveTileFromView(GroundBatches *Batches, usize Id)
+{
+    const u32 Slot = Batches->InViewSlot[Id];
+    const u32 Last = (u32)Batches->TileIdsInView.size() - 1;
+
+    if (Slot != Last)
+    {
+        const u32 MovedId = Batches->TileIdsInView[Last];
+
+        Batches->InstancesInView[Slot] = Batches->InstancesInView[Last];
+        Batches->TileIdsInView[Slot] = MovedId;
+        Batches->InViewSlot[MovedId] = Slot;
+    }
+
+    Batches->InstancesInView.pop_back();
+    Batches->TileIdsInView.pop_back();
+    Batches->InViewSlot[Id] = GROUND_NOT_IN_VIEW;
+    Batches->InViewCount--;
+}
+
+internal void
+SetTileInView(GroundBatches *Batches, const GroundTileStore *Tiles, usize Id, bool Visible)
+{
+    const bool WasVisible = Batches->InViewSlot[Id] != GROUND_NOT_IN_VIEW;
+
+    if (Visible && !WasVisible)
+    {
+        AddTileToView(Batches, Tiles, Id);
+    }
+    else if (!Visible && WasVisible)
+    {
+        RemoveTileFromView(Batches, Id);
+    }
+}
+
+// Brings the tiles of one leaf in line with its new classification
+internal void
+UpdateGroundLeafView(GroundBatches *Batches, const GroundQuadtree *Tree, const GroundTileStore *Tiles, const Frustum *frustum, const QuadtreeNode *Leaf, FrustumTestResult State, u32 PlaneMask)
+{
+    const u32 RowLength = Leaf->J1 - Leaf->J0;
+    u32 RowVisible[QUADTREE_LEAF_SIZE];
+
+    for (u32 i = Leaf->I0; i < Leaf->I1; ++i)
+    {
+        const usize FirstId = i * Tree->MapSize + Leaf->J0;
+
+        if (State != FRUSTUM_INTERSECTS)
+        {
+            for (usize Id = FirstId; Id < FirstId + RowLength; ++Id)
+            {
+                SetTileInView(Batches, Tiles, Id, State == FRUSTUM_INSIDE);
+            }
+
+            continue;
+        }
+
+        if (Batches->UseFootprint)
+        {
+            const GroundSpan Span = GetGroundFootprintSpan(&Batches->Footprint, i, Leaf->J0, Leaf->J1);
+
+            for (u32 j = Leaf->J0; j < Leaf->J1; ++j)
+            {
+                SetTileInView(Batches, Tiles, i * Tree->MapSize + j, j >= Span.JStart && j < Span.JEnd);
+            }
+
+            continue;
+        }
+
+        // The kernel writes the visible Ids in ascending order, walk them alongside the row
+        const usize VisibleCount = CullTileRun(frustum, PlaneMask, Tiles, FirstId, RowLength, RowVisible);
+
+        usize v = 0;
+        for (usize Id = FirstId; Id < FirstId + RowLength; ++Id)
+        {
+            const bool Visible = (v < VisibleCount) && (RowVisible[v] == Id);
+            v += Visible;
+
+            SetTileInView(Batches, Tiles, Id, Visible);
+        }
+    }
+}
+
+struct GroundViewWalk
+{
+    const GroundQuadtree *Tree;
+    const GroundTileStore *Tiles;
+    const Frustum *frustum;
+    const GroundLodView *Lod; // NULL draws every tile instanced
+
+    bool ApplyToTiles; // False only refreshes the node states and collects InstancedLeaves
+};
+
+// Walks the quadtree and only visits the subtrees whose classification may have changed
+internal void
+UpdateGroundViewNode(GroundBatches *Batches, const GroundViewWalk *Walk, u32 NodeIndex, u32 PlaneMask, FrustumTestResult ParentState)
+{
+    const QuadtreeNode *Node = &Walk->Tree->Nodes[NodeIndex];
+
+    FrustumTestResult State = ParentState;
+    if (State == FRUSTUM_INTERSECTS)
+    {
+        State = ClassifyBoxInFrustum(Walk->frustum, &Node->BoundingVolume, &PlaneMask);
+    }
+
+    const FrustumTestResult OldState = (FrustumTestResult)Batches->NodeState[NodeIndex];
+    Batches->NodeState[NodeIndex] = (u8)State;
+
+    // Outside before and after, so is every tile below it. Without LOD the same goes for
+    // inside, with LOD the leaves below may still switch level as the camera moves
+    if (Walk->ApplyToTiles && State == OldState && (State == FRUSTUM_OUTSIDE || (State == FRUSTUM_INSIDE && Walk->Lod == NULL)))
+    {
+        return;
+    }
+
+    if (Node->ChildCount == 0)
+    {
+        const u8 OldLod = Batches->NodeLod[NodeIndex];
+        const u8 Lod = (State != FRUSTUM_OUTSIDE && Walk->Lod != NULL) ? SelectGroundLod(Walk->Lod, &Node->BoundingVolume) : 0;
+        Batches->NodeLod[NodeIndex] = Lod;
+
+        const bool WasInstanced = (OldState != FRUSTUM_OUTSIDE) && (OldLod == 0);
+        const bool Instanced = (State != FRUSTUM_OUTSIDE) && (Lod == 0);
+
+        if (!Walk->ApplyToTiles)
+        {
+            if (Instanced)
+            {
+                AppendFrameArray(&Batches->InstancedLeaves, NodeIndex | ((u64)PlaneMask << 32));
+            }
+        }
+        else if (Instanced != WasInstanced || (Instanced && (State == FRUSTUM_INTERSECTS || OldState == FRUSTUM_INTERSECTS)))
+        {
+            UpdateGroundLeafView(Batches, Walk->Tree, Walk->Tiles, Walk->frustum, Node, Instanced ? State : FRUSTUM_OUTSIDE, PlaneMask);
+        }
+
+        return;
+    }
+
+    for (u32 c = 0; c < Node->ChildCount; ++c)
+    {
+        UpdateGroundViewNode(Batches, Walk, Node->FirstChild + c, PlaneMask, State);
+    }
+}
+
+// Rebuilds the lists from scratch, culling and list building run on all cores
+internal void
+BuildGroundBatches(GroundBatches *Batches, const GroundQuadtree *Tree, const GroundTileStore *Tiles, const Frustum *frustum, const GroundLodView *Lod, FrameArena *Arena)
+{
+    ProfileZone("BuildGroundBatches");
+
+    const u32 WorkerCount = (Jobs.WorkerCount > 0) ? Jobs.WorkerCount : 1;
+
+    for (u32 Id : Batches->TileIdsInView)
+    {
+        Batches->InViewSlot[Id] = GROUND_NOT_IN_VIEW;
+    }
+
+    for (u32 w = 0; w < WorkerCount; ++w)
+    {
+        WorkerGroundBatch *Batch = &WorkerGroundBatches[w];
+
+        Batch->VisibleTileIds = MakeFrameArray<u32>(Arena, Batch->VisibleTileIds.Count);
+        Batch->Instances = MakeFrameArray<u32>(Arena, Batch->Instances.Count);
+    }
+
+    if (Batches->UseFootprint)
+    {
+        BuildGroundFootprint(&Batches->Footprint, Tiles, frustum);
+    }
+
+    // Classify every node and collect the leaves that are drawn per tile
+    Batches->InstancedLeaves = MakeFrameArray<u64>(Arena, Batches->InstancedLeaves.Count);
+
+    const GroundViewWalk Walk = {Tree, Tiles, frustum, Lod, false};
+    UpdateGroundViewNode(Batches, &Walk, 0, FRUSTUM_ALL_PLANES, FRUSTUM_INTERSECTS);
+
+    // Cull and pack the tiles of those leaves into the worker's own list
+    ParallelFor(Batches->InstancedLeaves.Count, 4, [&](usize Begin, usize End, u32 Worker)
+                {
+                    ProfileZone("CullLeaves");
+
+                    WorkerGroundBatch *Batch = &WorkerGroundBatches[Worker];
+
+                    for (usize l = Begin; l < End; ++l)
+                    {
+                        const u32 NodeIndex = (u32)Batches->InstancedLeaves[l];
+                        const u32 PlaneMask = (u32)(Batches->InstancedLeaves[l] >> 32);
+                        const QuadtreeNode *Leaf = &Tree->Nodes[NodeIndex];
+
+                        const usize FirstVisible = Batch->VisibleTileIds.Count;
+
+                        if (Batches->NodeState[NodeIndex] == FRUSTUM_INSIDE)
+                        {
+                            AcceptQuadtreeNode(Tree, Leaf, &Batch->VisibleTileIds);
+                        }
+                        else if (Batches->UseFootprint)
+                        {
+                            AcceptGroundFootprintLeaf(&Batches->Footprint, Tree, Leaf, &Batch->VisibleTileIds);
+                        }
+                        else
+                        {
+                            CullQuadtreeLeaf(Tree, Leaf, Tiles, frustum, PlaneMask, &Batch->VisibleTileIds);
+                        }
+
+                        ReserveFrameArray(&Batch->Instances, Batch->VisibleTileIds.Count);
+
+                        for (usize i = FirstVisible; i < Batch->VisibleTileIds.Count; ++i)
+                        {
+                            Batch->Instances[Batch->Instances.Count++] = PackGroundTile(Tiles, Batch->VisibleTileIds[i]);
+                        }
+                    }
+                });
+
+    // Every worker's slice of the merged list starts where the previous worker's ends
+    usize Total = 0;
+
+    for (u32 w = 0; w < WorkerCount; ++w)
+    {
+        WorkerGroundBatches[w].MergeOffset = Total;
+        Total += WorkerGroundBatches[w].Instances.Count;
+    }
+
+    Batches->InstancesInView.resize(Total);
+    Batches->TileIdsInView.resize(Total);
+    Batches->InViewCount = Total;
+
+    ParallelFor(WorkerCount, 1, [&](usize Begin, usize End, u32 Worker)
+                {
+                    ProfileZone("MergeBatches");
+
+                    for (usize w = Begin; w < End; ++w)
+                    {
+                        const WorkerGroundBatch *Batch = &WorkerGroundBatches[w];
+                        const usize Count = Batch->Instances.Count;
+                        const usize Offset = Batch->MergeOffset;
+
+                        if (Count == 0)
+                        {
+                            continue;
+                        }
+
+                        memcpy(Batches->InstancesInView.data() + Offset, Batch->Instances.Items, Count * sizeof(u32));
+                        memcpy(Batches->TileIdsInView.data() + Offset, Batch->VisibleTileIds.Items, Count * sizeof(u32));
+
+                        for (usize i = 0; i < Count; ++i)
+                        {
+                            Batches->InViewSlot[Batch->VisibleTileIds[i]] = (u32)(Offset + i);
+                        }
+                    }
+                });
+}
+
+internal bool
+SameVector3(Vector3 A, Vector3 B)
+{
+    return A.x == B.x && A.y == B.y && A.z == B.z;
+}
+
+// Returns true when the lists changed since the last call. A rebuild takes its scratch from Arena
+internal bool
+UpdateGroundBatches(GroundBatches *Batches, const GroundQuadtree *Tree, const GroundTileStore *Tiles, const Frustum *frustum, const GroundLodView *Lod, const Camera3D *Camera, i32 ScreenWidth, i32 ScreenHeight, FrameArena *Arena)
+{
+    const bool SameProjection = Batches->Valid &&
+                                Camera->fovy == Batches->Camera.fovy &&
+                                Camera->projection == Batches->Camera.projection &&
+                                SameVector3(Camera->up, Batches->Camera.up) &&
+                                ScreenWidth == Batches->ScreenWidth &&
+                                ScreenHeight == Batches->ScreenHeight;
+
+    const bool SameView = SameProjection &&
+                          SameVector3(Camera->position, Batches->Camera.position) &&
+                          SameVector3(Camera->target, Batches->Camera.target);
+
+    // A pan moves the position and the target by the same amount, the view direction stays put
+    const Vector3 Direction = Vector3Subtract(Camera->target, Camera->position);
+    const Vector3 OldDirection = Vector3Subtract(Batches->Camera.target, Batches->Camera.position);
+    const bool Panned = SameProjection && Vector3Distance(Direction, OldDirection) < 0.001f;
+
+    if (SameView && Batches->DirtyTileIds.empty())
+    {
+        return false;
+    }
+
+    if (!SameView)
+    {
+        if (Panned)
+        {
+            ProfileZone("PanGroundBatches");
+
+            if (Batches->UseFootprint)
+            {
+                BuildGroundFootprint(&Batches->Footprint, Tiles, frustum);
+            }
+
+            const GroundViewWalk Walk = {Tree, Tiles, frustum, Lod, true};
+            UpdateGroundViewNode(Batches, &Walk, 0, FRUSTUM_ALL_PLANES, FRUSTUM_INTERSECTS);
+        }
+        else
+        {
+            BuildGroundBatches(Batches, Tree, Tiles, frustum, Lod, Arena);
+        }
+
+        Batches->Valid = true;
+        Batches->Camera = *Camera;
+        Batches->ScreenWidth = ScreenWidth;
+        Batches->ScreenHeight = ScreenHeight;
+    }
+
+    // Edited tiles get their record packed again
+    for (u32 Id : Batches->DirtyTileIds)
+    {
+        if (Batches->InViewSlot[Id] != GROUND_NOT_IN_VIEW)
+        {
+            Batches->InstancesInView[Batches->InViewSlot[Id]] = PackGroundTile(Tiles, Id);
+        }
+    }
+
+    Batches->DirtyTileIds.clear();
+
+    return true;
+}
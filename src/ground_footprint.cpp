@@ -0,0 +1,275 @@
+// Ground footprint ------------------------------------------
+// Culling without testing tiles one by one. The tiles are boxes of the same size on a regular
+// grid, so every frustum plane test of IsBoxInFrustum is linear in the grid position of the
+// tile: with the positive vertex of the box folded in, plane p keeps the tiles where
+//      A[p] * I + B[p] * J + C[p] >= 0
+// The 6 half-planes cut the grid down to a convex polygon, the footprint of the frustum on the
+// ground. Each row I of the polygon is one span [JStart, JEnd) of consecutive tile Ids, found by
+// intersecting the half-planes with the row. Culling costs O(rows in view), the tiles inside a
+// span are taken as they are.
+//
+// The tiles can have different elevations (see ground_tiles.cpp), the half-planes use the
+// lowest and highest box in the store so the footprint never misses a tile. The spans are
+// widened by GROUND_FOOTPRINT_EPSILON against float rounding and their ends are then tested
+// with the per-tile test, so on flat ground they hold exactly the tiles IsBoxInFrustum keeps.
+// With hills a span can hold a few tiles the per-tile test would have dropped, never less.
+const f64 GROUND_FOOTPRINT_EPSILON = 0.01; // Tiles
+const u32 GROUND_FOOTPRINT_MAX_VERTICES = 16; // A rectangle clipped by 6 half-planes has at most 10
+
+struct GroundSpan
+{
+    u32 JStart;
+    u32 JEnd;
+};
+
+struct GroundFootprint
+{
+    // Half-planes in tile coordinates, one per frustum plane
+    f64 A[6];
+    f64 B[6];
+    f64 C[6];
+
+    i64 FirstRow; // Rows [FirstRow, EndRow) of the store have a span, everything else is outside
+    i64 EndRow;
+    std::vector<GroundSpan> Spans; // Indexed by row, only filled in between FirstRow and EndRow
+    usize TileCount;               // In all the spans
+};
+
+// The exact test, a single tile through the scalar kernel
+internal bool
+IsGroundTileInFrustum(const Frustum *frustum, const GroundTileStore *Tiles, usize Id)
+{
+    u32 VisibleId;
+
+    return CullTileRunScalar(frustum, FRUSTUM_ALL_PLANES, Tiles, Id, 1, &VisibleId) == 1;
+}
+
+// Keeps the part of Polygon where A * I + B * J + C >= 0 (one Sutherland-Hodgman step), the
+// vertices are (I, J) pairs
+internal u32
+ClipGroundFootprintPolygon(const f64 *Polygon, u32 Count, f64 A, f64 B, f64 C, f64 *Result)
+{
+    u32 ResultCount = 0;
+
+    for (u32 v = 0; v < Count; ++v)
+    {
+        const f64 *Current = &Polygon[v * 2];
+        const f64 *Next = &Polygon[((v + 1) % Count) * 2];
+
+        const f64 CurrentSide = A * Current[0] + B * Current[1] + C;
+        const f64 NextSide = A * Next[0] + B * Next[1] + C;
+
+        if (CurrentSide >= 0.0)
+        {
+            Result[ResultCount * 2 + 0] = Current[0];
+            Result[ResultCount * 2 + 1] = Current[1];
+            ResultCount++;
+        }
+
+        // The edge crosses the line
+        if ((CurrentSide >= 0.0) != (NextSide >= 0.0))
+        {
+            const f64 t = CurrentSide / (CurrentSide - NextSide);
+
+            Result[ResultCount * 2 + 0] = Current[0] + (Next[0] - Current[0]) * t;
+            Result[ResultCount * 2 + 1] = Current[1] + (Next[1] - Current[1]) * t;
+            ResultCount++;
+        }
+    }
+
+    return ResultCount;
+}
+
+// Intersects the half-planes with row I, false when the row is outside
+internal bool
+GetGroundFootprintRow(const GroundFootprint *Footprint, i64 MapSize, i64 I, u32 *JStart, u32 *JEnd)
+{
+    f64 JLow = 0.0;
+    f64 JHigh = (f64)(MapSize - 1);
+
+    for (i32 p = 0; p < 6; ++p)
+    {
+        const f64 Side = Footprint->A[p] * (f64)I + Footprint->C[p];
+        const f64 B = Footprint->B[p];
+
+        if (B > 0.0)
+        {
+            JLow = Max(JLow, -Side / B);
+        }
+        else if (B < 0.0)
+        {
+            JHigh = Min(JHigh, Side / -B);
+        }
+        else if (Side < 0.0)
+        {
+            return false;
+        }
+    }
+
+    if (JLow > JHigh)
+    {
+        return false;
+    }
+
+    *JStart = (u32)ceil(JLow);
+    *JEnd = (u32)floor(JHigh) + 1;
+
+    return *JStart < *JEnd;
+}
+
+// Finds the span of every row in view
+internal void
+BuildGroundFootprint(GroundFootprint *Footprint, const GroundTileStore *Tiles, const Frustum *frustum)
+{
+    ProfileZone("BuildGroundFootprint");
+
+    const i64 MapSize = Tiles->MapSize;
+
+    Footprint->FirstRow = 0;
+    Footprint->EndRow = 0;
+    Footprint->TileCount = 0;
+    Footprint->Spans.resize(MapSize);
+
+    if (Tiles->Count == 0)
+    {
+        return;
+    }
+
+    // Every tile is tile 0 moved by whole tiles
+    const f64 TileSize = Tiles->TileSize;
+    const f64 CenterX = 0.5 * ((f64)Tiles->MinX[0] + (f64)Tiles->MaxX[0]);
+    const f64 CenterZ = 0.5 * ((f64)Tiles->MinZ[0] + (f64)Tiles->MaxZ[0]);
+    const f64 HalfX = 0.5 * ((f64)Tiles->MaxX[0] - (f64)Tiles->MinX[0]);
+    const f64 HalfZ = 0.5 * ((f64)Tiles->MaxZ[0] - (f64)Tiles->MinZ[0]);
+
+    for (i32 p = 0; p < 6; ++p)
+    {
+        const Vector3 normal = frustum->planes[p].normal;
+
+        // The positive vertex of the box, the lowest or highest box in the store for y
+        const f64 Y = (normal.y > 0.0f) ? Tiles->SurfaceMaxY : Tiles->BoundsMinY;
+
+        Footprint->A[p] = normal.x * TileSize;
+        Footprint->B[p] = normal.z * TileSize;
+        Footprint->C[p] = normal.x * CenterX + normal.z * CenterZ + fabs(normal.x) * HalfX + fabs(normal.z) * HalfZ + normal.y * Y + frustum->planes[p].distance;
+
+        // Moves the line out by the epsilon along both axes
+        Footprint->C[p] += GROUND_FOOTPRINT_EPSILON * (fabs(Footprint->A[p]) + fabs(Footprint->B[p]));
+    }
+
+    // The rows in view come from the polygon, the map clipped by every half-plane
+    f64 Polygon[2][GROUND_FOOTPRINT_MAX_VERTICES * 2] = {
+        {-1.0, -1.0, (f64)MapSize, -1.0, (f64)MapSize, (f64)MapSize, -1.0, (f64)MapSize},
+    };
+    u32 Count = 4;
+    u32 Current = 0;
+
+    for (i32 p = 0; p < 6 && Count > 0; ++p)
+    {
+        Count = ClipGroundFootprintPolygon(Polygon[Current], Count, Footprint->A[p], Footprint->B[p], Footprint->C[p], Polygon[1 - Current]);
+        Current = 1 - Current;
+    }
+
+    if (Count == 0)
+    {
+        return;
+    }
+
+    f64 MinI = Polygon[Current][0];
+    f64 MaxI = Polygon[Current][0];
+
+    for (u32 v = 1; v < Count; ++v)
+    {
+        MinI = Min(MinI, Polygon[Current][v * 2]);
+        MaxI = Max(MaxI, Polygon[Current][v * 2]);
+    }
+
+    Footprint->FirstRow = Max((i64)ceil(MinI), (i64)0);
+    Footprint->EndRow = Min((i64)floor(MaxI) + 1, MapSize);
+
+    for (i64 I = Footprint->FirstRow; I < Footprint->EndRow; ++I)
+    {
+        GroundSpan *Span = &Footprint->Spans[I];
+        *Span = {0, 0};
+
+        if (!GetGroundFootprintRow(Footprint, MapSize, I, &Span->JStart, &Span->JEnd))
+        {
+            continue;
+        }
+
+        // The ends were widened, keep only the tiles that pass the exact test
+        const usize RowId = I * MapSize;
+
+        while (Span->JStart < Span->JEnd && !IsGroundTileInFrustum(frustum, Tiles, RowId + Span->JStart))
+        {
+            Span->JStart++;
+        }
+
+        while (Span->JEnd > Span->JStart && !IsGroundTileInFrustum(frustum, Tiles, RowId + Span->JEnd - 1))
+        {
+            Span->JEnd--;
+        }
+
+        Footprint->TileCount += Span->JEnd - Span->JStart;
+    }
+}
+
+// The span of row I cut down to columns [J0, J1), empty when the row is not in view
+internal GroundSpan
+GetGroundFootprintSpan(const GroundFootprint *Footprint, i64 I, u32 J0, u32 J1)
+{
+    if (I < Footprint->FirstRow || I >= Footprint->EndRow)
+    {
+        return {0, 0};
+    }
+
+    const GroundSpan Span = Footprint->Spans[I];
+    const u32 JStart = Max(Span.JStart, J0);
+    const u32 JEnd = Min(Span.JEnd, J1);
+
+    return (JStart < JEnd) ? (GroundSpan){JStart, JEnd} : (GroundSpan){0, 0};
+}
+
+// The visible tiles of a partially visible quadtree leaf, straight from the spans
+internal void
+AcceptGroundFootprintLeaf(const GroundFootprint *Footprint, const GroundQuadtree *Tree, const QuadtreeNode *Leaf, FrameArray<u32> *VisibleTileIds)
+{
+    ReserveFrameArray(VisibleTileIds, VisibleTileIds->Count + (usize)(Leaf->I1 - Leaf->I0) * (Leaf->J1 - Leaf->J0));
+
+    u32 *Out = VisibleTileIds->Items + VisibleTileIds->Count;
+
+    for (u32 i = Leaf->I0; i < Leaf->I1; ++i)
+    {
+        const GroundSpan Span = GetGroundFootprintSpan(Footprint, i, Leaf->J0, Leaf->J1);
+
+        for (u32 j = Span.JStart; j < Span.JEnd; ++j)
+        {
+            *Out++ = (u32)(i * Tree->MapSize + j);
+        }
+    }
+
+    VisibleTileIds->Count = Out - VisibleTileIds->Items;
+}
+
+// Fills VisibleTileIds with every tile of the footprint, in Id order. Same tiles as
+// CullGroundQuadtree on flat ground, without a quadtree
+internal void
+CullGroundFootprint(GroundFootprint *Footprint, const GroundTileStore *Tiles, const Frustum *frustum, FrameArray<u32> *VisibleTileIds)
+{
+    BuildGroundFootprint(Footprint, Tiles, frustum);
+
+    ReserveFrameArray(VisibleTileIds, Footprint->TileCount);
+    VisibleTileIds->Count = Footprint->TileCount;
+    u32 *Out = VisibleTileIds->Items;
+
+    for (i64 I = Footprint->FirstRow; I < Footprint->EndRow; ++I)
+    {
+        const GroundSpan Span = Footprint->Spans[I];
+        const u32 RowId = (u32)(I * Tiles->MapSize);
+
+        for (u32 j = Span.JStart; j < Span.JEnd; ++j)
+        {
+            *Out++ = RowId + j;
+        }
+    }
+}
@@ -0,0 +1,417 @@
+// Ground LOD ------------------------------------------------
+// Far away the tiles are only a few pixels big and instancing every one of them costs more
+// than it shows. Every quadtree leaf (up to 16x16 tiles) is a chunk with pre-baked static
+// meshes, one per level:
+//      level 1: one quad per tile
+//      level 2: one quad per 2x2 tiles
+//      ...
+//      level 5: one quad per 16x16 tiles
+// A merged quad takes the material most of its tiles have. Level 0 means the chunk is not
+// baked and its tiles go through the instanced terrain pass (see ground_terrain.cpp).
+//
+// The level is picked per chunk from how many pixels a tile covers on screen, the batches
+// (see ground_batches.cpp) keep it next to the classification of every leaf.
+//
+// The meshes are baked relative to the corner of their chunk and moved into place when drawn.
+// A merged quad sits at the elevation of the highest tile of its block, straight from the
+// pyramid (see ground_tiles.cpp). Editing a tile only marks its chunk dirty, and a dirty chunk
+// rewrites its vertices and texture coordinates the next time it is drawn, a streamed window
+// brings new hills along.
+const u32 GROUND_LOD_BAKED_LEVELS = 5;
+const f32 GROUND_LOD_INSTANCED_PIXELS = 8.0f; // Tiles at least this big on screen are instanced
+const f32 GROUND_LOD_MIN_QUAD_PIXELS = 3.0f;  // Merged quads are at least this big on screen
+const u32 GROUND_NO_CHUNK = 0xFFFFFFFF;
+
+struct GroundLodView
+{
+    Vector3 CameraPosition;
+    f32 PixelScale; // Pixels covered by one world unit at distance 1
+    f32 TileSize;
+};
+
+struct GroundChunk
+{
+    u32 Node; // Quadtree leaf the chunk covers
+    Mesh Levels[GROUND_LOD_BAKED_LEVELS];
+    bool Dirty;
+};
+
+struct GroundLod
+{
+    GroundChunk *Chunks;
+    usize ChunkCount;
+
+    // Per quadtree node, index into Chunks or GROUND_NO_CHUNK
+    u32 *NodeChunk;
+    usize NodeCount;
+
+    std::vector<u32> DirtyChunks;
+    std::vector<f32> VertexScratch;
+    std::vector<f32> TexCoordScratch;
+
+    TerrainLayout Layout;
+    TerrainAtlas Atlas;
+    const Mesh *TileMesh;
+};
+
+internal GroundLodView
+MakeGroundLodView(const Camera3D *Camera, i32 ScreenHeight, f32 TileSize)
+{
+    GroundLodView Result = {0};
+    Result.CameraPosition = Camera->position;
+    Result.TileSize = TileSize;
+
+    // Keep the half angle in range, the fovy is clamped way past 180 degrees by the zoom code
+    f32 HalfFovy = Camera->fovy * DEG2RAD / 2.0f;
+    HalfFovy = (HalfFovy > 1.5f) ? 1.5f : HalfFovy;
+
+    Result.PixelScale = (f32)ScreenHeight / (2.0f * tanf(HalfFovy));
+
+    return Result;
+}
+
+// 0 when the tiles in the box are big enough on screen to be instanced, otherwise the baked level
+internal u8
+SelectGroundLod(const GroundLodView *View, const BoundingBox *Box)
+{
+    // Distance to the closest point of the box
+    const Vector3 Closest = Vector3Clamp(View->CameraPosition, Box->min, Box->max);
+    f32 Distance = Vector3Distance(View->CameraPosition, Closest);
+    Distance = (Distance < 1.0f) ? 1.0f : Distance;
+
+    const f32 TilePixels = View->PixelScale * View->TileSize / Distance;
+
+    if (TilePixels >= GROUND_LOD_INSTANCED_PIXELS)
+    {
+        return 0;
+    }
+
+    u8 Level = 1;
+    f32 QuadPixels = TilePixels;
+
+    while (QuadPixels < GROUND_LOD_MIN_QUAD_PIXELS && Level < GROUND_LOD_BAKED_LEVELS)
+    {
+        QuadPixels *= 2.0f;
+        ++Level;
+    }
+
+    return Level;
+}
+
+// Side of the square of tiles that one quad covers at the level
+internal u32
+GetGroundLodBlockSize(u32 Level)
+{
+    return 1u << (Level - 1);
+}
+
+internal u32
+CountChunkLevelQuads(const QuadtreeNode *Leaf, u32 Level)
+{
+    const u32 Block = GetGroundLodBlockSize(Level);
+    const u32 BlocksI = (Leaf->I1 - Leaf->I0 + Block - 1) / Block;
+    const u32 BlocksJ = (Leaf->J1 - Leaf->J0 + Block - 1) / Block;
+
+    return BlocksI * BlocksJ;
+}
+
+// The material most tiles of the block have, ties go to the lower index
+internal u32
+GetBlockMaterial(const GroundTileStore *Tiles, u32 I0, u32 I1, u32 J0, u32 J1)
+{
+    u32 Counts[TERRAIN_MAX_MATERIALS] = {0};
+    u32 Best = Tiles->MaterialIndex[I0 * Tiles->MapSize + J0];
+
+    for (u32 i = I0; i < I1; ++i)
+    {
+        for (u32 j = J0; j < J1; ++j)
+        {
+            const u32 Material = Tiles->MaterialIndex[i * Tiles->MapSize + j];
+            ++Counts[Material];
+
+            if (Counts[Material] > Counts[Best] || (Counts[Material] == Counts[Best] && Material < Best))
+            {
+                Best = Material;
+            }
+        }
+    }
+
+    return Best;
+}
+
+// Writes the quads of one level of a chunk, the arrays that are NULL are skipped. Every quad
+// is the tile mesh transformed like lighting_instancing.vs does it, stretched over the block
+internal void
+BakeChunkLevel(const GroundLod *Lod, const GroundTileStore *Tiles, const QuadtreeNode *Leaf, u32 Level, f32 *Vertices, f32 *TexCoords, f32 *Normals, u16 *Indices)
+{
+    const Mesh *TileMesh = Lod->TileMesh;
+    const TerrainLayout *Layout = &Lod->Layout;
+    const u32 Block = GetGroundLodBlockSize(Level);
+
+    const f32 AtlasColumns = (f32)TERRAIN_ATLAS_COLUMNS;
+    const f32 AtlasRows = (f32)Lod->Atlas.Rows;
+    const f32 Inset = Lod->Atlas.Inset;
+
+    u32 Quad = 0;
+
+    for (u32 bi = Leaf->I0; bi < Leaf->I1; bi += Block)
+    {
+        for (u32 bj = Leaf->J0; bj < Leaf->J1; bj += Block)
+        {
+            const u32 BlockI = (bi + Block < Leaf->I1) ? Block : Leaf->I1 - bi;
+            const u32 BlockJ = (bj + Block < Leaf->J1) ? Block : Leaf->J1 - bj;
+
+            // Relative to the corner of the chunk, which is at elevation 0
+            f32 MinY, MaxY;
+            GetGroundHeightRange(Tiles, bi, bi + BlockI, bj, bj + BlockJ, &MinY, &MaxY);
+
+            const Vector3 Center = {
+                ((f32)(bi - Leaf->I0) + BlockI / 2.0f) * Layout->SquareSize,
+                MaxY - GROUND_TILE_THICKNESS / 2.0f,
+                ((f32)(bj - Leaf->J0) + BlockJ / 2.0f) * Layout->SquareSize,
+            };
+
+            const u32 Material = GetBlockMaterial(Tiles, bi, bi + BlockI, bj, bj + BlockJ);
+            const Vector2 Cell = {fmodf((f32)Material, AtlasColumns), floorf((f32)Material / AtlasColumns)};
+
+            const u32 FirstVertex = Quad * TileMesh->vertexCount;
+
+            for (i32 v = 0; v < TileMesh->vertexCount; ++v)
+            {
+                const u32 Out = FirstVertex + v;
+
+                if (Vertices != NULL)
+                {
+                    const Vector3 Local = {TileMesh->vertices[v * 3 + 0], TileMesh->vertices[v * 3 + 1], TileMesh->vertices[v * 3 + 2]};
+                    const Vector3 Offset = Vector3Transform(Local, Layout->TileBasis);
+
+                    Vertices[Out * 3 + 0] = Center.x + Offset.x * BlockI;
+                    Vertices[Out * 3 + 1] = Center.y + Offset.y;
+                    Vertices[Out * 3 + 2] = Center.z + Offset.z * BlockJ;
+                }
+
+                if (TexCoords != NULL)
+                {
+                    const f32 U = Clamp(TileMesh->texcoords[v * 2 + 0], Inset, 1.0f - Inset);
+                    const f32 V = Clamp(TileMesh->texcoords[v * 2 + 1], Inset, 1.0f - Inset);
+
+                    TexCoords[Out * 2 + 0] = (Cell.x + U) / AtlasColumns;
+                    TexCoords[Out * 2 + 1] = (Cell.y + V) / AtlasRows;
+                }
+
+                if (Normals != NULL)
+                {
+                    const Vector3 Local = {TileMesh->normals[v * 3 + 0], TileMesh->normals[v * 3 + 1], TileMesh->normals[v * 3 + 2]};
+                    const Vector3 Normal = Vector3Normalize(Vector3Transform(Local, Layout->TileBasis));
+
+                    Normals[Out * 3 + 0] = Normal.x;
+                    Normals[Out * 3 + 1] = Normal.y;
+                    Normals[Out * 3 + 2] = Normal.z;
+                }
+            }
+
+            if (Indices != NULL)
+            {
+                const u32 IndexCount = TileMesh->triangleCount * 3;
+
+                for (u32 i = 0; i < IndexCount; ++i)
+                {
+                    Indices[Quad * IndexCount + i] = (u16)(FirstVertex + TileMesh->indices[i]);
+                }
+            }
+
+            ++Quad;
+        }
+    }
+}
+
+// Bakes and uploads every level of every chunk. Only the GPU copy is kept, a rebake builds the
+// vertices and texture coordinates again from the tiles
+internal void
+InitGroundLod(GroundLod *Lod, const GroundQuadtree *Tree, const GroundTileStore *Tiles, const Mesh *TileMesh, const TerrainLayout *Layout, const TerrainAtlas *Atlas)
+{
+    Assert(TileMesh->indices != NULL);
+
+    Lod->Layout = *Layout;
+    Lod->Atlas = *Atlas;
+    Lod->TileMesh = TileMesh;
+
+    Lod->NodeCount = Tree->NodeCount;
+    Lod->NodeChunk = (u32 *)calloc(Tree->NodeCount, sizeof(u32));
+    CPUMemory += Tree->NodeCount * sizeof(u32);
+
+    Lod->ChunkCount = 0;
+    for (usize n = 0; n < Tree->NodeCount; ++n)
+    {
+        Lod->NodeChunk[n] = (Tree->Nodes[n].ChildCount == 0) ? (u32)Lod->ChunkCount++ : GROUND_NO_CHUNK;
+    }
+
+    Lod->Chunks = (GroundChunk *)calloc(Lod->ChunkCount, sizeof(GroundChunk));
+    CPUMemory += Lod->ChunkCount * sizeof(GroundChunk);
+
+    for (usize n = 0; n < Tree->NodeCount; ++n)
+    {
+        if (Lod->NodeChunk[n] == GROUND_NO_CHUNK)
+        {
+            continue;
+        }
+
+        GroundChunk *Chunk = &Lod->Chunks[Lod->NodeChunk[n]];
+        const QuadtreeNode *Leaf = &Tree->Nodes[n];
+        Chunk->Node = (u32)n;
+
+        for (u32 Level = 1; Level <= GROUND_LOD_BAKED_LEVELS; ++Level)
+        {
+            const u32 QuadCount = CountChunkLevelQuads(Leaf, Level);
+
+            // raylib meshes use 16-bit indices
+            Assert(QuadCount * TileMesh->vertexCount <= 0xFFFF);
+
+            Mesh *LevelMesh = &Chunk->Levels[Level - 1];
+            LevelMesh->vertexCount = QuadCount * TileMesh->vertexCount;
+            LevelMesh->triangleCount = QuadCount * TileMesh->triangleCount;
+            LevelMesh->vertices = (f32 *)MemAlloc(LevelMesh->vertexCount * 3 * sizeof(f32));
+            LevelMesh->texcoords = (f32 *)MemAlloc(LevelMesh->vertexCount * 2 * sizeof(f32));
+            LevelMesh->normals = (f32 *)MemAlloc(LevelMesh->vertexCount * 3 * sizeof(f32));
+            LevelMesh->indices = (u16 *)MemAlloc(LevelMesh->triangleCount * 3 * sizeof(u16));
+
+            BakeChunkLevel(Lod, Tiles, Leaf, Level, LevelMesh->vertices, LevelMesh->texcoords, LevelMesh->normals, LevelMesh->indices);
+
+            UploadMesh(LevelMesh, false);
+
+            MemFree(LevelMesh->vertices);
+            MemFree(LevelMesh->texcoords);
+            MemFree(LevelMesh->normals);
+            MemFree(LevelMesh->indices);
+            LevelMesh->vertices = NULL;
+            LevelMesh->texcoords = NULL;
+            LevelMesh->normals = NULL;
+            LevelMesh->indices = NULL;
+        }
+    }
+}
+
+internal void
+MarkGroundChunkDirty(GroundLod *Lod, u32 ChunkIndex)
+{
+    GroundChunk *Chunk = &Lod->Chunks[ChunkIndex];
+
+    if (!Chunk->Dirty)
+    {
+        Chunk->Dirty = true;
+        Lod->DirtyChunks.push_back(ChunkIndex);
+    }
+}
+
+// Call after changing the material or the elevation of a tile
+internal void
+InvalidateGroundChunk(GroundLod *Lod, const GroundQuadtree *Tree, usize Id)
+{
+    const u32 Leaf = FindQuadtreeLeaf(Tree, (u32)(Id / Tree->MapSize), (u32)(Id % Tree->MapSize));
+
+    MarkGroundChunkDirty(Lod, Lod->NodeChunk[Leaf]);
+}
+
+// Call after the tiles in the store were replaced
+internal void
+InvalidateAllGroundChunks(GroundLod *Lod)
+{
+    for (usize c = 0; c < Lod->ChunkCount; ++c)
+    {
+        MarkGroundChunkDirty(Lod, (u32)c);
+    }
+}
+
+// The texture coordinates are baked against the atlas layout, a new atlas rebakes every chunk
+internal void
+SetGroundLodAtlas(GroundLod *Lod, const TerrainAtlas *Atlas)
+{
+    Lod->Atlas = *Atlas;
+
+    InvalidateAllGroundChunks(Lod);
+}
+
+// Rebakes the dirty chunks that are about to be drawn, the others wait until they are.
+// NodeState and NodeLod come from GroundBatches
+internal void
+RebakeDirtyGroundChunks(GroundLod *Lod, const GroundQuadtree *Tree, const GroundTileStore *Tiles, const u8 *NodeState, const u8 *NodeLod)
+{
+    ProfileZone("RebakeGroundChunks");
+
+    for (usize d = 0; d < Lod->DirtyChunks.size();)
+    {
+        const u32 ChunkIndex = Lod->DirtyChunks[d];
+        GroundChunk *Chunk = &Lod->Chunks[ChunkIndex];
+        const QuadtreeNode *Leaf = &Tree->Nodes[Chunk->Node];
+
+        if (NodeState[Chunk->Node] == FRUSTUM_OUTSIDE || NodeLod[Chunk->Node] == 0)
+        {
+            ++d;
+            continue;
+        }
+
+        for (u32 Level = 1; Level <= GROUND_LOD_BAKED_LEVELS; ++Level)
+        {
+            const Mesh *LevelMesh = &Chunk->Levels[Level - 1];
+
+            Lod->VertexScratch.resize(LevelMesh->vertexCount * 3);
+            Lod->TexCoordScratch.resize(LevelMesh->vertexCount * 2);
+            BakeChunkLevel(Lod, Tiles, Leaf, Level, Lod->VertexScratch.data(), Lod->TexCoordScratch.data(), NULL, NULL);
+
+            // Buffer 0 holds the vertices, buffer 1 the texture coordinates
+            UpdateMeshBuffer(*LevelMesh, 0, Lod->VertexScratch.data(), (i32)(LevelMesh->vertexCount * 3 * sizeof(f32)), 0);
+            UpdateMeshBuffer(*LevelMesh, 1, Lod->TexCoordScratch.data(), (i32)(LevelMesh->vertexCount * 2 * sizeof(f32)), 0);
+        }
+
+        Chunk->Dirty = false;
+
+        // Swap-remove, the moved entry is looked at next
+        Lod->DirtyChunks[d] = Lod->DirtyChunks.back();
+        Lod->DirtyChunks.pop_back();
+    }
+}
+
+// Draws the chunks in view that the batches gave a baked level, NodeState and NodeLod come from GroundBatches
+internal void
+DrawGroundChunks(const GroundLod *Lod, const GroundQuadtree *Tree, const GroundTileStore *Tiles, const u8 *NodeState, const u8 *NodeLod, const Material *Mat)
+{
+    for (usize c = 0; c < Lod->ChunkCount; ++c)
+    {
+        const GroundChunk *Chunk = &Lod->Chunks[c];
+        const u8 Level = NodeLod[Chunk->Node];
+
+        if (NodeState[Chunk->Node] == FRUSTUM_OUTSIDE || Level == 0)
+        {
+            continue;
+        }
+
+        // Corner of the chunk, the vertices are baked relative to it
+        const QuadtreeNode *Leaf = &Tree->Nodes[Chunk->Node];
+        const Vector3 Corner = Vector3Subtract(GetTileGridCenter(Tiles, Leaf->I0, Leaf->J0), (Vector3){Tiles->TileSize / 2.0f, 0.0f, Tiles->TileSize / 2.0f});
+
+        ProfileZone("DrawChunkMesh");
+        DrawMesh(Chunk->Levels[Level - 1], *Mat, MatrixTranslate(Corner.x, Corner.y, Corner.z));
+    }
+}
+
+internal void
+FreeGroundLod(GroundLod *Lod)
+{
+    for (usize c = 0; c < Lod->ChunkCount; ++c)
+    {
+        for (u32 l = 0; l < GROUND_LOD_BAKED_LEVELS; ++l)
+        {
+            UnloadMesh(Lod->Chunks[c].Levels[l]);
+        }
+    }
+
+    free(Lod->Chunks);
+    CPUMemory -= Lod->ChunkCount * sizeof(GroundChunk);
+
+    free(Lod->NodeChunk);
+    CPUMemory -= Lod->NodeCount * sizeof(u32);
+
+    Lod->Chunks = NULL;
+    Lod->NodeChunk = NULL;
+    Lod->DirtyChunks.clear();
+}
@@ -0,0 +1,252 @@
+// Ground map file -------------------------------------------
+// Binary map format made to be memory mapped and read in place, there is no parsing step.
+//
+//      GroundMapHeader
+//      GroundMapChunkEntry[ChunksPerSide * ChunksPerSide]  (chunk row major)
+//      chunk payloads, every one starts on a GROUND_MAP_ALIGNMENT boundary
+//
+// A chunk payload covers GROUND_MAP_CHUNK_SIZE x GROUND_MAP_CHUNK_SIZE tiles, stored the
+// same way as the tile store (row i, then column j):
+//      u8  Material[ChunkSize * ChunkSize]
+//      f32 Elevation[ChunkSize * ChunkSize]
+// Payloads are page aligned so the pages of a chunk can be handed back to the OS on their
+// own once the chunk leaves the streamed window. Everything is little endian.
+const u32 GROUND_MAP_MAGIC = 0x50414D47; // "GMAP"
+const u32 GROUND_MAP_VERSION = 2; // 2: the f32 per tile is its elevation, not the height of a flat tile
+const u32 GROUND_MAP_CHUNK_SIZE = 64;
+const u64 GROUND_MAP_ALIGNMENT = 4096;
+
+struct GroundMapHeader
+{
+    u32 Magic;
+    u32 Version;
+    u32 WorldSize;     // Tiles per side
+    u32 ChunkSize;     // Tiles per chunk side
+    u32 ChunksPerSide; // WorldSize / ChunkSize
+    u32 ChunkBytes;    // Size of every chunk payload
+    f32 TileSize;
+    u32 MaterialCount;
+    u64 IndexOffset; // Start of the chunk index, from the start of the file
+    u64 FileSize;
+};
+
+struct GroundMapChunkEntry
+{
+    u64 Offset; // Start of the payload, from the start of the file
+    f32 MinElevation;
+    f32 MaxElevation;
+};
+
+static_assert(sizeof(GroundMapHeader) == 48, "The header is part of the file format");
+static_assert(sizeof(GroundMapChunkEntry) == 16, "The chunk index is part of the file format");
+
+struct GroundMapFile
+{
+    MappedFile File;
+
+    const GroundMapHeader *Header;
+    const GroundMapChunkEntry *Chunks;
+};
+
+internal u64
+AlignGroundMapOffset(u64 Offset)
+{
+    return (Offset + GROUND_MAP_ALIGNMENT - 1) & ~(GROUND_MAP_ALIGNMENT - 1);
+}
+
+internal u32
+GetGroundMapChunkBytes(u32 ChunkSize)
+{
+    return ChunkSize * ChunkSize * (sizeof(u8) + sizeof(f32));
+}
+
+// Same rules as the map SetupGroundTiles generates: tiles on the heightmap with a random grass
+// material. (FirstI, FirstJ) is the world tile of the first tile of the chunk
+internal void
+GenerateGroundMapChunk(u32 ChunkSize, i64 FirstI, i64 FirstJ, u8 *Material, f32 *Elevation, f32 *MinElevation, f32 *MaxElevation)
+{
+    *MinElevation = FLT_MAX;
+    *MaxElevation = -FLT_MAX;
+
+    for (u32 t = 0; t < ChunkSize * ChunkSize; ++t)
+    {
+        Material[t] = (u8)GetRandomValue(0, GROUND_MATERIAL_COUNT - 1);
+        Elevation[t] = GetGroundElevation(FirstI + t / ChunkSize, FirstJ + t % ChunkSize);
+
+        *MinElevation = Min(*MinElevation, Elevation[t]);
+        *MaxElevation = Max(*MaxElevation, Elevation[t]);
+    }
+}
+
+// Converter, writes a procedurally generated world of WorldSize x WorldSize tiles. Only one
+// chunk is in memory at a time, so any map size the format allows can be written
+internal bool
+WriteGroundMapFile(const char *Path, u32 WorldSize, f32 TileSize)
+{
+    if (WorldSize == 0 || WorldSize % GROUND_MAP_CHUNK_SIZE != 0 || WorldSize > TERRAIN_MAX_MAP_SIZE)
+    {
+        printf("\tERROR: Map size %u must be a multiple of %u and at most %ld\n", WorldSize, GROUND_MAP_CHUNK_SIZE, TERRAIN_MAX_MAP_SIZE);
+        return false;
+    }
+
+    FILE *File = fopen(Path, "wb");
+    if (File == NULL)
+    {
+        printf("\tERROR: Could not open %s for writing\n", Path);
+        return false;
+    }
+
+    const u32 ChunkSize = GROUND_MAP_CHUNK_SIZE;
+    const u32 ChunksPerSide = WorldSize / ChunkSize;
+    const usize ChunkCount = (usize)ChunksPerSide * ChunksPerSide;
+    const u32 ChunkBytes = GetGroundMapChunkBytes(ChunkSize);
+    const u64 ChunkStride = AlignGroundMapOffset(ChunkBytes);
+
+    GroundMapHeader Header = {0};
+    Header.Magic = GROUND_MAP_MAGIC;
+    Header.Version = GROUND_MAP_VERSION;
+    Header.WorldSize = WorldSize;
+    Header.ChunkSize = ChunkSize;
+    Header.ChunksPerSide = ChunksPerSide;
+    Header.ChunkBytes = ChunkBytes;
+    Header.TileSize = TileSize;
+    Header.MaterialCount = GROUND_MATERIAL_COUNT;
+    Header.IndexOffset = sizeof(GroundMapHeader);
+
+    const u64 FirstChunkOffset = AlignGroundMapOffset(Header.IndexOffset + ChunkCount * sizeof(GroundMapChunkEntry));
+    Header.FileSize = FirstChunkOffset + ChunkCount * ChunkStride;
+
+    // The index is written last, the elevation ranges are only known after generating the chunks
+    std::vector<GroundMapChunkEntry> Index(ChunkCount);
+    std::vector<u8> Payload(ChunkStride, 0);
+
+    u8 *Material = Payload.data();
+    f32 *Elevation = (f32 *)(Payload.data() + ChunkSize * ChunkSize);
+
+    bool Ok = fseek(File, (long)FirstChunkOffset, SEEK_SET) == 0;
+
+    for (usize c = 0; c < ChunkCount && Ok; ++c)
+    {
+        Index[c].Offset = FirstChunkOffset + c * ChunkStride;
+        const i64 FirstI = (i64)(c / ChunksPerSide) * ChunkSize;
+        const i64 FirstJ = (i64)(c % ChunksPerSide) * ChunkSize;
+        GenerateGroundMapChunk(ChunkSize, FirstI, FirstJ, Material, Elevation, &Index[c].MinElevation, &Index[c].MaxElevation);
+
+        Ok = fwrite(Payload.data(), 1, ChunkStride, File) == ChunkStride;
+    }
+
+    // Zero padding between the index and the first chunk
+    std::vector<u8> Front(FirstChunkOffset, 0);
+    memcpy(Front.data(), &Header, sizeof(Header));
+    memcpy(Front.data() + Header.IndexOffset, Index.data(), ChunkCount * sizeof(GroundMapChunkEntry));
+
+    Ok = Ok && fseek(File, 0, SEEK_SET) == 0;
+    Ok = Ok && fwrite(Front.data(), 1, Front.size(), File) == Front.size();
+    Ok = (fclose(File) == 0) && Ok;
+
+    if (!Ok)
+    {
+        printf("\tERROR: Failed writing %s\n", Path);
+        return false;
+    }
+
+    printf("\tWrote %ux%u map (%zu chunks, %f MegaBytes) to %s\n", WorldSize, WorldSize, ChunkCount, (f64)Header.FileSize / (f64)Megabytes(1), Path);
+
+    return true;
+}
+
+// Checks everything the readers index with, so a bad file fails here and not in a chunk read
+internal bool
+ValidateGroundMapFile(const GroundMapFile *Map)
+{
+    if (Map->File.Size < sizeof(GroundMapHeader))
+    {
+        return false;
+    }
+
+    const GroundMapHeader *Header = (const GroundMapHeader *)Map->File.Data;
+    const usize ChunkCount = (usize)Header->ChunksPerSide * Header->ChunksPerSide;
+
+    if (Header->Magic != GROUND_MAP_MAGIC || Header->Version != GROUND_MAP_VERSION ||
+        Header->FileSize != Map->File.Size ||
+        Header->ChunkSize == 0 || Header->WorldSize != Header->ChunkSize * Header->ChunksPerSide ||
+        Header->WorldSize > TERRAIN_MAX_MAP_SIZE ||
+        Header->MaterialCount == 0 || Header->MaterialCount > GROUND_MATERIAL_COUNT ||
+        Header->ChunkBytes != GetGroundMapChunkBytes(Header->ChunkSize) ||
+        Header->IndexOffset + ChunkCount * sizeof(GroundMapChunkEntry) > Map->File.Size)
+    {
+        return false;
+    }
+
+    const GroundMapChunkEntry *Chunks = (const GroundMapChunkEntry *)(Map->File.Data + Header->IndexOffset);
+    for (usize c = 0; c < ChunkCount; ++c)
+    {
+        if (Chunks[c].Offset % GROUND_MAP_ALIGNMENT != 0 || Chunks[c].Offset + Header->ChunkBytes > Map->File.Size)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+internal void
+CloseGroundMapFile(GroundMapFile *Map)
+{
+    CloseMappedFile(&Map->File);
+    *Map = {0};
+}
+
+internal bool
+OpenGroundMapFile(GroundMapFile *Map, const char *Path)
+{
+    *Map = {0};
+
+    if (!OpenMappedFile(&Map->File, Path))
+    {
+        printf("\tERROR: Could not open map %s\n", Path);
+        return false;
+    }
+
+    if (!ValidateGroundMapFile(Map))
+    {
+        CloseGroundMapFile(Map);
+        printf("\tERROR: %s is not a valid map file\n", Path);
+        return false;
+    }
+
+    Map->Header = (const GroundMapHeader *)Map->File.Data;
+    Map->Chunks = (const GroundMapChunkEntry *)(Map->File.Data + Map->Header->IndexOffset);
+
+    return true;
+}
+
+internal const u8 *
+GetGroundMapChunkMaterials(const GroundMapFile *Map, u32 ChunkI, u32 ChunkJ)
+{
+    return Map->File.Data + Map->Chunks[ChunkI * Map->Header->ChunksPerSide + ChunkJ].Offset;
+}
+
+internal const f32 *
+GetGroundMapChunkElevations(const GroundMapFile *Map, u32 ChunkI, u32 ChunkJ)
+{
+    const u32 TilesPerChunk = Map->Header->ChunkSize * Map->Header->ChunkSize;
+
+    return (const f32 *)(GetGroundMapChunkMaterials(Map, ChunkI, ChunkJ) + TilesPerChunk);
+}
+
+// Tells the OS a chunk is about to be read, or that its pages can be dropped. The mapping is
+// read only, so dropped pages are read from the file again on the next touch
+internal void
+AdviseGroundMapChunk(const GroundMapFile *Map, u32 ChunkI, u32 ChunkJ, bool Needed)
+{
+#if defined(__linux__) || defined(__APPLE__)
+    if (!Map->File.Mapped)
+    {
+        return;
+    }
+
+    void *Start = (void *)GetGroundMapChunkMaterials(Map, ChunkI, ChunkJ);
+    madvise(Start, AlignGroundMapOffset(Map->Header->ChunkBytes), Needed ? MADV_WILLNEED : MADV_DONTNEED);
+#endif
+}
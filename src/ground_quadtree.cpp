@@ -0,0 +1,307 @@
+// Ground quadtree -------------------------------------------
+// Bounding hierarchy over the ground tile grid. Every node covers a rectangle of tiles
+// [I0, I1) x [J0, J1) and stores the union of their bounding volumes. Culling walks the
+// tree top down: nodes outside the frustum are dropped and nodes completely inside are
+// accepted without testing a single tile, only partially visible leaves test per tile
+// (with the batch kernels from frustum_simd.cpp).
+const i64 QUADTREE_LEAF_SIZE = 16; // Max tiles per leaf side
+
+struct QuadtreeNode
+{
+    BoundingBox BoundingVolume;
+
+    u32 I0, I1; // Tile rows covered by this node
+    u32 J0, J1; // Tile columns covered by this node
+
+    u32 FirstChild; // Index of the first child in GroundQuadtree::Nodes
+    u32 ChildCount; // 0 for leaves
+};
+
+struct GroundQuadtree
+{
+    QuadtreeNode *Nodes;
+    usize NodeCount;
+
+    i64 MapSize;
+};
+
+internal usize
+CountQuadtreeNodes(u32 I0, u32 I1, u32 J0, u32 J1)
+{
+    const u32 SizeI = I1 - I0;
+    const u32 SizeJ = J1 - J0;
+
+    if (SizeI <= QUADTREE_LEAF_SIZE && SizeJ <= QUADTREE_LEAF_SIZE)
+    {
+        return 1;
+    }
+
+    // Only split the sides that are larger than a leaf
+    const u32 MidI = (SizeI > QUADTREE_LEAF_SIZE) ? I0 + SizeI / 2 : I1;
+    const u32 MidJ = (SizeJ > QUADTREE_LEAF_SIZE) ? J0 + SizeJ / 2 : J1;
+
+    usize Count = 1;
+    Count += CountQuadtreeNodes(I0, MidI, J0, MidJ);
+    if (MidJ < J1)
+    {
+        Count += CountQuadtreeNodes(I0, MidI, MidJ, J1);
+    }
+    if (MidI < I1)
+    {
+        Count += CountQuadtreeNodes(MidI, I1, J0, MidJ);
+    }
+    if (MidI < I1 && MidJ < J1)
+    {
+        Count += CountQuadtreeNodes(MidI, I1, MidJ, J1);
+    }
+
+    return Count;
+}
+
+// Union of the bounding volumes of all the tiles in the leaf. The tiles of a row share their x
+// range and the tiles of a column their z range, so x and z come from the two corner tiles and
+// y from the pyramid (see ground_tiles.cpp)
+internal BoundingBox
+GetQuadtreeLeafBounds(const GroundQuadtree *Tree, const QuadtreeNode *Leaf, const GroundTileStore *Tiles)
+{
+    const BoundingBox First = GetTileBoundingBox(Tiles, Leaf->I0 * Tree->MapSize + Leaf->J0);
+    const BoundingBox Last = GetTileBoundingBox(Tiles, (Leaf->I1 - 1) * Tree->MapSize + Leaf->J1 - 1);
+
+    BoundingBox Result;
+    Result.min = Vector3Min(First.min, Last.min);
+    Result.max = Vector3Max(First.max, Last.max);
+
+    GetGroundHeightRange(Tiles, Leaf->I0, Leaf->I1, Leaf->J0, Leaf->J1, &Result.min.y, &Result.max.y);
+
+    return Result;
+}
+
+internal BoundingBox
+GetQuadtreeChildBounds(const GroundQuadtree *Tree, const QuadtreeNode *Node)
+{
+    BoundingBox Result = Tree->Nodes[Node->FirstChild].BoundingVolume;
+
+    for (u32 c = 1; c < Node->ChildCount; ++c)
+    {
+        Result.min = Vector3Min(Result.min, Tree->Nodes[Node->FirstChild + c].BoundingVolume.min);
+        Result.max = Vector3Max(Result.max, Tree->Nodes[Node->FirstChild + c].BoundingVolume.max);
+    }
+
+    return Result;
+}
+
+internal void
+BuildQuadtreeNode(GroundQuadtree *Tree, u32 NodeIndex, const GroundTileStore *Tiles, u32 I0, u32 I1, u32 J0, u32 J1)
+{
+    QuadtreeNode *Node = &Tree->Nodes[NodeIndex];
+    Node->I0 = I0;
+    Node->I1 = I1;
+    Node->J0 = J0;
+    Node->J1 = J1;
+    Node->FirstChild = 0;
+    Node->ChildCount = 0;
+
+    const u32 SizeI = I1 - I0;
+    const u32 SizeJ = J1 - J0;
+
+    if (SizeI <= QUADTREE_LEAF_SIZE && SizeJ <= QUADTREE_LEAF_SIZE)
+    {
+        Node->BoundingVolume = GetQuadtreeLeafBounds(Tree, Node, Tiles);
+        return;
+    }
+
+    const u32 MidI = (SizeI > QUADTREE_LEAF_SIZE) ? I0 + SizeI / 2 : I1;
+    const u32 MidJ = (SizeJ > QUADTREE_LEAF_SIZE) ? J0 + SizeJ / 2 : J1;
+
+    u32 ChildRects[4][4] = {
+        {I0, MidI, J0, MidJ},
+        {I0, MidI, MidJ, J1},
+        {MidI, I1, J0, MidJ},
+        {MidI, I1, MidJ, J1},
+    };
+
+    // Children are stored next to each other so a node only needs the index of the first one
+    u32 ChildCount = 0;
+    for (u32 c = 0; c < 4; ++c)
+    {
+        if (ChildRects[c][0] < ChildRects[c][1] && ChildRects[c][2] < ChildRects[c][3])
+        {
+            ++ChildCount;
+        }
+    }
+
+    const u32 FirstChild = (u32)Tree->NodeCount;
+    Tree->NodeCount += ChildCount;
+
+    u32 ChildIndex = FirstChild;
+    for (u32 c = 0; c < 4; ++c)
+    {
+        if (ChildRects[c][0] < ChildRects[c][1] && ChildRects[c][2] < ChildRects[c][3])
+        {
+            BuildQuadtreeNode(Tree, ChildIndex, Tiles, ChildRects[c][0], ChildRects[c][1], ChildRects[c][2], ChildRects[c][3]);
+            ++ChildIndex;
+        }
+    }
+
+    Node->FirstChild = FirstChild;
+    Node->ChildCount = ChildCount;
+
+    Node->BoundingVolume = GetQuadtreeChildBounds(Tree, Node);
+}
+
+// Call after UpdateGroundSurfaceRange, the leaves read the pyramid
+internal void
+BuildGroundQuadtree(GroundQuadtree *Tree, const GroundTileStore *Tiles)
+{
+    const i64 MapSize = Tiles->MapSize;
+    const usize MaxNodeCount = CountQuadtreeNodes(0, (u32)MapSize, 0, (u32)MapSize);
+
+    Tree->Nodes = (QuadtreeNode *)calloc(MaxNodeCount, sizeof(QuadtreeNode));
+    CPUMemory += MaxNodeCount * sizeof(QuadtreeNode);
+
+    Tree->MapSize = MapSize;
+    Tree->NodeCount = 1; // The root
+
+    BuildQuadtreeNode(Tree, 0, Tiles, 0, (u32)MapSize, 0, (u32)MapSize);
+
+    Assert(Tree->NodeCount == MaxNodeCount);
+}
+
+// Recomputes every bounding volume after the tiles moved or changed height, the shape of the
+// tree stays the same. Children always come after their parent, so walking the nodes
+// backwards finishes every child before its parent. Call after UpdateGroundSurfaceRange
+internal void
+RefitGroundQuadtree(GroundQuadtree *Tree, const GroundTileStore *Tiles)
+{
+    ParallelFor(Tree->NodeCount, 64, [&](usize Begin, usize End, u32 Worker)
+                {
+                    for (usize n = Begin; n < End; ++n)
+                    {
+                        QuadtreeNode *Node = &Tree->Nodes[n];
+
+                        if (Node->ChildCount == 0)
+                        {
+                            Node->BoundingVolume = GetQuadtreeLeafBounds(Tree, Node, Tiles);
+                        }
+                    }
+                });
+
+    for (usize n = Tree->NodeCount; n-- > 0;)
+    {
+        QuadtreeNode *Node = &Tree->Nodes[n];
+
+        if (Node->ChildCount > 0)
+        {
+            Node->BoundingVolume = GetQuadtreeChildBounds(Tree, Node);
+        }
+    }
+}
+
+internal void
+FreeGroundQuadtree(GroundQuadtree *Tree)
+{
+    free(Tree->Nodes);
+    CPUMemory -= Tree->NodeCount * sizeof(QuadtreeNode);
+
+    *Tree = {0};
+}
+
+// Appends every tile of the node to the visible list, no tests needed
+internal void
+AcceptQuadtreeNode(const GroundQuadtree *Tree, const QuadtreeNode *Node, FrameArray<u32> *VisibleTileIds)
+{
+    ReserveFrameArray(VisibleTileIds, VisibleTileIds->Count + (usize)(Node->I1 - Node->I0) * (Node->J1 - Node->J0));
+
+    u32 *Out = VisibleTileIds->Items + VisibleTileIds->Count;
+
+    for (u32 i = Node->I0; i < Node->I1; ++i)
+    {
+        for (u32 j = Node->J0; j < Node->J1; ++j)
+        {
+            *Out++ = (u32)(i * Tree->MapSize + j);
+        }
+    }
+
+    VisibleTileIds->Count = Out - VisibleTileIds->Items;
+}
+
+// Per-tile tests for a partially visible leaf. Every row of the leaf is a run of consecutive
+// Ids, each run is tested with the batch kernel against the planes left in PlaneMask
+internal void
+CullQuadtreeLeaf(const GroundQuadtree *Tree, const QuadtreeNode *Leaf, const GroundTileStore *Tiles, const Frustum *frustum, u32 PlaneMask, FrameArray<u32> *VisibleTileIds)
+{
+    const u32 RowLength = Leaf->J1 - Leaf->J0;
+
+    for (u32 i = Leaf->I0; i < Leaf->I1; ++i)
+    {
+        const usize FirstId = i * Tree->MapSize + Leaf->J0;
+
+        ReserveFrameArray(VisibleTileIds, VisibleTileIds->Count + RowLength);
+
+        VisibleTileIds->Count += CullTileRun(frustum, PlaneMask, Tiles, FirstId, RowLength, VisibleTileIds->Items + VisibleTileIds->Count);
+    }
+}
+
+internal void
+CullQuadtreeNode(const GroundQuadtree *Tree, u32 NodeIndex, const GroundTileStore *Tiles, const Frustum *frustum, u32 PlaneMask, FrameArray<u32> *VisibleTileIds)
+{
+    const QuadtreeNode *Node = &Tree->Nodes[NodeIndex];
+
+    const FrustumTestResult Result = ClassifyBoxInFrustum(frustum, &Node->BoundingVolume, &PlaneMask);
+
+    if (Result == FRUSTUM_OUTSIDE)
+    {
+        return;
+    }
+
+    if (Result == FRUSTUM_INSIDE)
+    {
+        AcceptQuadtreeNode(Tree, Node, VisibleTileIds);
+        return;
+    }
+
+    if (Node->ChildCount == 0)
+    {
+        CullQuadtreeLeaf(Tree, Node, Tiles, frustum, PlaneMask, VisibleTileIds);
+        return;
+    }
+
+    for (u32 c = 0; c < Node->ChildCount; ++c)
+    {
+        CullQuadtreeNode(Tree, Node->FirstChild + c, Tiles, frustum, PlaneMask, VisibleTileIds);
+    }
+}
+
+// Fills VisibleTileIds with the Id of every tile that passes IsBoxInFrustum
+internal void
+CullGroundQuadtree(const GroundQuadtree *Tree, const GroundTileStore *Tiles, const Frustum *frustum, FrameArray<u32> *VisibleTileIds)
+{
+    VisibleTileIds->Count = 0;
+
+    CullQuadtreeNode(Tree, 0, Tiles, frustum, FRUSTUM_ALL_PLANES, VisibleTileIds);
+}
+
+// Index of the leaf that holds tile (I, J)
+internal u32
+FindQuadtreeLeaf(const GroundQuadtree *Tree, u32 I, u32 J)
+{
+    u32 NodeIndex = 0;
+
+    while (Tree->Nodes[NodeIndex].ChildCount > 0)
+    {
+        const QuadtreeNode *Node = &Tree->Nodes[NodeIndex];
+
+        for (u32 c = 0; c < Node->ChildCount; ++c)
+        {
+            const QuadtreeNode *Child = &Tree->Nodes[Node->FirstChild + c];
+
+            if (I >= Child->I0 && I < Child->I1 && J >= Child->J0 && J < Child->J1)
+            {
+                NodeIndex = Node->FirstChild + c;
+                break;
+            }
+        }
+    }
+
+    return NodeIndex;
+}
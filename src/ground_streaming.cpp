@@ -0,0 +1,178 @@
+// Ground streaming ------------------------------------------
+// Keeps a window of a memory mapped world (see ground_map_file.cpp) in the tile store. The
+// window is a square of whole map chunks around the camera target, the rest of the world
+// stays on disk. When the target leaves the two middle chunks of the window, the window is
+// moved so the target is back in the middle:
+//  - chunks that left the window are handed back to the OS
+//  - the tiles of the new window are read straight from the mapping on the job system
+//  - the quadtree is refitted, the batches start over and the baked chunks are marked dirty
+// Everything else (batches, LOD, picking) keeps working on the store, so the resident set is
+// the store plus the mapped pages of the chunks in the window, whatever the size of the world.
+struct GroundStream
+{
+    GroundMapFile Map;
+
+    i64 WindowChunks; // Window side in map chunks
+    i64 OriginChunkI; // First map chunk in the window
+    i64 OriginChunkJ;
+    bool Loaded;
+};
+
+internal bool
+OpenGroundStream(GroundStream *Stream, const char *Path, i64 WindowSize)
+{
+    *Stream = {};
+
+    if (!OpenGroundMapFile(&Stream->Map, Path))
+    {
+        return false;
+    }
+
+    const GroundMapHeader *Header = Stream->Map.Header;
+
+    if (WindowSize % Header->ChunkSize != 0 || WindowSize > Header->WorldSize)
+    {
+        printf("\tERROR: The window of %ld tiles does not fit the %ux%u map with %u tile chunks\n", WindowSize, Header->WorldSize, Header->WorldSize, Header->ChunkSize);
+        CloseGroundMapFile(&Stream->Map);
+        return false;
+    }
+
+    Stream->WindowChunks = WindowSize / Header->ChunkSize;
+
+    printf("\tStreaming a %ux%u map, %ldx%ld tiles resident\n", Header->WorldSize, Header->WorldSize, WindowSize, WindowSize);
+
+    return true;
+}
+
+internal void
+CloseGroundStream(GroundStream *Stream)
+{
+    CloseGroundMapFile(&Stream->Map);
+
+    *Stream = {};
+}
+
+// Window origin that puts Position in the middle, kept inside the world
+internal void
+GetGroundStreamOrigin(const GroundStream *Stream, const GroundTileStore *Tiles, Vector3 Position, i64 *OriginChunkI, i64 *OriginChunkJ)
+{
+    const i64 ChunkSize = Stream->Map.Header->ChunkSize;
+    const i64 MaxOrigin = Stream->Map.Header->ChunksPerSide - Stream->WindowChunks;
+
+    const f32 HalfWorld = Stream->Map.Header->WorldSize / 2.0f;
+
+    const i64 ChunkI = (i64)floorf((Position.x / Tiles->TileSize + HalfWorld) / ChunkSize);
+    const i64 ChunkJ = (i64)floorf((Position.z / Tiles->TileSize + HalfWorld) / ChunkSize);
+
+    i64 I = ChunkI - Stream->WindowChunks / 2;
+    i64 J = ChunkJ - Stream->WindowChunks / 2;
+
+    *OriginChunkI = (I < 0) ? 0 : ((I > MaxOrigin) ? MaxOrigin : I);
+    *OriginChunkJ = (J < 0) ? 0 : ((J > MaxOrigin) ? MaxOrigin : J);
+}
+
+// Reads the chunks of the window at the origin into the store
+internal void
+LoadGroundWindow(GroundStream *Stream, GroundTileStore *Tiles, i64 OriginChunkI, i64 OriginChunkJ)
+{
+    ProfileZone("LoadGroundWindow");
+
+    const GroundMapFile *Map = &Stream->Map;
+    const u32 ChunkSize = Map->Header->ChunkSize;
+    const u8 MaterialCount = (u8)Map->Header->MaterialCount;
+
+    Assert(Tiles->MapSize == Stream->WindowChunks * ChunkSize);
+
+    // Hand back the pages of the chunks that leave the window, read ahead the ones that enter
+    if (Stream->Loaded)
+    {
+        for (i64 ci = Stream->OriginChunkI; ci < Stream->OriginChunkI + Stream->WindowChunks; ++ci)
+        {
+            for (i64 cj = Stream->OriginChunkJ; cj < Stream->OriginChunkJ + Stream->WindowChunks; ++cj)
+            {
+                const bool StaysIn = ci >= OriginChunkI && ci < OriginChunkI + Stream->WindowChunks &&
+                                     cj >= OriginChunkJ && cj < OriginChunkJ + Stream->WindowChunks;
+
+                if (!StaysIn)
+                {
+                    AdviseGroundMapChunk(Map, (u32)ci, (u32)cj, false);
+                }
+            }
+        }
+    }
+
+    for (i64 ci = OriginChunkI; ci < OriginChunkI + Stream->WindowChunks; ++ci)
+    {
+        for (i64 cj = OriginChunkJ; cj < OriginChunkJ + Stream->WindowChunks; ++cj)
+        {
+            AdviseGroundMapChunk(Map, (u32)ci, (u32)cj, true);
+        }
+    }
+
+    Stream->OriginChunkI = OriginChunkI;
+    Stream->OriginChunkJ = OriginChunkJ;
+    Stream->Loaded = true;
+
+    Tiles->WorldSize = Map->Header->WorldSize;
+    Tiles->OriginI = OriginChunkI * ChunkSize;
+    Tiles->OriginJ = OriginChunkJ * ChunkSize;
+
+    // Chunks are independent, one job each
+    ParallelFor(Stream->WindowChunks * Stream->WindowChunks, 1, [&](usize Begin, usize End, u32 Worker)
+                {
+                    for (usize c = Begin; c < End; ++c)
+                    {
+                        const u32 WindowI = (u32)(c / Stream->WindowChunks);
+                        const u32 WindowJ = (u32)(c % Stream->WindowChunks);
+
+                        const u8 *Materials = GetGroundMapChunkMaterials(Map, (u32)OriginChunkI + WindowI, (u32)OriginChunkJ + WindowJ);
+                        const f32 *Elevations = GetGroundMapChunkElevations(Map, (u32)OriginChunkI + WindowI, (u32)OriginChunkJ + WindowJ);
+
+                        for (u32 i = 0; i < ChunkSize; ++i)
+                        {
+                            const usize FirstId = (WindowI * ChunkSize + i) * Tiles->MapSize + WindowJ * ChunkSize;
+
+                            for (u32 j = 0; j < ChunkSize; ++j)
+                            {
+                                const u8 Material = Materials[i * ChunkSize + j];
+
+                                Tiles->MaterialIndex[FirstId + j] = (Material < MaterialCount) ? Material : 0;
+                                SetGroundTileGeometry(Tiles, FirstId + j, Elevations[i * ChunkSize + j]);
+                            }
+                        }
+                    }
+                });
+
+    UpdateGroundSurfaceRange(Tiles);
+}
+
+// Moves the window when Position left its middle. Returns true when the tiles in the store were
+// replaced, everything built on top of them is brought up to date here
+internal bool
+UpdateGroundStream(GroundStream *Stream, GroundTileStore *Tiles, GroundQuadtree *Tree, GroundBatches *Batches, GroundLod *Lod, Vector3 Position)
+{
+    if (Stream->Map.File.Data == NULL)
+    {
+        return false;
+    }
+
+    i64 OriginChunkI, OriginChunkJ;
+    GetGroundStreamOrigin(Stream, Tiles, Position, &OriginChunkI, &OriginChunkJ);
+
+    // Inside the middle two chunks the window stays put, so going back and forth over a chunk
+    // border does not load the window every time
+    if (Stream->Loaded &&
+        OriginChunkI >= Stream->OriginChunkI - 1 && OriginChunkI <= Stream->OriginChunkI &&
+        OriginChunkJ >= Stream->OriginChunkJ - 1 && OriginChunkJ <= Stream->OriginChunkJ)
+    {
+        return false;
+    }
+
+    LoadGroundWindow(Stream, Tiles, OriginChunkI, OriginChunkJ);
+
+    RefitGroundQuadtree(Tree, Tiles);
+    ResetGroundBatches(Batches);
+    InvalidateAllGroundChunks(Lod);
+
+    return true;
+}
@@ -0,0 +1,324 @@
+// Ground terrain --------------------------------------------
+// Single draw call terrain pass. The tiles sit on a regular grid, so instead of a 64 byte
+// Matrix every visible tile only sends a packed 32-bit record with its grid position and
+// material, and lighting_instancing.vs rebuilds the transform from it:
+//      world = TileBasis * vertex + ((x - MapSize / 2 + 0.5) * SquareSize, elevation, (z - MapSize / 2 + 0.5) * SquareSize)
+// TileBasis is the scale and the two 45 degree rotations that every tile shares. The record
+// has no room left for the elevation, the shader reads it from a float texture with one texel
+// per tile of the store, uploaded again whenever the tiles in the store change.
+//
+// The record is read by the shader as two unsigned shorts:
+//      low:  x (13 bits) | material bits 0-2 << 13
+//      high: z (13 bits) | material bits 3-5 << 13
+// The grass textures live in one atlas and the material picks the cell.
+//
+// x and z are world tile coordinates and MapSize is the size of the whole world, so the records
+// stay valid when the tile store only holds a streamed window of the world.
+const u32 GROUND_MATERIAL_COUNT = 4;
+
+const u32 TERRAIN_COORD_BITS = 13;
+const i64 TERRAIN_MAX_MAP_SIZE = 1 << TERRAIN_COORD_BITS;
+const u32 TERRAIN_MAX_MATERIALS = 64;
+const u32 TERRAIN_ATLAS_COLUMNS = 2;
+
+const i32 TERRAIN_GL_UNSIGNED_SHORT = 0x1403; // GL_UNSIGNED_SHORT, rlgl has no name for it
+
+struct TerrainLayout
+{
+    Matrix TileBasis; // Tile transform without the translation
+    f32 SquareSize;
+    i64 MapSize;
+};
+
+struct TerrainAtlas
+{
+    Texture2D Texture;
+    u32 Rows;  // TERRAIN_ATLAS_COLUMNS cells per row
+    f32 Inset; // Half a texel of a cell, keeps point sampling out of the neighbour cell
+};
+
+struct GroundTerrain
+{
+    TerrainLayout Layout;
+
+    // Per-instance records, the buffer is bound to the vertex array of the tile mesh
+    u32 MeshVao;
+    u32 InstanceVbo;
+    usize InstanceCapacity;
+    usize InstanceCount;
+    i32 InstanceLoc;
+
+    // Elevation of every tile in the store, row I is texel row I
+    u32 ElevationTexture;
+    i32 ElevationMapLoc;
+    i32 StoreOriginLoc;
+    std::vector<f32> ElevationScratch;
+};
+
+internal u32
+PackTileInstance(u32 X, u32 Z, u32 Material)
+{
+    const u32 CoordMask = (1u << TERRAIN_COORD_BITS) - 1;
+
+    const u32 Low = (X & CoordMask) | ((Material & 0x7) << TERRAIN_COORD_BITS);
+    const u32 High = (Z & CoordMask) | (((Material >> 3) & 0x7) << TERRAIN_COORD_BITS);
+
+    return Low | (High << 16);
+}
+
+internal void
+UnpackTileInstance(u32 Packed, u32 *X, u32 *Z, u32 *Material)
+{
+    const u32 CoordMask = (1u << TERRAIN_COORD_BITS) - 1;
+    const u32 Low = Packed & 0xFFFF;
+    const u32 High = Packed >> 16;
+
+    *X = Low & CoordMask;
+    *Z = High & CoordMask;
+    *Material = (Low >> TERRAIN_COORD_BITS) | ((High >> TERRAIN_COORD_BITS) << 3);
+}
+
+internal u32
+PackGroundTile(const GroundTileStore *Tiles, usize Id)
+{
+    const u32 X = (u32)(Tiles->OriginI + (i64)(Id / Tiles->MapSize));
+    const u32 Z = (u32)(Tiles->OriginJ + (i64)(Id % Tiles->MapSize));
+
+    return PackTileInstance(X, Z, Tiles->MaterialIndex[Id]);
+}
+
+// CPU version of what lighting_instancing.vs does with a record and the elevation it reads
+internal Matrix
+ReconstructTileTransform(const TerrainLayout *Layout, u32 Packed, f32 Elevation)
+{
+    u32 X, Z, Material;
+    UnpackTileInstance(Packed, &X, &Z, &Material);
+
+    Matrix Result = Layout->TileBasis;
+    Result.m12 = ((f32)X - Layout->MapSize / 2.0f + 0.5f) * Layout->SquareSize;
+    Result.m13 = Elevation;
+    Result.m14 = ((f32)Z - Layout->MapSize / 2.0f + 0.5f) * Layout->SquareSize;
+
+    return Result;
+}
+
+// The shared basis is taken from the first tile, every tile must then match its record
+internal TerrainLayout
+MakeTerrainLayout(const GroundTileStore *Tiles)
+{
+    Assert(Tiles->WorldSize <= TERRAIN_MAX_MAP_SIZE);
+
+    TerrainLayout Layout = {0};
+    Layout.TileBasis = Tiles->Transforms[0];
+    Layout.TileBasis.m12 = 0.0f;
+    Layout.TileBasis.m13 = 0.0f;
+    Layout.TileBasis.m14 = 0.0f;
+    Layout.SquareSize = Tiles->TileSize;
+    Layout.MapSize = Tiles->WorldSize;
+
+    return Layout;
+}
+
+// Packs the images into a grid of TERRAIN_ATLAS_COLUMNS cells, every cell has the size of the
+// first image. Only touches the CPU, so the asset loader threads can build it
+internal Image
+BuildTerrainAtlasImage(const char **Paths, u32 Count)
+{
+    Assert(Count > 0 && Count <= TERRAIN_MAX_MATERIALS);
+
+    Image First = LoadImage(Paths[0]);
+    const i32 CellWidth = First.width;
+    const i32 CellHeight = First.height;
+    UnloadImage(First);
+
+    const u32 Rows = (Count + TERRAIN_ATLAS_COLUMNS - 1) / TERRAIN_ATLAS_COLUMNS;
+    Image AtlasImage = GenImageColor(CellWidth * TERRAIN_ATLAS_COLUMNS, CellHeight * Rows, BLANK);
+
+    for (u32 i = 0; i < Count; ++i)
+    {
+        Image Cell = LoadImage(Paths[i]);
+        if (Cell.width != CellWidth || Cell.height != CellHeight)
+        {
+            ImageResize(&Cell, CellWidth, CellHeight);
+        }
+
+        const Rectangle Source = {0.0f, 0.0f, (f32)CellWidth, (f32)CellHeight};
+        const Rectangle Dest = {(f32)((i % TERRAIN_ATLAS_COLUMNS) * CellWidth), (f32)((i / TERRAIN_ATLAS_COLUMNS) * CellHeight), (f32)CellWidth, (f32)CellHeight};
+        ImageDraw(&AtlasImage, Cell, Source, Dest, WHITE);
+
+        UnloadImage(Cell);
+    }
+
+    return AtlasImage;
+}
+
+// Atlas of Count materials on an uploaded texture, a texture smaller than the grid (a loading
+// placeholder) gives every material the same texel
+internal TerrainAtlas
+MakeTerrainAtlas(Texture2D Texture, u32 Count)
+{
+    const i32 CellWidth = Max(Texture.width / (i32)TERRAIN_ATLAS_COLUMNS, 1);
+
+    TerrainAtlas Result = {0};
+    Result.Texture = Texture;
+    Result.Rows = (Count + TERRAIN_ATLAS_COLUMNS - 1) / TERRAIN_ATLAS_COLUMNS;
+    Result.Inset = 0.5f / (f32)CellWidth;
+
+    SetTextureWrap(Result.Texture, TEXTURE_WRAP_CLAMP);
+
+    return Result;
+}
+
+internal void
+BindTerrainInstanceBuffer(const GroundTerrain *Terrain)
+{
+    rlEnableVertexArray(Terrain->MeshVao);
+    rlEnableVertexBuffer(Terrain->InstanceVbo);
+    rlSetVertexAttribute(Terrain->InstanceLoc, 2, TERRAIN_GL_UNSIGNED_SHORT, false, sizeof(u32), 0);
+    rlEnableVertexAttribute(Terrain->InstanceLoc);
+    rlSetVertexAttributeDivisor(Terrain->InstanceLoc, 1);
+    rlDisableVertexBuffer();
+    rlDisableVertexArray();
+}
+
+// Atlas uniforms, set again when the loaded atlas replaces the placeholder
+internal void
+SetGroundTerrainAtlas(Shader shader, const TerrainAtlas *Atlas)
+{
+    const f32 AtlasColumns = (f32)TERRAIN_ATLAS_COLUMNS;
+    const f32 AtlasRows = (f32)Atlas->Rows;
+    SetShaderValue(shader, GetShaderLocation(shader, "atlasColumns"), &AtlasColumns, SHADER_UNIFORM_FLOAT);
+    SetShaderValue(shader, GetShaderLocation(shader, "atlasRows"), &AtlasRows, SHADER_UNIFORM_FLOAT);
+    SetShaderValue(shader, GetShaderLocation(shader, "atlasInset"), &Atlas->Inset, SHADER_UNIFORM_FLOAT);
+}
+
+internal void
+InitGroundTerrain(GroundTerrain *Terrain, const GroundTileStore *Tiles, const Mesh *TileMesh, Shader shader, const TerrainAtlas *Atlas)
+{
+    Terrain->Layout = MakeTerrainLayout(Tiles);
+    Terrain->MeshVao = TileMesh->vaoId;
+    Terrain->InstanceLoc = GetShaderLocationAttrib(shader, "instanceTile");
+
+    // The layout uniforms never change, set them once
+    SetShaderValueMatrix(shader, GetShaderLocation(shader, "tileBasis"), Terrain->Layout.TileBasis);
+
+    const f32 SquareSize = Terrain->Layout.SquareSize;
+    const f32 MapSize = (f32)Terrain->Layout.MapSize;
+    SetShaderValue(shader, GetShaderLocation(shader, "squareSize"), &SquareSize, SHADER_UNIFORM_FLOAT);
+    SetShaderValue(shader, GetShaderLocation(shader, "mapSize"), &MapSize, SHADER_UNIFORM_FLOAT);
+
+    SetGroundTerrainAtlas(shader, Atlas);
+
+    Terrain->InstanceCapacity = 4096;
+    Terrain->InstanceCount = 0;
+    Terrain->InstanceVbo = rlLoadVertexBuffer(NULL, (i32)(Terrain->InstanceCapacity * sizeof(u32)), true);
+
+    BindTerrainInstanceBuffer(Terrain);
+
+    Terrain->ElevationMapLoc = GetShaderLocation(shader, "elevationMap");
+    Terrain->StoreOriginLoc = GetShaderLocation(shader, "storeOrigin");
+    Terrain->ElevationTexture = rlLoadTexture(NULL, (i32)Tiles->MapSize, (i32)Tiles->MapSize, PIXELFORMAT_UNCOMPRESSED_R32, 1);
+}
+
+// Call after the tiles in the store were replaced
+internal void
+UploadTerrainElevation(GroundTerrain *Terrain, const GroundTileStore *Tiles, Shader shader)
+{
+    Terrain->ElevationScratch.resize(Tiles->Count);
+
+    for (usize Id = 0; Id < Tiles->Count; ++Id)
+    {
+        Terrain->ElevationScratch[Id] = Tiles->Transforms[Id].m13;
+    }
+
+    rlUpdateTexture(Terrain->ElevationTexture, 0, 0, (i32)Tiles->MapSize, (i32)Tiles->MapSize, PIXELFORMAT_UNCOMPRESSED_R32, Terrain->ElevationScratch.data());
+
+    const f32 StoreOrigin[2] = {(f32)Tiles->OriginI, (f32)Tiles->OriginJ};
+    SetShaderValue(shader, Terrain->StoreOriginLoc, StoreOrigin, SHADER_UNIFORM_VEC2);
+}
+
+// Only needed when the instance list changed, the buffer is kept between frames
+internal void
+UploadTerrainInstances(GroundTerrain *Terrain, const u32 *Instances, usize Count)
+{
+    if (Count > Terrain->InstanceCapacity)
+    {
+        while (Terrain->InstanceCapacity < Count)
+        {
+            Terrain->InstanceCapacity *= 2;
+        }
+
+        rlUnloadVertexBuffer(Terrain->InstanceVbo);
+        Terrain->InstanceVbo = rlLoadVertexBuffer(NULL, (i32)(Terrain->InstanceCapacity * sizeof(u32)), true);
+
+        BindTerrainInstanceBuffer(Terrain);
+    }
+
+    if (Count > 0)
+    {
+        rlUpdateVertexBuffer(Terrain->InstanceVbo, Instances, (i32)(Count * sizeof(u32)), 0);
+    }
+
+    Terrain->InstanceCount = Count;
+}
+
+// Same state as DrawMeshInstanced sets up, but with the persistent record buffer
+internal void
+DrawGroundTerrain(const GroundTerrain *Terrain, const Mesh *TileMesh, const Material *Mat)
+{
+    if (Terrain->InstanceCount == 0)
+    {
+        return;
+    }
+
+    ProfileZone("DrawTerrainInstanced");
+
+    // Flush what raylib has batched so far, the terrain goes straight to rlgl
+    rlDrawRenderBatchActive();
+
+    rlEnableShader(Mat->shader.id);
+
+    const Color Diffuse = Mat->maps[MATERIAL_MAP_DIFFUSE].color;
+    const f32 DiffuseColor[4] = {Diffuse.r / 255.0f, Diffuse.g / 255.0f, Diffuse.b / 255.0f, Diffuse.a / 255.0f};
+    rlSetUniform(Mat->shader.locs[SHADER_LOC_COLOR_DIFFUSE], DiffuseColor, SHADER_UNIFORM_VEC4, 1);
+
+    const Matrix ModelView = MatrixMultiply(rlGetMatrixTransform(), rlGetMatrixModelview());
+    rlSetUniformMatrix(Mat->shader.locs[SHADER_LOC_MATRIX_MVP], MatrixMultiply(ModelView, rlGetMatrixProjection()));
+    rlSetUniformMatrix(Mat->shader.locs[SHADER_LOC_MATRIX_NORMAL], MatrixIdentity());
+
+    const i32 TextureSlot = 0;
+    rlActiveTextureSlot(TextureSlot);
+    rlEnableTexture(Mat->maps[MATERIAL_MAP_DIFFUSE].texture.id);
+    rlSetUniform(Mat->shader.locs[SHADER_LOC_MAP_DIFFUSE], &TextureSlot, SHADER_UNIFORM_INT, 1);
+
+    const i32 ElevationSlot = 1;
+    rlActiveTextureSlot(ElevationSlot);
+    rlEnableTexture(Terrain->ElevationTexture);
+    rlSetUniform(Terrain->ElevationMapLoc, &ElevationSlot, SHADER_UNIFORM_INT, 1);
+
+    rlEnableVertexArray(Terrain->MeshVao);
+    if (TileMesh->indices != NULL)
+    {
+        rlDrawVertexArrayElementsInstanced(0, TileMesh->triangleCount * 3, 0, (i32)Terrain->InstanceCount);
+    }
+    else
+    {
+        rlDrawVertexArrayInstanced(0, TileMesh->vertexCount, (i32)Terrain->InstanceCount);
+    }
+    rlDisableVertexArray();
+
+    rlActiveTextureSlot(ElevationSlot);
+    rlDisableTexture();
+    rlActiveTextureSlot(TextureSlot);
+    rlDisableTexture();
+    rlDisableShader();
+}
+
+internal void
+FreeGroundTerrain(GroundTerrain *Terrain)
+{
+    rlUnloadVertexBuffer(Terrain->InstanceVbo);
+    rlUnloadTexture(Terrain->ElevationTexture);
+
+    *Terrain = GroundTerrain();
+}
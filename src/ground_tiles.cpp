@@ -0,0 +1,399 @@
+// Ground tiles ----------------------------------------------
+// Structure of arrays storage for the ground tiles, the tile Id is the index into every array.
+// The arrays are split by how often they are read:
+//  - hot: the bounding volume min/max and the material index, streamed by culling and batching every frame
+//  - warm: the transform, only read for the tiles that are in view
+//  - cold: tile size and height, only read at setup, picking and for debug drawing
+// A culled tile costs 24 bytes of bounds instead of a 160 byte GroundTile.
+//
+// The store can hold a window of a bigger world (see ground_streaming.cpp). Tile (I, J) of
+// the store is tile (OriginI + I, OriginJ + J) of the world, the world is centered on the origin.
+//
+// Every tile is a slab GROUND_TILE_THICKNESS thick centered on its elevation, which comes from
+// the heightmap (GetGroundElevation, or the map file). On top of the bounds sits a min/max
+// pyramid: level 0 is MinY/MaxY and cell (i, j) of level L holds the lowest bottom and highest
+// top of the tiles [i << L, (i + 1) << L) x [j << L, (j + 1) << L). It gives the height range
+// of any block of tiles without touching the tiles (GetGroundHeightRange), so the quadtree and
+// the LOD chunks stay tight on hills, and picking skips every block the ray passes above.
+const f32 GROUND_TILE_THICKNESS = 0.1f;
+const u32 GROUND_PYRAMID_MAX_LEVELS = 16; // Level 0 included, enough for TERRAIN_MAX_MAP_SIZE tiles per side
+
+// Heightmap, value noise over a lattice of hill points, cut into terraces
+const f32 GROUND_HILL_HEIGHT = 96.0f;
+const f32 GROUND_TERRACE_HEIGHT = 8.0f; // Elevations are whole terraces
+const i64 GROUND_HILL_SPACING = 32;     // Tiles between two hill points
+const f32 GROUND_HILL_SEA_LEVEL = 0.55f; // Noise below this is flat ground at elevation 0
+
+struct GroundTileInfo
+{
+    f32 width;
+    f32 depth;
+    f32 height; // Thickness of the tile
+};
+
+struct GroundTileStore
+{
+    i64 MapSize;
+    usize Count;  // MapSize * MapSize
+    f32 TileSize; // World size of a tile along x and z
+
+    // Tiles per side of the whole world and the world tile of the first tile in the store
+    i64 WorldSize;
+    i64 OriginI;
+    i64 OriginJ;
+
+    // Lowest and highest tile top, see UpdateGroundSurfaceRange
+    f32 SurfaceMinY;
+    f32 SurfaceMaxY;
+    f32 BoundsMinY; // Lowest tile bottom
+
+    // Min/max pyramid, level 0 are the MinY/MaxY arrays below. Levels above 0 are owned
+    u32 PyramidLevels;
+    i64 PyramidSize[GROUND_PYRAMID_MAX_LEVELS]; // Cells per side
+    f32 *PyramidMinY[GROUND_PYRAMID_MAX_LEVELS];
+    f32 *PyramidMaxY[GROUND_PYRAMID_MAX_LEVELS];
+
+    // Hot: bounding volumes used for frustum culling
+    f32 *MinX;
+    f32 *MinY;
+    f32 *MinZ;
+    f32 *MaxX;
+    f32 *MaxY;
+    f32 *MaxZ;
+
+    // Hot: packed material index used for batching
+    u8 *MaterialIndex;
+
+    // Warm: 3D position
+    Matrix *Transforms;
+
+    // Cold
+    GroundTileInfo *Info;
+};
+
+internal void *
+AllocateTileArray(usize Count, usize ElementSize)
+{
+    CPUMemory += Count * ElementSize;
+    return calloc(Count, ElementSize);
+}
+
+internal void
+FreeTileArray(void *Array, usize Count, usize ElementSize)
+{
+    free(Array);
+    CPUMemory -= Count * ElementSize;
+}
+
+internal void
+AllocateGroundTileStore(GroundTileStore *Store, i64 MapSize, f32 TileSize)
+{
+    Store->MapSize = MapSize;
+    Store->Count = MapSize * MapSize;
+    Store->TileSize = TileSize;
+
+    // The whole world until a streamed window says otherwise
+    Store->WorldSize = MapSize;
+    Store->OriginI = 0;
+    Store->OriginJ = 0;
+
+    Store->MinX = (f32 *)AllocateTileArray(Store->Count, sizeof(f32));
+    Store->MinY = (f32 *)AllocateTileArray(Store->Count, sizeof(f32));
+    Store->MinZ = (f32 *)AllocateTileArray(Store->Count, sizeof(f32));
+    Store->MaxX = (f32 *)AllocateTileArray(Store->Count, sizeof(f32));
+    Store->MaxY = (f32 *)AllocateTileArray(Store->Count, sizeof(f32));
+    Store->MaxZ = (f32 *)AllocateTileArray(Store->Count, sizeof(f32));
+
+    Store->MaterialIndex = (u8 *)AllocateTileArray(Store->Count, sizeof(u8));
+
+    Store->Transforms = (Matrix *)AllocateTileArray(Store->Count, sizeof(Matrix));
+
+    Store->Info = (GroundTileInfo *)AllocateTileArray(Store->Count, sizeof(GroundTileInfo));
+
+    // Halve until a single cell covers the store
+    Store->PyramidLevels = 1;
+    Store->PyramidSize[0] = MapSize;
+    Store->PyramidMinY[0] = Store->MinY;
+    Store->PyramidMaxY[0] = Store->MaxY;
+
+    while (Store->PyramidSize[Store->PyramidLevels - 1] > 1)
+    {
+        const u32 Level = Store->PyramidLevels++;
+        Assert(Level < GROUND_PYRAMID_MAX_LEVELS);
+
+        const i64 Size = (Store->PyramidSize[Level - 1] + 1) / 2;
+        Store->PyramidSize[Level] = Size;
+        Store->PyramidMinY[Level] = (f32 *)AllocateTileArray(Size * Size, sizeof(f32));
+        Store->PyramidMaxY[Level] = (f32 *)AllocateTileArray(Size * Size, sizeof(f32));
+    }
+}
+
+internal void
+FreeGroundTileStore(GroundTileStore *Store)
+{
+    FreeTileArray(Store->MinX, Store->Count, sizeof(f32));
+    FreeTileArray(Store->MinY, Store->Count, sizeof(f32));
+    FreeTileArray(Store->MinZ, Store->Count, sizeof(f32));
+    FreeTileArray(Store->MaxX, Store->Count, sizeof(f32));
+    FreeTileArray(Store->MaxY, Store->Count, sizeof(f32));
+    FreeTileArray(Store->MaxZ, Store->Count, sizeof(f32));
+
+    FreeTileArray(Store->MaterialIndex, Store->Count, sizeof(u8));
+
+    FreeTileArray(Store->Transforms, Store->Count, sizeof(Matrix));
+
+    FreeTileArray(Store->Info, Store->Count, sizeof(GroundTileInfo));
+
+    for (u32 Level = 1; Level < Store->PyramidLevels; ++Level)
+    {
+        const i64 Size = Store->PyramidSize[Level];
+        FreeTileArray(Store->PyramidMinY[Level], Size * Size, sizeof(f32));
+        FreeTileArray(Store->PyramidMaxY[Level], Size * Size, sizeof(f32));
+    }
+
+    *Store = {0};
+}
+
+internal BoundingBox
+GetTileBoundingBox(const GroundTileStore *Store, usize Id)
+{
+    BoundingBox Box = {
+        .min = {Store->MinX[Id], Store->MinY[Id], Store->MinZ[Id]},
+        .max = {Store->MaxX[Id], Store->MaxY[Id], Store->MaxZ[Id]},
+    };
+
+    return Box;
+}
+
+internal void
+SetTileBoundingBox(GroundTileStore *Store, usize Id, BoundingBox Box)
+{
+    Store->MinX[Id] = Box.min.x;
+    Store->MinY[Id] = Box.min.y;
+    Store->MinZ[Id] = Box.min.z;
+    Store->MaxX[Id] = Box.max.x;
+    Store->MaxY[Id] = Box.max.y;
+    Store->MaxZ[Id] = Box.max.z;
+}
+
+// World position of the center of tile (I, J) of the store
+internal Vector3
+GetTileGridCenter(const GroundTileStore *Store, i64 I, i64 J)
+{
+    return (Vector3){
+        ((f32)(Store->OriginI + I) - Store->WorldSize / 2.0f + 0.5f) * Store->TileSize,
+        0.0f,
+        ((f32)(Store->OriginJ + J) - Store->WorldSize / 2.0f + 0.5f) * Store->TileSize,
+    };
+}
+
+internal void
+CalculateBoundingBox(GroundTileStore *Tiles, usize Id)
+{
+    const GroundTileInfo *tile = &Tiles->Info[Id];
+
+    const f32 halfWidth = tile->width / 2.0f;
+    const f32 halfDepth = tile->depth / 2.0f;
+    const f32 halfHeight = tile->height / 2.0f; // If you want to center the height
+
+    // Define the corners of the box in local space
+    Vector3 localCorners[8] = {
+        {-halfWidth, -halfHeight, -halfDepth}, // Bottom-left
+        {halfWidth, -halfHeight, -halfDepth},  // Bottom-right
+        {-halfWidth, -halfHeight, halfDepth},  // Top-left
+        {halfWidth, -halfHeight, halfDepth},   // Top-right
+        {-halfWidth, halfHeight, -halfDepth},  // Upper-left
+        {halfWidth, halfHeight, -halfDepth},   // Upper-right
+        {-halfWidth, halfHeight, halfDepth},   // Lower-left
+        {halfWidth, halfHeight, halfDepth}     // Upper-right
+    };
+
+    // Apply the matrix transform to each corner
+    Vector3 transformedCorners[8];
+    for (i32 i = 0; i < 8; ++i)
+    {
+        transformedCorners[i] = Vector3Transform(localCorners[i], Tiles->Transforms[Id]);
+    }
+
+    // Initialize the bounding box
+    BoundingBox BoundingVolume;
+    BoundingVolume.min = transformedCorners[0];
+    BoundingVolume.max = transformedCorners[0];
+
+    // Update min/max based on transformed corners
+    for (i32 i = 1; i < 8; ++i)
+    {
+        BoundingVolume.min = Vector3Min(BoundingVolume.min, transformedCorners[i]);
+        BoundingVolume.max = Vector3Max(BoundingVolume.max, transformedCorners[i]);
+    }
+
+    SetTileBoundingBox(Tiles, Id, BoundingVolume);
+}
+
+// Transform, size and bounding volume of a tile from its place on the grid and its elevation.
+// Only touches the tile itself, so tiles can be set up from any thread
+internal void
+SetGroundTileGeometry(GroundTileStore *Tiles, usize Id, f32 Elevation)
+{
+    Vector3 Center = GetTileGridCenter(Tiles, Id / Tiles->MapSize, Id % Tiles->MapSize);
+    Center.y = Elevation;
+    const f32 SquareSize = Tiles->TileSize;
+
+    // Create a model matrix for each data poto position it
+    Matrix *MatrixTransform = &Tiles->Transforms[Id];
+    *MatrixTransform = MatrixIdentity();
+
+    const f64 Scale = 0.03150;
+    *MatrixTransform = MatrixMultiply(*MatrixTransform, MatrixScale(SquareSize * Scale, SquareSize * Scale, SquareSize * Scale));
+
+    *MatrixTransform = MatrixMultiply(*MatrixTransform, MatrixRotate((Vector3){0.0f, 1.0f, 0.0f}, 45.0f * DEG2RAD));
+
+    *MatrixTransform = MatrixMultiply(*MatrixTransform, MatrixTranslate(Center.x, Center.y, Center.z));
+
+    // Bounding box from the Tiles->Transforms[Id] and the width, depth, height
+    Tiles->Info[Id].width = 1.0f * SquareSize;
+    Tiles->Info[Id].depth = 1.0f * SquareSize;
+    Tiles->Info[Id].height = GROUND_TILE_THICKNESS;
+
+    CalculateBoundingBox(Tiles, Id);
+
+    // Rotated 45 degrees, only for rendering, the bounding box above is already final
+    const Matrix rotationMatrix = MatrixRotate((Vector3){0.0f, 1.0f, 0.0f}, 45.0f * DEG2RAD);
+    *MatrixTransform = MatrixMultiply(rotationMatrix, *MatrixTransform);
+}
+
+// Tile center in world space, taken from the translation part of the transform
+internal Vector3
+GetTilePosition(const GroundTileStore *Store, usize Id)
+{
+    const Matrix *Transform = &Store->Transforms[Id];
+
+    return (Vector3){Transform->m12, Transform->m13, Transform->m14};
+}
+
+// Hash of a hill point, in [0, 1]
+internal f32
+GetGroundHillValue(i64 I, i64 J)
+{
+    u64 Hash = (u64)I * 0x9E3779B97F4A7C15ull ^ (u64)J * 0xC2B2AE3D27D4EB4Full;
+    Hash ^= Hash >> 29;
+    Hash *= 0xBF58476D1CE4E5B9ull;
+    Hash ^= Hash >> 32;
+
+    return (f32)(Hash & 0xFFFFFF) / (f32)0xFFFFFF;
+}
+
+// Value noise with a smooth blend between the four hill points around the tile
+internal f32
+GetGroundHillNoise(i64 WorldI, i64 WorldJ, i64 Spacing)
+{
+    const i64 CellI = WorldI / Spacing;
+    const i64 CellJ = WorldJ / Spacing;
+    f32 U = (f32)(WorldI - CellI * Spacing) / (f32)Spacing;
+    f32 V = (f32)(WorldJ - CellJ * Spacing) / (f32)Spacing;
+    U = U * U * (3.0f - 2.0f * U);
+    V = V * V * (3.0f - 2.0f * V);
+
+    const f32 Top = Lerp(GetGroundHillValue(CellI, CellJ), GetGroundHillValue(CellI, CellJ + 1), V);
+    const f32 Bottom = Lerp(GetGroundHillValue(CellI + 1, CellJ), GetGroundHillValue(CellI + 1, CellJ + 1), V);
+
+    return Lerp(Top, Bottom, U);
+}
+
+// Elevation of world tile (WorldI, WorldJ), the same in every run so the map file converter and
+// the in-memory map agree. Most of the world is flat ground at 0 with terraced hills on top
+internal f32
+GetGroundElevation(i64 WorldI, i64 WorldJ)
+{
+    const f32 Noise = 0.75f * GetGroundHillNoise(WorldI, WorldJ, GROUND_HILL_SPACING) +
+                      0.25f * GetGroundHillNoise(WorldI, WorldJ, GROUND_HILL_SPACING / 4);
+
+    const f32 Hill = Max(Noise - GROUND_HILL_SEA_LEVEL, 0.0f) / (1.0f - GROUND_HILL_SEA_LEVEL);
+
+    return floorf(Hill * GROUND_HILL_HEIGHT / GROUND_TERRACE_HEIGHT) * GROUND_TERRACE_HEIGHT;
+}
+
+// Call after the bounding volumes change, rebuilds the pyramid. Picking only walks the tiles
+// between these heights and the footprint culling (see ground_footprint.cpp) covers everything
+// down to BoundsMinY
+internal void
+UpdateGroundSurfaceRange(GroundTileStore *Store)
+{
+    for (u32 Level = 1; Level < Store->PyramidLevels; ++Level)
+    {
+        const i64 Size = Store->PyramidSize[Level];
+        const i64 Below = Store->PyramidSize[Level - 1];
+        const f32 *BelowMinY = Store->PyramidMinY[Level - 1];
+        const f32 *BelowMaxY = Store->PyramidMaxY[Level - 1];
+
+        for (i64 i = 0; i < Size; ++i)
+        {
+            for (i64 j = 0; j < Size; ++j)
+            {
+                // The last row and column of an odd level only have one cell below them
+                const i64 I0 = i * 2;
+                const i64 J0 = j * 2;
+                const i64 I1 = Min(I0 + 1, Below - 1);
+                const i64 J1 = Min(J0 + 1, Below - 1);
+
+                const f32 MinY = Min(Min(BelowMinY[I0 * Below + J0], BelowMinY[I0 * Below + J1]),
+                                     Min(BelowMinY[I1 * Below + J0], BelowMinY[I1 * Below + J1]));
+                const f32 MaxY = Max(Max(BelowMaxY[I0 * Below + J0], BelowMaxY[I0 * Below + J1]),
+                                     Max(BelowMaxY[I1 * Below + J0], BelowMaxY[I1 * Below + J1]));
+
+                Store->PyramidMinY[Level][i * Size + j] = MinY;
+                Store->PyramidMaxY[Level][i * Size + j] = MaxY;
+            }
+        }
+    }
+
+    Store->SurfaceMinY = FLT_MAX;
+    Store->SurfaceMaxY = -FLT_MAX;
+    Store->BoundsMinY = FLT_MAX;
+
+    for (usize Id = 0; Id < Store->Count; ++Id)
+    {
+        Store->SurfaceMinY = (Store->MaxY[Id] < Store->SurfaceMinY) ? Store->MaxY[Id] : Store->SurfaceMinY;
+        Store->SurfaceMaxY = (Store->MaxY[Id] > Store->SurfaceMaxY) ? Store->MaxY[Id] : Store->SurfaceMaxY;
+        Store->BoundsMinY = (Store->MinY[Id] < Store->BoundsMinY) ? Store->MinY[Id] : Store->BoundsMinY;
+    }
+}
+
+internal void
+AddGroundHeightRange(const GroundTileStore *Store, u32 Level, i64 CellI, i64 CellJ, i64 I0, i64 I1, i64 J0, i64 J1, f32 *MinY, f32 *MaxY)
+{
+    const i64 CellI0 = CellI << Level;
+    const i64 CellJ0 = CellJ << Level;
+    const i64 CellI1 = Min((CellI + 1) << Level, Store->MapSize);
+    const i64 CellJ1 = Min((CellJ + 1) << Level, Store->MapSize);
+
+    if (CellI0 >= I1 || CellI1 <= I0 || CellJ0 >= J1 || CellJ1 <= J0)
+    {
+        return;
+    }
+
+    // Level 0 cells are single tiles, so they always end up here or above
+    if (CellI0 >= I0 && CellI1 <= I1 && CellJ0 >= J0 && CellJ1 <= J1)
+    {
+        const i64 Cell = CellI * Store->PyramidSize[Level] + CellJ;
+        *MinY = Min(*MinY, Store->PyramidMinY[Level][Cell]);
+        *MaxY = Max(*MaxY, Store->PyramidMaxY[Level][Cell]);
+        return;
+    }
+
+    for (i64 c = 0; c < 4; ++c)
+    {
+        AddGroundHeightRange(Store, Level - 1, CellI * 2 + c / 2, CellJ * 2 + c % 2, I0, I1, J0, J1, MinY, MaxY);
+    }
+}
+
+// Lowest bottom and highest top of the tiles [I0, I1) x [J0, J1), from the biggest pyramid cells
+// that fit. A block aligned to its power of two size is a single cell
+internal void
+GetGroundHeightRange(const GroundTileStore *Store, i64 I0, i64 I1, i64 J0, i64 J1, f32 *MinY, f32 *MaxY)
+{
+    *MinY = FLT_MAX;
+    *MaxY = -FLT_MAX;
+
+    AddGroundHeightRange(Store, Store->PyramidLevels - 1, 0, 0, I0, I1, J0, J1, MinY, MaxY);
+}
@@ -0,0 +1,357 @@
+// Job system ------------------------------------------------
+// Small work-stealing scheduler. Every worker owns a deque of jobs: it pushes and pops at the
+// bottom, idle workers steal from the top of the other deques. The main thread is worker 0 and
+// helps out while it waits, so a ParallelFor never leaves a core idle.
+//
+// A job is a range of a ParallelFor. Ranges bigger than the grain are split in half, one half
+// is pushed for others to steal and the other half is kept, so the work spreads out in a
+// logarithmic number of steps. Nothing is allocated after JobSystemInit.
+//
+// Threads the job system did not start (the simulation thread, see sim_thread.cpp) can get a
+// queue of their own with JobSystemAddThread. Their ParallelFors run next to the ones of the
+// main thread and only the pool threads (workers 1 to WorkerCount - 1) steal from them. A pool
+// thread that splits a stolen range pushes the halves back to the queue of the thread that owns
+// the loop, never to its own, so the main thread never picks up their ranges and their work
+// never lands in the middle of a frame. They never steal themselves either: a loop that keeps
+// per-worker data for worker 0 to WorkerCount - 1 is never run by them.
+const u32 MAX_WORKERS = 64;
+const u32 MAX_ADDED_THREADS = 4; // Queues after the workers kept free for JobSystemAddThread
+const u32 WORKER_QUEUE_SIZE = 256; // Must be a power of two
+
+// Called for every range [Begin, End), WorkerIndex can be used to index per-worker data
+typedef void JobFunction(void *Data, usize Begin, usize End, u32 WorkerIndex);
+
+struct ParallelForState
+{
+    JobFunction *Function;
+    void *Data;
+    usize Grain;
+    u32 Owner; // Queue of the thread that runs the loop, split ranges go back to it
+
+    std::atomic<usize> Remaining; // Items that have not been processed yet
+};
+
+struct Job
+{
+    ParallelForState *State;
+    usize Begin;
+    usize End;
+};
+
+struct alignas(64) WorkerQueue
+{
+    std::atomic_flag Lock;
+    u32 Top;    // Thieves take from here
+    u32 Bottom; // The owner pushes and pops here
+    Job Jobs[WORKER_QUEUE_SIZE];
+};
+
+struct JobSystem
+{
+    u32 WorkerCount;             // Including the main thread
+    std::atomic<u32> QueueCount; // Workers and the threads added after them
+
+    std::thread Threads[MAX_WORKERS];
+    WorkerQueue Queues[MAX_WORKERS + MAX_ADDED_THREADS];
+
+    std::atomic<u32> QueuedJobs;
+    std::atomic<bool> Quit;
+
+    std::atomic<u64> AddedRangesOnMain; // Ranges of added threads the main thread ran, has to stay 0
+
+    std::mutex SleepLock;
+    std::condition_variable WakeUp;
+};
+
+global_variable JobSystem Jobs;
+thread_local u32 WorkerIndex = 0;
+thread_local bool WorkerSteals = true; // False on the threads added with JobSystemAddThread
+
+internal void
+LockWorkerQueue(WorkerQueue *Queue)
+{
+    while (Queue->Lock.test_and_set(std::memory_order_acquire))
+    {
+        // Spin, the lock is only ever held for a couple of instructions
+    }
+}
+
+internal void
+UnlockWorkerQueue(WorkerQueue *Queue)
+{
+    Queue->Lock.clear(std::memory_order_release);
+}
+
+internal bool
+PushJob(u32 Worker, Job NewJob)
+{
+    WorkerQueue *Queue = &Jobs.Queues[Worker];
+
+    LockWorkerQueue(Queue);
+    const bool HasRoom = (Queue->Bottom - Queue->Top) < WORKER_QUEUE_SIZE;
+    if (HasRoom)
+    {
+        Queue->Jobs[Queue->Bottom & (WORKER_QUEUE_SIZE - 1)] = NewJob;
+        Queue->Bottom++;
+    }
+    UnlockWorkerQueue(Queue);
+
+    if (HasRoom)
+    {
+        Jobs.QueuedJobs.fetch_add(1, std::memory_order_release);
+
+        // Taking the sleep lock orders the push with a worker that is about to go to sleep,
+        // otherwise it could check QueuedJobs right before the increment and miss the wake up
+        {
+            std::lock_guard<std::mutex> Lock(Jobs.SleepLock);
+        }
+        Jobs.WakeUp.notify_one();
+    }
+
+    return HasRoom;
+}
+
+internal bool
+PopJob(u32 Worker, Job *Result)
+{
+    WorkerQueue *Queue = &Jobs.Queues[Worker];
+
+    LockWorkerQueue(Queue);
+    const bool HasJob = Queue->Bottom != Queue->Top;
+    if (HasJob)
+    {
+        Queue->Bottom--;
+        *Result = Queue->Jobs[Queue->Bottom & (WORKER_QUEUE_SIZE - 1)];
+    }
+    UnlockWorkerQueue(Queue);
+
+    if (HasJob)
+    {
+        Jobs.QueuedJobs.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    return HasJob;
+}
+
+internal bool
+StealJob(u32 Victim, Job *Result)
+{
+    WorkerQueue *Queue = &Jobs.Queues[Victim];
+
+    LockWorkerQueue(Queue);
+    const bool HasJob = Queue->Bottom != Queue->Top;
+    if (HasJob)
+    {
+        *Result = Queue->Jobs[Queue->Top & (WORKER_QUEUE_SIZE - 1)];
+        Queue->Top++;
+    }
+    UnlockWorkerQueue(Queue);
+
+    if (HasJob)
+    {
+        Jobs.QueuedJobs.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    return HasJob;
+}
+
+internal void
+RunJob(Job CurrentJob, u32 Worker)
+{
+    ParallelForState *State = CurrentJob.State;
+
+    if (Worker == 0 && State->Owner >= Jobs.WorkerCount)
+    {
+        Jobs.AddedRangesOnMain.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // The loops of added threads stay in their queue, the main thread does not steal from it
+    const u32 Queue = (State->Owner >= Jobs.WorkerCount) ? State->Owner : Worker;
+
+    // Keep the first half, give the second half away until the range is small enough
+    while (CurrentJob.End - CurrentJob.Begin > State->Grain)
+    {
+        const usize Middle = CurrentJob.Begin + (CurrentJob.End - CurrentJob.Begin) / 2;
+
+        if (!PushJob(Queue, (Job){State, Middle, CurrentJob.End}))
+        {
+            break; // Queue is full, just do the whole range here
+        }
+
+        CurrentJob.End = Middle;
+    }
+
+    State->Function(State->Data, CurrentJob.Begin, CurrentJob.End, Worker);
+
+    State->Remaining.fetch_sub(CurrentJob.End - CurrentJob.Begin, std::memory_order_acq_rel);
+}
+
+// Runs one job from our own queue or stolen from another worker, false if there was nothing to do
+internal bool
+RunNextJob(u32 Worker)
+{
+    Job NextJob;
+
+    if (PopJob(Worker, &NextJob))
+    {
+        RunJob(NextJob, Worker);
+        return true;
+    }
+
+    if (!WorkerSteals)
+    {
+        return false;
+    }
+
+    const u32 QueueCount = Jobs.QueueCount.load(std::memory_order_acquire);
+
+    for (u32 i = 1; i < QueueCount; ++i)
+    {
+        const u32 Victim = (Worker + i) % QueueCount;
+
+        // The main thread leaves the queues of added threads to the pool
+        if (Worker == 0 && Victim >= Jobs.WorkerCount)
+        {
+            continue;
+        }
+
+        if (StealJob(Victim, &NextJob))
+        {
+            RunJob(NextJob, Worker);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+internal void
+WorkerThreadMain(u32 Worker)
+{
+    WorkerIndex = Worker;
+
+    while (!Jobs.Quit.load(std::memory_order_acquire))
+    {
+        if (RunNextJob(Worker))
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> Lock(Jobs.SleepLock);
+        Jobs.WakeUp.wait(Lock, []
+                         { return Jobs.QueuedJobs.load(std::memory_order_acquire) > 0 || Jobs.Quit.load(std::memory_order_acquire); });
+    }
+}
+
+// WorkerCount includes the main thread, 0 means one worker per hardware thread
+internal void
+JobSystemInit(u32 WorkerCount)
+{
+    if (WorkerCount == 0)
+    {
+        WorkerCount = std::thread::hardware_concurrency();
+    }
+
+    WorkerCount = (WorkerCount < 1) ? 1 : WorkerCount;
+    WorkerCount = (WorkerCount > MAX_WORKERS) ? MAX_WORKERS : WorkerCount;
+
+    Jobs.WorkerCount = WorkerCount;
+    Jobs.QueueCount = WorkerCount;
+    Jobs.QueuedJobs = 0;
+    Jobs.Quit = false;
+    Jobs.AddedRangesOnMain = 0;
+
+    for (u32 i = 0; i < ArrayCount(Jobs.Queues); ++i)
+    {
+        Jobs.Queues[i].Lock.clear();
+        Jobs.Queues[i].Top = 0;
+        Jobs.Queues[i].Bottom = 0;
+    }
+
+    WorkerIndex = 0;
+
+    for (u32 i = 1; i < WorkerCount; ++i)
+    {
+        Jobs.Threads[i] = std::thread(WorkerThreadMain, i);
+    }
+}
+
+internal void
+JobSystemShutdown(void)
+{
+    {
+        std::lock_guard<std::mutex> Lock(Jobs.SleepLock);
+        Jobs.Quit = true;
+    }
+    Jobs.WakeUp.notify_all();
+
+    for (u32 i = 1; i < Jobs.WorkerCount; ++i)
+    {
+        if (Jobs.Threads[i].joinable())
+        {
+            Jobs.Threads[i].join();
+        }
+    }
+
+    Jobs.WorkerCount = 0;
+    Jobs.QueueCount = 0;
+}
+
+// Gives the calling thread a queue after the ones of the workers. Call it on the thread before
+// its first ParallelFor, and stop the thread before JobSystemShutdown
+internal void
+JobSystemAddThread(void)
+{
+    const u32 Queue = Jobs.QueueCount.fetch_add(1, std::memory_order_acq_rel);
+    Assert(Queue < Jobs.WorkerCount + MAX_ADDED_THREADS);
+
+    WorkerIndex = Queue;
+    WorkerSteals = false;
+}
+
+internal void
+ParallelForRange(usize Count, usize Grain, JobFunction *Function, void *Data)
+{
+    if (Count == 0)
+    {
+        return;
+    }
+
+    const u32 Worker = WorkerIndex;
+
+    if (Jobs.WorkerCount <= 1 || Count <= Grain)
+    {
+        Function(Data, 0, Count, Worker);
+        return;
+    }
+
+    ParallelForState State;
+    State.Function = Function;
+    State.Data = Data;
+    State.Grain = (Grain < 1) ? 1 : Grain;
+    State.Owner = Worker;
+    State.Remaining = Count;
+
+    RunJob((Job){&State, 0, Count}, Worker);
+
+    // Help with whatever is queued until every range of this loop is done
+    while (State.Remaining.load(std::memory_order_acquire) > 0)
+    {
+        if (!RunNextJob(Worker))
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+// Calls Body(Begin, End, WorkerIndex) for ranges of at most Grain items until [0, Count) is covered
+template <typename F>
+internal void
+ParallelFor(usize Count, usize Grain, F &&Body)
+{
+    using BodyType = std::remove_reference_t<F>;
+
+    ParallelForRange(Count, Grain, [](void *Data, usize Begin, usize End, u32 Worker)
+                     { (*(BodyType *)Data)(Begin, End, Worker); },
+                     (void *)&Body);
+}
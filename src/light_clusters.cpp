@@ -0,0 +1,440 @@
+// Light clusters --------------------------------------------
+// Clustered forward lighting for point lights. The view is cut into LIGHT_CLUSTERS_X by
+// LIGHT_CLUSTERS_Y screen tiles and LIGHT_CLUSTERS_Z depth slices, the slices grow
+// exponentially with the view depth so near and far clusters are about as deep as they are wide.
+// Every frame the CPU bins the lights into the clusters they reach and the fragment shader only
+// loops over the lights of its own cluster (see shaders/lighting.fs), instead of every light.
+//
+// BinLightClusters only touches the CPU: in every slice a light reaches, the view space bounding
+// box of its sphere is projected to a range of screen tiles, and the light goes into every
+// cluster of that range. The lists end up in one array like a CSR matrix, cluster c has the lights
+//      Indices[Offset[c] .. Offset[c] + Count[c])
+// The GPU gets three float textures: the lights, the offset and count of every cluster and the
+// index array. GLSL 330 has no storage buffers, texelFetch reads them like arrays.
+//
+// The lights, the lists and the texels to upload are only kept for one frame, they live in the
+// frame arena given to BeginLightClusters.
+const u32 LIGHT_CLUSTERS_X = 16; // Same numbers in shaders/lighting.fs
+const u32 LIGHT_CLUSTERS_Y = 9;
+const u32 LIGHT_CLUSTERS_Z = 24;
+const u32 LIGHT_CLUSTER_COUNT = LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z;
+
+const u32 LIGHT_CLUSTER_MAX_LIGHTS = 1024;
+const u32 LIGHT_CLUSTER_INDEX_WIDTH = 4096;                              // Texels per row of the index texture
+const u32 LIGHT_CLUSTER_MAX_INDICES = LIGHT_CLUSTER_INDEX_WIDTH * 64;    // Lights in all the lists together
+const f32 LIGHT_CLUSTER_NEAR = 16.0f;                                    // View depth the slices start at, everything closer is in the first
+const f32 LIGHT_CLUSTER_FAR = 4000.0f;                                   // Far plane of the game's projection
+const f32 LIGHT_CLUSTER_CAMERA_NEAR = 0.01f;                             // Near plane of the game's projection
+const i32 LIGHT_CLUSTER_TEXTURE_SLOT = 12;                               // First of 3 slots, above the ones DrawMesh uses for material maps
+const u32 LIGHT_CLUSTER_MAX_SHADERS = 4;
+
+struct PointLight
+{
+    Vector3 Position;
+    f32 Radius; // Nothing is lit beyond it
+    Color LightColor;
+};
+
+// The screen tiles a light reaches in one slice, inclusive
+struct LightClusterSpan
+{
+    u16 Light;
+    u8 Z;
+    u8 X0, X1;
+    u8 Y0, Y1;
+};
+
+// Uniform locations of a shader the clusters are fed to
+struct LightClusterShader
+{
+    Shader Target;
+    i32 ViewPosLoc;
+    i32 ViewForwardLoc;
+    i32 ClusterScaleLoc;
+    i32 ClusterDepthLoc;
+};
+
+struct LightClusters
+{
+    FrameArena *Arena;              // Of the current frame
+    FrameArray<PointLight> Lights; // Filled by the game every frame, at most LIGHT_CLUSTER_MAX_LIGHTS
+
+    // Output of BinLightClusters
+    u32 Offset[LIGHT_CLUSTER_COUNT];
+    u32 Count[LIGHT_CLUSTER_COUNT];
+    FrameArray<u16> Indices;
+    u32 Dropped; // Light and cluster pairs that did not fit in LIGHT_CLUSTER_MAX_INDICES
+
+    // View the clusters were binned for
+    Matrix View;
+    Vector3 Position;
+    Vector3 Forward;
+    f32 TanX; // Half the view size at depth 1
+    f32 TanY;
+    f32 InvTanX;
+    f32 InvTanY;
+    f32 SliceScale;                          // Slices per log of the depth
+    f32 SliceDepth[LIGHT_CLUSTERS_Z + 1];    // View depth every slice starts at, the last is the far plane
+
+    FrameArray<LightClusterSpan> Spans; // Scratch
+    u32 Filled[LIGHT_CLUSTER_COUNT];     // Per cluster, scratch
+
+    // GPU side
+    Texture2D LightTexture; // 2 texels per light: position and radius, color
+    Texture2D GridTexture;  // 1 texel per cluster: offset, count
+    Texture2D IndexTexture; // 1 texel per index
+
+    LightClusterShader Shaders[LIGHT_CLUSTER_MAX_SHADERS];
+    u32 ShaderCount;
+};
+
+internal u32
+GetLightClusterIndex(u32 X, u32 Y, u32 Z)
+{
+    return X + Y * LIGHT_CLUSTERS_X + Z * LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y;
+}
+
+// Depth slice of a view depth, the same math as the fragment shader
+internal u32
+GetLightClusterSlice(const LightClusters *Clusters, f32 Depth)
+{
+    if (Depth <= LIGHT_CLUSTER_NEAR)
+    {
+        return 0;
+    }
+
+    // Positive here, the cast rounds down
+    const f32 Slice = logf(Depth / LIGHT_CLUSTER_NEAR) * Clusters->SliceScale;
+
+    return (u32)Min(Slice, (f32)(LIGHT_CLUSTERS_Z - 1));
+}
+
+internal u8
+GetLightClusterTile(f32 Ndc, u32 TileCount)
+{
+    // Clamped first, the cast rounds down
+    const f32 Tile = (Ndc * 0.5f + 0.5f) * (f32)TileCount;
+
+    return (u8)Clamp(Tile, 0.0f, (f32)(TileCount - 1));
+}
+
+// Adds the screen tiles the light reaches in every slice it is in. In each slice the sphere is
+// cut down to the part between the slice's depths, its bounding box in view space is projected
+// to the screen: x / depth over the box is smallest and largest at its corners, the box is in
+// front of the camera so the depth is never 0. Cutting per slice
+// keeps large lights close to the camera from filling the whole depth range with screen-sized boxes
+internal void
+AddLightClusterSpans(LightClusters *Clusters, u32 Light)
+{
+    const PointLight *Point = &Clusters->Lights[Light];
+    const Vector3 Center = Vector3Transform(Point->Position, Clusters->View);
+    const f32 Depth = -Center.z; // The camera looks down -z
+    const f32 Radius = Point->Radius;
+
+    if (Depth + Radius < LIGHT_CLUSTER_CAMERA_NEAR || Depth - Radius > LIGHT_CLUSTER_FAR)
+    {
+        return;
+    }
+
+    const f32 DepthMin = Max(Depth - Radius, LIGHT_CLUSTER_CAMERA_NEAR);
+    const f32 DepthMax = Min(Depth + Radius, LIGHT_CLUSTER_FAR);
+    const u32 Z0 = GetLightClusterSlice(Clusters, DepthMin);
+    const u32 Z1 = GetLightClusterSlice(Clusters, DepthMax);
+
+    for (u32 z = Z0; z <= Z1; ++z)
+    {
+        const f32 Near = Max(Clusters->SliceDepth[z], DepthMin);
+        const f32 Far = Min(Clusters->SliceDepth[z + 1], DepthMax);
+
+        // Radius of the widest circle of the sphere in the slice
+        const f32 Across = Clamp(Depth, Near, Far) - Depth;
+        const f32 SliceRadius = sqrtf(Max(Radius * Radius - Across * Across, 0.0f));
+
+        const f32 NearScale = 1.0f / Near;
+        const f32 FarScale = 1.0f / Far;
+
+        const f32 X0 = (Center.x - SliceRadius) * Clusters->InvTanX;
+        const f32 X1 = (Center.x + SliceRadius) * Clusters->InvTanX;
+        const f32 Y0 = (Center.y - SliceRadius) * Clusters->InvTanY;
+        const f32 Y1 = (Center.y + SliceRadius) * Clusters->InvTanY;
+
+        const f32 MinX = Min(X0 * NearScale, X0 * FarScale);
+        const f32 MaxX = Max(X1 * NearScale, X1 * FarScale);
+        const f32 MinY = Min(Y0 * NearScale, Y0 * FarScale);
+        const f32 MaxY = Max(Y1 * NearScale, Y1 * FarScale);
+
+        if (MaxX < -1.0f || MinX > 1.0f || MaxY < -1.0f || MinY > 1.0f)
+        {
+            continue;
+        }
+
+        LightClusterSpan Span;
+        Span.Light = (u16)Light;
+        Span.Z = (u8)z;
+        Span.X0 = GetLightClusterTile(MinX, LIGHT_CLUSTERS_X);
+        Span.X1 = GetLightClusterTile(MaxX, LIGHT_CLUSTERS_X);
+        Span.Y0 = GetLightClusterTile(MinY, LIGHT_CLUSTERS_Y);
+        Span.Y1 = GetLightClusterTile(MaxY, LIGHT_CLUSTERS_Y);
+
+        AppendFrameArray(&Clusters->Spans, Span);
+    }
+}
+
+// Bins Clusters->Lights for the camera, the same projection as the game draws with.
+// Counts every cluster's lights, turns the counts into offsets and then writes the lists
+internal void
+BinLightClusters(LightClusters *Clusters, const Camera3D *Camera, f32 Aspect)
+{
+    ProfileZone("BinLightClusters");
+
+    Assert(Clusters->Lights.Count <= LIGHT_CLUSTER_MAX_LIGHTS);
+
+    Clusters->View = MatrixLookAt(Camera->position, Camera->target, Camera->up);
+    Clusters->Position = Camera->position;
+    Clusters->Forward = Vector3Normalize(Vector3Subtract(Camera->target, Camera->position));
+    Clusters->TanY = tanf(Camera->fovy * 0.5f * DEG2RAD);
+    Clusters->TanX = Clusters->TanY * Aspect;
+    Clusters->InvTanX = 1.0f / Clusters->TanX;
+    Clusters->InvTanY = 1.0f / Clusters->TanY;
+    Clusters->SliceScale = (f32)LIGHT_CLUSTERS_Z / logf(LIGHT_CLUSTER_FAR / LIGHT_CLUSTER_NEAR);
+
+    Clusters->SliceDepth[0] = LIGHT_CLUSTER_CAMERA_NEAR;
+    for (u32 z = 1; z < LIGHT_CLUSTERS_Z; ++z)
+    {
+        Clusters->SliceDepth[z] = LIGHT_CLUSTER_NEAR * expf((f32)z / Clusters->SliceScale);
+    }
+    Clusters->SliceDepth[LIGHT_CLUSTERS_Z] = LIGHT_CLUSTER_FAR;
+
+    memset(Clusters->Count, 0, sizeof(Clusters->Count));
+    memset(Clusters->Filled, 0, sizeof(Clusters->Filled));
+
+    Clusters->Spans = MakeFrameArray<LightClusterSpan>(Clusters->Arena, Clusters->Spans.Count);
+
+    for (u32 l = 0; l < (u32)Clusters->Lights.Count; ++l)
+    {
+        AddLightClusterSpans(Clusters, l);
+    }
+
+    for (usize s = 0; s < Clusters->Spans.Count; ++s)
+    {
+        const LightClusterSpan &Span = Clusters->Spans[s];
+
+        for (u32 y = Span.Y0; y <= Span.Y1; ++y)
+        {
+            u32 *Count = &Clusters->Count[GetLightClusterIndex(0, y, Span.Z)];
+
+            for (u32 x = Span.X0; x <= Span.X1; ++x)
+            {
+                Count[x]++;
+            }
+        }
+    }
+
+    // Lists that do not fit anymore are cut short
+    u32 Total = 0;
+    Clusters->Dropped = 0;
+
+    for (u32 c = 0; c < LIGHT_CLUSTER_COUNT; ++c)
+    {
+        const u32 Count = Min(Clusters->Count[c], LIGHT_CLUSTER_MAX_INDICES - Total);
+
+        Clusters->Dropped += Clusters->Count[c] - Count;
+        Clusters->Offset[c] = Total;
+        Clusters->Count[c] = Count;
+        Total += Count;
+    }
+
+    Clusters->Indices = MakeFrameArray<u16>(Clusters->Arena, Total);
+    Clusters->Indices.Count = Total;
+
+    for (usize s = 0; s < Clusters->Spans.Count; ++s)
+    {
+        const LightClusterSpan &Span = Clusters->Spans[s];
+
+        for (u32 y = Span.Y0; y <= Span.Y1; ++y)
+        {
+            for (u32 x = Span.X0; x <= Span.X1; ++x)
+            {
+                const u32 c = GetLightClusterIndex(x, y, Span.Z);
+
+                if (Clusters->Filled[c] < Clusters->Count[c])
+                {
+                    Clusters->Indices[Clusters->Offset[c] + Clusters->Filled[c]++] = Span.Light;
+                }
+            }
+        }
+    }
+}
+
+// Start of a frame, empties the lights. Everything the clusters make this frame goes into Arena
+internal void
+BeginLightClusters(LightClusters *Clusters, FrameArena *Arena)
+{
+    Clusters->Arena = Arena;
+    Clusters->Lights = MakeFrameArray<PointLight>(Arena, LIGHT_CLUSTER_MAX_LIGHTS);
+}
+
+// Lights out of view are skipped, they would not land in any cluster. False once the list is full
+internal bool
+AddPointLight(LightClusters *Clusters, const Frustum *frustum, Vector3 Position, f32 Radius, Color LightColor)
+{
+    if (Clusters->Lights.Count >= LIGHT_CLUSTER_MAX_LIGHTS)
+    {
+        return false;
+    }
+
+    const BoundingBox Bounds = {
+        Vector3Subtract(Position, (Vector3){Radius, Radius, Radius}),
+        Vector3Add(Position, (Vector3){Radius, Radius, Radius}),
+    };
+
+    if (IsBoxInFrustum(frustum, &Bounds))
+    {
+        AppendFrameArray(&Clusters->Lights, {Position, Radius, LightColor});
+    }
+
+    return true;
+}
+
+internal Texture2D
+LoadLightClusterTexture(i32 Width, i32 Height, PixelFormat Format, i32 TexelSize)
+{
+    Image Empty = {0};
+    Empty.width = Width;
+    Empty.height = Height;
+    Empty.mipmaps = 1;
+    Empty.format = Format;
+    Empty.data = calloc((usize)Width * Height, TexelSize);
+
+    const Texture2D Result = LoadTextureFromImage(Empty);
+    free(Empty.data);
+
+    return Result;
+}
+
+// Needs the OpenGL context
+internal void
+InitLightClusters(LightClusters *Clusters)
+{
+    Clusters->LightTexture = LoadLightClusterTexture(LIGHT_CLUSTER_MAX_LIGHTS * 2, 1, PIXELFORMAT_UNCOMPRESSED_R32G32B32A32, 4 * sizeof(f32));
+    Clusters->GridTexture = LoadLightClusterTexture(LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y, LIGHT_CLUSTERS_Z, PIXELFORMAT_UNCOMPRESSED_R32G32B32A32, 4 * sizeof(f32));
+    Clusters->IndexTexture = LoadLightClusterTexture(LIGHT_CLUSTER_INDEX_WIDTH, LIGHT_CLUSTER_MAX_INDICES / LIGHT_CLUSTER_INDEX_WIDTH, PIXELFORMAT_UNCOMPRESSED_R32, sizeof(f32));
+
+    Clusters->ShaderCount = 0;
+}
+
+internal void
+FreeLightClusters(LightClusters *Clusters)
+{
+    // The benchmarks only bin, without an OpenGL context
+    if (Clusters->LightTexture.id > 0)
+    {
+        UnloadTexture(Clusters->LightTexture);
+        UnloadTexture(Clusters->GridTexture);
+        UnloadTexture(Clusters->IndexTexture);
+    }
+
+    Clusters->Arena = NULL;
+    Clusters->Lights = {0};
+    Clusters->Indices = {0};
+    Clusters->Spans = {0};
+    Clusters->ShaderCount = 0;
+}
+
+// The shader reads the clusters from the texture slots LIGHT_CLUSTER_TEXTURE_SLOT and up
+internal void
+AddLightClusterShader(LightClusters *Clusters, Shader Target)
+{
+    Assert(Clusters->ShaderCount < LIGHT_CLUSTER_MAX_SHADERS);
+
+    LightClusterShader *Entry = &Clusters->Shaders[Clusters->ShaderCount++];
+    Entry->Target = Target;
+    Entry->ViewPosLoc = GetShaderLocation(Target, "viewPos");
+    Entry->ViewForwardLoc = GetShaderLocation(Target, "viewForward");
+    Entry->ClusterScaleLoc = GetShaderLocation(Target, "clusterScale");
+    Entry->ClusterDepthLoc = GetShaderLocation(Target, "clusterDepth");
+
+    const char *Samplers[3] = {"lightData", "clusterGrid", "clusterLights"};
+    for (i32 s = 0; s < 3; ++s)
+    {
+        const i32 Slot = LIGHT_CLUSTER_TEXTURE_SLOT + s;
+        SetShaderValue(Target, GetShaderLocation(Target, Samplers[s]), &Slot, SHADER_UNIFORM_INT);
+    }
+}
+
+// Uploads what BinLightClusters made and binds the textures for the rest of the frame
+internal void
+UploadLightClusters(LightClusters *Clusters, i32 RenderWidth, i32 RenderHeight)
+{
+    ProfileZone("UploadLightClusters");
+
+    const usize LightCount = Clusters->Lights.Count;
+    const usize IndexCount = Clusters->Indices.Count;
+    const usize Rows = (IndexCount + LIGHT_CLUSTER_INDEX_WIDTH - 1) / LIGHT_CLUSTER_INDEX_WIDTH;
+
+    // Staging for the textures one after the other, the index rows are uploaded whole
+    f32 *Texels = PushFrameArray<f32>(Clusters->Arena, Max(Max(LightCount * 8, (usize)LIGHT_CLUSTER_COUNT * 4), Rows * LIGHT_CLUSTER_INDEX_WIDTH));
+
+    if (LightCount > 0)
+    {
+        for (usize l = 0; l < LightCount; ++l)
+        {
+            const PointLight *Light = &Clusters->Lights[l];
+            f32 *Texel = &Texels[l * 8];
+
+            Texel[0] = Light->Position.x;
+            Texel[1] = Light->Position.y;
+            Texel[2] = Light->Position.z;
+            Texel[3] = Light->Radius;
+            Texel[4] = Light->LightColor.r / 255.0f;
+            Texel[5] = Light->LightColor.g / 255.0f;
+            Texel[6] = Light->LightColor.b / 255.0f;
+            Texel[7] = 0.0f;
+        }
+
+        UpdateTextureRec(Clusters->LightTexture, (Rectangle){0, 0, (f32)LightCount * 2, 1}, Texels);
+    }
+
+    for (u32 c = 0; c < LIGHT_CLUSTER_COUNT; ++c)
+    {
+        Texels[c * 4 + 0] = (f32)Clusters->Offset[c];
+        Texels[c * 4 + 1] = (f32)Clusters->Count[c];
+        Texels[c * 4 + 2] = 0.0f;
+        Texels[c * 4 + 3] = 0.0f;
+    }
+
+    UpdateTexture(Clusters->GridTexture, Texels);
+
+    // Only the rows the lists reach
+    if (IndexCount > 0)
+    {
+        for (usize i = 0; i < IndexCount; ++i)
+        {
+            Texels[i] = (f32)Clusters->Indices[i];
+        }
+
+        UpdateTextureRec(Clusters->IndexTexture, (Rectangle){0, 0, (f32)LIGHT_CLUSTER_INDEX_WIDTH, (f32)Rows}, Texels);
+    }
+
+    const f32 ClusterScale[2] = {(f32)LIGHT_CLUSTERS_X / (f32)RenderWidth, (f32)LIGHT_CLUSTERS_Y / (f32)RenderHeight};
+    const f32 ClusterDepth[2] = {LIGHT_CLUSTER_NEAR, Clusters->SliceScale};
+
+    for (u32 s = 0; s < Clusters->ShaderCount; ++s)
+    {
+        const LightClusterShader *Entry = &Clusters->Shaders[s];
+
+        SetShaderValue(Entry->Target, Entry->ViewPosLoc, &Clusters->Position, SHADER_UNIFORM_VEC3);
+        SetShaderValue(Entry->Target, Entry->ViewForwardLoc, &Clusters->Forward, SHADER_UNIFORM_VEC3);
+        SetShaderValue(Entry->Target, Entry->ClusterScaleLoc, ClusterScale, SHADER_UNIFORM_VEC2);
+        SetShaderValue(Entry->Target, Entry->ClusterDepthLoc, ClusterDepth, SHADER_UNIFORM_VEC2);
+    }
+
+    // Nothing else binds these slots, they stay bound for every draw of the frame
+    const u32 TextureIds[3] = {Clusters->LightTexture.id, Clusters->GridTexture.id, Clusters->IndexTexture.id};
+    for (i32 s = 0; s < 3; ++s)
+    {
+        rlActiveTextureSlot(LIGHT_CLUSTER_TEXTURE_SLOT + s);
+        rlEnableTexture(TextureIds[s]);
+    }
+    rlActiveTextureSlot(0);
+}
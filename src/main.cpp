@@ -5,59 +5,85 @@
 #include "includes.h"
 #include "raylib_includes.h"
 
+#include "frustum.cpp"
+#include "job_system.cpp"
+
 // Variables -------------------------------------------------
 i32 SCREEN_WIDTH = 640 * 2;
 i32 SCREEN_HEIGHT = 360 * 2;
 
 bool Debug = false;
-const i64 MAP_SIZE = 256;
+
+const char *MapPath = NULL;      // Map file to stream the ground from, procedural map when NULL
+const char *WriteMapPath = NULL; // Write a procedural map file of WriteMapSize tiles and exit
+u32 WriteMapSize = 8192;
+bool CookModels = false; // Cook the model cache from the GLB files and exit
+const char *TracePath = "profile_trace.json"; // F9 writes the last TraceFrames frames here
+u32 TraceFrames = 120;
+bool TraceOnExit = false; // Set by RAYLIB_ORTHOGRAPHIC_TRACE
+bool ShowProfiler = false; // F3
+const i64 MAP_SIZE = 256; // Tiles per side in memory, the whole map or the window streamed from a map file
 const i64 SQUARE_SIZE = 32;
 
-u64 CPUMemory = 0L;
+std::atomic<u64> CPUMemory(0); // Written by the main thread, the job system workers and the simulation thread
+
+#include "profiler.cpp"
+#include "frame_arena.cpp"
+#include "mapped_file.cpp"
+#include "model_glb.cpp"
+#include "model_cache.cpp"
+#include "asset_loader.cpp"
+
+AssetLoader Assets;
+u64 AssetsVersion = 0; // Loader version the assets in use were taken at
+AssetHandle MainFontAsset = ASSET_NONE;
 
 Font MainFont = {0};
 
-// Ground ----------------------------------------------------
-Texture2D GrassTexture = {0};
-Texture2D GrassTexture02 = {0};
-Texture2D GrassTexture03 = {0};
-Texture2D GrassTexture04 = {0};
+FrameArena FrameScratch; // Reset at the start of every frame, for what is only drawn once
+
+// Debug HUD -------------------------------------------------
+#include "debug_hud.cpp"
+
+enum HudLabelId
+{
+    HUD_FPS,
+    HUD_RIGHT_MOUSE,
+    HUD_FOVY,
+    HUD_FIRST_TILE,
+    HUD_IN_VIEW,
+    HUD_MAIN_CAMERA,
+    HUD_DEBUG_CAMERA,
+    HUD_SELECTED_TILE,
+    HUD_SELECTED_POSITION,
+    HUD_HIT_OBJECT,
+    HUD_HIT_DISTANCE,
+    HUD_TRACK_PIECES,
+    HUD_TRAINS,
+    HUD_POINT_LIGHTS,
+    HUD_SIMULATION,
+    HUD_LABEL_COUNT,
+};
+
+DebugHud Hud = {};
 
+// Ground ----------------------------------------------------
 Mesh GroundMesh = {0};
 
-Material *GroundMaterials = NULL;
 Shader CustomShader = {0};
+Shader ChunkShader = {0}; // Not instanced, for the baked terrain chunks
+Shader ModelShader = {0}; // Instanced with a transform per instance, for the placed models
 
 Camera3D MainCamera = {};
-const f64 CameraAngle = 0.0;
-const f64 CameraAndgleCos = cos(CameraAngle * DEG2RAD);
-const f64 CameraAndgleSin = sin(CameraAngle * DEG2RAD);
 const Vector3 CameraStartPosition = (Vector3){90.0 * 2.0, 180.0 * 2, 90.0 * 2.0};
 
 Camera3D DebugCamera = {};
 const Vector3 DebugCameraStartPosition = (Vector3){90.0f * 2.0, 180.0f * 2.0, 90.0f * 2.0};
 
 // Types -----------------------------------------------------
-struct GroundTile
-{
-    usize Id;
-
-    // 3D position
-    Matrix MatrixTransform;
+#include "ground_tiles.cpp"
 
-    usize MaterialIndex;
-    Material Mat;
-
-    // Used for frustum culling
-    BoundingBox BoundingVolume;
-
-    f32 width;
-    f32 depth;
-    f32 height; // Height of the tile (if applicable)
-};
-
-GroundTile *GroundTiles = NULL;
-std::vector<GroundTile> GroundTilesInView;
+GroundTileStore GroundTiles = {0};
 
 // Display information about closest hit
 RayCollision collision = {
@@ -68,79 +94,82 @@ RayCollision collision = {
 };
 
 const char *hitObjectName = "None";
-Ray ray = {0}; // Picking ray
-GroundTile *SelectedGroundTile = NULL;
+Ray ray = {0};               // Picking ray
+i64 SelectedGroundTile = -1; // Id of the hovered tile, -1 when no tile is hovered
 
-struct Plane
-{
-    Vector3 normal; // Normal of the plane
-    f32 distance;   // Distance from the origin to the plane
-};
+#include "picking.cpp"
+#include "frustum_simd.cpp"
+#include "ground_quadtree.cpp"
+#include "ground_footprint.cpp"
 
-struct Frustum
-{
-    Plane planes[6]; // Define the 6 planes of the frustum
-};
+GroundQuadtree GroundTree = {0};
 
 // Instanced rendering specific data ------------------------
-Material Mat01;
-Material Mat02;
-Material Mat03;
-Material Mat04;
-
-// Lists to store the transforms of tiles in view for each material
-std::vector<Matrix> TransformsInView01;
-std::vector<Matrix> TransformsInView02;
-std::vector<Matrix> TransformsInView03;
-std::vector<Matrix> TransformsInView04;
-
-u64 InViewCount = 0;
-// ----------------------------------------------------------
+#include "ground_terrain.cpp"
+#include "ground_lod.cpp"
+#include "ground_batches.cpp"
 
-// Railroads and trains -------------------------------------
-Model RailRoadStraightModel;
+#include "material_palette.cpp"
 
-struct TrainTrack
-{
-    Model m_Model;
-    Vector3 Position;
-    Vector3 Rotation;
-};
+MaterialPalette GroundPalette = {0};
+u8 TerrainMaterial = 0; // Palette index of the grass atlas material
+u8 ChunkMaterial = 0;   // Same atlas with the non-instanced shader
 
-std::vector<TrainTrack> TrainTracks;
-// Functions -------------------------------------------------
+TerrainAtlas GrassAtlas = {0};
+AssetHandle GrassAtlasAsset = ASSET_NONE;
+GroundTerrain Terrain = {};
+GroundLod TerrainLod = {};
 
-internal std::vector<GroundTile>
-GetGroundTilesByMaterialIndex(GroundTile *groundTiles, usize count, usize targetIndex)
-{
-    std::vector<GroundTile> result;
+// Lists to store the transforms of tiles in view for each material, kept across frames
+GroundBatches GroundInView = {};
 
-    for (usize i = 0; i < count; ++i)
-    {
-        if (groundTiles[i].MaterialIndex == targetIndex)
-        {
-            result.push_back(groundTiles[i]);
-        }
-    }
+#include "ground_map_file.cpp"
+#include "ground_streaming.cpp"
 
-    return result;
-}
+GroundStream GroundMapStream = {};
+// ----------------------------------------------------------
 
-internal std::vector<Matrix>
-GetMatricesByMaterialIndex(GroundTile *groundTiles, usize count, usize targetIndex)
-{
-    std::vector<Matrix> result;
+// Railroads and trains -------------------------------------
+#include "track_network.cpp"
+#include "track_batches.cpp"
+#include "track_routes.cpp"
+#include "track_blocks.cpp"
+#include "train_sim.cpp"
+#include "sim_thread.cpp"
+#include "train_batches.cpp"
+
+Model TrackModels[TRACK_MODEL_COUNT] = {};
+AssetHandle TrackModelAssets[TRACK_MODEL_COUNT] = {};
+TrackNetwork Tracks = {};
+TrackBatches TracksInView = {};
+TrackRouter Routes = {};
+u8 PlaceRotation = 0;                               // Quarter turns of the next piece, R turns it
+TrackModelHandle PlaceModel = TRACK_MODEL_STRAIGHT; // Next piece, T cycles through the models
+i64 RouteFromI = -1;                                // P marks the start of a debug route, P again finds it
+i64 RouteFromJ = -1;
+std::vector<u32> DebugRoute;
+
+Model TrainModels[TRAIN_MODEL_COUNT] = {};
+AssetHandle TrainModelAssets[TRAIN_MODEL_COUNT] = {};
+TrainSim Trains = {};
+TrackBlocks TrainBlocks = {};
+SimThread Simulation; // Ticks Trains and TrainBlocks, edits of them and of Tracks are queued to it
+TrainBatches TrainsInView = {};
+const u32 SPAWN_TRAIN_CARRIAGES = 4; // G spawns a train of this many carriages, the locomotive included
+const f32 SPAWN_TRAIN_SPEED = 3.0f;  // Tiles per second
+// ----------------------------------------------------------
 
-    for (usize i = 0; i < count; ++i)
-    {
-        if (groundTiles[i].MaterialIndex == targetIndex)
-        {
-            result.push_back(groundTiles[i].MatrixTransform);
-        }
-    }
+// Point lights ---------------------------------------------
+#include "light_clusters.cpp"
 
-    return result;
-}
+LightClusters PointLights = {};
+const u32 TRACK_LAMP_SPACING = 4; // A lamp on every track piece with (I + J) % spacing == 0
+const f32 TRACK_LAMP_Y = 24.0f; // Above the ground elevation of the piece
+const f32 TRACK_LAMP_RADIUS = 80.0f;
+const Color TRACK_LAMP_COLOR = (Color){255, 190, 110, 255};
+const f32 HEADLIGHT_RADIUS = 96.0f;
+const Color HEADLIGHT_COLOR = (Color){255, 250, 220, 255};
+// Functions -------------------------------------------------
 
 internal void
 ParseInputArgs(i32 argc, char **argv)
@@ -159,6 +188,38 @@ ParseInputArgs(i32 argc, char **argv)
             printf("\tRunning in DEBUG mode !!!\n");
             Debug = true;
         }
+        else if (strcmp(argv[i], "RAYLIB_ORTHOGRAPHIC_MAP") == 0 && i + 1 < argc)
+        {
+            MapPath = argv[++i];
+            printf("\tStreaming the ground from %s\n", MapPath);
+        }
+        else if (strcmp(argv[i], "RAYLIB_ORTHOGRAPHIC_WRITE_MAP") == 0 && i + 1 < argc)
+        {
+            WriteMapPath = argv[++i];
+
+            // Optional map size, the default is the largest map the terrain records can address
+            if (i + 1 < argc && argv[i + 1][0] >= '0' && argv[i + 1][0] <= '9')
+            {
+                WriteMapSize = (u32)atoi(argv[++i]);
+            }
+        }
+        else if (strcmp(argv[i], "RAYLIB_ORTHOGRAPHIC_COOK_MODELS") == 0)
+        {
+            CookModels = true;
+        }
+        else if (strcmp(argv[i], "RAYLIB_ORTHOGRAPHIC_TRACE") == 0 && i + 1 < argc)
+        {
+            TracePath = argv[++i];
+            TraceOnExit = true;
+
+            // Optional frame count
+            if (i + 1 < argc && argv[i + 1][0] >= '0' && argv[i + 1][0] <= '9')
+            {
+                TraceFrames = (u32)atoi(argv[++i]);
+            }
+
+            printf("\tWriting the last %u frames to %s on exit\n", TraceFrames, TracePath);
+        }
     }
 }
 
@@ -194,28 +255,11 @@ HandleWindowResize(void)
     }
 }
 
-internal Vector2
-GetTileCoordsUnderMouse(RayCollision groundHitInfo, Camera3D camera)
-{
-    Vector2 tileCoords = {-1, -1}; // Initialize to out-of-bounds
-
-    // World space collision point on the ground
-    Vector3 hitPosition = collision.point;
-
-    // Convert to local grid coordinates by adjusting for map offset and tile size
-    f64 localX = hitPosition.x * CameraAndgleCos - hitPosition.z * CameraAndgleSin + (MAP_SIZE * SQUARE_SIZE) / 2.0f;
-    f64 localZ = hitPosition.x * CameraAndgleSin + hitPosition.z * CameraAndgleCos + (MAP_SIZE * SQUARE_SIZE) / 2.0f;
-
-    // Calculate tile indices (floor to get correct tile)
-    tileCoords.x = floor(localX / SQUARE_SIZE);
-    tileCoords.y = floor(localZ / SQUARE_SIZE);
-
-    return tileCoords;
-}
-
 internal void
 GameUpdate(f64 DeltaTime)
 {
+    ProfileZone("GameUpdate");
+
     HandleWindowResize();
 
     if (IsKeyPressed(KEY_ESCAPE))
@@ -228,56 +272,51 @@ GameUpdate(f64 DeltaTime)
         ToggleFullscreen();
     }
 
+    if (IsKeyPressed(KEY_F3))
+    {
+        ShowProfiler = !ShowProfiler;
+    }
+
+    if (IsKeyPressed(KEY_F9))
+    {
+        WriteProfilerTrace(TracePath, TraceFrames);
+    }
+
+    // Simulation speed, the frame rate stays the same
+    if (IsKeyPressed(KEY_F5))
+    {
+        CycleSimSpeed(&Simulation);
+    }
+
+    // Frustum footprint or per-tile tests for the tiles at the edge of the view
+    if (IsKeyPressed(KEY_F4))
+    {
+        GroundInView.UseFootprint = !GroundInView.UseFootprint;
+        GroundInView.Valid = false;
+    }
+
     // Set the hovered tile
     {
+        ProfileZone("Picking");
+
         // Reset the collision info
         hitObjectName = "None";
         ray = GetMouseRay(GetMousePosition(), MainCamera);
 
-        // Initialize collision distance to a large value so the closest hit is recorded
-        collision.distance = FLT_MAX;
-        SelectedGroundTile = NULL;
+        // Walk the height pyramid under the mouse ray, only the tiles next to the hit are tested
+        const TilePick Pick = PickTile(&GroundTiles, ray);
 
-        // Check for ray collision with the ground plane in all TransformsInView lists
-        // for (usize i = 0; i < InViewCount; ++i)
-        for (usize i = 0; i < (MAP_SIZE * MAP_SIZE); ++i)
-        {
-            // Transform the bounding box of the current tile
-            BoundingBox transformedBox;
-            transformedBox.min = Vector3Transform(GroundTiles[i].BoundingVolume.min, GroundTiles[i].MatrixTransform);
-            transformedBox.max = Vector3Transform(GroundTiles[i].BoundingVolume.max, GroundTiles[i].MatrixTransform);
-
-            // Perform the ray collision check with the transformed bounding box
-            RayCollision tileHitInfo = GetRayCollisionBox(ray, transformedBox);
-            if (tileHitInfo.hit && tileHitInfo.distance < collision.distance)
-            {
-                // Update collision information and selected tile
-                collision = tileHitInfo;
-                hitObjectName = "Ground";
-                SelectedGroundTile = &GroundTiles[i];
-            }
-        }
+        collision = Pick.Collision;
+        SelectedGroundTile = Pick.Id;
 
-        if (Debug)
+        if (SelectedGroundTile != -1)
         {
-            printf("Hit Tile ID: %ld, Distance: %f\n", (SelectedGroundTile != NULL) ? SelectedGroundTile->Id : -1, collision.distance);
+            hitObjectName = "Ground";
         }
 
-        // Check if a tile was hit
-        if (SelectedGroundTile != NULL)
+        if (Debug)
         {
-            Vector2 tileCoords = GetTileCoordsUnderMouse(collision, MainCamera);
-            i64 Id = static_cast<i64>(tileCoords.x) * MAP_SIZE + static_cast<i64>(tileCoords.y);
-
-            if (tileCoords.x >= 0 && tileCoords.y >= 0 &&
-                tileCoords.x < MAP_SIZE && tileCoords.y < MAP_SIZE)
-            {
-                SelectedGroundTile = &GroundTiles[Id];
-            }
-            else
-            {
-                SelectedGroundTile = NULL;
-            }
+            printf("Hit Tile ID: %ld, Distance: %f\n", SelectedGroundTile, collision.distance);
         }
     }
 
@@ -397,119 +436,139 @@ GameUpdate(f64 DeltaTime)
         }
     }
 
-    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON))
+    if (IsKeyPressed(KEY_R))
+    {
+        PlaceRotation = (PlaceRotation + 1) & 3;
+    }
+
+    if (IsKeyPressed(KEY_T))
+    {
+        PlaceModel = (TrackModelHandle)((PlaceModel + 1) % TRACK_MODEL_COUNT);
+    }
+
+    // Left click places a track piece on the hovered tile, middle click removes it
+    if (SelectedGroundTile != -1 && collision.hit)
     {
-        if (SelectedGroundTile != NULL)
+        const i64 WorldI = GroundTiles.OriginI + SelectedGroundTile / GroundTiles.MapSize;
+        const i64 WorldJ = GroundTiles.OriginJ + SelectedGroundTile % GroundTiles.MapSize;
+
+        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON))
+        {
+            const TrackPlaceResult Result = PlaceTrackPiece(&Tracks, WorldI, WorldJ, PlaceModel, PlaceRotation);
+
+            if (Result != TRACK_PLACE_DUPLICATE)
+            {
+                // The simulation thread ticks on a copy of the tracks, it gets the piece on its next tick
+                QueuePlaceTrack(&Simulation, WorldI, WorldJ, PlaceModel, PlaceRotation);
+                InvalidateTrackRouteTile(&Routes, (u32)WorldI, (u32)WorldJ);
+                printf("Track %s at tile: %ld, %ld\n", (Result == TRACK_PLACE_ADDED) ? "added" : "replaced", WorldI, WorldJ);
+            }
+        }
+        else if (IsMouseButtonPressed(MOUSE_MIDDLE_BUTTON))
         {
-            if (collision.hit)
+            if (RemoveTrackPiece(&Tracks, WorldI, WorldJ))
+            {
+                QueueRemoveTrack(&Simulation, WorldI, WorldJ);
+                InvalidateTrackRouteTile(&Routes, (u32)WorldI, (u32)WorldJ);
+                printf("Track removed at tile: %ld, %ld\n", WorldI, WorldJ);
+            }
+        }
+
+        if (IsKeyPressed(KEY_P))
+        {
+            if (RouteFromI == -1)
+            {
+                RouteFromI = WorldI;
+                RouteFromJ = WorldJ;
+                DebugRoute.clear();
+                printf("Route from tile: %ld, %ld\n", WorldI, WorldJ);
+            }
+            else
             {
-                // Place a new into TrainTracks
-                TrainTrack newTrack = {
-                    .m_Model = RailRoadStraightModel,
-                    .Position = (Vector3){SelectedGroundTile->MatrixTransform.m12, 1.0f, SelectedGroundTile->MatrixTransform.m14},
-                    .Rotation = {0.0f, 0.0f, 0.0f}};
+                ProfileZone("FindTrackRoute");
 
-                TrainTracks.push_back(newTrack);
+                const std::vector<u32> *Route = FindTrackRoute(&Routes, &Tracks, (u32)RouteFromI, (u32)RouteFromJ, (u32)WorldI, (u32)WorldJ);
 
-                printf("TrainTrack added at: %f, %f, %f\n", collision.point.x, 1.0f, collision.point.z);
+                if (Route != NULL)
+                {
+                    DebugRoute = *Route;
+                    printf("Route to tile: %ld, %ld, %zu tiles\n", WorldI, WorldJ, Route->size());
+                }
+                else
+                {
+                    DebugRoute.clear();
+                    printf("No route to tile: %ld, %ld\n", WorldI, WorldJ);
+                }
+
+                RouteFromI = -1;
+                RouteFromJ = -1;
             }
         }
-    }
-}
-
-internal void
-CalculateBoundingBox(GroundTile *tile)
-{
-    const f32 halfWidth = tile->width / 2.0f;
-    const f32 halfDepth = tile->depth / 2.0f;
-    const f32 halfHeight = tile->height / 2.0f; // If you want to center the height
-
-    // Define the corners of the box in local space
-    Vector3 localCorners[8] = {
-        {-halfWidth, -halfHeight, -halfDepth}, // Bottom-left
-        {halfWidth, -halfHeight, -halfDepth},  // Bottom-right
-        {-halfWidth, -halfHeight, halfDepth},  // Top-left
-        {halfWidth, -halfHeight, halfDepth},   // Top-right
-        {-halfWidth, halfHeight, -halfDepth},  // Upper-left
-        {halfWidth, halfHeight, -halfDepth},   // Upper-right
-        {-halfWidth, halfHeight, halfDepth},   // Lower-left
-        {halfWidth, halfHeight, halfDepth}     // Upper-right
-    };
 
-    // Apply the matrix transform to each corner
-    Vector3 transformedCorners[8];
-    for (i32 i = 0; i < 8; ++i)
-    {
-        transformedCorners[i] = Vector3Transform(localCorners[i], tile->MatrixTransform);
+        if (IsKeyPressed(KEY_G))
+        {
+            // Spawned on the simulation thread's next tick, when the blocks under it are free
+            if (FindTrackPiece(&Tracks, WorldI, WorldJ) != TRACK_NO_PIECE)
+            {
+                QueueSpawnTrain(&Simulation, (u32)WorldI, (u32)WorldJ, SPAWN_TRAIN_CARRIAGES, SPAWN_TRAIN_SPEED);
+                printf("Train queued at tile: %ld, %ld\n", WorldI, WorldJ);
+            }
+        }
     }
 
-    // Initialize the bounding box
-    tile->BoundingVolume.min = transformedCorners[0];
-    tile->BoundingVolume.max = transformedCorners[0];
+    // Page the ground around the camera in and out, the old tile Ids mean nothing after a move
+    ProfileZone("UpdateGroundStream");
 
-    // Update min/max based on transformed corners
-    for (i32 i = 1; i < 8; ++i)
+    if (UpdateGroundStream(&GroundMapStream, &GroundTiles, &GroundTree, &GroundInView, &TerrainLod, MainCamera.target))
     {
-        tile->BoundingVolume.min = Vector3Min(tile->BoundingVolume.min, transformedCorners[i]);
-        tile->BoundingVolume.max = Vector3Max(tile->BoundingVolume.max, transformedCorners[i]);
+        UploadTerrainElevation(&Terrain, &GroundTiles, CustomShader);
+        SelectedGroundTile = -1;
+        collision.hit = false;
     }
 }
 
-internal int
-IsBoxInFrustum(const Frustum *frustum, const BoundingBox *box)
+// Lamps along the tracks and the headlights of the trains, only the ones that reach into the view
+internal void
+GatherPointLights(const Frustum *frustum, const TrainSnapshot *TrainState, f32 TrainBlend)
 {
-    for (i32 i = 0; i < 6; ++i)
+    BeginLightClusters(&PointLights, &FrameScratch);
+
+    for (const u32 Front : TrainState->Front)
     {
-        Vector3 normal = frustum->planes[i].normal;
-        f32 distance = frustum->planes[i].distance;
+        Vector3 Position = GetTrainSnapshotPosition(TrainState, Front, TrainBlend);
+        Position.y += TRAIN_Y;
 
-        // Find the most positive vertex (the farthest point along the normal)
-        Vector3 positiveVertex = (Vector3){
-            (normal.x > 0.0f) ? box->max.x : box->min.x,
-            (normal.y > 0.0f) ? box->max.y : box->min.y,
-            (normal.z > 0.0f) ? box->max.z : box->min.z};
+        if (!AddPointLight(&PointLights, frustum, Position, HEADLIGHT_RADIUS, HEADLIGHT_COLOR))
+        {
+            return;
+        }
+    }
 
-        // Find the most negative vertex (the nearest point along the normal)
-        Vector3 negativeVertex = (Vector3){
-            (normal.x < 0.0f) ? box->max.x : box->min.x,
-            (normal.y < 0.0f) ? box->max.y : box->min.y,
-            (normal.z < 0.0f) ? box->max.z : box->min.z};
+    for (const TrackPiece &Piece : Tracks.Pieces)
+    {
+        const u32 I = Piece.Tile / Tracks.WorldSize;
+        const u32 J = Piece.Tile % Tracks.WorldSize;
 
-        // If the positive vertex is behind the plane, the box is outside
-        if ((normal.x * positiveVertex.x + normal.y * positiveVertex.y + normal.z * positiveVertex.z + distance) < 0.0f)
+        if ((I + J) % TRACK_LAMP_SPACING != 0)
         {
-            return 0; // Box is outside the frustum
+            continue;
         }
-    }
 
-    return 1; // Box is inside or intersects the frustum
-}
+        Vector3 Position = GetTrackPieceCenter(&Tracks, GroundTiles.TileSize, Piece.Tile);
+        Position.y += TRACK_LAMP_Y - TRACK_PIECE_Y;
 
-internal Frustum
-CalculateFrustum(Camera3D camera)
-{
-    Frustum frustum;
-    Matrix viewMatrix = MatrixLookAt(camera.position, camera.target, camera.up);
-    f32 aspect = (f32)GetScreenWidth() / (f32)GetScreenHeight();
-    f32 top = tanf(camera.fovy * 0.5f * DEG2RAD);
-    f32 right = top * aspect;
-    Matrix projectionMatrix = MatrixPerspective(camera.fovy * DEG2RAD, aspect, 0.01f, 4000.0f);
-    Matrix viewProjMatrix = MatrixMultiply(viewMatrix, projectionMatrix);
-
-    // Extract frustum planes (left, right, bottom, top, near, far)
-    frustum.planes[0] = (Plane){.normal = {viewProjMatrix.m3 + viewProjMatrix.m0, viewProjMatrix.m7 + viewProjMatrix.m4, viewProjMatrix.m11 + viewProjMatrix.m8}, .distance = viewProjMatrix.m15 + viewProjMatrix.m12};  // Left
-    frustum.planes[1] = (Plane){.normal = {viewProjMatrix.m3 - viewProjMatrix.m0, viewProjMatrix.m7 - viewProjMatrix.m4, viewProjMatrix.m11 - viewProjMatrix.m8}, .distance = viewProjMatrix.m15 - viewProjMatrix.m12};  // Right
-    frustum.planes[2] = (Plane){.normal = {viewProjMatrix.m3 + viewProjMatrix.m1, viewProjMatrix.m7 + viewProjMatrix.m5, viewProjMatrix.m11 + viewProjMatrix.m9}, .distance = viewProjMatrix.m15 + viewProjMatrix.m13};  // Bottom
-    frustum.planes[3] = (Plane){.normal = {viewProjMatrix.m3 - viewProjMatrix.m1, viewProjMatrix.m7 - viewProjMatrix.m5, viewProjMatrix.m11 - viewProjMatrix.m9}, .distance = viewProjMatrix.m15 - viewProjMatrix.m13};  // Top
-    frustum.planes[4] = (Plane){.normal = {viewProjMatrix.m3 + viewProjMatrix.m2, viewProjMatrix.m7 + viewProjMatrix.m6, viewProjMatrix.m11 + viewProjMatrix.m10}, .distance = viewProjMatrix.m15 + viewProjMatrix.m14}; // Near
-    frustum.planes[5] = (Plane){.normal = {viewProjMatrix.m3 - viewProjMatrix.m2, viewProjMatrix.m7 - viewProjMatrix.m6, viewProjMatrix.m11 - viewProjMatrix.m10}, .distance = viewProjMatrix.m15 - viewProjMatrix.m14}; // Far
-
-    return frustum;
+        if (!AddPointLight(&PointLights, frustum, Position, TRACK_LAMP_RADIUS, TRACK_LAMP_COLOR))
+        {
+            return;
+        }
+    }
 }
 
 internal void
 GameRender(f64 DeltaTime)
 {
+    ProfileZone("GameRender");
+
     Color bgColor = (Color){10, 10, 24, 255};
     ClearBackground(bgColor);
 
@@ -533,6 +592,19 @@ GameRender(f64 DeltaTime)
     // Center of the world
     Frustum cameraFrustum = CalculateFrustum(MainCamera); // Define and calculate the camera frustum here
 
+    // The trains are drawn from the newest tick of the simulation thread, between its two poses
+    const TrainSnapshot *TrainState = AcquireTrainSnapshot(&Simulation);
+    const f32 TrainBlend = GetTrainSnapshotBlend(TrainState, GetSimClock(&Simulation));
+
+    // Bin the point lights for this view before anything lit is drawn
+    {
+        ProfileZone("LightClusters");
+
+        GatherPointLights(&cameraFrustum, TrainState, TrainBlend);
+        BinLightClusters(&PointLights, &MainCamera, (f32)GetScreenWidth() / (f32)GetScreenHeight());
+        UploadLightClusters(&PointLights, GetRenderWidth(), GetRenderHeight());
+    }
+
     // Render wires for the cameraFrustum
     if (Debug)
     {
@@ -551,82 +623,51 @@ GameRender(f64 DeltaTime)
     // Center of the world a test cube
     DrawCube((Vector3){0.0f, 16.0f, 0.0f}, 32.0f, 32.0f, 32.0f, RED);
 
-    GroundTilesInView.clear();
-
-    TransformsInView01.clear();
-    TransformsInView02.clear();
-    TransformsInView03.clear();
-    TransformsInView04.clear();
+    // Bring the instance list up to date, free when the camera did not move. The records only
+    // go to the GPU when the list changed. Chunks too far away for instancing get a baked level
+    const GroundLodView LodView = MakeGroundLodView(&MainCamera, GetScreenHeight(), GroundTiles.TileSize);
 
-    InViewCount = 0;
-
-    for (usize i = 0; i < MAP_SIZE; ++i)
     {
-        for (usize j = 0; j < MAP_SIZE; ++j)
-        {
-            const usize Id = i * MAP_SIZE + j;
-
-            // Calculate the bounding box for each tile
-            // CalculateBoundingBox(&GroundTiles[Id]);
-
-            // Check if the tile is in the frustum
-            if (IsBoxInFrustum(&cameraFrustum, &GroundTiles[Id].BoundingVolume))
-            {
-                GroundTilesInView.push_back(GroundTiles[Id]);
-
-                // Add the tile's transform to the appropriate list based on its material
-                if (GroundTiles[Id].MaterialIndex == 0)
-                {
-                    TransformsInView01.push_back(GroundTiles[Id].MatrixTransform);
-                }
-                else if (GroundTiles[Id].MaterialIndex == 1)
-                {
-                    TransformsInView02.push_back(GroundTiles[Id].MatrixTransform);
-                }
-                else if (GroundTiles[Id].MaterialIndex == 2)
-                {
-                    TransformsInView03.push_back(GroundTiles[Id].MatrixTransform);
-                }
-                else if (GroundTiles[Id].MaterialIndex == 3)
-                {
-                    TransformsInView04.push_back(GroundTiles[Id].MatrixTransform);
-                }
+        ProfileZone("UpdateGroundBatches");
 
-                InViewCount++;
-            }
+        if (UpdateGroundBatches(&GroundInView, &GroundTree, &GroundTiles, &cameraFrustum, &LodView, &MainCamera, GetScreenWidth(), GetScreenHeight(), &FrameScratch))
+        {
+            ProfileZone("UploadTerrainInstances");
+            UploadTerrainInstances(&Terrain, GroundInView.InstancesInView.data(), GroundInView.InstancesInView.size());
         }
     }
 
-    // Batch render the tiles for each material
-    if (!TransformsInView01.empty())
-    {
-        DrawMeshInstanced(GroundMesh, Mat01, TransformsInView01.data(), TransformsInView01.size());
-    }
-    if (!TransformsInView02.empty())
-    {
-        DrawMeshInstanced(GroundMesh, Mat02, TransformsInView02.data(), TransformsInView02.size());
-    }
-    if (!TransformsInView03.empty())
-    {
-        DrawMeshInstanced(GroundMesh, Mat03, TransformsInView03.data(), TransformsInView03.size());
-    }
-    if (!TransformsInView04.empty())
-    {
-        DrawMeshInstanced(GroundMesh, Mat04, TransformsInView04.data(), TransformsInView04.size());
-    }
+    // All the instanced tiles in view in one draw call, then one draw per baked chunk
+    DrawGroundTerrain(&Terrain, &GroundMesh, &GroundPalette.Materials[TerrainMaterial]);
+
+    RebakeDirtyGroundChunks(&TerrainLod, &GroundTree, &GroundTiles, GroundInView.NodeState, GroundInView.NodeLod);
+    DrawGroundChunks(&TerrainLod, &GroundTree, &GroundTiles, GroundInView.NodeState, GroundInView.NodeLod, &GroundPalette.Materials[ChunkMaterial]);
 
     // Railroads and Trains
     {
-        DrawModel(RailRoadStraightModel, (Vector3){64.0f + 16.0f, 1.0f, 64.0f + 16.0f}, 32.0f, WHITE);
+        ProfileZone("DrawTracks");
+
+        DrawModel(TrackModels[TRACK_MODEL_STRAIGHT], (Vector3){64.0f + 16.0f, 1.0f, 64.0f + 16.0f}, 32.0f, WHITE);
+
+        // The pieces in view, one instanced draw per model mesh
+        UpdateTrackBatches(&TracksInView, &Tracks, GroundTiles.TileSize, &cameraFrustum, &MainCamera, GetScreenWidth(), GetScreenHeight());
+        DrawTrackBatches(&TracksInView, TrackModels, ModelShader);
 
-        for (usize i = 0; i < TrainTracks.size(); ++i)
+        // The last route found with P, drawn just above the tracks
+        for (usize t = 1; t < DebugRoute.size(); ++t)
         {
-            DrawModel(TrainTracks[i].m_Model, TrainTracks[i].Position, 32.0f, WHITE);
+            const Vector3 From = Vector3Add(GetTrackPieceCenter(&Tracks, GroundTiles.TileSize, DebugRoute[t - 1]), (Vector3){0.0f, 4.0f, 0.0f});
+            const Vector3 To = Vector3Add(GetTrackPieceCenter(&Tracks, GroundTiles.TileSize, DebugRoute[t]), (Vector3){0.0f, 4.0f, 0.0f});
+
+            DrawLine3D(From, To, MAGENTA);
         }
+
+        BuildTrainBatches(&TrainsInView, TrainState, TrainBlend, &cameraFrustum, &FrameScratch);
+        DrawTrainBatches(&TrainsInView, TrainModels, ModelShader);
     }
 
     // Highlight the selected tile
-    if (SelectedGroundTile != NULL)
+    if (SelectedGroundTile != -1)
     {
         if (collision.hit)
         {
@@ -645,7 +686,8 @@ GameRender(f64 DeltaTime)
             // DrawLine3D(collision.point, normalEnd, RED);
 
             // Highlight the selected tile
-            DrawCubeWires(Vector3Transform((Vector3){0.0f, 0.0f, 0.0f}, SelectedGroundTile->MatrixTransform), SelectedGroundTile->width, SelectedGroundTile->height, SelectedGroundTile->depth, WHITE);
+            const GroundTileInfo *SelectedInfo = &GroundTiles.Info[SelectedGroundTile];
+            DrawCubeWires(Vector3Transform((Vector3){0.0f, 0.0f, 0.0f}, GroundTiles.Transforms[SelectedGroundTile]), SelectedInfo->width, SelectedInfo->height, SelectedInfo->depth, WHITE);
         }
 
         // DrawRay(ray, MAROON);
@@ -656,56 +698,74 @@ GameRender(f64 DeltaTime)
     EndMode3D();
 
     // Draw UI -----------------------------------------------------------------------
-    DrawTextEx(MainFont, TextFormat("FPS: %i", GetFPS()), {10, 10}, 16, 2, BLACK);
-    DrawTextEx(MainFont, TextFormat("FPS: %i", GetFPS()), {13, 13}, 16, 2, WHITE);
+    ProfileZone("Hud");
+
+    SetHudLabel(&Hud, HUD_FPS, "FPS: %i", GetFPS());
 
     if (IsMouseButtonDown(MOUSE_RIGHT_BUTTON))
     {
-        DrawTextEx(MainFont, "RIGHT MOUSE IS PRESSED!", {10, 32}, 16, 2, BLACK);
-        DrawTextEx(MainFont, "RIGHT MOUSE IS PRESSED!", {13, 35}, 16, 2, WHITE);
+        SetHudLabel(&Hud, HUD_RIGHT_MOUSE, "RIGHT MOUSE IS PRESSED!");
+    }
+    else
+    {
+        HideHudLabel(&Hud, HUD_RIGHT_MOUSE);
     }
 
-    DrawTextEx(MainFont, TextFormat("MainCamera.fovy: %f", MainCamera.fovy), {10, 64}, 16, 2, BLACK);
-    DrawTextEx(MainFont, TextFormat("MainCamera.fovy: %f", MainCamera.fovy), {13, 67}, 16, 2, WHITE);
+    SetHudLabel(&Hud, HUD_FOVY, "MainCamera.fovy: %f", MainCamera.fovy);
 
     // if IsBoxInFrustum(&cameraFrustum, &GroundTiles[0].BoundingVolume)
-    if (IsBoxInFrustum(&cameraFrustum, &GroundTiles[0].BoundingVolume))
+    const BoundingBox FirstTileBox = GetTileBoundingBox(&GroundTiles, 0);
+    if (IsBoxInFrustum(&cameraFrustum, &FirstTileBox))
     {
-        DrawTextEx(MainFont, "Tile 01 is in the frustum", {10, 96}, 16, 2, BLACK);
-        DrawTextEx(MainFont, "Tile 01 is in the frustum", {13, 99}, 16, 2, WHITE);
+        SetHudLabel(&Hud, HUD_FIRST_TILE, "Tile 01 is in the frustum");
+    }
+    else
+    {
+        HideHudLabel(&Hud, HUD_FIRST_TILE);
     }
 
-    DrawTextEx(MainFont, TextFormat("In View Count: %i", InViewCount), {10, 118}, 32, 2, BLACK);
-    DrawTextEx(MainFont, TextFormat("In View Count: %i", InViewCount), {13, 121}, 32, 2, WHITE);
-
-    DrawTextEx(MainFont, TextFormat("MainCamera.position: %f, %f, %f", MainCamera.position.x, MainCamera.position.y, MainCamera.position.z), {10, 160}, 16, 2, BLACK);
-    DrawTextEx(MainFont, TextFormat("MainCamera.position: %f, %f, %f", MainCamera.position.x, MainCamera.position.y, MainCamera.position.z), {13, 163}, 16, 2, WHITE);
+    const char *CullMode = GroundInView.UseFootprint ? "footprint" : "per tile";
+    SetHudLabel(&Hud, HUD_IN_VIEW, "In View Count: %i (%s)", GroundInView.InViewCount, CullMode);
 
-    DrawTextEx(MainFont, TextFormat("DebugCamera.position: %f, %f, %f", DebugCamera.position.x, DebugCamera.position.y, DebugCamera.position.z), {10, 192}, 16, 2, BLACK);
-    DrawTextEx(MainFont, TextFormat("DebugCamera.position: %f, %f, %f", DebugCamera.position.x, DebugCamera.position.y, DebugCamera.position.z), {13, 195}, 16, 2, WHITE);
+    SetHudLabel(&Hud, HUD_MAIN_CAMERA, "MainCamera.position: %f, %f, %f", MainCamera.position.x, MainCamera.position.y, MainCamera.position.z);
+    SetHudLabel(&Hud, HUD_DEBUG_CAMERA, "DebugCamera.position: %f, %f, %f", DebugCamera.position.x, DebugCamera.position.y, DebugCamera.position.z);
 
-    if (SelectedGroundTile != NULL)
+    if (SelectedGroundTile != -1)
     {
-        DrawTextEx(MainFont, TextFormat("Selected Tile: %i", SelectedGroundTile->MaterialIndex), {10, 224}, 16, 2, BLACK);
-        DrawTextEx(MainFont, TextFormat("Selected Tile: %i", SelectedGroundTile->MaterialIndex), {13, 227}, 16, 2, WHITE);
+        SetHudLabel(&Hud, HUD_SELECTED_TILE, "Selected Tile: %i", GroundTiles.MaterialIndex[SelectedGroundTile]);
 
         // SelectedGroundTile transform position
-        DrawTextEx(MainFont, TextFormat("Selected Tile Position: %f, %f, %f", SelectedGroundTile->MatrixTransform.m12, SelectedGroundTile->MatrixTransform.m13, SelectedGroundTile->MatrixTransform.m14), {10, 256}, 16, 2, BLACK);
-        DrawTextEx(MainFont, TextFormat("Selected Tile Position: %f, %f, %f", SelectedGroundTile->MatrixTransform.m12, SelectedGroundTile->MatrixTransform.m13, SelectedGroundTile->MatrixTransform.m14), {13, 259}, 16, 2, WHITE);
+        const Vector3 SelectedPosition = GetTilePosition(&GroundTiles, SelectedGroundTile);
+        SetHudLabel(&Hud, HUD_SELECTED_POSITION, "Selected Tile Position: %f, %f, %f", SelectedPosition.x, SelectedPosition.y, SelectedPosition.z);
 
         // Draw some debug GUI text
-        DrawTextEx(MainFont, TextFormat("Hit Object: %s", hitObjectName), (Vector2){10, 288}, 20, 2, BLACK);
-        DrawTextEx(MainFont, TextFormat("Hit Object: %s", hitObjectName), (Vector2){13, 291}, 20, 2, WHITE);
-
-        DrawTextEx(MainFont, TextFormat("Hit Distance: %f", collision.distance), (Vector2){10, 320}, 20, 2, BLACK);
-        DrawTextEx(MainFont, TextFormat("Hit Distance: %f", collision.distance), (Vector2){13, 323}, 20, 2, WHITE);
+        SetHudLabel(&Hud, HUD_HIT_OBJECT, "Hit Object: %s", hitObjectName);
+        SetHudLabel(&Hud, HUD_HIT_DISTANCE, "Hit Distance: %f", collision.distance);
     }
     else
     {
-        DrawTextEx(MainFont, "No Tile Selected", {10, 224}, 16, 2, BLACK);
-        DrawTextEx(MainFont, "No Tile Selected", {13, 227}, 16, 2, WHITE);
+        SetHudLabel(&Hud, HUD_SELECTED_TILE, "No Tile Selected");
+        HideHudLabel(&Hud, HUD_SELECTED_POSITION);
+        HideHudLabel(&Hud, HUD_HIT_OBJECT);
+        HideHudLabel(&Hud, HUD_HIT_DISTANCE);
     }
 
+    SetHudLabel(&Hud, HUD_TRACK_PIECES, "Track Pieces: %zu (%zu in view)", Tracks.Pieces.size(), TracksInView.InViewCount);
+    SetHudLabel(&Hud, HUD_TRAINS, "Trains: %zu (%zu carriages, %zu in view, %lu deadlocks broken)", TrainState->Front.size(), GetTrainSnapshotCarriageCount(TrainState), TrainsInView.InViewCount, TrainState->Deadlocks);
+    SetHudLabel(&Hud, HUD_POINT_LIGHTS, "Point Lights: %zu in view (%zu in clusters)", PointLights.Lights.Count, PointLights.Indices.Count);
+    SetHudLabel(&Hud, HUD_SIMULATION, "Simulation: %.0fx (F5), tick %lu, %.2f ms", GetSimSpeed(&Simulation), TrainState->Tick, TrainState->TickSeconds * 1000.0f);
+
+    // Only the labels that changed are laid out again, all of them are one draw
+    DrawHud(&Hud, MainFont);
+
+    if (ShowProfiler)
+    {
+        DrawProfilerOverlay(GetFontDefault(), 10, 416);
+    }
+
+    DrawAssetLoaderProgress(&Assets, 10, SCREEN_HEIGHT - 40, 300);
+
+    ProfileZone("EndDrawing");
     EndDrawing();
 }
 
@@ -719,14 +779,46 @@ PrintMemoryUsage(void)
 internal void
 CleanupOurStuff(void)
 {
+    FreeGroundTerrain(&Terrain); // Needs the OpenGL context
+    FreeGroundLod(&TerrainLod);  // Needs the OpenGL context
+    FreeLightClusters(&PointLights); // Needs the OpenGL context
+    FreeDebugHud(&Hud);              // Needs the OpenGL context
+
+    FreeAssetLoader(&Assets); // Needs the OpenGL context
+
     CloseWindow(); // Close window and OpenGL context
     printf("\n\tClosed window and OpenGL context\n");
 
-    free(GroundMaterials);
-    CPUMemory -= (MAP_SIZE * MAP_SIZE) * sizeof(Material);
+    StopSimThread(&Simulation); // Has a job queue of its own
+    JobSystemShutdown();
+
+    if (TraceOnExit)
+    {
+        WriteProfilerTrace(TracePath, TraceFrames);
+    }
+
+    ProfilerShutdown();
+
+    FreeMaterialPalette(&GroundPalette);
+
+    FreeGroundTileStore(&GroundTiles);
+
+    FreeGroundBatches(&GroundInView);
+
+    FreeGroundQuadtree(&GroundTree);
 
-    free(GroundTiles);
-    CPUMemory -= ((MAP_SIZE * MAP_SIZE) * sizeof(GroundTile));
+    CloseGroundStream(&GroundMapStream);
+
+    FreeTrackNetwork(&Tracks);
+    FreeTrackBatches(&TracksInView);
+    FreeTrackRouter(&Routes);
+    FreeTrainSim(&Trains);
+    FreeTrackBlocks(&TrainBlocks);
+    FreeTrainBatches(&TrainsInView);
+    DebugRoute = std::vector<u32>();
+
+    printf("\n\tFrame arena: %zu KB at most in a frame, allocated %lu times\n", (usize)(FrameScratch.HighWater / Kilobytes(1)), FrameScratch.Grows);
+    FreeFrameArena(&FrameScratch);
 
     // @Note(Victor): There should be no allocated memory left
     Assert(CPUMemory == 0);
@@ -751,152 +843,209 @@ SetupGroundTiles(void)
 {
     // Create the ground tiles
     {
-        GroundMaterials = (Material *)calloc((MAP_SIZE * MAP_SIZE), sizeof(Material));
-        CPUMemory += (MAP_SIZE * MAP_SIZE) * sizeof(Material);
+        AllocateGroundTileStore(&GroundTiles, MAP_SIZE, SQUARE_SIZE);
 
-        GroundTiles = (GroundTile *)calloc((MAP_SIZE * MAP_SIZE), sizeof(GroundTile));
-        CPUMemory += (MAP_SIZE * MAP_SIZE) * sizeof(GroundTile);
+        const bool Streamed = (MapPath != NULL) && OpenGroundStream(&GroundMapStream, MapPath, MAP_SIZE);
 
-        for (usize i = 0; i < MAP_SIZE; ++i)
+        if (Streamed)
+        {
+            // Only the window around the camera is read from the map file
+            i64 OriginChunkI, OriginChunkJ;
+            GetGroundStreamOrigin(&GroundMapStream, &GroundTiles, MainCamera.target, &OriginChunkI, &OriginChunkJ);
+            LoadGroundWindow(&GroundMapStream, &GroundTiles, OriginChunkI, OriginChunkJ);
+        }
+        else
         {
-            for (usize j = 0; j < MAP_SIZE; ++j)
+            // Tile geometry on the heightmap, rows are independent so they are spread over the job system
+            ParallelFor(MAP_SIZE, 8, [&](usize RowBegin, usize RowEnd, u32 Worker)
+                        {
+                            for (usize Id = RowBegin * MAP_SIZE; Id < RowEnd * MAP_SIZE; ++Id)
+                            {
+                                SetGroundTileGeometry(&GroundTiles, Id, GetGroundElevation(Id / MAP_SIZE, Id % MAP_SIZE));
+                            }
+                        });
+
+            // Assign Random Material, stays on the main thread since GetRandomValue is not thread safe
+            for (usize Id = 0; Id < GroundTiles.Count; ++Id)
             {
-                const usize Id = i * MAP_SIZE + j;
-
-                GroundTiles[Id].Id = Id;
-
-                const f32 X = i - MAP_SIZE / 2.0f + 0.5f;
-                const f32 Y = 0.0f;
-                const f32 Z = j - MAP_SIZE / 2.0f + 0.5f;
-
-                // Create a model matrix for each data poto position it
-                GroundTiles[Id].MatrixTransform = MatrixIdentity();
-
-                const f64 Scale = 0.03150;
-                GroundTiles[Id].MatrixTransform = MatrixMultiply(GroundTiles[Id].MatrixTransform, MatrixScale(SQUARE_SIZE * Scale, SQUARE_SIZE * Scale, SQUARE_SIZE * Scale));
-
-                GroundTiles[Id].MatrixTransform = MatrixMultiply(GroundTiles[Id].MatrixTransform, MatrixRotate((Vector3){0.0f, 1.0f, 0.0f}, 45.0f * DEG2RAD));
-
-                GroundTiles[Id].MatrixTransform = MatrixMultiply(GroundTiles[Id].MatrixTransform, MatrixTranslate(X * SQUARE_SIZE, Y * SQUARE_SIZE, Z * SQUARE_SIZE));
-
-                // Assign Random Material
-                {
-                    GroundMaterials[Id] = LoadMaterialDefault();
-
-                    const i32 RandomGrassId = GetRandomValue(0, 3);
-
-                    // Assign different grass materials to the ground
-                    if (RandomGrassId == 0)
-                    {
-                        GroundMaterials[Id].maps[MATERIAL_MAP_DIFFUSE].texture = GrassTexture;
-                    }
-                    else if (RandomGrassId == 1)
-                    {
-                        GroundMaterials[Id].maps[MATERIAL_MAP_DIFFUSE].texture = GrassTexture02;
-                    }
-                    else if (RandomGrassId == 2)
-                    {
-                        GroundMaterials[Id].maps[MATERIAL_MAP_DIFFUSE].texture = GrassTexture03;
-                    }
-                    else if (RandomGrassId == 3)
-                    {
-                        GroundMaterials[Id].maps[MATERIAL_MAP_DIFFUSE].texture = GrassTexture04;
-                    }
-
-                    GroundMaterials[Id].maps[MATERIAL_MAP_DIFFUSE].color = WHITE;
-                    GroundMaterials[Id].maps[MATERIAL_MAP_SPECULAR].value = 0.0f;
-
-                    f32 shininess = 0.0f;
-                    SetShaderValue(GroundMaterials[Id].shader, GetShaderLocation(GroundMaterials[Id].shader, "shininess"), &shininess, SHADER_UNIFORM_FLOAT);
-                    GroundMaterials[Id].shader = CustomShader;
-
-                    GroundTiles[Id].Mat = GroundMaterials[Id];
-                    GroundTiles[Id].MaterialIndex = RandomGrassId;
-                }
-
-                // Bounding box from the GroundTiles[Id].MatrixTransform and the width, depth, height
-                GroundTiles[Id].width = 1.0f * SQUARE_SIZE;
-                GroundTiles[Id].depth = 1.0f * SQUARE_SIZE;
-                GroundTiles[Id].height = 0.1f;
+                GroundTiles.MaterialIndex[Id] = (u8)GetRandomValue(0, GROUND_MATERIAL_COUNT - 1);
+            }
+        }
 
-                GroundTiles[Id].BoundingVolume.min = (Vector3){-0.5f * SQUARE_SIZE, 0.0f * SQUARE_SIZE, -0.5f * SQUARE_SIZE};
-                GroundTiles[Id].BoundingVolume.max = (Vector3){0.5f * SQUARE_SIZE, 0.0f * SQUARE_SIZE, 0.5f * SQUARE_SIZE};
+        // One material for the whole terrain, the material index of a tile picks its cell in the grass atlas
+        TerrainMaterial = RegisterPaletteMaterial(&GroundPalette, CustomShader, GrassAtlas.Texture);
+        ChunkMaterial = RegisterPaletteMaterial(&GroundPalette, ChunkShader, GrassAtlas.Texture);
 
-                CalculateBoundingBox(&GroundTiles[Id]);
-            } // j
-        } // i
+        f32 shininess = 0.0f;
+        SetShaderValue(CustomShader, GetShaderLocation(CustomShader, "shininess"), &shininess, SHADER_UNIFORM_FLOAT);
+        SetShaderValue(ChunkShader, GetShaderLocation(ChunkShader, "shininess"), &shininess, SHADER_UNIFORM_FLOAT);
+        SetShaderValue(ModelShader, GetShaderLocation(ModelShader, "shininess"), &shininess, SHADER_UNIFORM_FLOAT);
     } // block
 
-    // 01
-    i64 MaterialTargetIndex = 0;
-    std::vector<GroundTile> Tiles01 = GetGroundTilesByMaterialIndex(GroundTiles, (MAP_SIZE * MAP_SIZE), MaterialTargetIndex);
-    Mat01 = Tiles01.front().Mat;
-
-    // 02
-    MaterialTargetIndex = 1;
-    std::vector<GroundTile> Tiles02 = GetGroundTilesByMaterialIndex(GroundTiles, (MAP_SIZE * MAP_SIZE), MaterialTargetIndex);
-    Mat02 = Tiles02.front().Mat;
+    // The bounding volumes are final, build the pyramid and the culling hierarchy on top of them
+    UpdateGroundSurfaceRange(&GroundTiles);
+    BuildGroundQuadtree(&GroundTree, &GroundTiles);
+    InitGroundBatches(&GroundInView, &GroundTree, &GroundTiles);
+    GroundInView.UseFootprint = true; // F4 switches to per-tile tests
 
-    // 03
-    MaterialTargetIndex = 2;
-    std::vector<GroundTile> Tiles03 = GetGroundTilesByMaterialIndex(GroundTiles, (MAP_SIZE * MAP_SIZE), MaterialTargetIndex);
-    Mat03 = Tiles03.front().Mat;
+    GroundMesh = GenMeshPlane(SQUARE_SIZE, SQUARE_SIZE, 1, 1);
 
-    // 04
-    MaterialTargetIndex = 3;
-    std::vector<GroundTile> Tiles04 = GetGroundTilesByMaterialIndex(GroundTiles, (MAP_SIZE * MAP_SIZE), MaterialTargetIndex);
-    Mat04 = Tiles04.front().Mat;
+    InitGroundTerrain(&Terrain, &GroundTiles, &GroundMesh, CustomShader, &GrassAtlas);
+    UploadTerrainElevation(&Terrain, &GroundTiles, CustomShader);
 
-    // Rotated 45 degrees
-    GroundMesh = GenMeshPlane(SQUARE_SIZE, SQUARE_SIZE, 1, 1);
-    Matrix rotationMatrix = MatrixRotate((Vector3){0.0f, 1.0f, 0.0f}, 45.0f * DEG2RAD);
-    for (usize i = 0; i < MAP_SIZE; ++i)
-    {
-        for (usize j = 0; j < MAP_SIZE; ++j)
-        {
-            const usize Id = i * MAP_SIZE + j;
-            GroundTiles[Id].MatrixTransform = MatrixMultiply(rotationMatrix, GroundTiles[Id].MatrixTransform);
-        }
-    }
+    // Far away chunks are drawn from baked meshes instead
+    InitGroundLod(&TerrainLod, &GroundTree, &GroundTiles, &GroundMesh, &Terrain.Layout, &GrassAtlas);
 }
 
-internal void
-SetupShaders(void)
+internal Shader
+LoadLightingShader(const char *VertexShaderPath)
 {
-    CustomShader = LoadShader("./shaders/lighting_instancing.vs", "./shaders/lighting.fs");
+    Shader Result = LoadShader(VertexShaderPath, "./shaders/lighting.fs");
 
     // Get shader locations
-    CustomShader.locs[SHADER_LOC_MATRIX_MVP] = GetShaderLocation(CustomShader, "mvp");
-    CustomShader.locs[SHADER_LOC_VECTOR_VIEW] = GetShaderLocation(CustomShader, "viewPos");
-    CustomShader.locs[SHADER_LOC_MATRIX_MODEL] = GetShaderLocationAttrib(CustomShader, "instanceTransform");
+    Result.locs[SHADER_LOC_MATRIX_MVP] = GetShaderLocation(Result, "mvp");
+    Result.locs[SHADER_LOC_VECTOR_VIEW] = GetShaderLocation(Result, "viewPos");
 
     // Lighting
     {
         // Setting shader values
-        i32 AmbientLoc = GetShaderLocation(CustomShader, "ambient");
+        i32 AmbientLoc = GetShaderLocation(Result, "ambient");
         f64 AmbientValue[4] = {0.8, 0.8, 0.8, 0.1};
-        SetShaderValue(CustomShader, AmbientLoc, &AmbientValue, SHADER_UNIFORM_VEC4);
+        SetShaderValue(Result, AmbientLoc, &AmbientValue, SHADER_UNIFORM_VEC4);
 
-        i32 ColorDiffuseLoc = GetShaderLocation(CustomShader, "colorDiffuse");
+        i32 ColorDiffuseLoc = GetShaderLocation(Result, "colorDiffuse");
         f64 DiffuseValue[4] = {1.0, 1.0, 1.0, 1.0};
-        SetShaderValue(CustomShader, ColorDiffuseLoc, &DiffuseValue, SHADER_UNIFORM_VEC4);
+        SetShaderValue(Result, ColorDiffuseLoc, &DiffuseValue, SHADER_UNIFORM_VEC4);
 
         // Like the sun shining on the earth
-        CreateLight(LIGHT_DIRECTIONAL, {1000.0f, 1000.0f, 0.0f}, Vector3Zero(), WHITE, CustomShader);
+        CreateLight(LIGHT_DIRECTIONAL, {1000.0f, 1000.0f, 0.0f}, Vector3Zero(), WHITE, Result);
 
         // We can also add a polight at the center of the world
-        // CreateLight(LIGHT_POINT, {0.0f, 0.0f, 0.0f}, Vector3Zero(), WHITE, CustomShader);
+        // CreateLight(LIGHT_POINT, {0.0f, 0.0f, 0.0f}, Vector3Zero(), WHITE, Result);
     }
+
+    return Result;
+}
+
+internal void
+SetupShaders(void)
+{
+    CustomShader = LoadLightingShader("./shaders/lighting_instancing.vs");
+    ChunkShader = LoadLightingShader("./shaders/lighting.vs");
+
+    // DrawMeshInstanced binds the instance transforms to the attribute in this location
+    ModelShader = LoadLightingShader("./shaders/model_instancing.vs");
+    ModelShader.locs[SHADER_LOC_MATRIX_MODEL] = GetShaderLocationAttrib(ModelShader, "instanceTransform");
+
+    // The chunks are drawn with DrawMesh, the fragment shader wants their world positions
+    ChunkShader.locs[SHADER_LOC_MATRIX_MODEL] = GetShaderLocation(ChunkShader, "matModel");
+
+    // Point lights for all of them
+    InitLightClusters(&PointLights);
+    AddLightClusterShader(&PointLights, CustomShader);
+    AddLightClusterShader(&PointLights, ChunkShader);
+    AddLightClusterShader(&PointLights, ModelShader);
+}
+
+// Where every label goes, the text comes every frame in GameRender
+internal void
+SetupHud(void)
+{
+    InitDebugHud(&Hud, HUD_LABEL_COUNT);
+
+    PlaceHudLabel(&Hud, HUD_FPS, (Vector2){10, 10}, 16, 2);
+    PlaceHudLabel(&Hud, HUD_RIGHT_MOUSE, (Vector2){10, 32}, 16, 2);
+    PlaceHudLabel(&Hud, HUD_FOVY, (Vector2){10, 64}, 16, 2);
+    PlaceHudLabel(&Hud, HUD_FIRST_TILE, (Vector2){10, 96}, 16, 2);
+    PlaceHudLabel(&Hud, HUD_IN_VIEW, (Vector2){10, 118}, 32, 2);
+    PlaceHudLabel(&Hud, HUD_MAIN_CAMERA, (Vector2){10, 160}, 16, 2);
+    PlaceHudLabel(&Hud, HUD_DEBUG_CAMERA, (Vector2){10, 192}, 16, 2);
+    PlaceHudLabel(&Hud, HUD_SELECTED_TILE, (Vector2){10, 224}, 16, 2);
+    PlaceHudLabel(&Hud, HUD_SELECTED_POSITION, (Vector2){10, 256}, 16, 2);
+    PlaceHudLabel(&Hud, HUD_HIT_OBJECT, (Vector2){10, 288}, 20, 2);
+    PlaceHudLabel(&Hud, HUD_HIT_DISTANCE, (Vector2){10, 320}, 20, 2);
+    PlaceHudLabel(&Hud, HUD_TRACK_PIECES, (Vector2){10, 352}, 16, 2);
+    PlaceHudLabel(&Hud, HUD_TRAINS, (Vector2){10, 368}, 16, 2);
+    PlaceHudLabel(&Hud, HUD_POINT_LIGHTS, (Vector2){10, 384}, 16, 2);
+    PlaceHudLabel(&Hud, HUD_SIMULATION, (Vector2){10, 400}, 16, 2);
 }
 
+internal Image
+BuildGrassAtlasImage(const void *Paths)
+{
+    return BuildTerrainAtlasImage((const char **)Paths, GROUND_MATERIAL_COUNT);
+}
+
+// Everything is queued up front, the loader threads decode while the ground is set up and the
+// placeholders are used until the assets are in (see UpdateAssets)
 internal void
 SetupResources(void)
 {
-    MainFont = LoadFontEx("./resources/fonts/SuperMarioBros2.ttf", 32, 0, 250);
-    GrassTexture = LoadTexture("./resources/images/grass.png");
-    GrassTexture02 = LoadTexture("./resources/images/grass_02.png");
-    GrassTexture03 = LoadTexture("./resources/images/grass_03.png");
-    GrassTexture04 = LoadTexture("./resources/images/grass_04.png");
+    InitAssetLoader(&Assets);
+
+    MainFontAsset = QueueFontAsset(&Assets, "./resources/fonts/SuperMarioBros2.ttf", 32, 250);
+    MainFont = GetAssetFont(&Assets, MainFontAsset);
+
+    local_persist const char *GrassImages[GROUND_MATERIAL_COUNT] = {
+        "./resources/images/grass.png",
+        "./resources/images/grass_02.png",
+        "./resources/images/grass_03.png",
+        "./resources/images/grass_04.png",
+    };
+    GrassAtlasAsset = QueueBuiltTextureAsset(&Assets, "grass atlas", BuildGrassAtlasImage, GrassImages);
+    GrassAtlas = MakeTerrainAtlas(GetAssetTexture(&Assets, GrassAtlasAsset), GROUND_MATERIAL_COUNT);
+
+    for (u32 m = 0; m < TRACK_MODEL_COUNT; ++m)
+    {
+        TrackModelAssets[m] = QueueModelAsset(&Assets, TrackModelInfos[m].Path);
+        TrackModels[m] = GetAssetModel(&Assets, TrackModelAssets[m]);
+    }
+
+    for (u32 m = 0; m < TRAIN_MODEL_COUNT; ++m)
+    {
+        TrainModelAssets[m] = QueueModelAsset(&Assets, TrainModelPaths[m]);
+        TrainModels[m] = GetAssetModel(&Assets, TrainModelAssets[m]);
+    }
+}
+
+// Uploads what the loader threads decoded and swaps the loaded assets in for the placeholders
+internal void
+UpdateAssets(void)
+{
+    PumpAssetLoader(&Assets);
+
+    if (Assets.Version == AssetsVersion)
+    {
+        return;
+    }
+
+    AssetsVersion = Assets.Version;
+
+    MainFont = GetAssetFont(&Assets, MainFontAsset);
+
+    const Texture2D AtlasTexture = GetAssetTexture(&Assets, GrassAtlasAsset);
+    if (AtlasTexture.id != GrassAtlas.Texture.id)
+    {
+        GrassAtlas = MakeTerrainAtlas(AtlasTexture, GROUND_MATERIAL_COUNT);
+
+        GroundPalette.Materials[TerrainMaterial].maps[MATERIAL_MAP_DIFFUSE].texture = AtlasTexture;
+        GroundPalette.Materials[ChunkMaterial].maps[MATERIAL_MAP_DIFFUSE].texture = AtlasTexture;
+        SetGroundTerrainAtlas(CustomShader, &GrassAtlas);
+        SetGroundLodAtlas(&TerrainLod, &GrassAtlas);
+    }
+
+    // The batches keep the bounds and transforms of the models
+    for (u32 m = 0; m < TRACK_MODEL_COUNT; ++m)
+    {
+        TrackModels[m] = GetAssetModel(&Assets, TrackModelAssets[m]);
+    }
+    InitTrackBatches(&TracksInView, TrackModels);
+
+    for (u32 m = 0; m < TRAIN_MODEL_COUNT; ++m)
+    {
+        TrainModels[m] = GetAssetModel(&Assets, TrainModelAssets[m]);
+    }
+    InitTrainBatches(&TrainsInView, TrainModels);
 }
 
 internal void
@@ -918,7 +1067,15 @@ SetupCameras(void)
 internal void
 SetupRailroadsAndTrains(void)
 {
-    RailRoadStraightModel = LoadModel("./resources/models/GLB format/railroad-straight.glb");
+    // Pieces are kept per world tile, so they stay put when a streamed ground window moves
+    InitTrackNetwork(&Tracks, (u32)GroundTiles.WorldSize);
+    InitTrackBatches(&TracksInView, TrackModels);
+    InitTrackRouter(&Routes, &Tracks);
+
+    InitTrainSim(&Trains, GroundTiles.TileSize);
+    InitTrainBatches(&TrainsInView, TrainModels);
+
+    StartSimThread(&Simulation, &Trains, &Tracks, &TrainBlocks);
 }
 
 i32 main(i32 argc, char **argv)
@@ -927,6 +1084,18 @@ i32 main(i32 argc, char **argv)
 
     ParseInputArgs(argc, argv);
 
+    // Map converter, no window needed
+    if (WriteMapPath != NULL)
+    {
+        return WriteGroundMapFile(WriteMapPath, WriteMapSize, (f32)SQUARE_SIZE) ? 0 : 1;
+    }
+
+    // Model cooker, same
+    if (CookModels)
+    {
+        return CookModelCache(MODEL_CACHE_PATH, MODEL_CACHE_SOURCE) ? 0 : 1;
+    }
+
     printf("\tHello from raylib_orthographic!\n\n");
 
     // Raylib setup ---------------------------------------------------
@@ -939,8 +1108,19 @@ i32 main(i32 argc, char **argv)
     SetWindowState(FLAG_VSYNC_HINT);
     // ----------------------------------------------------------------
 
+    SetupFrustumCullingKernel();
+    printf("\tFrustum culling kernel: %s\n", CullTileRunName);
+
+    ProfilerInit();
+
+    JobSystemInit(0);
+    printf("\tJob system workers: %u\n", Jobs.WorkerCount);
+
+    InitFrameArena(&FrameScratch, Megabytes(1)); // Grows to what the frames use
+
     SetupCameras();
     SetupResources();
+    SetupHud();
     SetupShaders();
     SetupGroundTiles();
     SetupRailroadsAndTrains();
@@ -951,9 +1131,21 @@ i32 main(i32 argc, char **argv)
     // Main loop
     while (!WindowShouldClose()) // Detect window close button or ESC key
     {
-        f64 DeltaTime = GetFrameTime();
-        GameUpdate(DeltaTime);
-        GameRender(DeltaTime);
+        ProfilerBeginFrame();
+
+        {
+            ProfileZone("Frame");
+
+            ResetFrameArena(&FrameScratch);
+
+            UpdateAssets();
+
+            f64 DeltaTime = GetFrameTime();
+            GameUpdate(DeltaTime);
+            GameRender(DeltaTime);
+        }
+
+        ProfilerEndFrame();
     }
 
     CleanupOurStuff();
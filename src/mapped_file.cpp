@@ -0,0 +1,101 @@
+// Mapped file -----------------------------------------------
+// A whole file in memory, read only, for the binary formats that are used in place without a
+// parsing step (see ground_map_file.cpp and model_cache.cpp). The formats validate the bytes on
+// top of it.
+//
+// Where the platform has mmap the file is mapped read only and shared, the pages come straight
+// from the page cache and are only read when touched. Elsewhere it is read into memory.
+struct MappedFile
+{
+    u8 *Data; // The whole file
+    usize Size;
+    bool Mapped; // False when the file was read into memory
+};
+
+internal void
+CloseMappedFile(MappedFile *File)
+{
+    if (File->Data == NULL)
+    {
+        return;
+    }
+
+    if (File->Mapped)
+    {
+#if defined(__linux__) || defined(__APPLE__)
+        munmap(File->Data, File->Size);
+#endif
+    }
+    else
+    {
+        free(File->Data);
+        CPUMemory -= File->Size;
+    }
+
+    *File = {0};
+}
+
+// False when the file is missing, empty or can not be read, the caller says what it was for
+internal bool
+OpenMappedFile(MappedFile *File, const char *Path)
+{
+    *File = {0};
+
+#if defined(__linux__) || defined(__APPLE__)
+    const i32 Fd = open(Path, O_RDONLY);
+    if (Fd < 0)
+    {
+        return false;
+    }
+
+    struct stat Stat;
+    if (fstat(Fd, &Stat) != 0 || Stat.st_size <= 0)
+    {
+        close(Fd);
+        return false;
+    }
+
+    void *Data = mmap(NULL, (usize)Stat.st_size, PROT_READ, MAP_SHARED, Fd, 0);
+    close(Fd);
+
+    if (Data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    File->Data = (u8 *)Data;
+    File->Size = (usize)Stat.st_size;
+    File->Mapped = true;
+#else
+    FILE *Handle = fopen(Path, "rb");
+    if (Handle == NULL)
+    {
+        return false;
+    }
+
+    fseek(Handle, 0, SEEK_END);
+    const long Size = ftell(Handle);
+    fseek(Handle, 0, SEEK_SET);
+
+    if (Size <= 0)
+    {
+        fclose(Handle);
+        return false;
+    }
+
+    File->Size = (usize)Size;
+    File->Data = (u8 *)calloc(File->Size, 1);
+    CPUMemory += File->Size;
+
+    const bool Read = fread(File->Data, 1, File->Size, Handle) == File->Size;
+    fclose(Handle);
+
+    if (!Read)
+    {
+        CloseMappedFile(File);
+        return false;
+    }
+#endif
+
+    return true;
+}
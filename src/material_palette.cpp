@@ -0,0 +1,40 @@
+// Material palette ------------------------------------------
+// The handful of materials the ground is drawn with, shared by every tile. A tile only stores
+// its palette index (GroundTileStore::MaterialIndex), so the materials and their maps are
+// created once and do not grow with the map size.
+const u32 MAX_PALETTE_MATERIALS = 16;
+
+struct MaterialPalette
+{
+    Material Materials[MAX_PALETTE_MATERIALS];
+    u32 Count;
+};
+
+// Returns the palette index of the new material
+internal u8
+RegisterPaletteMaterial(MaterialPalette *Palette, Shader shader, Texture2D DiffuseTexture)
+{
+    Assert(Palette->Count < MAX_PALETTE_MATERIALS);
+
+    Material *Mat = &Palette->Materials[Palette->Count];
+    *Mat = LoadMaterialDefault();
+
+    Mat->shader = shader;
+    Mat->maps[MATERIAL_MAP_DIFFUSE].texture = DiffuseTexture;
+    Mat->maps[MATERIAL_MAP_DIFFUSE].color = WHITE;
+    Mat->maps[MATERIAL_MAP_SPECULAR].value = 0.0f;
+
+    return (u8)Palette->Count++;
+}
+
+// The shader and the textures belong to whoever registered them, only the maps are freed here
+internal void
+FreeMaterialPalette(MaterialPalette *Palette)
+{
+    for (u32 i = 0; i < Palette->Count; ++i)
+    {
+        MemFree(Palette->Materials[i].maps);
+    }
+
+    *Palette = {0};
+}
@@ -0,0 +1,436 @@
+// Model cache -----------------------------------------------
+// Every .glb under resources/models cooked into one file, laid out the way raylib meshes want
+// it, so loading a model is a lookup in a memory mapped file instead of parsing glTF:
+//
+//      ModelCacheHeader
+//      per model, every part on a MODEL_CACHE_ALIGNMENT boundary:
+//          ModelCacheModel
+//          ModelCacheMesh[MeshCount]
+//          ModelCacheMaterial[MaterialCount]
+//          f32 vertices, normals, tangents and texture coordinates, u16 indices, per mesh
+//      ModelCacheEntry[EntryCount]  (sorted by path)
+//
+// The mesh arrays are used in place, the meshes of a cached model point into the mapping and
+// nothing is copied before the upload. Everything is little endian.
+//
+// An entry is keyed on the content hash of its GLB. The size and modification time of the GLB
+// are kept next to it: when they still match the file is not read at all, when they do not the
+// GLB is hashed and the entry is only used if the content is the same. A stale or missing entry
+// falls back to decoding the GLB (see asset_loader.cpp), and the cache is cooked again.
+const u32 MODEL_CACHE_MAGIC = 0x434C444D; // "MDLC"
+const u32 MODEL_CACHE_VERSION = 1;
+const u32 MODEL_CACHE_PATH_SIZE = 240;
+const u64 MODEL_CACHE_ALIGNMENT = 64;
+
+const char *MODEL_CACHE_PATH = "./resources/models/models.cache";
+const char *MODEL_CACHE_SOURCE = "./resources/models"; // Cooked with every .glb below it
+
+struct ModelCacheHeader
+{
+    u32 Magic;
+    u32 Version;
+    u32 EntryCount;
+    u32 Reserved;
+    u64 EntriesOffset; // From the start of the file
+    u64 FileSize;
+};
+
+struct ModelCacheEntry
+{
+    char Path[MODEL_CACHE_PATH_SIZE]; // Of the GLB, as it was found under MODEL_CACHE_SOURCE
+    u64 SourceSize;
+    i64 SourceTime; // Modification time
+    u64 ContentHash;
+    u64 Offset; // Of the ModelCacheModel
+};
+
+struct ModelCacheModel
+{
+    u32 MeshCount;
+    u32 MaterialCount;
+    Vector3 BoundsMin; // Of all meshes
+    Vector3 BoundsMax;
+};
+
+// Array offsets are from the start of the file, 0 when the mesh does not have the array
+struct ModelCacheMesh
+{
+    u32 VertexCount;
+    u32 TriangleCount;
+    u32 IndexCount;
+    u32 Material; // Index into the materials of the model, GLB_NONE for the default material
+    u64 Vertices;
+    u64 Normals;
+    u64 Tangents;
+    u64 TexCoords;
+    u64 Indices;
+};
+
+struct ModelCacheMaterial
+{
+    Color BaseColor;
+    char TexturePath[MODEL_CACHE_PATH_SIZE - sizeof(Color)]; // Empty when there is no texture
+};
+
+static_assert(sizeof(ModelCacheHeader) == 32, "The header is part of the file format");
+static_assert(sizeof(ModelCacheEntry) == 272, "The entries are part of the file format");
+static_assert(sizeof(ModelCacheModel) == 32, "The models are part of the file format");
+static_assert(sizeof(ModelCacheMesh) == 56, "The meshes are part of the file format");
+static_assert(sizeof(ModelCacheMaterial) == 240, "The materials are part of the file format");
+
+struct ModelCache
+{
+    MappedFile File;
+
+    const ModelCacheHeader *Header;
+    const ModelCacheEntry *Entries;
+};
+
+// FNV-1a over the GLB bytes
+internal u64
+HashModelSource(const u8 *Data, usize Size)
+{
+    u64 Hash = 0xCBF29CE484222325;
+
+    for (usize i = 0; i < Size; ++i)
+    {
+        Hash = (Hash ^ Data[i]) * 0x100000001B3;
+    }
+
+    return Hash;
+}
+
+// Size and modification time of a file, false when it can not be read
+internal bool
+GetModelSourceStamp(const char *Path, u64 *Size, i64 *Time)
+{
+#if defined(__linux__) || defined(__APPLE__)
+    struct stat Stat;
+    if (stat(Path, &Stat) != 0)
+    {
+        return false;
+    }
+
+    *Size = (u64)Stat.st_size;
+    *Time = (i64)Stat.st_mtime;
+
+    return true;
+#else
+    *Size = (u64)GetFileLength(Path);
+    *Time = (i64)GetFileModTime(Path);
+
+    return *Size > 0;
+#endif
+}
+
+internal bool
+ValidateModelCache(const ModelCache *Cache)
+{
+    if (Cache->File.Size < sizeof(ModelCacheHeader))
+    {
+        return false;
+    }
+
+    const ModelCacheHeader *Header = (const ModelCacheHeader *)Cache->File.Data;
+
+    return Header->Magic == MODEL_CACHE_MAGIC && Header->Version == MODEL_CACHE_VERSION && Header->FileSize == Cache->File.Size &&
+           Header->EntriesOffset + (u64)Header->EntryCount * sizeof(ModelCacheEntry) <= Cache->File.Size;
+}
+
+internal void
+CloseModelCache(ModelCache *Cache)
+{
+    CloseMappedFile(&Cache->File);
+    *Cache = {0};
+}
+
+// False when there is no cache yet or it is from another version, every model is a miss then
+internal bool
+OpenModelCache(ModelCache *Cache, const char *Path)
+{
+    *Cache = {0};
+
+    if (!OpenMappedFile(&Cache->File, Path))
+    {
+        return false;
+    }
+
+    if (!ValidateModelCache(Cache))
+    {
+        CloseModelCache(Cache);
+        printf("\tModel cache %s is not valid, models are loaded from their GLB files\n", Path);
+        return false;
+    }
+
+    Cache->Header = (const ModelCacheHeader *)Cache->File.Data;
+    Cache->Entries = (const ModelCacheEntry *)(Cache->File.Data + Cache->Header->EntriesOffset);
+
+    return true;
+}
+
+// Binary search over the sorted entries, NULL when the GLB was not cooked
+internal const ModelCacheEntry *
+FindModelCacheEntry(const ModelCache *Cache, const char *Path)
+{
+    if (Cache->File.Data == NULL)
+    {
+        return NULL;
+    }
+
+    u32 Low = 0;
+    u32 High = Cache->Header->EntryCount;
+
+    while (Low < High)
+    {
+        const u32 Middle = (Low + High) / 2;
+        const i32 Order = strncmp(Cache->Entries[Middle].Path, Path, MODEL_CACHE_PATH_SIZE);
+
+        if (Order == 0)
+        {
+            return &Cache->Entries[Middle];
+        }
+
+        if (Order < 0)
+        {
+            Low = Middle + 1;
+        }
+        else
+        {
+            High = Middle;
+        }
+    }
+
+    return NULL;
+}
+
+// True when the GLB's size or modification time is not the one it was cooked with. It may still
+// have the same content, compare HashModelSource with the entry to know
+internal bool
+HasModelSourceChanged(const ModelCacheEntry *Entry, const char *Path)
+{
+    u64 Size = 0;
+    i64 Time = 0;
+
+    return !GetModelSourceStamp(Path, &Size, &Time) || Size != Entry->SourceSize || Time != Entry->SourceTime;
+}
+
+internal bool
+IsModelCacheRangeValid(const ModelCache *Cache, u64 Offset, u64 Bytes)
+{
+    return Offset <= Cache->File.Size && Bytes <= Cache->File.Size - Offset;
+}
+
+// Fills Result with meshes pointing into the cache, nothing is copied. Only valid while the cache is open
+internal bool
+MapCachedModel(const ModelCache *Cache, const ModelCacheEntry *Entry, GlbModel *Result)
+{
+    *Result = GlbModel();
+    Result->Mapped = true;
+
+    if (!IsModelCacheRangeValid(Cache, Entry->Offset, sizeof(ModelCacheModel)))
+    {
+        return false;
+    }
+
+    const ModelCacheModel *Model = (const ModelCacheModel *)(Cache->File.Data + Entry->Offset);
+    const u64 MeshesOffset = Entry->Offset + sizeof(ModelCacheModel);
+    const u64 MaterialsOffset = MeshesOffset + (u64)Model->MeshCount * sizeof(ModelCacheMesh);
+
+    if (!IsModelCacheRangeValid(Cache, MeshesOffset, (u64)Model->MeshCount * sizeof(ModelCacheMesh) + (u64)Model->MaterialCount * sizeof(ModelCacheMaterial)))
+    {
+        return false;
+    }
+
+    const ModelCacheMesh *Meshes = (const ModelCacheMesh *)(Cache->File.Data + MeshesOffset);
+    const ModelCacheMaterial *Materials = (const ModelCacheMaterial *)(Cache->File.Data + MaterialsOffset);
+
+    for (u32 m = 0; m < Model->MaterialCount; ++m)
+    {
+        GlbMaterial Material = {};
+        Material.BaseColor = Materials[m].BaseColor;
+        Material.TexturePath = std::string(Materials[m].TexturePath, strnlen(Materials[m].TexturePath, sizeof(Materials[m].TexturePath)));
+        Result->Materials.push_back(Material);
+    }
+
+    for (u32 i = 0; i < Model->MeshCount; ++i)
+    {
+        const ModelCacheMesh *Cached = &Meshes[i];
+        const u64 Vertices = (u64)Cached->VertexCount;
+
+        const bool Valid = Cached->Vertices != 0 && IsModelCacheRangeValid(Cache, Cached->Vertices, Vertices * 3 * sizeof(f32)) &&
+                           IsModelCacheRangeValid(Cache, Cached->Normals, (Cached->Normals != 0) ? Vertices * 3 * sizeof(f32) : 0) &&
+                           IsModelCacheRangeValid(Cache, Cached->Tangents, (Cached->Tangents != 0) ? Vertices * 4 * sizeof(f32) : 0) &&
+                           IsModelCacheRangeValid(Cache, Cached->TexCoords, (Cached->TexCoords != 0) ? Vertices * 2 * sizeof(f32) : 0) &&
+                           IsModelCacheRangeValid(Cache, Cached->Indices, (u64)Cached->IndexCount * sizeof(u16));
+
+        if (!Valid)
+        {
+            *Result = GlbModel();
+            return false;
+        }
+
+        // raylib's meshes are not const, they are only ever read from
+        Mesh MeshData = {0};
+        MeshData.vertexCount = (i32)Cached->VertexCount;
+        MeshData.triangleCount = (i32)Cached->TriangleCount;
+        MeshData.vertices = (f32 *)(Cache->File.Data + Cached->Vertices);
+        MeshData.normals = (Cached->Normals != 0) ? (f32 *)(Cache->File.Data + Cached->Normals) : NULL;
+        MeshData.tangents = (Cached->Tangents != 0) ? (f32 *)(Cache->File.Data + Cached->Tangents) : NULL;
+        MeshData.texcoords = (Cached->TexCoords != 0) ? (f32 *)(Cache->File.Data + Cached->TexCoords) : NULL;
+        MeshData.indices = (Cached->Indices != 0) ? (u16 *)(Cache->File.Data + Cached->Indices) : NULL;
+
+        Result->Meshes.push_back(MeshData);
+        Result->MeshMaterial.push_back((Cached->Material < Model->MaterialCount) ? Cached->Material : GLB_NONE);
+    }
+
+    return !Result->Meshes.empty();
+}
+
+// Appends Size bytes on an Alignment boundary, returns where they went. Zeros when Data is NULL,
+// for what is filled in later
+internal u64
+AppendModelCacheBytes(std::vector<u8> *File, const void *Data, usize Size, u64 Alignment)
+{
+    const u64 Offset = (File->size() + Alignment - 1) & ~(Alignment - 1);
+
+    File->resize(Offset + Size);
+    if (Data != NULL && Size > 0)
+    {
+        memcpy(File->data() + Offset, Data, Size);
+    }
+
+    return Offset;
+}
+
+internal void
+AppendCachedModel(std::vector<u8> *File, const GlbModel *Model, ModelCacheEntry *Entry)
+{
+    ModelCacheModel Header = {};
+    Header.MeshCount = (u32)Model->Meshes.size();
+    Header.MaterialCount = (u32)Model->Materials.size();
+    Header.BoundsMin = (Vector3){FLT_MAX, FLT_MAX, FLT_MAX};
+    Header.BoundsMax = (Vector3){-FLT_MAX, -FLT_MAX, -FLT_MAX};
+
+    // The header, the meshes and the materials are written together so they can be read together
+    Entry->Offset = AppendModelCacheBytes(File, &Header, sizeof(Header), MODEL_CACHE_ALIGNMENT);
+    const u64 MeshesOffset = AppendModelCacheBytes(File, NULL, Header.MeshCount * sizeof(ModelCacheMesh), 1);
+
+    for (const GlbMaterial &Source : Model->Materials)
+    {
+        ModelCacheMaterial Material = {};
+        Material.BaseColor = Source.BaseColor;
+        strncpy(Material.TexturePath, Source.TexturePath.c_str(), sizeof(Material.TexturePath) - 1);
+
+        AppendModelCacheBytes(File, &Material, sizeof(Material), 1);
+    }
+
+    for (u32 i = 0; i < Header.MeshCount; ++i)
+    {
+        const Mesh *Source = &Model->Meshes[i];
+        const usize Vertices = (usize)Source->vertexCount;
+
+        ModelCacheMesh Cached = {};
+        Cached.VertexCount = (u32)Source->vertexCount;
+        Cached.TriangleCount = (u32)Source->triangleCount;
+        Cached.IndexCount = (Source->indices != NULL) ? (u32)Source->triangleCount * 3 : 0;
+        Cached.Material = Model->MeshMaterial[i];
+        Cached.Vertices = AppendModelCacheBytes(File, Source->vertices, Vertices * 3 * sizeof(f32), MODEL_CACHE_ALIGNMENT);
+        Cached.Normals = (Source->normals != NULL) ? AppendModelCacheBytes(File, Source->normals, Vertices * 3 * sizeof(f32), MODEL_CACHE_ALIGNMENT) : 0;
+        Cached.Tangents = (Source->tangents != NULL) ? AppendModelCacheBytes(File, Source->tangents, Vertices * 4 * sizeof(f32), MODEL_CACHE_ALIGNMENT) : 0;
+        Cached.TexCoords = (Source->texcoords != NULL) ? AppendModelCacheBytes(File, Source->texcoords, Vertices * 2 * sizeof(f32), MODEL_CACHE_ALIGNMENT) : 0;
+        Cached.Indices = (Source->indices != NULL) ? AppendModelCacheBytes(File, Source->indices, Cached.IndexCount * sizeof(u16), MODEL_CACHE_ALIGNMENT) : 0;
+
+        memcpy(File->data() + MeshesOffset + i * sizeof(ModelCacheMesh), &Cached, sizeof(Cached));
+
+        for (usize v = 0; v < Vertices; ++v)
+        {
+            const Vector3 Position = {Source->vertices[v * 3 + 0], Source->vertices[v * 3 + 1], Source->vertices[v * 3 + 2]};
+            Header.BoundsMin = Vector3Min(Header.BoundsMin, Position);
+            Header.BoundsMax = Vector3Max(Header.BoundsMax, Position);
+        }
+    }
+
+    memcpy(File->data() + Entry->Offset, &Header, sizeof(Header));
+}
+
+// Decodes every .glb below SourceDirectory and writes them to CachePath. The file is written
+// next to it first and then renamed over it, a running game keeps its mapping of the old one
+internal bool
+CookModelCache(const char *CachePath, const char *SourceDirectory)
+{
+    FilePathList Files = LoadDirectoryFilesEx(SourceDirectory, ".glb", true);
+
+    std::vector<std::string> Paths;
+    for (u32 f = 0; f < Files.count; ++f)
+    {
+        if (strlen(Files.paths[f]) < MODEL_CACHE_PATH_SIZE)
+        {
+            Paths.push_back(Files.paths[f]);
+        }
+    }
+    UnloadDirectoryFiles(Files);
+
+    // Sorted, so the entries can be binary searched
+    std::sort(Paths.begin(), Paths.end(), [](const std::string &A, const std::string &B)
+              { return strcmp(A.c_str(), B.c_str()) < 0; });
+
+    std::vector<u8> File;
+    std::vector<ModelCacheEntry> Entries;
+    AppendModelCacheBytes(&File, NULL, sizeof(ModelCacheHeader), 1);
+
+    for (const std::string &Path : Paths)
+    {
+        std::vector<u8> Bytes;
+        GlbModel Model;
+        ModelCacheEntry Entry = {};
+
+        const std::string Directory = Path.substr(0, Path.find_last_of('/'));
+
+        if (!GetModelSourceStamp(Path.c_str(), &Entry.SourceSize, &Entry.SourceTime) || !ReadAssetFile(Path.c_str(), &Bytes) ||
+            !DecodeGlbModel(Bytes.data(), Bytes.size(), Directory.c_str(), &Model))
+        {
+            printf("\tERROR: Could not cook %s\n", Path.c_str());
+            continue;
+        }
+
+        strncpy(Entry.Path, Path.c_str(), sizeof(Entry.Path) - 1);
+        Entry.ContentHash = HashModelSource(Bytes.data(), Bytes.size());
+
+        AppendCachedModel(&File, &Model, &Entry);
+        Entries.push_back(Entry);
+
+        FreeGlbModel(&Model);
+    }
+
+    ModelCacheHeader Header = {};
+    Header.Magic = MODEL_CACHE_MAGIC;
+    Header.Version = MODEL_CACHE_VERSION;
+    Header.EntryCount = (u32)Entries.size();
+    Header.EntriesOffset = AppendModelCacheBytes(&File, Entries.data(), Entries.size() * sizeof(ModelCacheEntry), MODEL_CACHE_ALIGNMENT);
+    Header.FileSize = File.size();
+    memcpy(File.data(), &Header, sizeof(Header));
+
+    const std::string TempPath = std::string(CachePath) + ".tmp";
+
+    FILE *Out = fopen(TempPath.c_str(), "wb");
+    if (Out == NULL)
+    {
+        printf("\tERROR: Could not open %s for writing\n", TempPath.c_str());
+        return false;
+    }
+
+    const bool Written = fwrite(File.data(), 1, File.size(), Out) == File.size();
+    fclose(Out);
+
+    // rename does not replace an existing file everywhere
+    if (!Written || (rename(TempPath.c_str(), CachePath) != 0 && (remove(CachePath) != 0 || rename(TempPath.c_str(), CachePath) != 0)))
+    {
+        remove(TempPath.c_str());
+        printf("\tERROR: Could not write the model cache %s\n", CachePath);
+        return false;
+    }
+
+    printf("\tCooked %zu models into %s (%.1f MB)\n", Entries.size(), CachePath, (f64)File.size() / (f64)Megabytes(1));
+
+    return true;
+}
@@ -0,0 +1,764 @@
+// GLB models ------------------------------------------------
+// Decodes binary glTF (.glb) files into raylib meshes without touching the GPU, so it can run on
+// the asset loader threads (see asset_loader.cpp). It covers what the Kenney kits use:
+//  - the one binary buffer embedded in the file
+//  - float positions, normals, tangents and texture coordinates, 8, 16 or 32 bit indices
+//  - node translations, rotations, scales and matrices, baked into the vertices like raylib does
+//  - a base color and a base color texture per material, the texture referenced by file name
+// Every triangle primitive becomes one mesh. The vertex arrays are allocated with MemAlloc, so
+// UnloadModel frees them like the ones LoadModel makes.
+//
+// The JSON chunk is parsed into a flat array of tokens in document order. A token knows where
+// its value ends, so skipping a member or an array item is a jump and nothing is copied.
+const u32 GLB_MAGIC = 0x46546C67;      // "glTF"
+const u32 GLB_CHUNK_JSON = 0x4E4F534A; // "JSON"
+const u32 GLB_CHUNK_BIN = 0x004E4942;  // "BIN\0"
+const u32 GLB_NONE = 0xFFFFFFFF;
+const u32 GLB_MAX_DEPTH = 64; // Deepest JSON nesting and node hierarchy accepted
+
+const u32 GLB_FLOAT = 5126; // glTF component types
+const u32 GLB_UNSIGNED_BYTE = 5121;
+const u32 GLB_UNSIGNED_SHORT = 5123;
+const u32 GLB_UNSIGNED_INT = 5125;
+
+enum GlbJsonType : u8
+{
+    GLB_JSON_OBJECT,
+    GLB_JSON_ARRAY,
+    GLB_JSON_STRING,
+    GLB_JSON_NUMBER,
+    GLB_JSON_LITERAL, // true, false and null
+};
+
+struct GlbJsonToken
+{
+    GlbJsonType Type;
+    u32 Begin;  // Offset of the value in the text, strings without their quotes
+    u32 Length;
+    u32 End;    // Index of the first token after the value and everything in it
+    f64 Number;
+};
+
+struct GlbJson
+{
+    const char *Text;
+    u32 Length;
+    std::vector<GlbJsonToken> Tokens; // Object members are a string token followed by the value
+};
+
+struct GlbMaterial
+{
+    Color BaseColor;
+    std::string TexturePath; // Empty when the material has no base color texture
+};
+
+// CPU side of a model, ready to be uploaded
+struct GlbModel
+{
+    std::vector<Mesh> Meshes;
+    std::vector<u32> MeshMaterial; // Index into Materials, GLB_NONE for the default material
+    std::vector<GlbMaterial> Materials;
+    bool Mapped; // The mesh arrays point into the model cache (see model_cache.cpp), they are not freed
+};
+
+struct GlbAccessor
+{
+    const u8 *Data; // First element
+    u32 Count;
+    u32 Components; // 1 for SCALAR up to 16 for MAT4
+    u32 ComponentType;
+    u32 Stride; // Bytes from one element to the next
+};
+
+struct GlbFile
+{
+    GlbJson Json;
+    const u8 *Bin;
+    usize BinSize;
+    const char *Directory;
+    GlbModel *Result;
+};
+
+// Reads a whole file, on any thread. Shared by the asset code (see asset_loader.cpp)
+internal bool
+ReadAssetFile(const char *Path, std::vector<u8> *Bytes)
+{
+    FILE *File = fopen(Path, "rb");
+    if (File == NULL)
+    {
+        return false;
+    }
+
+    fseek(File, 0, SEEK_END);
+    const long Size = ftell(File);
+    fseek(File, 0, SEEK_SET);
+
+    Bytes->resize((Size > 0) ? (usize)Size : 0);
+    const bool Read = Size > 0 && fread(Bytes->data(), 1, Bytes->size(), File) == Bytes->size();
+    fclose(File);
+
+    return Read;
+}
+
+internal void
+SkipGlbJsonSpace(const GlbJson *Json, u32 *At)
+{
+    while (*At < Json->Length && (Json->Text[*At] == ' ' || Json->Text[*At] == '\t' || Json->Text[*At] == '\n' || Json->Text[*At] == '\r'))
+    {
+        (*At)++;
+    }
+}
+
+// Appends the value at *At and everything in it, false on malformed JSON
+internal bool
+ParseGlbJsonValue(GlbJson *Json, u32 *At, u32 Depth)
+{
+    SkipGlbJsonSpace(Json, At);
+
+    if (*At >= Json->Length || Depth > GLB_MAX_DEPTH)
+    {
+        return false;
+    }
+
+    const u32 Index = (u32)Json->Tokens.size();
+    Json->Tokens.push_back({});
+
+    GlbJsonToken Token = {};
+    Token.Begin = *At;
+
+    const char First = Json->Text[*At];
+
+    if (First == '{' || First == '[')
+    {
+        const bool IsObject = (First == '{');
+        const char Close = IsObject ? '}' : ']';
+        Token.Type = IsObject ? GLB_JSON_OBJECT : GLB_JSON_ARRAY;
+
+        (*At)++;
+        SkipGlbJsonSpace(Json, At);
+
+        if (*At < Json->Length && Json->Text[*At] == Close)
+        {
+            (*At)++;
+        }
+        else
+        {
+            for (;;)
+            {
+                if (IsObject)
+                {
+                    SkipGlbJsonSpace(Json, At);
+                    if (*At >= Json->Length || Json->Text[*At] != '"' || !ParseGlbJsonValue(Json, At, Depth + 1))
+                    {
+                        return false;
+                    }
+
+                    SkipGlbJsonSpace(Json, At);
+                    if (*At >= Json->Length || Json->Text[*At] != ':')
+                    {
+                        return false;
+                    }
+                    (*At)++;
+                }
+
+                if (!ParseGlbJsonValue(Json, At, Depth + 1))
+                {
+                    return false;
+                }
+
+                SkipGlbJsonSpace(Json, At);
+                if (*At >= Json->Length)
+                {
+                    return false;
+                }
+
+                const char Next = Json->Text[(*At)++];
+                if (Next == Close)
+                {
+                    break;
+                }
+                if (Next != ',')
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    else if (First == '"')
+    {
+        Token.Type = GLB_JSON_STRING;
+        Token.Begin = ++(*At);
+
+        while (*At < Json->Length && Json->Text[*At] != '"')
+        {
+            *At += (Json->Text[*At] == '\\') ? 2 : 1; // Escapes are kept as they are
+        }
+
+        if (*At >= Json->Length)
+        {
+            return false;
+        }
+
+        Token.Length = *At - Token.Begin;
+        (*At)++;
+    }
+    else if (First == '-' || (First >= '0' && First <= '9'))
+    {
+        Token.Type = GLB_JSON_NUMBER;
+
+        // The chunk is not zero terminated, copy the number out before converting it
+        char Digits[64];
+        u32 Count = 0;
+        while (*At < Json->Length && Count < sizeof(Digits) - 1 && strchr("+-.eE0123456789", Json->Text[*At]) != NULL)
+        {
+            Digits[Count++] = Json->Text[(*At)++];
+        }
+        Digits[Count] = 0;
+
+        Token.Number = strtod(Digits, NULL);
+    }
+    else
+    {
+        Token.Type = GLB_JSON_LITERAL;
+
+        while (*At < Json->Length && Json->Text[*At] >= 'a' && Json->Text[*At] <= 'z')
+        {
+            (*At)++;
+        }
+
+        if (*At == Token.Begin)
+        {
+            return false;
+        }
+
+        Token.Number = (Json->Text[Token.Begin] == 't') ? 1.0 : 0.0;
+    }
+
+    if (Token.Type != GLB_JSON_STRING)
+    {
+        Token.Length = *At - Token.Begin;
+    }
+    Token.End = (u32)Json->Tokens.size();
+    Json->Tokens[Index] = Token;
+
+    return true;
+}
+
+internal bool
+ParseGlbJson(GlbJson *Json, const char *Text, u32 Length)
+{
+    Json->Text = Text;
+    Json->Length = Length;
+    Json->Tokens.clear();
+
+    u32 At = 0;
+
+    return ParseGlbJsonValue(Json, &At, 0) && Json->Tokens[0].Type == GLB_JSON_OBJECT;
+}
+
+internal bool
+IsGlbJsonString(const GlbJson *Json, u32 Token, const char *String)
+{
+    const GlbJsonToken *Value = &Json->Tokens[Token];
+
+    return Value->Type == GLB_JSON_STRING && strlen(String) == Value->Length && memcmp(Json->Text + Value->Begin, String, Value->Length) == 0;
+}
+
+// Token of the member's value, GLB_NONE when Object is not an object or has no such member
+internal u32
+FindGlbJsonMember(const GlbJson *Json, u32 Object, const char *Key)
+{
+    if (Object == GLB_NONE || Json->Tokens[Object].Type != GLB_JSON_OBJECT)
+    {
+        return GLB_NONE;
+    }
+
+    for (u32 t = Object + 1; t < Json->Tokens[Object].End; t = Json->Tokens[t + 1].End)
+    {
+        if (IsGlbJsonString(Json, t, Key))
+        {
+            return t + 1;
+        }
+    }
+
+    return GLB_NONE;
+}
+
+internal u32
+GetGlbJsonCount(const GlbJson *Json, u32 Array)
+{
+    if (Array == GLB_NONE || Json->Tokens[Array].Type != GLB_JSON_ARRAY)
+    {
+        return 0;
+    }
+
+    u32 Count = 0;
+    for (u32 t = Array + 1; t < Json->Tokens[Array].End; t = Json->Tokens[t].End)
+    {
+        Count++;
+    }
+
+    return Count;
+}
+
+// Token of item Index, GLB_NONE when Array is not an array or is too short
+internal u32
+GetGlbJsonItem(const GlbJson *Json, u32 Array, u32 Index)
+{
+    if (Array == GLB_NONE || Json->Tokens[Array].Type != GLB_JSON_ARRAY)
+    {
+        return GLB_NONE;
+    }
+
+    for (u32 t = Array + 1; t < Json->Tokens[Array].End; t = Json->Tokens[t].End)
+    {
+        if (Index-- == 0)
+        {
+            return t;
+        }
+    }
+
+    return GLB_NONE;
+}
+
+internal f64
+GetGlbJsonNumber(const GlbJson *Json, u32 Object, const char *Key, f64 Default)
+{
+    const u32 Value = FindGlbJsonMember(Json, Object, Key);
+
+    return (Value != GLB_NONE && Json->Tokens[Value].Type == GLB_JSON_NUMBER) ? Json->Tokens[Value].Number : Default;
+}
+
+internal u32
+GetGlbJsonIndex(const GlbJson *Json, u32 Object, const char *Key)
+{
+    const f64 Number = GetGlbJsonNumber(Json, Object, Key, -1.0);
+
+    return (Number >= 0.0) ? (u32)Number : GLB_NONE;
+}
+
+// Reads up to Count numbers of an array member into Out, the rest keeps what it had
+internal void
+GetGlbJsonNumbers(const GlbJson *Json, u32 Object, const char *Key, f32 *Out, u32 Count)
+{
+    const u32 Array = FindGlbJsonMember(Json, Object, Key);
+
+    for (u32 i = 0; i < Count; ++i)
+    {
+        const u32 Item = GetGlbJsonItem(Json, Array, i);
+
+        if (Item == GLB_NONE || Json->Tokens[Item].Type != GLB_JSON_NUMBER)
+        {
+            break;
+        }
+
+        Out[i] = (f32)Json->Tokens[Item].Number;
+    }
+}
+
+internal u32
+GetGlbComponentCount(const GlbJson *Json, u32 Type)
+{
+    const char *Names[] = {"SCALAR", "VEC2", "VEC3", "VEC4", "MAT2", "MAT3", "MAT4"};
+    const u32 Counts[] = {1, 2, 3, 4, 4, 9, 16};
+
+    for (u32 i = 0; i < ArrayCount(Names); ++i)
+    {
+        if (Type != GLB_NONE && IsGlbJsonString(Json, Type, Names[i]))
+        {
+            return Counts[i];
+        }
+    }
+
+    return 0;
+}
+
+internal u32
+GetGlbComponentSize(u32 ComponentType)
+{
+    switch (ComponentType)
+    {
+    case GLB_FLOAT:
+    case GLB_UNSIGNED_INT:
+        return 4;
+    case GLB_UNSIGNED_SHORT:
+        return 2;
+    case GLB_UNSIGNED_BYTE:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+// Resolves an accessor to its bytes in the binary chunk, false when it points outside of it
+internal bool
+GetGlbAccessor(const GlbFile *File, u32 Index, GlbAccessor *Result)
+{
+    const GlbJson *Json = &File->Json;
+    const u32 Accessor = GetGlbJsonItem(Json, FindGlbJsonMember(Json, 0, "accessors"), Index);
+    const u32 View = GetGlbJsonItem(Json, FindGlbJsonMember(Json, 0, "bufferViews"), GetGlbJsonIndex(Json, Accessor, "bufferView"));
+
+    if (Accessor == GLB_NONE || View == GLB_NONE || GetGlbJsonIndex(Json, View, "buffer") != 0)
+    {
+        return false; // Sparse accessors and external buffers are not supported
+    }
+
+    Result->Count = GetGlbJsonIndex(Json, Accessor, "count");
+    Result->Components = GetGlbComponentCount(Json, FindGlbJsonMember(Json, Accessor, "type"));
+    Result->ComponentType = GetGlbJsonIndex(Json, Accessor, "componentType");
+
+    const u32 ElementSize = Result->Components * GetGlbComponentSize(Result->ComponentType);
+    const u32 Stride = GetGlbJsonIndex(Json, View, "byteStride");
+    Result->Stride = (Stride != GLB_NONE) ? Stride : ElementSize;
+
+    const u64 ViewOffset = (u64)GetGlbJsonNumber(Json, View, "byteOffset", 0.0);
+    const u64 ViewLength = (u64)GetGlbJsonNumber(Json, View, "byteLength", 0.0);
+    const u64 Offset = (u64)GetGlbJsonNumber(Json, Accessor, "byteOffset", 0.0);
+
+    if (Result->Count == GLB_NONE || Result->Count == 0 || ElementSize == 0)
+    {
+        return false;
+    }
+
+    const u64 Needed = Offset + (u64)(Result->Count - 1) * Result->Stride + ElementSize;
+    if (ViewOffset + ViewLength > File->BinSize || Needed > ViewLength)
+    {
+        return false;
+    }
+
+    Result->Data = File->Bin + ViewOffset + Offset;
+
+    return true;
+}
+
+// Copies a float accessor of Components components into a new MemAlloc'd array, NULL when the
+// primitive does not have the attribute or it has another layout
+internal f32 *
+ReadGlbFloats(const GlbFile *File, u32 Index, u32 Components, u32 VertexCount)
+{
+    GlbAccessor Accessor;
+
+    if (Index == GLB_NONE || !GetGlbAccessor(File, Index, &Accessor) || Accessor.ComponentType != GLB_FLOAT ||
+        Accessor.Components != Components || Accessor.Count != VertexCount)
+    {
+        return NULL;
+    }
+
+    f32 *Result = (f32 *)MemAlloc(VertexCount * Components * sizeof(f32));
+
+    for (u32 v = 0; v < VertexCount; ++v)
+    {
+        memcpy(&Result[v * Components], Accessor.Data + (usize)v * Accessor.Stride, Components * sizeof(f32));
+    }
+
+    return Result;
+}
+
+internal void
+FreeGlbMeshArrays(Mesh *MeshData)
+{
+    MemFree(MeshData->vertices);
+    MemFree(MeshData->normals);
+    MemFree(MeshData->tangents);
+    MemFree(MeshData->texcoords);
+    MemFree(MeshData->indices);
+
+    *MeshData = {0};
+}
+
+// Frees the CPU arrays of a model that was never uploaded
+internal void
+FreeGlbModel(GlbModel *Model)
+{
+    for (Mesh &MeshData : Model->Meshes)
+    {
+        if (!Model->Mapped)
+        {
+            FreeGlbMeshArrays(&MeshData);
+        }
+    }
+
+    *Model = GlbModel();
+}
+
+internal bool
+DecodeGlbPrimitive(GlbFile *File, u32 Primitive, const Matrix *World)
+{
+    const GlbJson *Json = &File->Json;
+    const u32 Attributes = FindGlbJsonMember(Json, Primitive, "attributes");
+
+    if (GetGlbJsonNumber(Json, Primitive, "mode", 4.0) != 4.0)
+    {
+        return true; // Points and lines are skipped, raylib only draws triangles
+    }
+
+    GlbAccessor Positions;
+    if (!GetGlbAccessor(File, GetGlbJsonIndex(Json, Attributes, "POSITION"), &Positions))
+    {
+        return false;
+    }
+
+    Mesh Result = {0};
+    Result.vertexCount = (i32)Positions.Count;
+    Result.triangleCount = (i32)Positions.Count / 3;
+    Result.vertices = ReadGlbFloats(File, GetGlbJsonIndex(Json, Attributes, "POSITION"), 3, Positions.Count);
+    Result.normals = ReadGlbFloats(File, GetGlbJsonIndex(Json, Attributes, "NORMAL"), 3, Positions.Count);
+    Result.tangents = ReadGlbFloats(File, GetGlbJsonIndex(Json, Attributes, "TANGENT"), 4, Positions.Count);
+    Result.texcoords = ReadGlbFloats(File, GetGlbJsonIndex(Json, Attributes, "TEXCOORD_0"), 2, Positions.Count);
+
+    if (Result.vertices == NULL)
+    {
+        FreeGlbMeshArrays(&Result);
+        return false;
+    }
+
+    // Bake the node transform, normals go through the inverse transpose so scales keep them straight
+    const Matrix Direction = {World->m0, World->m4, World->m8, 0.0f, World->m1, World->m5, World->m9, 0.0f, World->m2, World->m6, World->m10, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+    const Matrix NormalMatrix = MatrixTranspose(MatrixInvert(Direction));
+
+    for (i32 v = 0; v < Result.vertexCount; ++v)
+    {
+        Vector3 *Position = (Vector3 *)&Result.vertices[v * 3];
+        *Position = Vector3Transform(*Position, *World);
+
+        if (Result.normals != NULL)
+        {
+            Vector3 *Normal = (Vector3 *)&Result.normals[v * 3];
+            *Normal = Vector3Normalize(Vector3Transform(*Normal, NormalMatrix));
+        }
+
+        if (Result.tangents != NULL)
+        {
+            Vector3 *Tangent = (Vector3 *)&Result.tangents[v * 4];
+            *Tangent = Vector3Normalize(Vector3Transform(*Tangent, Direction));
+        }
+    }
+
+    const u32 IndicesIndex = GetGlbJsonIndex(Json, Primitive, "indices");
+
+    if (IndicesIndex != GLB_NONE)
+    {
+        GlbAccessor Indices;
+
+        // raylib meshes use 16-bit indices
+        if (!GetGlbAccessor(File, IndicesIndex, &Indices) || Indices.Components != 1 || Positions.Count > 0x10000)
+        {
+            FreeGlbMeshArrays(&Result);
+            return false;
+        }
+
+        Result.triangleCount = (i32)Indices.Count / 3;
+        Result.indices = (u16 *)MemAlloc(Indices.Count * sizeof(u16));
+
+        for (u32 i = 0; i < Indices.Count; ++i)
+        {
+            const u8 *Item = Indices.Data + (usize)i * Indices.Stride;
+            u32 Value = 0;
+
+            switch (Indices.ComponentType)
+            {
+            case GLB_UNSIGNED_BYTE:
+                Value = *Item;
+                break;
+            case GLB_UNSIGNED_SHORT:
+                Value = *(const u16 *)Item;
+                break;
+            case GLB_UNSIGNED_INT:
+                Value = *(const u32 *)Item;
+                break;
+            default:
+                Value = Positions.Count;
+                break;
+            }
+
+            if (Value >= Positions.Count)
+            {
+                FreeGlbMeshArrays(&Result);
+                return false;
+            }
+
+            Result.indices[i] = (u16)Value;
+        }
+    }
+
+    File->Result->Meshes.push_back(Result);
+    File->Result->MeshMaterial.push_back(GetGlbJsonIndex(Json, Primitive, "material"));
+
+    return true;
+}
+
+// Visits a node and its children, World is the transform of the parent
+internal bool
+DecodeGlbNode(GlbFile *File, u32 NodeIndex, Matrix Parent, u32 Depth)
+{
+    const GlbJson *Json = &File->Json;
+    const u32 Node = GetGlbJsonItem(Json, FindGlbJsonMember(Json, 0, "nodes"), NodeIndex);
+
+    if (Node == GLB_NONE || Depth > GLB_MAX_DEPTH)
+    {
+        return false;
+    }
+
+    Matrix Local = MatrixIdentity();
+
+    if (FindGlbJsonMember(Json, Node, "matrix") != GLB_NONE)
+    {
+        // Column major like raylib's Matrix, m0 m1 m2 m3 is the first column
+        f32 Elements[16] = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+        GetGlbJsonNumbers(Json, Node, "matrix", Elements, 16);
+        Local = {Elements[0], Elements[4], Elements[8], Elements[12],
+                 Elements[1], Elements[5], Elements[9], Elements[13],
+                 Elements[2], Elements[6], Elements[10], Elements[14],
+                 Elements[3], Elements[7], Elements[11], Elements[15]};
+    }
+    else
+    {
+        f32 Translation[3] = {0.0f, 0.0f, 0.0f};
+        f32 Rotation[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+        f32 Scale[3] = {1.0f, 1.0f, 1.0f};
+        GetGlbJsonNumbers(Json, Node, "translation", Translation, 3);
+        GetGlbJsonNumbers(Json, Node, "rotation", Rotation, 4);
+        GetGlbJsonNumbers(Json, Node, "scale", Scale, 3);
+
+        // Scale, then rotate, then translate
+        const Matrix RotationMatrix = QuaternionToMatrix((Quaternion){Rotation[0], Rotation[1], Rotation[2], Rotation[3]});
+        Local = MatrixMultiply(MatrixMultiply(MatrixScale(Scale[0], Scale[1], Scale[2]), RotationMatrix),
+                               MatrixTranslate(Translation[0], Translation[1], Translation[2]));
+    }
+
+    const Matrix World = MatrixMultiply(Local, Parent);
+
+    const u32 MeshIndex = GetGlbJsonIndex(Json, Node, "mesh");
+    if (MeshIndex != GLB_NONE)
+    {
+        const u32 MeshObject = GetGlbJsonItem(Json, FindGlbJsonMember(Json, 0, "meshes"), MeshIndex);
+        const u32 Primitives = FindGlbJsonMember(Json, MeshObject, "primitives");
+
+        if (MeshObject == GLB_NONE)
+        {
+            return false;
+        }
+
+        for (u32 p = 0; p < GetGlbJsonCount(Json, Primitives); ++p)
+        {
+            if (!DecodeGlbPrimitive(File, GetGlbJsonItem(Json, Primitives, p), &World))
+            {
+                return false;
+            }
+        }
+    }
+
+    const u32 Children = FindGlbJsonMember(Json, Node, "children");
+    for (u32 c = 0; c < GetGlbJsonCount(Json, Children); ++c)
+    {
+        const u32 Child = GetGlbJsonItem(Json, Children, c);
+
+        if (Json->Tokens[Child].Type != GLB_JSON_NUMBER || !DecodeGlbNode(File, (u32)Json->Tokens[Child].Number, World, Depth + 1))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+internal void
+DecodeGlbMaterials(GlbFile *File)
+{
+    const GlbJson *Json = &File->Json;
+    const u32 Materials = FindGlbJsonMember(Json, 0, "materials");
+
+    for (u32 m = 0; m < GetGlbJsonCount(Json, Materials); ++m)
+    {
+        const u32 Pbr = FindGlbJsonMember(Json, GetGlbJsonItem(Json, Materials, m), "pbrMetallicRoughness");
+
+        f32 Factor[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+        GetGlbJsonNumbers(Json, Pbr, "baseColorFactor", Factor, 4);
+
+        GlbMaterial Material = {};
+        Material.BaseColor = (Color){(u8)(Clamp(Factor[0], 0.0f, 1.0f) * 255.0f), (u8)(Clamp(Factor[1], 0.0f, 1.0f) * 255.0f),
+                                     (u8)(Clamp(Factor[2], 0.0f, 1.0f) * 255.0f), (u8)(Clamp(Factor[3], 0.0f, 1.0f) * 255.0f)};
+
+        const u32 TextureIndex = GetGlbJsonIndex(Json, FindGlbJsonMember(Json, Pbr, "baseColorTexture"), "index");
+        const u32 Texture = GetGlbJsonItem(Json, FindGlbJsonMember(Json, 0, "textures"), TextureIndex);
+        const u32 Image = GetGlbJsonItem(Json, FindGlbJsonMember(Json, 0, "images"), GetGlbJsonIndex(Json, Texture, "source"));
+        const u32 Uri = FindGlbJsonMember(Json, Image, "uri");
+
+        if (Uri != GLB_NONE && Json->Tokens[Uri].Type == GLB_JSON_STRING)
+        {
+            Material.TexturePath = std::string(File->Directory) + "/" + std::string(Json->Text + Json->Tokens[Uri].Begin, Json->Tokens[Uri].Length);
+        }
+        else if (Image != GLB_NONE)
+        {
+            TraceLog(LOG_WARNING, "GLB: images embedded in the buffer are not supported, using the base color");
+        }
+
+        File->Result->Materials.push_back(Material);
+    }
+}
+
+// Decodes a whole .glb file held in memory. Directory is where texture file names are relative to
+internal bool
+DecodeGlbModel(const u8 *Data, usize Size, const char *Directory, GlbModel *Result)
+{
+    *Result = GlbModel();
+
+    u32 Header[5];
+    if (Size < sizeof(Header))
+    {
+        return false;
+    }
+    memcpy(Header, Data, sizeof(Header));
+
+    // Magic, version, length, then the JSON chunk's length and type
+    if (Header[0] != GLB_MAGIC || Header[1] != 2 || Header[2] > Size || Header[4] != GLB_CHUNK_JSON || (u64)Header[3] + 20 > Header[2])
+    {
+        return false;
+    }
+
+    GlbFile File = {};
+    File.Directory = Directory;
+    File.Result = Result;
+
+    const usize BinChunk = 20 + (((usize)Header[3] + 3) & ~(usize)3);
+    if (BinChunk + 8 <= Header[2])
+    {
+        u32 Chunk[2];
+        memcpy(Chunk, Data + BinChunk, sizeof(Chunk));
+
+        if (Chunk[1] == GLB_CHUNK_BIN && BinChunk + 8 + Chunk[0] <= Header[2])
+        {
+            File.Bin = Data + BinChunk + 8;
+            File.BinSize = Chunk[0];
+        }
+    }
+
+    if (!ParseGlbJson(&File.Json, (const char *)Data + 20, Header[3]))
+    {
+        return false;
+    }
+
+    DecodeGlbMaterials(&File);
+
+    const u32 SceneIndex = GetGlbJsonIndex(&File.Json, 0, "scene");
+    const u32 Scene = GetGlbJsonItem(&File.Json, FindGlbJsonMember(&File.Json, 0, "scenes"), (SceneIndex != GLB_NONE) ? SceneIndex : 0);
+    const u32 Roots = FindGlbJsonMember(&File.Json, Scene, "nodes");
+
+    for (u32 r = 0; r < GetGlbJsonCount(&File.Json, Roots); ++r)
+    {
+        const GlbJsonToken *Root = &File.Json.Tokens[GetGlbJsonItem(&File.Json, Roots, r)];
+
+        if (Root->Type != GLB_JSON_NUMBER || !DecodeGlbNode(&File, (u32)Root->Number, MatrixIdentity(), 0))
+        {
+            FreeGlbModel(Result);
+            return false;
+        }
+    }
+
+    for (u32 &Material : Result->MeshMaterial)
+    {
+        Material = (Material < Result->Materials.size()) ? Material : GLB_NONE;
+    }
+
+    return !Result->Meshes.empty();
+}
@@ -0,0 +1,417 @@
+// Picking ---------------------------------------------------
+// Finds the tile under a ray without touching the other tiles. The ray is clipped to the slab
+// the tile tops live in (map rectangle, SurfaceMinY..SurfaceMaxY) and the part that is left is
+// walked front to back until the ray goes under a tile top.
+// On a flat map the slab is a plane, so this is a ray-plane test and one cell.
+//
+// PickTile walks the min/max pyramid of the store (see ground_tiles.cpp): a block the ray stays
+// above over its whole length is skipped at once, otherwise the walk goes down a level, and after
+// every skip into a new block of the level above it goes back up one. Only the tiles next to
+// the hit are tested one by one, so a long grazing ray over hills costs about as much as a short
+// one. PickTileGrid is the plain DDA over every cell under the ray, PickTile hands it the rays
+// that only cross a few tiles and the benchmark checks the two against each other.
+//
+// Both walks do their border math the same way, so they agree to the bit: in tile units, the t
+// of a border is always computed fresh from the border's tile coordinate (GetTileBorderT), and
+// when the ray crosses an x and a z border at the same t the z border is crossed first.
+const f32 PICK_EPSILON = 0.001f;
+const f32 PICK_GRID_SPAN = 8.0f; // Tiles, rays that cross fewer in the slab have nothing to skip and walk the grid
+
+struct TilePick
+{
+    i64 Id; // -1 when no tile was hit
+    RayCollision Collision;
+};
+
+// Clips [*TEnter, *TExit] to the part of the ray where Lo <= Origin + Direction * t <= Hi
+internal bool
+ClipRayToSlab(f32 Origin, f32 Direction, f32 Lo, f32 Hi, f32 *TEnter, f32 *TExit)
+{
+    if (fabsf(Direction) < 1e-8f)
+    {
+        return (Origin >= Lo - PICK_EPSILON) && (Origin <= Hi + PICK_EPSILON);
+    }
+
+    f32 T0 = (Lo - Origin) / Direction;
+    f32 T1 = (Hi - Origin) / Direction;
+    if (T0 > T1)
+    {
+        const f32 Swap = T0;
+        T0 = T1;
+        T1 = Swap;
+    }
+
+    *TEnter = (T0 > *TEnter) ? T0 : *TEnter;
+    *TExit = (T1 < *TExit) ? T1 : *TExit;
+
+    return *TEnter <= *TExit + PICK_EPSILON;
+}
+
+// The part of a ray inside the slab of the tile tops
+struct TilePickSegment
+{
+    f32 TEnter;
+    f32 TExit;
+    f32 MapMinX; // Corner of the rectangle covered by the tiles in the store
+    f32 MapMinZ;
+    i64 I; // Tile where the ray enters the slab
+    i64 J;
+};
+
+// The ray in tile units, tile (I, J) covers [I, I + 1) x [J, J + 1)
+struct TileRay
+{
+    f32 TileX;
+    f32 TileZ;
+    f32 DirectionX;
+    f32 DirectionZ;
+    f32 InverseX; // 0 when the ray runs along the axis
+    f32 InverseZ;
+};
+
+internal TileRay
+MakeTileRay(const TilePickSegment *Segment, Ray ray, f32 TileSize)
+{
+    TileRay Result;
+    Result.TileX = (ray.position.x - Segment->MapMinX) / TileSize;
+    Result.TileZ = (ray.position.z - Segment->MapMinZ) / TileSize;
+    Result.DirectionX = ray.direction.x / TileSize;
+    Result.DirectionZ = ray.direction.z / TileSize;
+    Result.InverseX = (fabsf(ray.direction.x) > 1e-8f) ? 1.0f / Result.DirectionX : 0.0f;
+    Result.InverseZ = (fabsf(ray.direction.z) > 1e-8f) ? 1.0f / Result.DirectionZ : 0.0f;
+
+    return Result;
+}
+
+// t where the ray reaches tile coordinate Border, FLT_MAX when it never does
+internal f32
+GetTileBorderT(f32 Border, f32 Tile, f32 Inverse)
+{
+    return (Inverse != 0.0f) ? (Border - Tile) * Inverse : FLT_MAX;
+}
+
+// The tile along one axis the ray is in at TCross, when it crosses a border of the other axis
+// there, found between Lo and Hi - 1. Decided by the t of the borders like the grid walk steps:
+// a border at the same t as TCross is already behind when PastOnTie is set
+internal i64
+GetTileAtCrossing(f32 Tile, f32 Direction, f32 Inverse, i64 Step, f32 TCross, bool PastOnTie, i64 Lo, i64 Hi)
+{
+    i64 Result = (i64)floorf(Tile + Direction * TCross);
+    Result = (Result < Lo) ? Lo : ((Result >= Hi) ? Hi - 1 : Result);
+
+    if (Inverse == 0.0f)
+    {
+        return Result;
+    }
+
+    for (;;)
+    {
+        const f32 TExit = GetTileBorderT((f32)((Step > 0) ? Result + 1 : Result), Tile, Inverse);
+        const bool Past = PastOnTie ? (TExit <= TCross) : (TExit < TCross);
+
+        if (!Past || Result + Step < Lo || Result + Step >= Hi)
+        {
+            break;
+        }
+
+        Result += Step;
+    }
+
+    for (;;)
+    {
+        const f32 TEnter = GetTileBorderT((f32)((Step > 0) ? Result : Result + 1), Tile, Inverse);
+        const bool Before = PastOnTie ? (TEnter > TCross) : (TEnter >= TCross);
+
+        if (!Before || Result - Step < Lo || Result - Step >= Hi)
+        {
+            break;
+        }
+
+        Result -= Step;
+    }
+
+    return Result;
+}
+
+internal bool
+ClipRayToGround(const GroundTileStore *Tiles, Ray ray, TilePickSegment *Segment)
+{
+    const f32 Extent = Tiles->MapSize * Tiles->TileSize;
+    const f32 MapMinX = ((f32)Tiles->OriginI - Tiles->WorldSize / 2.0f) * Tiles->TileSize;
+    const f32 MapMinZ = ((f32)Tiles->OriginJ - Tiles->WorldSize / 2.0f) * Tiles->TileSize;
+
+    f32 TEnter = 0.0f;
+    f32 TExit = FLT_MAX;
+
+    if (!ClipRayToSlab(ray.position.x, ray.direction.x, MapMinX, MapMinX + Extent, &TEnter, &TExit) ||
+        !ClipRayToSlab(ray.position.z, ray.direction.z, MapMinZ, MapMinZ + Extent, &TEnter, &TExit) ||
+        !ClipRayToSlab(ray.position.y, ray.direction.y, Tiles->SurfaceMinY, Tiles->SurfaceMaxY, &TEnter, &TExit))
+    {
+        return false;
+    }
+
+    const Vector3 Start = Vector3Add(ray.position, Vector3Scale(ray.direction, TEnter));
+
+    i64 I = (i64)floorf((Start.x - MapMinX) / Tiles->TileSize);
+    i64 J = (i64)floorf((Start.z - MapMinZ) / Tiles->TileSize);
+    Segment->I = (I < 0) ? 0 : ((I >= Tiles->MapSize) ? Tiles->MapSize - 1 : I);
+    Segment->J = (J < 0) ? 0 : ((J >= Tiles->MapSize) ? Tiles->MapSize - 1 : J);
+
+    Segment->TEnter = TEnter;
+    Segment->TExit = TExit;
+    Segment->MapMinX = MapMinX;
+    Segment->MapMinZ = MapMinZ;
+
+    return true;
+}
+
+// Every cell under the segment, front to back
+internal TilePick
+WalkTileGrid(const GroundTileStore *Tiles, Ray ray, const TilePickSegment *Segment)
+{
+    TilePick Result = {0};
+    Result.Id = -1;
+    Result.Collision.distance = FLT_MAX;
+
+    const f32 TExit = Segment->TExit;
+    const TileRay Walk = MakeTileRay(Segment, ray, Tiles->TileSize);
+    i64 I = Segment->I;
+    i64 J = Segment->J;
+
+    const i64 StepI = (ray.direction.x > 0.0f) ? 1 : -1;
+    const i64 StepJ = (ray.direction.z > 0.0f) ? 1 : -1;
+
+    f32 T = Segment->TEnter;
+    Vector3 EnterNormal = {0.0f, 1.0f, 0.0f}; // Normal of the cell face the ray came in through
+
+    for (;;)
+    {
+        // The t of the cell borders the ray leaves through along x and z
+        const f32 TMaxX = GetTileBorderT((f32)((StepI > 0) ? I + 1 : I), Walk.TileX, Walk.InverseX);
+        const f32 TMaxZ = GetTileBorderT((f32)((StepJ > 0) ? J + 1 : J), Walk.TileZ, Walk.InverseZ);
+
+        const i64 Id = I * Tiles->MapSize + J;
+        const f32 Top = Tiles->MaxY[Id];
+        const f32 CellExit = fminf(fminf(TMaxX, TMaxZ), TExit);
+
+        f32 HitT = -1.0f;
+        Vector3 HitNormal = EnterNormal;
+
+        if (ray.position.y + ray.direction.y * T <= Top + PICK_EPSILON)
+        {
+            // Already under this tile top when entering the cell, so it was hit on the side
+            HitT = T;
+        }
+        else if (ray.direction.y < 0.0f)
+        {
+            const f32 TTop = (Top - ray.position.y) / ray.direction.y;
+            if (TTop <= CellExit + PICK_EPSILON)
+            {
+                HitT = TTop;
+                HitNormal = (Vector3){0.0f, 1.0f, 0.0f};
+            }
+        }
+
+        if (HitT >= 0.0f)
+        {
+            Result.Id = Id;
+            Result.Collision.hit = true;
+            Result.Collision.distance = HitT * Vector3Length(ray.direction);
+            Result.Collision.point = Vector3Add(ray.position, Vector3Scale(ray.direction, HitT));
+            Result.Collision.normal = HitNormal;
+            return Result;
+        }
+
+        if (CellExit >= TExit)
+        {
+            return Result;
+        }
+
+        // Step into the next cell along the axis whose border comes first
+        if (TMaxX < TMaxZ)
+        {
+            I += StepI;
+            T = TMaxX;
+            EnterNormal = (Vector3){(f32)-StepI, 0.0f, 0.0f};
+        }
+        else
+        {
+            J += StepJ;
+            T = TMaxZ;
+            EnterNormal = (Vector3){0.0f, 0.0f, (f32)-StepJ};
+        }
+
+        if (I < 0 || J < 0 || I >= Tiles->MapSize || J >= Tiles->MapSize)
+        {
+            return Result;
+        }
+    }
+}
+
+internal TilePick
+PickTileGrid(const GroundTileStore *Tiles, Ray ray)
+{
+    TilePickSegment Segment;
+    if (!ClipRayToGround(Tiles, ray, &Segment))
+    {
+        TilePick Result = {0};
+        Result.Id = -1;
+        Result.Collision.distance = FLT_MAX;
+        return Result;
+    }
+
+    return WalkTileGrid(Tiles, ray, &Segment);
+}
+
+internal TilePick
+PickTile(const GroundTileStore *Tiles, Ray ray)
+{
+    TilePick Result = {0};
+    Result.Id = -1;
+    Result.Collision.distance = FLT_MAX;
+
+    TilePickSegment Segment;
+    if (!ClipRayToGround(Tiles, ray, &Segment))
+    {
+        return Result;
+    }
+
+    // A steep ray from the game camera only crosses a few tiles in the slab, there is nothing
+    // to skip and the plain grid walk is cheaper
+    const f32 TileSize = Tiles->TileSize;
+    const f32 TEnter = Segment.TEnter;
+    const f32 TExit = Segment.TExit;
+    const f32 SpanTiles = (TExit - TEnter) * fmaxf(fabsf(ray.direction.x), fabsf(ray.direction.z)) / TileSize;
+
+    if (SpanTiles <= PICK_GRID_SPAN)
+    {
+        return WalkTileGrid(Tiles, ray, &Segment);
+    }
+
+    i64 I = Segment.I;
+    i64 J = Segment.J;
+
+    const i64 StepI = (ray.direction.x > 0.0f) ? 1 : -1;
+    const i64 StepJ = (ray.direction.z > 0.0f) ? 1 : -1;
+
+    // The walk happens in tile units, the same as the grid walk
+    const TileRay Walk = MakeTileRay(&Segment, ray, TileSize);
+
+    // A block is only skipped when the ray is clearly above it, the tile test has the final say
+    const f32 SkipEpsilon = PICK_EPSILON * (1.0f + fabsf(ray.direction.y));
+
+    // Start with blocks about as big as the stretch of the ray in the slab
+    const u32 TopLevel = Tiles->PyramidLevels - 1;
+    u32 Level = 0;
+
+    while (Level < TopLevel && (f32)(1ll << Level) < SpanTiles)
+    {
+        ++Level;
+    }
+
+    f32 T = TEnter;
+    Vector3 EnterNormal = {0.0f, 1.0f, 0.0f}; // Normal of the block face the ray came in through
+
+    for (;;)
+    {
+        // The block of this level the current tile is in, and where the ray leaves it
+        const i64 CellI = I >> Level;
+        const i64 CellJ = J >> Level;
+        const i64 BlockI0 = CellI << Level;
+        const i64 BlockJ0 = CellJ << Level;
+        const i64 BlockI1 = Min((CellI + 1) << Level, Tiles->MapSize);
+        const i64 BlockJ1 = Min((CellJ + 1) << Level, Tiles->MapSize);
+
+        const f32 TBorderX = GetTileBorderT((f32)((StepI > 0) ? BlockI1 : BlockI0), Walk.TileX, Walk.InverseX);
+        const f32 TBorderZ = GetTileBorderT((f32)((StepJ > 0) ? BlockJ1 : BlockJ0), Walk.TileZ, Walk.InverseZ);
+        const f32 BlockExit = fminf(fminf(TBorderX, TBorderZ), TExit);
+
+        const f32 Top = Tiles->PyramidMaxY[Level][CellI * Tiles->PyramidSize[Level] + CellJ];
+        const f32 EnterY = ray.position.y + ray.direction.y * T;
+
+        if (Level > 0)
+        {
+            // The ray is a line, its lowest point over the block is at one of the ends
+            const f32 ExitY = ray.position.y + ray.direction.y * BlockExit;
+
+            if (Min(EnterY, ExitY) <= Top + SkipEpsilon)
+            {
+                --Level;
+                continue;
+            }
+        }
+        else
+        {
+            f32 HitT = -1.0f;
+            Vector3 HitNormal = EnterNormal;
+
+            if (EnterY <= Top + PICK_EPSILON)
+            {
+                // Already under this tile top when entering the tile, so it was hit on the side
+                HitT = T;
+            }
+            else if (ray.direction.y < 0.0f)
+            {
+                const f32 TTop = (Top - ray.position.y) / ray.direction.y;
+                if (TTop <= BlockExit + PICK_EPSILON)
+                {
+                    HitT = TTop;
+                    HitNormal = (Vector3){0.0f, 1.0f, 0.0f};
+                }
+            }
+
+            if (HitT >= 0.0f)
+            {
+                Result.Id = I * Tiles->MapSize + J;
+                Result.Collision.hit = true;
+                Result.Collision.distance = HitT * Vector3Length(ray.direction);
+                Result.Collision.point = Vector3Add(ray.position, Vector3Scale(ray.direction, HitT));
+                Result.Collision.normal = HitNormal;
+                return Result;
+            }
+        }
+
+        if (BlockExit >= TExit)
+        {
+            return Result;
+        }
+
+        // Into the tile on the other side of the border the ray leaves through. The other
+        // coordinate is the tile the grid walk would be in when it crosses that border: a z
+        // border at the same t is crossed before an x border, never after
+        i64 Crossed;
+        i64 Step;
+
+        if (TBorderX < TBorderZ)
+        {
+            I = (StepI > 0) ? BlockI1 : BlockI0 - 1;
+            J = GetTileAtCrossing(Walk.TileZ, Walk.DirectionZ, Walk.InverseZ, StepJ, TBorderX, true, BlockJ0, BlockJ1);
+            Crossed = I;
+            Step = StepI;
+            T = TBorderX;
+            EnterNormal = (Vector3){(f32)-StepI, 0.0f, 0.0f};
+        }
+        else
+        {
+            I = GetTileAtCrossing(Walk.TileX, Walk.DirectionX, Walk.InverseX, StepI, TBorderZ, false, BlockI0, BlockI1);
+            J = (StepJ > 0) ? BlockJ1 : BlockJ0 - 1;
+            Crossed = J;
+            Step = StepJ;
+            T = TBorderZ;
+            EnterNormal = (Vector3){0.0f, 0.0f, (f32)-StepJ};
+        }
+
+        if (I < 0 || J < 0 || I >= Tiles->MapSize || J >= Tiles->MapSize)
+        {
+            return Result;
+        }
+
+        // Up a level when the ray just came into a new block of the level above, going up inside
+        // it would only come back down to the tiles that stopped the skip before
+        const i64 Parent = 2ll << Level;
+        if (Level < TopLevel && ((Step > 0) ? (Crossed % Parent == 0) : ((Crossed + 1) % Parent == 0)))
+        {
+            ++Level;
+        }
+    }
+}
@@ -0,0 +1,401 @@
+// Profiler --------------------------------------------------
+// Scoped CPU timing zones. ProfileZone("Name") times the rest of the enclosing scope, zones nest
+// and can be used on any thread. Every thread writes its zones to its own ring buffer, nothing is
+// shared or locked while recording:
+//  - ProfilerEndFrame folds the zones of the frame into per zone history, the overlay shows the
+//    rolling average and percentiles of the last PROFILER_FRAME_HISTORY frames
+//  - WriteProfilerTrace writes the last frames as Chrome trace event JSON, open it in
+//    chrome://tracing or https://ui.perfetto.dev
+// Build with -DPROFILER=0 and every macro below expands to nothing.
+#ifndef PROFILER
+#define PROFILER 1
+#endif
+
+#if PROFILER
+
+const u32 PROFILER_MAX_THREADS = 16;
+const u32 PROFILER_RING_SIZE = 16384; // Zones per thread, must be a power of two
+const u32 PROFILER_FRAME_HISTORY = 256;
+const u32 PROFILER_MAX_ZONES = 64; // Distinct zone names
+
+struct ProfileEvent
+{
+    const char *Name; // Zones are told apart by name
+    u64 Begin;        // Nanoseconds
+    u64 End;
+    u32 Depth; // Zones open on the thread when this one started
+};
+
+struct alignas(64) ProfileThread
+{
+    ProfileEvent *Events; // Ring of PROFILER_RING_SIZE
+
+    std::atomic<u64> Head; // Events ever written, only the owning thread writes
+    u64 ReadHead;          // Events folded into the history by ProfilerEndFrame
+    u32 Depth;
+};
+
+struct ProfileZoneStats
+{
+    const char *Name;
+    u32 Depth;
+    u32 Calls;      // In the last frame
+    u64 FirstBegin; // Of the zone in the last frame it ran, orders the overlay
+
+    f32 Ms[PROFILER_FRAME_HISTORY]; // Summed over all calls and threads, per frame
+};
+
+struct ProfilerState
+{
+    ProfileThread Threads[PROFILER_MAX_THREADS];
+    std::atomic<u32> ThreadCount;
+
+    u64 FrameIndex; // Frames begun
+    u64 FrameStarts[PROFILER_FRAME_HISTORY];
+
+    ProfileZoneStats Zones[PROFILER_MAX_ZONES];
+    u32 ZoneCount;
+
+    bool Initialized;
+};
+
+global_variable ProfilerState Profiler;
+
+// Slot of the calling thread, claimed on its first zone. -1 before that, -2 when all are taken
+thread_local i32 ProfilerSlot = -1;
+
+internal u64
+GetProfilerTime(void)
+{
+    return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+internal ProfileThread *
+GetProfileThread(void)
+{
+    if (ProfilerSlot == -1)
+    {
+        const u32 Slot = Profiler.ThreadCount.fetch_add(1, std::memory_order_relaxed);
+        ProfilerSlot = (Slot < PROFILER_MAX_THREADS) ? (i32)Slot : -2;
+    }
+
+    return (ProfilerSlot >= 0) ? &Profiler.Threads[ProfilerSlot] : NULL;
+}
+
+struct ProfileScope
+{
+    ProfileThread *Thread;
+    const char *Name;
+    u64 Begin;
+    u32 Depth;
+
+    ProfileScope(const char *ZoneName)
+    {
+        Thread = Profiler.Initialized ? GetProfileThread() : NULL;
+        Name = ZoneName;
+        Depth = 0;
+
+        if (Thread != NULL)
+        {
+            Depth = Thread->Depth++;
+        }
+
+        Begin = GetProfilerTime();
+    }
+
+    ~ProfileScope()
+    {
+        const u64 End = GetProfilerTime();
+
+        if (Thread == NULL)
+        {
+            return;
+        }
+
+        const u64 Head = Thread->Head.load(std::memory_order_relaxed);
+        Thread->Events[Head & (PROFILER_RING_SIZE - 1)] = (ProfileEvent){Name, Begin, End, Depth};
+        Thread->Head.store(Head + 1, std::memory_order_release);
+
+        Thread->Depth--;
+    }
+};
+
+#define ProfileConcat2(A, B) A##B
+#define ProfileConcat(A, B) ProfileConcat2(A, B)
+#define ProfileZone(Name) ProfileScope ProfileConcat(ProfileScope_, __LINE__)(Name)
+
+// Called on the main thread, it gets the first slot
+internal void
+ProfilerInit(void)
+{
+    for (u32 t = 0; t < PROFILER_MAX_THREADS; ++t)
+    {
+        ProfileThread *Thread = &Profiler.Threads[t];
+
+        Thread->Events = (ProfileEvent *)calloc(PROFILER_RING_SIZE, sizeof(ProfileEvent));
+        CPUMemory += PROFILER_RING_SIZE * sizeof(ProfileEvent);
+
+        Thread->Head = 0;
+        Thread->ReadHead = 0;
+        Thread->Depth = 0;
+    }
+
+    Profiler.ThreadCount = 0;
+    Profiler.FrameIndex = 0;
+    Profiler.ZoneCount = 0;
+    Profiler.Initialized = true;
+
+    GetProfileThread();
+}
+
+// Threads must not open zones anymore
+internal void
+ProfilerShutdown(void)
+{
+    if (!Profiler.Initialized)
+    {
+        return;
+    }
+
+    Profiler.Initialized = false;
+
+    for (u32 t = 0; t < PROFILER_MAX_THREADS; ++t)
+    {
+        free(Profiler.Threads[t].Events);
+        CPUMemory -= PROFILER_RING_SIZE * sizeof(ProfileEvent);
+
+        Profiler.Threads[t].Events = NULL;
+    }
+}
+
+internal void
+ProfilerBeginFrame(void)
+{
+    Profiler.FrameStarts[Profiler.FrameIndex % PROFILER_FRAME_HISTORY] = GetProfilerTime();
+    Profiler.FrameIndex++;
+}
+
+internal ProfileZoneStats *
+FindProfileZone(const char *Name)
+{
+    for (u32 z = 0; z < Profiler.ZoneCount; ++z)
+    {
+        // Literals with the same text are usually the same pointer, compare the text when not
+        if (Profiler.Zones[z].Name == Name || strcmp(Profiler.Zones[z].Name, Name) == 0)
+        {
+            return &Profiler.Zones[z];
+        }
+    }
+
+    if (Profiler.ZoneCount == PROFILER_MAX_ZONES)
+    {
+        return NULL;
+    }
+
+    ProfileZoneStats *Zone = &Profiler.Zones[Profiler.ZoneCount++];
+    *Zone = {};
+    Zone->Name = Name;
+
+    return Zone;
+}
+
+// Folds the zones that ended since the last call into the current frame of the history. Call
+// it on the main thread outside of any zone, with no job running
+internal void
+ProfilerEndFrame(void)
+{
+    if (!Profiler.Initialized || Profiler.FrameIndex == 0)
+    {
+        return;
+    }
+
+    const u64 Frame = (Profiler.FrameIndex - 1) % PROFILER_FRAME_HISTORY;
+    const u64 FrameStart = Profiler.FrameStarts[Frame];
+
+    for (u32 z = 0; z < Profiler.ZoneCount; ++z)
+    {
+        Profiler.Zones[z].Ms[Frame] = 0.0f;
+        Profiler.Zones[z].Calls = 0;
+    }
+
+    const u32 ThreadCount = Min(Profiler.ThreadCount.load(std::memory_order_relaxed), PROFILER_MAX_THREADS);
+
+    for (u32 t = 0; t < ThreadCount; ++t)
+    {
+        ProfileThread *Thread = &Profiler.Threads[t];
+        const u64 Head = Thread->Head.load(std::memory_order_acquire);
+
+        // Zones the ring already wrote over are gone
+        u64 Read = Max(Thread->ReadHead, (Head > PROFILER_RING_SIZE) ? Head - PROFILER_RING_SIZE : 0);
+
+        for (; Read < Head; ++Read)
+        {
+            const ProfileEvent *Event = &Thread->Events[Read & (PROFILER_RING_SIZE - 1)];
+            ProfileZoneStats *Zone = FindProfileZone(Event->Name);
+
+            if (Zone == NULL)
+            {
+                continue;
+            }
+
+            const u64 Begin = (Event->Begin > FrameStart) ? Event->Begin - FrameStart : 0;
+
+            if (Zone->Calls == 0 || Begin < Zone->FirstBegin)
+            {
+                Zone->FirstBegin = Begin;
+                Zone->Depth = Event->Depth;
+            }
+
+            Zone->Ms[Frame] += (f32)((f64)(Event->End - Event->Begin) / 1000000.0);
+            Zone->Calls++;
+        }
+
+        Thread->ReadHead = Head;
+    }
+}
+
+internal f32
+GetSortedPercentile(const f32 *Sorted, u32 Count, f32 Percentile)
+{
+    const u32 Index = (u32)(Percentile * (f32)(Count - 1) + 0.5f);
+
+    return Sorted[Index];
+}
+
+// Table of every zone: last frame, rolling average and percentiles over the frame history
+internal void
+DrawProfilerOverlay(Font font, i32 X, i32 Y)
+{
+    if (!Profiler.Initialized || Profiler.FrameIndex < 2)
+    {
+        return;
+    }
+
+    // The frame in progress has not been folded in yet
+    const u32 FrameCount = (u32)Min(Profiler.FrameIndex - 1, (u64)PROFILER_FRAME_HISTORY);
+    const u64 LastFrame = (Profiler.FrameIndex - 2) % PROFILER_FRAME_HISTORY;
+
+    // Same order the zones ran in during the frame
+    u32 Order[PROFILER_MAX_ZONES];
+    for (u32 z = 0; z < Profiler.ZoneCount; ++z)
+    {
+        Order[z] = z;
+    }
+
+    std::sort(Order, Order + Profiler.ZoneCount, [](u32 A, u32 B)
+              { return Profiler.Zones[A].FirstBegin < Profiler.Zones[B].FirstBegin; });
+
+    const i32 FontSize = 10;
+    const i32 LineHeight = 14;
+    const i32 Width = 620;
+    const i32 Height = (i32)(Profiler.ZoneCount + 1) * LineHeight + 8;
+
+    DrawRectangle(X, Y, Width, Height, Fade(BLACK, 0.7f));
+
+    i32 LineY = Y + 4;
+    DrawTextEx(font, TextFormat("ZONE (%u FRAMES, MS)", FrameCount), {(f32)X + 4, (f32)LineY}, FontSize, 1, YELLOW);
+    DrawTextEx(font, "LAST    AVG    P50    P95    P99  CALLS", {(f32)X + 280, (f32)LineY}, FontSize, 1, YELLOW);
+    LineY += LineHeight;
+
+    f32 Sorted[PROFILER_FRAME_HISTORY];
+
+    for (u32 o = 0; o < Profiler.ZoneCount; ++o)
+    {
+        const ProfileZoneStats *Zone = &Profiler.Zones[Order[o]];
+
+        f64 Sum = 0.0;
+        for (u32 f = 0; f < FrameCount; ++f)
+        {
+            Sorted[f] = Zone->Ms[f];
+            Sum += Zone->Ms[f];
+        }
+
+        std::sort(Sorted, Sorted + FrameCount);
+
+        const i32 Indent = (i32)Min(Zone->Depth, 8u) * 12;
+        DrawTextEx(font, Zone->Name, {(f32)(X + 4 + Indent), (f32)LineY}, FontSize, 1, WHITE);
+        DrawTextEx(font, TextFormat("%6.2f %6.2f %6.2f %6.2f %6.2f %6u", Zone->Ms[LastFrame], (f32)(Sum / FrameCount), GetSortedPercentile(Sorted, FrameCount, 0.5f), GetSortedPercentile(Sorted, FrameCount, 0.95f), GetSortedPercentile(Sorted, FrameCount, 0.99f), Zone->Calls), {(f32)X + 280, (f32)LineY}, FontSize, 1, WHITE);
+
+        LineY += LineHeight;
+    }
+}
+
+// Writes the zones of the last FrameCount frames (at most the frame history) as Chrome trace
+// event JSON. Frames are only complete as far as the rings go back
+internal bool
+WriteProfilerTrace(const char *Path, u32 FrameCount)
+{
+    if (!Profiler.Initialized || Profiler.FrameIndex == 0)
+    {
+        return false;
+    }
+
+    FrameCount = (u32)Min((u64)FrameCount, Min(Profiler.FrameIndex, (u64)PROFILER_FRAME_HISTORY));
+    FrameCount = Max(FrameCount, 1u);
+
+    const u64 Start = Profiler.FrameStarts[(Profiler.FrameIndex - FrameCount) % PROFILER_FRAME_HISTORY];
+
+    FILE *File = fopen(Path, "w");
+    if (File == NULL)
+    {
+        printf("\tERROR: Could not open %s for writing\n", Path);
+        return false;
+    }
+
+    fprintf(File, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+
+    const u32 ThreadCount = Min(Profiler.ThreadCount.load(std::memory_order_relaxed), PROFILER_MAX_THREADS);
+    usize EventCount = 0;
+
+    for (u32 t = 0; t < ThreadCount; ++t)
+    {
+        fprintf(File, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"%s %u\"}},\n", t, (t == 0) ? "Main" : "Thread", t);
+    }
+
+    for (u32 t = 0; t < ThreadCount; ++t)
+    {
+        const ProfileThread *Thread = &Profiler.Threads[t];
+        const u64 Head = Thread->Head.load(std::memory_order_acquire);
+
+        for (u64 Read = (Head > PROFILER_RING_SIZE) ? Head - PROFILER_RING_SIZE : 0; Read < Head; ++Read)
+        {
+            const ProfileEvent *Event = &Thread->Events[Read & (PROFILER_RING_SIZE - 1)];
+
+            if (Event->Begin < Start)
+            {
+                continue;
+            }
+
+            // Microseconds from the start of the first frame
+            fprintf(File, "{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f},\n", Event->Name, t, (f64)(Event->Begin - Start) / 1000.0, (f64)(Event->End - Event->Begin) / 1000.0);
+            EventCount++;
+        }
+    }
+
+    // Frame markers, and no trailing comma after the last event
+    for (u32 f = 0; f < FrameCount; ++f)
+    {
+        const u64 FrameStart = Profiler.FrameStarts[(Profiler.FrameIndex - FrameCount + f) % PROFILER_FRAME_HISTORY];
+        fprintf(File, "{\"name\": \"Frame %lu\", \"ph\": \"i\", \"s\": \"g\", \"pid\": 1, \"tid\": 0, \"ts\": %.3f}%s\n", (unsigned long)(Profiler.FrameIndex - FrameCount + f), (f64)(FrameStart - Start) / 1000.0, (f + 1 < FrameCount) ? "," : "");
+    }
+
+    fprintf(File, "]}\n");
+
+    const bool Ok = fclose(File) == 0;
+
+    printf("\tWrote %zu zones of the last %u frames to %s\n", EventCount, FrameCount, Path);
+
+    return Ok;
+}
+
+#else
+
+#define ProfileZone(Name)
+#define ProfilerInit()
+#define ProfilerShutdown()
+#define ProfilerBeginFrame()
+#define ProfilerEndFrame()
+#define DrawProfilerOverlay(font, X, Y)
+#define WriteProfilerTrace(Path, FrameCount) false
+
+#endif
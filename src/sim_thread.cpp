@@ -0,0 +1,387 @@
+// Simulation thread -----------------------------------------
+// The train simulation ticks on a thread of its own at a fixed rate, the frames never wait for
+// it. Every tick is SIM_TICK_SECONDS of simulated time and is due SIM_TICK_SECONDS / Speed of
+// real time after the one before, so the simulation runs faster or slower without the frame rate
+// changing. A long tick only delays the ones after it; when the simulation falls more than
+// SIM_MAX_LAG ticks behind, the time it is behind is dropped instead of caught up.
+//
+// After every tick the carriages before and after it are written to a snapshot. There are three
+// of them: the simulation writes one, the renderer reads one and the third is the newest finished
+// one, swapped with an atomic exchange so neither side ever waits for the other. The renderer
+// draws the carriages between the two poses of the newest snapshot, at how far the clock is into
+// the tick after it, so the trains move smoothly at any frame rate, one tick behind.
+//
+// The simulation thread owns the TrainSim and the TrackBlocks and ticks them on a copy of the
+// TrackNetwork of its own. The game never touches them while the thread runs: placing and
+// removing pieces and spawning trains are queued as edits, the game places and removes the
+// pieces on its own network right away. At the start of every tick the thread takes the queued
+// edits and applies them in the same order, so both networks stay the same. EditLock is only
+// held to queue the edits and to take them, never while a tick runs, so an edit never waits
+// for a tick.
+const f32 SIM_TICK_SECONDS = 1.0f / 60.0f;
+const f64 SIM_MAX_LAG = 8.0; // Ticks
+const u32 SIM_SNAPSHOT_COUNT = 3;
+const u32 SIM_SNAPSHOT_FRESH = 0x80000000; // Set on NewestSnapshot until the renderer took it
+const f32 SimSpeeds[] = {1.0f, 2.0f, 4.0f}; // F5 cycles through them
+
+enum SimEditType : u8
+{
+    SIM_EDIT_PLACE_TRACK,
+    SIM_EDIT_REMOVE_TRACK,
+    SIM_EDIT_SPAWN_TRAIN,
+};
+
+struct SimEdit
+{
+    SimEditType Type;
+    u8 Model;    // TrackModelHandle, placing only
+    u8 Rotation; // Placing only
+    u32 I;       // World tile
+    u32 J;
+    u32 Carriages; // Spawning only
+    f32 Speed;
+};
+
+// Per carriage, in world units
+struct TrainPoses
+{
+    std::vector<f32> X;
+    std::vector<f32> Y; // Elevation of the ground under the carriage
+    std::vector<f32> Z;
+    std::vector<f32> DirectionX;
+    std::vector<f32> DirectionZ;
+};
+
+struct TrainSnapshot
+{
+    TrainPoses From; // Before the tick, the trains spawned since the tick before included
+    TrainPoses To;
+    std::vector<u8> Model;  // Per carriage, TrainModelHandle
+    std::vector<u32> Front; // Per train, carriage of the locomotive
+
+    u64 Tick;        // Ticks done, this one included
+    f64 DueTime;     // Seconds on the simulation clock the tick was due at
+    f64 Interval;    // Seconds to the next tick at the speed it ran at
+    f32 TickSeconds; // How long the tick took
+    u64 Deadlocks;
+};
+
+struct SimThread
+{
+    TrainSim *Sim;
+    TrackNetwork Network; // Copy of the game's, kept the same by replaying its edits
+    TrackBlocks *Blocks;
+
+    TrainSnapshot Snapshots[SIM_SNAPSHOT_COUNT];
+    u32 WriteSnapshot;               // Only the simulation thread touches it
+    u32 ReadSnapshot;                // Only the renderer
+    std::atomic<u32> NewestSnapshot; // The other one, SIM_SNAPSHOT_FRESH when it was not read yet
+
+    std::atomic<u32> SpeedIndex; // Into SimSpeeds
+    std::chrono::steady_clock::time_point Start;
+
+    std::mutex EditLock;
+    std::vector<SimEdit> QueuedEdits; // Held under EditLock
+    std::vector<SimEdit> TickEdits;   // Taken from QueuedEdits, only the simulation thread touches it
+    u64 LastEditTick;                 // Ticks done before the last edits were applied, for the checks
+
+    std::mutex WakeLock;
+    std::condition_variable WakeUp;
+    bool Quit;
+    std::thread Thread;
+};
+
+// Seconds since the simulation thread started
+internal f64
+GetSimClock(const SimThread *Simulation)
+{
+    return std::chrono::duration<f64>(std::chrono::steady_clock::now() - Simulation->Start).count();
+}
+
+internal void
+CopyTrainPoses(TrainPoses *Poses, const TrainSim *Sim)
+{
+    Poses->X.assign(Sim->PositionX.begin(), Sim->PositionX.end());
+    Poses->Y.assign(Sim->PositionY.begin(), Sim->PositionY.end());
+    Poses->Z.assign(Sim->PositionZ.begin(), Sim->PositionZ.end());
+    Poses->DirectionX.assign(Sim->DirectionX.begin(), Sim->DirectionX.end());
+    Poses->DirectionZ.assign(Sim->DirectionZ.begin(), Sim->DirectionZ.end());
+}
+
+// Both poses are the current state, for the snapshot the renderer starts with
+internal void
+WriteTrainSnapshot(TrainSnapshot *Snapshot, const TrainSim *Sim)
+{
+    CopyTrainPoses(&Snapshot->To, Sim);
+    Snapshot->Model.assign(Sim->Model.begin(), Sim->Model.end());
+
+    Snapshot->Front.resize(GetTrainCount(Sim));
+    for (usize Train = 0; Train < GetTrainCount(Sim); ++Train)
+    {
+        Snapshot->Front[Train] = (u32)GetTrainFront(Sim, Train);
+    }
+
+    Snapshot->Tick = Sim->Ticks;
+    Snapshot->Deadlocks = Sim->Deadlocks;
+}
+
+// Edits are applied in the order they were queued, all of them before the same tick
+internal void
+QueueSimEdits(SimThread *Simulation, const SimEdit *Edits, usize Count)
+{
+    std::lock_guard<std::mutex> Lock(Simulation->EditLock);
+    Simulation->QueuedEdits.insert(Simulation->QueuedEdits.end(), Edits, Edits + Count);
+}
+
+// Place the piece on the game's network too, the simulation only gets it on its next tick
+internal void
+QueuePlaceTrack(SimThread *Simulation, i64 I, i64 J, TrackModelHandle Model, u8 Rotation)
+{
+    const SimEdit Edit = {SIM_EDIT_PLACE_TRACK, (u8)Model, Rotation, (u32)I, (u32)J, 0, 0.0f};
+    QueueSimEdits(Simulation, &Edit, 1);
+}
+
+internal void
+QueueRemoveTrack(SimThread *Simulation, i64 I, i64 J)
+{
+    const SimEdit Edit = {SIM_EDIT_REMOVE_TRACK, 0, 0, (u32)I, (u32)J, 0, 0.0f};
+    QueueSimEdits(Simulation, &Edit, 1);
+}
+
+// The train shows up in the snapshots once it spawned, nothing happens when SpawnTrain fails
+internal void
+QueueSpawnTrain(SimThread *Simulation, u32 I, u32 J, u32 Carriages, f32 Speed)
+{
+    const SimEdit Edit = {SIM_EDIT_SPAWN_TRAIN, 0, 0, I, J, Carriages, Speed};
+    QueueSimEdits(Simulation, &Edit, 1);
+}
+
+internal void
+ApplySimEdit(TrainSim *Sim, TrackNetwork *Network, TrackBlocks *Blocks, const SimEdit *Edit)
+{
+    switch (Edit->Type)
+    {
+    case SIM_EDIT_PLACE_TRACK:
+        PlaceTrackPiece(Network, Edit->I, Edit->J, (TrackModelHandle)Edit->Model, Edit->Rotation);
+        break;
+    case SIM_EDIT_REMOVE_TRACK:
+        RemoveTrackPiece(Network, Edit->I, Edit->J);
+        break;
+    case SIM_EDIT_SPAWN_TRAIN:
+        SpawnTrain(Sim, Network, Blocks, Edit->I, Edit->J, Edit->Carriages, Edit->Speed);
+        break;
+    }
+}
+
+// Takes everything queued so far, the lock is only held for the swap
+internal void
+ApplySimEdits(SimThread *Simulation)
+{
+    {
+        std::lock_guard<std::mutex> Lock(Simulation->EditLock);
+        std::swap(Simulation->QueuedEdits, Simulation->TickEdits);
+    }
+
+    if (Simulation->TickEdits.empty())
+    {
+        return;
+    }
+
+    for (const SimEdit &Edit : Simulation->TickEdits)
+    {
+        ApplySimEdit(Simulation->Sim, &Simulation->Network, Simulation->Blocks, &Edit);
+    }
+
+    Simulation->TickEdits.clear();
+    Simulation->LastEditTick = Simulation->Sim->Ticks;
+}
+
+internal void
+RunSimTick(SimThread *Simulation, f64 DueTime, f64 Interval)
+{
+    TrainSnapshot *Snapshot = &Simulation->Snapshots[Simulation->WriteSnapshot];
+
+    const auto Start = std::chrono::steady_clock::now();
+
+    ApplySimEdits(Simulation);
+
+    CopyTrainPoses(&Snapshot->From, Simulation->Sim);
+    TickTrainSim(Simulation->Sim, &Simulation->Network, Simulation->Blocks, SIM_TICK_SECONDS);
+    WriteTrainSnapshot(Snapshot, Simulation->Sim);
+
+    Snapshot->DueTime = DueTime;
+    Snapshot->Interval = Interval;
+    Snapshot->TickSeconds = std::chrono::duration<f32>(std::chrono::steady_clock::now() - Start).count();
+
+    // Hand the snapshot over and keep writing into the one the renderer is done with
+    const u32 Older = Simulation->NewestSnapshot.exchange(Simulation->WriteSnapshot | SIM_SNAPSHOT_FRESH, std::memory_order_acq_rel);
+    Simulation->WriteSnapshot = Older & ~SIM_SNAPSHOT_FRESH;
+}
+
+internal void
+SimThreadMain(SimThread *Simulation)
+{
+    // Its ParallelFors get a queue of their own, worker 0 is the main thread's
+    JobSystemAddThread();
+
+    f64 DueTime = GetSimClock(Simulation);
+
+    for (;;)
+    {
+        {
+            const auto Due = Simulation->Start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<f64>(DueTime));
+
+            std::unique_lock<std::mutex> Lock(Simulation->WakeLock);
+            if (Simulation->WakeUp.wait_until(Lock, Due, [Simulation]
+                                              { return Simulation->Quit; }))
+            {
+                return;
+            }
+        }
+
+        const f64 Interval = SIM_TICK_SECONDS / SimSpeeds[Simulation->SpeedIndex.load(std::memory_order_relaxed)];
+
+        RunSimTick(Simulation, DueTime, Interval);
+        DueTime += Interval;
+
+        const f64 Now = GetSimClock(Simulation);
+        if (Now - DueTime > SIM_MAX_LAG * Interval)
+        {
+            DueTime = Now;
+        }
+    }
+}
+
+// The thread owns Sim and Blocks until StopSimThread, change them and Network through the
+// Queue functions only
+internal void
+StartSimThread(SimThread *Simulation, TrainSim *Sim, const TrackNetwork *Network, TrackBlocks *Blocks)
+{
+    Simulation->Sim = Sim;
+    Simulation->Blocks = Blocks;
+    CopyTrackNetwork(&Simulation->Network, Network);
+
+    Simulation->QueuedEdits.clear();
+    Simulation->TickEdits.clear();
+    Simulation->LastEditTick = 0;
+
+    for (u32 s = 0; s < SIM_SNAPSHOT_COUNT; ++s)
+    {
+        TrainSnapshot *Snapshot = &Simulation->Snapshots[s];
+
+        WriteTrainSnapshot(Snapshot, Sim);
+        Snapshot->From = Snapshot->To;
+        Snapshot->DueTime = 0.0;
+        Snapshot->Interval = SIM_TICK_SECONDS;
+        Snapshot->TickSeconds = 0.0f;
+    }
+
+    Simulation->ReadSnapshot = 0;
+    Simulation->NewestSnapshot = 1;
+    Simulation->WriteSnapshot = 2;
+
+    Simulation->SpeedIndex = 0;
+    Simulation->Start = std::chrono::steady_clock::now();
+    Simulation->Quit = false;
+    Simulation->Thread = std::thread(SimThreadMain, Simulation);
+}
+
+// Frees the snapshots and the network copy, the TrainSim and TrackBlocks belong to the caller
+// again. Edits queued after the last tick are dropped
+internal void
+StopSimThread(SimThread *Simulation)
+{
+    {
+        std::lock_guard<std::mutex> Lock(Simulation->WakeLock);
+        Simulation->Quit = true;
+    }
+    Simulation->WakeUp.notify_all();
+
+    if (Simulation->Thread.joinable())
+    {
+        Simulation->Thread.join();
+    }
+
+    for (u32 s = 0; s < SIM_SNAPSHOT_COUNT; ++s)
+    {
+        Simulation->Snapshots[s] = TrainSnapshot();
+    }
+
+    FreeTrackNetwork(&Simulation->Network);
+    Simulation->QueuedEdits = std::vector<SimEdit>();
+    Simulation->TickEdits = std::vector<SimEdit>();
+}
+
+internal void
+CycleSimSpeed(SimThread *Simulation)
+{
+    const u32 Count = ArrayCount(SimSpeeds);
+    Simulation->SpeedIndex = (Simulation->SpeedIndex.load() + 1) % Count;
+}
+
+internal f32
+GetSimSpeed(const SimThread *Simulation)
+{
+    return SimSpeeds[Simulation->SpeedIndex.load(std::memory_order_relaxed)];
+}
+
+// The newest finished snapshot, stays valid until the next call. Render thread only
+internal const TrainSnapshot *
+AcquireTrainSnapshot(SimThread *Simulation)
+{
+    if (Simulation->NewestSnapshot.load(std::memory_order_acquire) & SIM_SNAPSHOT_FRESH)
+    {
+        const u32 Newest = Simulation->NewestSnapshot.exchange(Simulation->ReadSnapshot, std::memory_order_acq_rel);
+        Simulation->ReadSnapshot = Newest & ~SIM_SNAPSHOT_FRESH;
+    }
+
+    return &Simulation->Snapshots[Simulation->ReadSnapshot];
+}
+
+// How far from the poses before the tick to the ones after it the carriages are drawn at Time.
+// Stays at 1 when the next tick is late
+internal f32
+GetTrainSnapshotBlend(const TrainSnapshot *Snapshot, f64 Time)
+{
+    const f64 Blend = (Time - Snapshot->DueTime) / Snapshot->Interval;
+    return Clamp((f32)Blend, 0.0f, 1.0f);
+}
+
+internal usize
+GetTrainSnapshotCarriageCount(const TrainSnapshot *Snapshot)
+{
+    return Snapshot->To.X.size();
+}
+
+internal Vector3
+GetTrainSnapshotPosition(const TrainSnapshot *Snapshot, usize Carriage, f32 Blend)
+{
+    const TrainPoses *From = &Snapshot->From;
+    const TrainPoses *To = &Snapshot->To;
+
+    return (Vector3){
+        From->X[Carriage] + (To->X[Carriage] - From->X[Carriage]) * Blend,
+        From->Y[Carriage] + (To->Y[Carriage] - From->Y[Carriage]) * Blend,
+        From->Z[Carriage] + (To->Z[Carriage] - From->Z[Carriage]) * Blend,
+    };
+}
+
+// Unit length. A train that turned around in the tick points the new way
+internal Vector2
+GetTrainSnapshotDirection(const TrainSnapshot *Snapshot, usize Carriage, f32 Blend)
+{
+    const TrainPoses *From = &Snapshot->From;
+    const TrainPoses *To = &Snapshot->To;
+
+    const f32 X = From->DirectionX[Carriage] + (To->DirectionX[Carriage] - From->DirectionX[Carriage]) * Blend;
+    const f32 Z = From->DirectionZ[Carriage] + (To->DirectionZ[Carriage] - From->DirectionZ[Carriage]) * Blend;
+    const f32 LengthSquared = X * X + Z * Z;
+
+    if (LengthSquared < 1e-6f)
+    {
+        return (Vector2){To->DirectionX[Carriage], To->DirectionZ[Carriage]};
+    }
+
+    const f32 InverseLength = 1.0f / sqrtf(LengthSquared);
+    return (Vector2){X * InverseLength, Z * InverseLength};
+}
@@ -0,0 +1,243 @@
+// Track batches ---------------------------------------------
+// Per model list of the transforms of the track pieces in view, kept across frames. Every model
+// mesh is drawn with one DrawMeshInstanced call, so the draw calls grow with the number of model
+// types and not with the number of pieces.
+//
+// Culling walks the pages of the track network (see track_network.cpp) instead of the pieces:
+// a page outside the frustum skips its 16x16 tiles at once, a page inside takes all its pieces
+// without testing them. Only the pieces of pages on the frustum border are tested one by one.
+// The lists are only rebuilt when the camera moved or the network changed.
+const f32 TRACK_PIECE_SCALE = 32.0f;
+const f32 TRACK_PIECE_Y = 1.0f; // Above the ground elevation of the tile
+
+struct TrackBatches
+{
+    std::vector<Matrix> Transforms[TRACK_MODEL_COUNT];
+    usize InViewCount;
+
+    // Per model and quarter turn: model transform, scale and rotation, and the bounds of the
+    // piece relative to the center of its tile
+    Matrix Basis[TRACK_MODEL_COUNT][4];
+    BoundingBox Bounds[TRACK_MODEL_COUNT][4];
+    BoundingBox Reach; // Union of all the bounds above, how far any piece reaches out of its tile
+
+    // View and network the lists were built for
+    bool Valid;
+    Camera3D Camera;
+    i32 ScreenWidth;
+    i32 ScreenHeight;
+    u64 NetworkVersion;
+};
+
+internal void
+InitTrackBatches(TrackBatches *Batches, const Model *Models)
+{
+    Batches->Reach = (BoundingBox){{FLT_MAX, FLT_MAX, FLT_MAX}, {-FLT_MAX, -FLT_MAX, -FLT_MAX}};
+
+    for (u32 m = 0; m < TRACK_MODEL_COUNT; ++m)
+    {
+        const Model *TrackModel = &Models[m];
+
+        BoundingBox MeshBounds = (BoundingBox){{FLT_MAX, FLT_MAX, FLT_MAX}, {-FLT_MAX, -FLT_MAX, -FLT_MAX}};
+        for (i32 i = 0; i < TrackModel->meshCount; ++i)
+        {
+            const BoundingBox Box = GetMeshBoundingBox(TrackModel->meshes[i]);
+            MeshBounds.min = Vector3Min(MeshBounds.min, Box.min);
+            MeshBounds.max = Vector3Max(MeshBounds.max, Box.max);
+        }
+
+        for (u32 r = 0; r < 4; ++r)
+        {
+            // Same transform DrawModelEx builds, a quarter turn takes the north edge to the east edge
+            const Matrix Scale = MatrixScale(TRACK_PIECE_SCALE, TRACK_PIECE_SCALE, TRACK_PIECE_SCALE);
+            const Matrix Rotation = MatrixRotate((Vector3){0.0f, 1.0f, 0.0f}, -90.0f * r * DEG2RAD);
+
+            Batches->Basis[m][r] = MatrixMultiply(TrackModel->transform, MatrixMultiply(Scale, Rotation));
+
+            BoundingBox *Bounds = &Batches->Bounds[m][r];
+            *Bounds = (BoundingBox){{FLT_MAX, FLT_MAX, FLT_MAX}, {-FLT_MAX, -FLT_MAX, -FLT_MAX}};
+
+            for (u32 c = 0; c < 8; ++c)
+            {
+                const Vector3 Corner = {
+                    (c & 1) ? MeshBounds.max.x : MeshBounds.min.x,
+                    (c & 2) ? MeshBounds.max.y : MeshBounds.min.y,
+                    (c & 4) ? MeshBounds.max.z : MeshBounds.min.z,
+                };
+
+                const Vector3 Transformed = Vector3Transform(Corner, Batches->Basis[m][r]);
+                Bounds->min = Vector3Min(Bounds->min, Transformed);
+                Bounds->max = Vector3Max(Bounds->max, Transformed);
+            }
+
+            Bounds->min.y += TRACK_PIECE_Y;
+            Bounds->max.y += TRACK_PIECE_Y;
+
+            Batches->Reach.min = Vector3Min(Batches->Reach.min, Bounds->min);
+            Batches->Reach.max = Vector3Max(Batches->Reach.max, Bounds->max);
+        }
+    }
+
+    Batches->Valid = false;
+}
+
+internal void
+FreeTrackBatches(TrackBatches *Batches)
+{
+    for (u32 m = 0; m < TRACK_MODEL_COUNT; ++m)
+    {
+        Batches->Transforms[m] = std::vector<Matrix>();
+    }
+
+    Batches->InViewCount = 0;
+    Batches->Valid = false;
+}
+
+internal Vector3
+GetTrackPieceCenter(const TrackNetwork *Network, f32 TileSize, u32 Tile)
+{
+    const f32 HalfWorld = Network->WorldSize / 2.0f;
+
+    return (Vector3){
+        ((f32)(Tile / Network->WorldSize) - HalfWorld + 0.5f) * TileSize,
+        GetGroundElevation(Tile / Network->WorldSize, Tile % Network->WorldSize) + TRACK_PIECE_Y,
+        ((f32)(Tile % Network->WorldSize) - HalfWorld + 0.5f) * TileSize,
+    };
+}
+
+internal void
+AddTrackPieceToView(TrackBatches *Batches, const TrackPiece *Piece, Vector3 Center)
+{
+    Matrix Transform = Batches->Basis[Piece->Model][Piece->Rotation];
+    Transform.m12 += Center.x;
+    Transform.m13 += Center.y;
+    Transform.m14 += Center.z;
+
+    Batches->Transforms[Piece->Model].push_back(Transform);
+}
+
+internal void
+BuildTrackBatches(TrackBatches *Batches, const TrackNetwork *Network, f32 TileSize, const Frustum *frustum)
+{
+    for (u32 m = 0; m < TRACK_MODEL_COUNT; ++m)
+    {
+        Batches->Transforms[m].clear();
+    }
+
+    const u32 SlotsPerPage = TRACK_PAGE_SIZE * TRACK_PAGE_SIZE;
+    const f32 HalfWorld = Network->WorldSize / 2.0f;
+
+    for (usize p = 0; p < Network->PageCells.size(); ++p)
+    {
+        const u32 PageI = Network->PageCells[p] / Network->PagesPerSide;
+        const u32 PageJ = Network->PageCells[p] % Network->PagesPerSide;
+
+        // Tile centers of the page corners, grown by how far the pieces reach out of their tile
+        // and by the highest hill they can stand on
+        const f32 MinX = ((f32)(PageI * TRACK_PAGE_SIZE) - HalfWorld + 0.5f) * TileSize;
+        const f32 MinZ = ((f32)(PageJ * TRACK_PAGE_SIZE) - HalfWorld + 0.5f) * TileSize;
+        const f32 Span = (TRACK_PAGE_SIZE - 1) * TileSize;
+
+        const BoundingBox PageBox = {
+            {MinX + Batches->Reach.min.x, Batches->Reach.min.y, MinZ + Batches->Reach.min.z},
+            {MinX + Span + Batches->Reach.max.x, Batches->Reach.max.y + GROUND_HILL_HEIGHT, MinZ + Span + Batches->Reach.max.z},
+        };
+
+        u32 PlaneMask = FRUSTUM_ALL_PLANES;
+        const FrustumTestResult PageState = ClassifyBoxInFrustum(frustum, &PageBox, &PlaneMask);
+
+        if (PageState == FRUSTUM_OUTSIDE)
+        {
+            continue;
+        }
+
+        const u32 *Slots = &Network->PageSlots[p * SlotsPerPage];
+
+        for (u32 s = 0; s < SlotsPerPage; ++s)
+        {
+            if (Slots[s] == TRACK_NO_PIECE)
+            {
+                continue;
+            }
+
+            const TrackPiece *Piece = &Network->Pieces[Slots[s]];
+            const Vector3 Center = GetTrackPieceCenter(Network, TileSize, Piece->Tile);
+
+            if (PageState == FRUSTUM_INTERSECTS)
+            {
+                const BoundingBox *Bounds = &Batches->Bounds[Piece->Model][Piece->Rotation];
+                const Vector3 Ground = {Center.x, Center.y - TRACK_PIECE_Y, Center.z};
+                const BoundingBox PieceBox = {Vector3Add(Bounds->min, Ground), Vector3Add(Bounds->max, Ground)};
+
+                u32 PieceMask = PlaneMask;
+                if (ClassifyBoxInFrustum(frustum, &PieceBox, &PieceMask) == FRUSTUM_OUTSIDE)
+                {
+                    continue;
+                }
+            }
+
+            AddTrackPieceToView(Batches, Piece, Center);
+        }
+    }
+
+    Batches->InViewCount = 0;
+    for (u32 m = 0; m < TRACK_MODEL_COUNT; ++m)
+    {
+        Batches->InViewCount += Batches->Transforms[m].size();
+    }
+}
+
+// Returns true when the lists changed since the last call
+internal bool
+UpdateTrackBatches(TrackBatches *Batches, const TrackNetwork *Network, f32 TileSize, const Frustum *frustum, const Camera3D *Camera, i32 ScreenWidth, i32 ScreenHeight)
+{
+    const bool SameView = Batches->Valid &&
+                          Camera->fovy == Batches->Camera.fovy &&
+                          ScreenWidth == Batches->ScreenWidth &&
+                          ScreenHeight == Batches->ScreenHeight &&
+                          SameVector3(Camera->position, Batches->Camera.position) &&
+                          SameVector3(Camera->target, Batches->Camera.target) &&
+                          SameVector3(Camera->up, Batches->Camera.up);
+
+    if (SameView && Network->Version == Batches->NetworkVersion)
+    {
+        return false;
+    }
+
+    ProfileZone("BuildTrackBatches");
+
+    BuildTrackBatches(Batches, Network, TileSize, frustum);
+
+    Batches->Valid = true;
+    Batches->Camera = *Camera;
+    Batches->ScreenWidth = ScreenWidth;
+    Batches->ScreenHeight = ScreenHeight;
+    Batches->NetworkVersion = Network->Version;
+
+    return true;
+}
+
+// One instanced draw per mesh of every model with pieces in view, with the model's own
+// materials drawn through Shader
+internal void
+DrawTrackBatches(const TrackBatches *Batches, const Model *Models, Shader shader)
+{
+    for (u32 m = 0; m < TRACK_MODEL_COUNT; ++m)
+    {
+        const std::vector<Matrix> *Transforms = &Batches->Transforms[m];
+
+        if (Transforms->empty())
+        {
+            continue;
+        }
+
+        for (i32 i = 0; i < Models[m].meshCount; ++i)
+        {
+            Material MeshMaterial = Models[m].materials[Models[m].meshMaterial[i]];
+            MeshMaterial.shader = shader;
+
+            ProfileZone("DrawMeshInstanced");
+            DrawMeshInstanced(Models[m].meshes[i], MeshMaterial, Transforms->data(), (i32)Transforms->size());
+        }
+    }
+}
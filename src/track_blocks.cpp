@@ -0,0 +1,102 @@
+// Track blocks ----------------------------------------------
+// Every tile with track is a signal block that at most one train holds at a time. The owner of
+// a block is kept next to the piece index of its tile, per page slot of the track network (see
+// track_network.cpp), so looking up a block costs the same as looking up a piece and the
+// blocks of a page share cache lines.
+//
+// Owners and requests are atomics, trains running on different workers reserve blocks without
+// locks (see train_sim.cpp for the protocol). A block that is free can have many trains asking
+// for it in the same tick: each one posts its request key with an atomic min, the lowest key
+// wins, no matter in which order the requests came in.
+const u32 TRACK_BLOCK_FREE = 0;                    // Owners are train index + 1
+const u64 TRACK_BLOCK_NO_REQUEST = 0xFFFFFFFFFFFFFFFF;
+
+struct TrackBlocks
+{
+    std::atomic<u32> *Owner;
+    std::atomic<u64> *Request; // Lowest request key this tick
+    usize Count;               // Page slots covered, grows with the network
+};
+
+internal void
+FreeTrackBlocks(TrackBlocks *Blocks)
+{
+    free(Blocks->Owner);
+    free(Blocks->Request);
+    CPUMemory -= Blocks->Count * (sizeof(std::atomic<u32>) + sizeof(std::atomic<u64>));
+
+    *Blocks = {};
+}
+
+// Grows the blocks to cover pages allocated since the last call, not while trains tick
+internal void
+SyncTrackBlocks(TrackBlocks *Blocks, const TrackNetwork *Network)
+{
+    const usize Count = Network->PageSlots.size();
+
+    if (Count <= Blocks->Count)
+    {
+        return;
+    }
+
+    std::atomic<u32> *Owner = (std::atomic<u32> *)calloc(Count, sizeof(std::atomic<u32>));
+    std::atomic<u64> *Request = (std::atomic<u64> *)calloc(Count, sizeof(std::atomic<u64>));
+    CPUMemory += Count * (sizeof(std::atomic<u32>) + sizeof(std::atomic<u64>));
+
+    for (usize s = 0; s < Count; ++s)
+    {
+        Owner[s].store((s < Blocks->Count) ? Blocks->Owner[s].load(std::memory_order_relaxed) : TRACK_BLOCK_FREE, std::memory_order_relaxed);
+        Request[s].store(TRACK_BLOCK_NO_REQUEST, std::memory_order_relaxed);
+    }
+
+    FreeTrackBlocks(Blocks);
+
+    Blocks->Owner = Owner;
+    Blocks->Request = Request;
+    Blocks->Count = Count;
+}
+
+// Page slot of world tile (I, J), TRACK_NO_PIECE when its page was never allocated
+internal u32
+GetTrackBlock(const TrackNetwork *Network, u32 I, u32 J)
+{
+    const u32 *Slot = GetTrackSlot((TrackNetwork *)Network, I, J, false);
+
+    return (Slot != NULL) ? (u32)(Slot - Network->PageSlots.data()) : TRACK_NO_PIECE;
+}
+
+internal u32
+GetTrackBlockOwner(const TrackBlocks *Blocks, u32 Block)
+{
+    return Blocks->Owner[Block].load(std::memory_order_relaxed);
+}
+
+internal void
+SetTrackBlockOwner(TrackBlocks *Blocks, u32 Block, u32 Owner)
+{
+    Blocks->Owner[Block].store(Owner, std::memory_order_relaxed);
+}
+
+// Lock-free minimum, the block goes to the lowest key once every request is in
+internal void
+RequestTrackBlock(TrackBlocks *Blocks, u32 Block, u64 Key)
+{
+    u64 Current = Blocks->Request[Block].load(std::memory_order_relaxed);
+
+    while (Key < Current && !Blocks->Request[Block].compare_exchange_weak(Current, Key, std::memory_order_relaxed))
+    {
+        // Current was reloaded, try again while the key is still lower
+    }
+}
+
+internal u64
+GetTrackBlockRequest(const TrackBlocks *Blocks, u32 Block)
+{
+    return Blocks->Request[Block].load(std::memory_order_relaxed);
+}
+
+internal void
+ClearTrackBlockRequest(TrackBlocks *Blocks, u32 Block)
+{
+    Blocks->Request[Block].store(TRACK_BLOCK_NO_REQUEST, std::memory_order_relaxed);
+}
@@ -0,0 +1,283 @@
+// Track network ---------------------------------------------
+// The placed track pieces, indexed by the world tile they are on. Pieces live in one dense
+// array, a sparse grid of pages maps a world tile to its piece:
+//  - lookup, insert and remove are O(1), a tile holds at most one piece
+//  - only the pages tracks were ever placed on are allocated, an 8192x8192 world costs a 1 MB
+//    page table plus 1 KB per 16x16 tiles with track on them
+//  - a piece is 8 bytes: its tile, a model handle, a rotation and its edges
+// World tiles are used instead of store Ids, so pieces keep their tile when the ground window
+// is streamed (see ground_streaming.cpp).
+//
+// Every piece knows which of its four edges the track leaves through, and which of those are
+// linked to a neighbour piece that has the opposite edge. The links are kept up to date on
+// every insert and remove, by looking at the four neighbours only.
+const u32 TRACK_PAGE_SIZE = 16; // Tiles per page side
+const u32 TRACK_NO_PIECE = 0xFFFFFFFF;
+const u32 TRACK_NO_PAGE = 0; // Page table entries are page index + 1, so a zeroed table is empty
+
+// Edges of a tile, I runs along +x and J along +z
+enum TrackEdge : u8
+{
+    TRACK_EDGE_NORTH = 1 << 0, // -z, tile (I, J - 1)
+    TRACK_EDGE_EAST = 1 << 1,  // +x, tile (I + 1, J)
+    TRACK_EDGE_SOUTH = 1 << 2, // +z, tile (I, J + 1)
+    TRACK_EDGE_WEST = 1 << 3,  // -x, tile (I - 1, J)
+};
+
+const i32 TrackEdgeOffsetI[4] = {0, 1, 0, -1};
+const i32 TrackEdgeOffsetJ[4] = {-1, 0, 1, 0};
+
+// Handles into TrackModels, a piece stores the handle instead of a copy of the Model
+enum TrackModelHandle : u8
+{
+    TRACK_MODEL_STRAIGHT,
+    TRACK_MODEL_CORNER,
+    TRACK_MODEL_CROSSING,
+
+    TRACK_MODEL_COUNT
+};
+
+struct TrackModelInfo
+{
+    const char *Path;
+    u8 Edges; // Edges the track leaves through without rotation
+};
+
+const TrackModelInfo TrackModelInfos[TRACK_MODEL_COUNT] = {
+    {"./resources/models/GLB format/railroad-straight.glb", TRACK_EDGE_NORTH | TRACK_EDGE_SOUTH},
+    {"./resources/models/GLB format/railroad-corner-small.glb", TRACK_EDGE_SOUTH | TRACK_EDGE_WEST},
+    {"./resources/models/GLB format/track.glb", TRACK_EDGE_NORTH | TRACK_EDGE_EAST | TRACK_EDGE_SOUTH | TRACK_EDGE_WEST}, // No crossing model in the kit yet
+};
+
+struct TrackPiece
+{
+    u32 Tile;    // World tile, I * WorldSize + J
+    u8 Model;    // TrackModelHandle
+    u8 Rotation; // Quarter turns around +y
+    u8 Edges;    // Edges the track leaves through, rotated
+    u8 Links;    // Edges linked to a neighbour piece
+};
+
+static_assert(sizeof(TrackPiece) == 8, "Pieces are kept small, networks get big");
+
+struct TrackNetwork
+{
+    u32 WorldSize;    // Tiles per side
+    u32 PagesPerSide; // WorldSize / TRACK_PAGE_SIZE, rounded up
+    u32 *PageTable;   // PagesPerSide^2 entries, TRACK_NO_PAGE until a piece is placed on the page
+
+    std::vector<u32> PageSlots; // TRACK_PAGE_SIZE^2 piece indices per page
+    std::vector<u32> PageCells; // Page table index of every page, for walking the pages in use
+
+    std::vector<TrackPiece> Pieces;
+    u64 Version; // Bumped on every change, lets the draw lists know they are stale
+};
+
+enum TrackPlaceResult
+{
+    TRACK_PLACE_ADDED,
+    TRACK_PLACE_REPLACED,  // Another piece was on the tile
+    TRACK_PLACE_DUPLICATE, // The same piece was already on the tile, nothing changed
+};
+
+internal void
+InitTrackNetwork(TrackNetwork *Network, u32 WorldSize)
+{
+    Network->WorldSize = WorldSize;
+    Network->PagesPerSide = (WorldSize + TRACK_PAGE_SIZE - 1) / TRACK_PAGE_SIZE;
+
+    const usize PageCount = (usize)Network->PagesPerSide * Network->PagesPerSide;
+    Network->PageTable = (u32 *)calloc(PageCount, sizeof(u32));
+    CPUMemory += PageCount * sizeof(u32);
+
+    Network->PageSlots.clear();
+    Network->PageCells.clear();
+    Network->Pieces.clear();
+    Network->Version = 0;
+}
+
+internal void
+FreeTrackNetwork(TrackNetwork *Network)
+{
+    free(Network->PageTable);
+    CPUMemory -= (usize)Network->PagesPerSide * Network->PagesPerSide * sizeof(u32);
+
+    Network->PageTable = NULL;
+    Network->PageSlots = std::vector<u32>();
+    Network->PageCells = std::vector<u32>();
+    Network->Pieces = std::vector<TrackPiece>();
+}
+
+// Copy is a network of its own, free it with FreeTrackNetwork
+internal void
+CopyTrackNetwork(TrackNetwork *Copy, const TrackNetwork *Network)
+{
+    InitTrackNetwork(Copy, Network->WorldSize);
+
+    memcpy(Copy->PageTable, Network->PageTable, (usize)Network->PagesPerSide * Network->PagesPerSide * sizeof(u32));
+    Copy->PageSlots = Network->PageSlots;
+    Copy->PageCells = Network->PageCells;
+    Copy->Pieces = Network->Pieces;
+    Copy->Version = Network->Version;
+}
+
+internal u8
+RotateTrackEdges(u8 Edges, u8 Rotation)
+{
+    Rotation &= 3;
+
+    return (u8)(((Edges << Rotation) | (Edges >> (4 - Rotation))) & 0xF);
+}
+
+internal u8
+GetOppositeTrackEdge(u32 Edge)
+{
+    return (u8)(1 << ((Edge + 2) & 3));
+}
+
+// Slot of the tile's piece index, NULL when its page was never allocated and Allocate is false
+internal u32 *
+GetTrackSlot(TrackNetwork *Network, u32 I, u32 J, bool Allocate)
+{
+    const u32 Cell = (I / TRACK_PAGE_SIZE) * Network->PagesPerSide + J / TRACK_PAGE_SIZE;
+    u32 *Page = &Network->PageTable[Cell];
+
+    if (*Page == TRACK_NO_PAGE)
+    {
+        if (!Allocate)
+        {
+            return NULL;
+        }
+
+        *Page = (u32)(Network->PageSlots.size() / (TRACK_PAGE_SIZE * TRACK_PAGE_SIZE)) + 1;
+        Network->PageSlots.resize(Network->PageSlots.size() + TRACK_PAGE_SIZE * TRACK_PAGE_SIZE, TRACK_NO_PIECE);
+        Network->PageCells.push_back(Cell);
+    }
+
+    return &Network->PageSlots[(usize)(*Page - 1) * TRACK_PAGE_SIZE * TRACK_PAGE_SIZE + (I % TRACK_PAGE_SIZE) * TRACK_PAGE_SIZE + J % TRACK_PAGE_SIZE];
+}
+
+// Index of the piece on world tile (I, J), TRACK_NO_PIECE when there is none
+internal u32
+FindTrackPiece(const TrackNetwork *Network, i64 I, i64 J)
+{
+    if (I < 0 || J < 0 || I >= Network->WorldSize || J >= Network->WorldSize)
+    {
+        return TRACK_NO_PIECE;
+    }
+
+    const u32 *Slot = GetTrackSlot((TrackNetwork *)Network, (u32)I, (u32)J, false);
+
+    return (Slot != NULL) ? *Slot : TRACK_NO_PIECE;
+}
+
+// Links or unlinks the piece on (I, J) with its four neighbours, both sides of every edge
+internal void
+UpdateTrackLinks(TrackNetwork *Network, u32 I, u32 J, bool Linked)
+{
+    const u32 Index = FindTrackPiece(Network, I, J);
+    TrackPiece *Piece = (Index != TRACK_NO_PIECE) ? &Network->Pieces[Index] : NULL;
+
+    for (u32 e = 0; e < 4; ++e)
+    {
+        const u32 NeighbourIndex = FindTrackPiece(Network, (i64)I + TrackEdgeOffsetI[e], (i64)J + TrackEdgeOffsetJ[e]);
+
+        if (NeighbourIndex == TRACK_NO_PIECE)
+        {
+            continue;
+        }
+
+        TrackPiece *Neighbour = &Network->Pieces[NeighbourIndex];
+        const u8 Edge = (u8)(1 << e);
+        const u8 Opposite = GetOppositeTrackEdge(e);
+
+        const bool Connects = Linked && Piece != NULL && (Piece->Edges & Edge) && (Neighbour->Edges & Opposite);
+
+        if (Connects)
+        {
+            Piece->Links |= Edge;
+            Neighbour->Links |= Opposite;
+        }
+        else
+        {
+            Neighbour->Links &= (u8)~Opposite;
+        }
+    }
+}
+
+internal bool
+RemoveTrackPiece(TrackNetwork *Network, i64 I, i64 J)
+{
+    const u32 Index = FindTrackPiece(Network, I, J);
+
+    if (Index == TRACK_NO_PIECE)
+    {
+        return false;
+    }
+
+    UpdateTrackLinks(Network, (u32)I, (u32)J, false);
+
+    *GetTrackSlot(Network, (u32)I, (u32)J, false) = TRACK_NO_PIECE;
+
+    // Swap-remove, the moved piece gets its new index in the grid
+    const TrackPiece Last = Network->Pieces.back();
+    Network->Pieces.pop_back();
+
+    if (Index < Network->Pieces.size())
+    {
+        Network->Pieces[Index] = Last;
+        *GetTrackSlot(Network, Last.Tile / Network->WorldSize, Last.Tile % Network->WorldSize, false) = Index;
+    }
+
+    Network->Version++;
+
+    return true;
+}
+
+// Places a piece on world tile (I, J), a different piece already on the tile is replaced
+internal TrackPlaceResult
+PlaceTrackPiece(TrackNetwork *Network, i64 I, i64 J, TrackModelHandle Model, u8 Rotation)
+{
+    Assert(I >= 0 && J >= 0 && I < Network->WorldSize && J < Network->WorldSize);
+
+    TrackPlaceResult Result = TRACK_PLACE_ADDED;
+
+    const u32 Existing = FindTrackPiece(Network, I, J);
+
+    if (Existing != TRACK_NO_PIECE)
+    {
+        const TrackPiece *Piece = &Network->Pieces[Existing];
+
+        if (Piece->Model == Model && Piece->Rotation == (Rotation & 3))
+        {
+            return TRACK_PLACE_DUPLICATE;
+        }
+
+        RemoveTrackPiece(Network, I, J);
+        Result = TRACK_PLACE_REPLACED;
+    }
+
+    TrackPiece Piece = {};
+    Piece.Tile = (u32)(I * Network->WorldSize + J);
+    Piece.Model = Model;
+    Piece.Rotation = Rotation & 3;
+    Piece.Edges = RotateTrackEdges(TrackModelInfos[Model].Edges, Piece.Rotation);
+
+    *GetTrackSlot(Network, (u32)I, (u32)J, true) = (u32)Network->Pieces.size();
+    Network->Pieces.push_back(Piece);
+
+    UpdateTrackLinks(Network, (u32)I, (u32)J, true);
+
+    Network->Version++;
+
+    return Result;
+}
+
+internal usize
+GetTrackNetworkMemory(const TrackNetwork *Network)
+{
+    return (usize)Network->PagesPerSide * Network->PagesPerSide * sizeof(u32) +
+           Network->PageSlots.capacity() * sizeof(u32) +
+           Network->PageCells.capacity() * sizeof(u32) +
+           Network->Pieces.capacity() * sizeof(TrackPiece);
+}
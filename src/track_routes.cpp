@@ -0,0 +1,766 @@
+// Track routes ----------------------------------------------
+// Shortest routes over the track network (see track_network.cpp), tile by tile along the links
+// between pieces. Every step to a linked neighbour costs 1.
+//
+// The world is cut into clusters of TRACK_CLUSTER_SIZE x TRACK_CLUSTER_SIZE tiles, the same as
+// the map chunks. Hierarchical A*:
+//  - the portals of a cluster are its pieces that are linked to a piece in another cluster
+//  - every cluster keeps the distance between pairs of its portals, inside the cluster. A pair
+//    whose shortest path runs through a third portal is left out, the search gets there over
+//    the third portal at the same cost. On a dense network that keeps a few edges per portal
+//    instead of one to every other portal
+//  - a route search connects the start and the goal to the portals of their cluster, runs A*
+//    over the portals only, then fills in the tiles cluster by cluster
+// The distances between portals are exact, so the routes are the shortest ones.
+//
+// Edits only mark the clusters of the edited tile dirty (and the neighbour cluster for tiles
+// on a cluster border), dirty clusters are rebuilt before the next search. Found routes are
+// kept in an LRU cache keyed by origin and destination, a cached route is used as long as none
+// of the clusters it passes through changed. Routes are still drivable after edits elsewhere,
+// but new track outside of them does not make them shorter until they drop out of the cache.
+//
+// Not thread safe, searches share the scratch memory of the router.
+const u32 TRACK_CLUSTER_SIZE = 64;
+const u32 TRACK_CLUSTER_TILES = TRACK_CLUSTER_SIZE * TRACK_CLUSTER_SIZE;
+const u16 TRACK_UNREACHABLE = 0xFFFF;
+const u32 TRACK_ROUTE_CACHE_SIZE = 1024;
+
+// A* node: cluster index << 12 | portal index, plus the start and the goal
+const u32 TRACK_NODE_PORTAL_BITS = 12;
+const u32 TRACK_NODE_START = 0xFFFFFFFF;
+const u32 TRACK_NODE_GOAL = 0xFFFFFFFE;
+
+struct TrackCluster
+{
+    std::vector<u32> Portals;    // World tiles, sorted
+    std::vector<u32> EdgeBegin;  // Portals + 1, the edges of portal p are EdgeBegin[p] to EdgeBegin[p + 1]
+    std::vector<u16> EdgeTarget; // Portal index
+    std::vector<u16> EdgeCost;   // Tiles between the two portals
+    std::vector<u8> Links;       // TRACK_CLUSTER_TILES, links of the pieces that stay inside the cluster, empty without pieces
+    u32 Version;                 // Bumped on every rebuild
+    bool Dirty;
+
+    // A* scratch, only valid when SearchStamp matches the router's
+    u32 SearchStamp;
+    std::vector<u32> Cost;
+    std::vector<u32> Parent;
+};
+
+struct TrackRouteEntry
+{
+    u64 Key; // Origin tile << 32 | destination tile
+    std::vector<u32> Tiles;
+    std::vector<u32> Clusters; // Clusters the route passes through, and their version
+    std::vector<u32> Versions;
+
+    u32 Prev; // LRU list, most recently used first
+    u32 Next;
+};
+
+struct TrackRouteOpen
+{
+    u32 Estimate; // Cost so far plus the heuristic
+    u32 Cost;
+    u32 Node;
+};
+
+struct TrackRouter
+{
+    u32 WorldSize;
+    u32 ClustersPerSide;
+    std::vector<TrackCluster> Clusters;
+    std::vector<u32> DirtyClusters;
+
+    // Breadth first search inside one cluster, indexed by the tile in the cluster
+    u32 BfsStamp;
+    u32 *BfsVisited; // Stamp of the search that reached the tile
+    u16 *BfsDistance;
+    u16 *BfsParent;
+    u16 *BfsQueue;
+    u8 *BfsThroughPortal; // The path to the tile runs through a portal other than the first tile
+    u32 *BfsPortal;       // PortalStamp on the portals of the cluster being rebuilt
+    u32 PortalStamp;
+
+    // A* over the portals
+    u32 SearchStamp;
+    std::vector<TrackRouteOpen> Open;
+    std::vector<u16> StartDistances; // Start to the portals of its cluster
+    std::vector<u16> GoalDistances;  // Goal to the portals of its cluster
+    u32 GoalCost;
+    u32 GoalParent;
+    std::vector<u32> AbstractRoute;
+
+    // LRU cache
+    std::vector<TrackRouteEntry> Cache;
+    std::unordered_map<u64, u32> CacheIndex;
+    u32 CacheHead;
+    u32 CacheTail;
+
+    // Counters for the HUD and the benchmark
+    u64 Searches;
+    u64 CacheHits;
+};
+
+const u32 TRACK_NO_ENTRY = 0xFFFFFFFF;
+
+// Step to the neighbour over each TrackEdge, in tiles of a cluster
+const i32 TrackClusterStep[4] = {-1, (i32)TRACK_CLUSTER_SIZE, 1, -(i32)TRACK_CLUSTER_SIZE};
+
+internal u32
+GetTrackClusterIndex(const TrackRouter *Router, u32 I, u32 J)
+{
+    return (I / TRACK_CLUSTER_SIZE) * Router->ClustersPerSide + J / TRACK_CLUSTER_SIZE;
+}
+
+internal void
+MarkTrackClusterDirty(TrackRouter *Router, u32 ClusterIndex)
+{
+    TrackCluster *Cluster = &Router->Clusters[ClusterIndex];
+
+    if (!Cluster->Dirty)
+    {
+        Cluster->Dirty = true;
+        Router->DirtyClusters.push_back(ClusterIndex);
+    }
+}
+
+// Call after a piece on world tile (I, J) was placed or removed
+internal void
+InvalidateTrackRouteTile(TrackRouter *Router, u32 I, u32 J)
+{
+    MarkTrackClusterDirty(Router, GetTrackClusterIndex(Router, I, J));
+
+    // A piece on the border can be a portal of the cluster next to it
+    for (u32 e = 0; e < 4; ++e)
+    {
+        const i64 NeighbourI = (i64)I + TrackEdgeOffsetI[e];
+        const i64 NeighbourJ = (i64)J + TrackEdgeOffsetJ[e];
+
+        if (NeighbourI < 0 || NeighbourJ < 0 || NeighbourI >= Router->WorldSize || NeighbourJ >= Router->WorldSize)
+        {
+            continue;
+        }
+
+        MarkTrackClusterDirty(Router, GetTrackClusterIndex(Router, (u32)NeighbourI, (u32)NeighbourJ));
+    }
+}
+
+internal void
+InitTrackRouter(TrackRouter *Router, const TrackNetwork *Network)
+{
+    Router->WorldSize = Network->WorldSize;
+    Router->ClustersPerSide = (Network->WorldSize + TRACK_CLUSTER_SIZE - 1) / TRACK_CLUSTER_SIZE;
+    Router->Clusters.assign((usize)Router->ClustersPerSide * Router->ClustersPerSide, TrackCluster{});
+    Router->DirtyClusters.clear();
+
+    Router->BfsStamp = 0;
+    Router->BfsVisited = (u32 *)calloc(TRACK_CLUSTER_TILES, sizeof(u32));
+    Router->BfsDistance = (u16 *)calloc(TRACK_CLUSTER_TILES, sizeof(u16));
+    Router->BfsParent = (u16 *)calloc(TRACK_CLUSTER_TILES, sizeof(u16));
+    Router->BfsQueue = (u16 *)calloc(TRACK_CLUSTER_TILES, sizeof(u16));
+    Router->BfsThroughPortal = (u8 *)calloc(TRACK_CLUSTER_TILES, sizeof(u8));
+    Router->BfsPortal = (u32 *)calloc(TRACK_CLUSTER_TILES, sizeof(u32));
+    CPUMemory += TRACK_CLUSTER_TILES * (2 * sizeof(u32) + 3 * sizeof(u16) + sizeof(u8));
+    Router->PortalStamp = 0;
+
+    Router->SearchStamp = 0;
+
+    Router->Cache.assign(TRACK_ROUTE_CACHE_SIZE, TrackRouteEntry{});
+    Router->CacheIndex.clear();
+    Router->CacheIndex.reserve(TRACK_ROUTE_CACHE_SIZE * 2);
+
+    // All entries start out in the LRU list, the unused ones have no key in the index
+    for (u32 e = 0; e < TRACK_ROUTE_CACHE_SIZE; ++e)
+    {
+        Router->Cache[e].Key = ~0ull;
+        Router->Cache[e].Prev = (e > 0) ? e - 1 : TRACK_NO_ENTRY;
+        Router->Cache[e].Next = (e + 1 < TRACK_ROUTE_CACHE_SIZE) ? e + 1 : TRACK_NO_ENTRY;
+    }
+    Router->CacheHead = 0;
+    Router->CacheTail = TRACK_ROUTE_CACHE_SIZE - 1;
+
+    Router->Searches = 0;
+    Router->CacheHits = 0;
+
+    // Pieces placed before the router existed
+    for (const TrackPiece &Piece : Network->Pieces)
+    {
+        MarkTrackClusterDirty(Router, GetTrackClusterIndex(Router, Piece.Tile / Network->WorldSize, Piece.Tile % Network->WorldSize));
+    }
+}
+
+internal void
+FreeTrackRouter(TrackRouter *Router)
+{
+    free(Router->BfsVisited);
+    free(Router->BfsDistance);
+    free(Router->BfsParent);
+    free(Router->BfsQueue);
+    free(Router->BfsThroughPortal);
+    free(Router->BfsPortal);
+    CPUMemory -= TRACK_CLUSTER_TILES * (2 * sizeof(u32) + 3 * sizeof(u16) + sizeof(u8));
+
+    *Router = {};
+}
+
+// Breadth first search from world tile (I, J) over the pieces of its cluster, the results are
+// in the Bfs arrays for the tiles with BfsVisited == BfsStamp. Stops early once the tile Stop
+// in the cluster is reached, TRACK_CLUSTER_TILES searches the whole cluster
+internal void
+SearchTrackCluster(TrackRouter *Router, u32 I, u32 J, u32 Stop = TRACK_CLUSTER_TILES)
+{
+    const u32 ClusterI = (I / TRACK_CLUSTER_SIZE) * TRACK_CLUSTER_SIZE;
+    const u32 ClusterJ = (J / TRACK_CLUSTER_SIZE) * TRACK_CLUSTER_SIZE;
+    const u8 *Links = Router->Clusters[GetTrackClusterIndex(Router, I, J)].Links.data();
+
+    Router->BfsStamp++;
+
+    const u16 First = (u16)((I - ClusterI) * TRACK_CLUSTER_SIZE + (J - ClusterJ));
+    Router->BfsVisited[First] = Router->BfsStamp;
+    Router->BfsDistance[First] = 0;
+    Router->BfsParent[First] = First;
+    Router->BfsThroughPortal[First] = 0;
+
+    u32 QueueBegin = 0;
+    u32 QueueEnd = 0;
+    Router->BfsQueue[QueueEnd++] = First;
+
+    while (QueueBegin < QueueEnd)
+    {
+        const u16 Local = Router->BfsQueue[QueueBegin++];
+
+        for (u32 e = 0; e < 4; ++e)
+        {
+            if ((Links[Local] & (1 << e)) == 0)
+            {
+                continue;
+            }
+
+            const u16 Next = (u16)(Local + TrackClusterStep[e]);
+
+            if (Router->BfsVisited[Next] == Router->BfsStamp)
+            {
+                continue;
+            }
+
+            Router->BfsVisited[Next] = Router->BfsStamp;
+            Router->BfsDistance[Next] = Router->BfsDistance[Local] + 1;
+            Router->BfsParent[Next] = Local;
+            Router->BfsThroughPortal[Next] = Router->BfsThroughPortal[Local] | (Local != First && Router->BfsPortal[Local] == Router->PortalStamp);
+            Router->BfsQueue[QueueEnd++] = Next;
+
+            if (Next == Stop)
+            {
+                return;
+            }
+        }
+    }
+}
+
+internal u16
+GetTrackSearchDistance(const TrackRouter *Router, u32 I, u32 J)
+{
+    const u16 Local = (u16)((I % TRACK_CLUSTER_SIZE) * TRACK_CLUSTER_SIZE + J % TRACK_CLUSTER_SIZE);
+
+    return (Router->BfsVisited[Local] == Router->BfsStamp) ? Router->BfsDistance[Local] : TRACK_UNREACHABLE;
+}
+
+// Distances from the last search to every portal of Cluster
+internal void
+GetTrackPortalDistances(const TrackRouter *Router, const TrackCluster *Cluster, u32 WorldSize, std::vector<u16> *Distances)
+{
+    Distances->resize(Cluster->Portals.size());
+
+    for (usize p = 0; p < Cluster->Portals.size(); ++p)
+    {
+        (*Distances)[p] = GetTrackSearchDistance(Router, Cluster->Portals[p] / WorldSize, Cluster->Portals[p] % WorldSize);
+    }
+}
+
+internal bool
+IsTrackPortal(const TrackNetwork *Network, const TrackRouter *Router, u32 I, u32 J, u32 ClusterIndex)
+{
+    const u32 Index = FindTrackPiece(Network, I, J);
+
+    if (Index == TRACK_NO_PIECE)
+    {
+        return false;
+    }
+
+    const u8 Links = Network->Pieces[Index].Links;
+
+    for (u32 e = 0; e < 4; ++e)
+    {
+        if ((Links & (1 << e)) && GetTrackClusterIndex(Router, (u32)((i64)I + TrackEdgeOffsetI[e]), (u32)((i64)J + TrackEdgeOffsetJ[e])) != ClusterIndex)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+internal void
+RebuildTrackCluster(TrackRouter *Router, const TrackNetwork *Network, u32 ClusterIndex)
+{
+    TrackCluster *Cluster = &Router->Clusters[ClusterIndex];
+
+    const u32 I0 = (ClusterIndex / Router->ClustersPerSide) * TRACK_CLUSTER_SIZE;
+    const u32 J0 = (ClusterIndex % Router->ClustersPerSide) * TRACK_CLUSTER_SIZE;
+    const u32 I1 = Min(I0 + TRACK_CLUSTER_SIZE, Router->WorldSize);
+    const u32 J1 = Min(J0 + TRACK_CLUSTER_SIZE, Router->WorldSize);
+
+    // Links inside the cluster, so the searches don't go through the pages of the network
+    Cluster->Links.clear();
+
+    for (u32 i = I0; i < I1; ++i)
+    {
+        for (u32 j = J0; j < J1; ++j)
+        {
+            const u32 Index = FindTrackPiece(Network, i, j);
+
+            if (Index == TRACK_NO_PIECE)
+            {
+                continue;
+            }
+
+            if (Cluster->Links.empty())
+            {
+                Cluster->Links.assign(TRACK_CLUSTER_TILES, 0);
+            }
+
+            u8 Links = Network->Pieces[Index].Links;
+
+            for (u32 e = 0; e < 4; ++e)
+            {
+                const i64 NextI = (i64)i + TrackEdgeOffsetI[e];
+                const i64 NextJ = (i64)j + TrackEdgeOffsetJ[e];
+
+                if (NextI < I0 || NextJ < J0 || NextI >= I1 || NextJ >= J1)
+                {
+                    Links &= (u8)~(1 << e);
+                }
+            }
+
+            Cluster->Links[(i - I0) * TRACK_CLUSTER_SIZE + (j - J0)] = Links;
+        }
+    }
+
+    // Portals can only be on the border, in tile order so they can be found with a binary search
+    Cluster->Portals.clear();
+
+    for (u32 i = I0; i < I1; ++i)
+    {
+        const bool BorderRow = (i == I0 || i == I1 - 1);
+
+        for (u32 j = J0; j < J1; ++j)
+        {
+            if (!BorderRow && j > J0 && j < J1 - 1)
+            {
+                j = J1 - 2; // Skip to the last column
+                continue;
+            }
+
+            if (IsTrackPortal(Network, Router, i, j, ClusterIndex))
+            {
+                Cluster->Portals.push_back(i * Router->WorldSize + j);
+            }
+        }
+    }
+
+    const usize PortalCount = Cluster->Portals.size();
+
+    Router->PortalStamp++;
+    for (u32 Portal : Cluster->Portals)
+    {
+        Router->BfsPortal[(Portal / Router->WorldSize - I0) * TRACK_CLUSTER_SIZE + (Portal % Router->WorldSize - J0)] = Router->PortalStamp;
+    }
+
+    Cluster->EdgeBegin.resize(PortalCount + 1);
+    Cluster->EdgeTarget.clear();
+    Cluster->EdgeCost.clear();
+
+    for (usize p = 0; p < PortalCount; ++p)
+    {
+        SearchTrackCluster(Router, Cluster->Portals[p] / Router->WorldSize, Cluster->Portals[p] % Router->WorldSize);
+
+        Cluster->EdgeBegin[p] = (u32)Cluster->EdgeTarget.size();
+
+        for (usize q = 0; q < PortalCount; ++q)
+        {
+            const u16 Local = (u16)((Cluster->Portals[q] / Router->WorldSize - I0) * TRACK_CLUSTER_SIZE + (Cluster->Portals[q] % Router->WorldSize - J0));
+
+            if (q == p || Router->BfsVisited[Local] != Router->BfsStamp || Router->BfsThroughPortal[Local])
+            {
+                continue;
+            }
+
+            Cluster->EdgeTarget.push_back((u16)q);
+            Cluster->EdgeCost.push_back(Router->BfsDistance[Local]);
+        }
+    }
+
+    Cluster->EdgeBegin[PortalCount] = (u32)Cluster->EdgeTarget.size();
+
+    Cluster->Version++;
+    Cluster->Dirty = false;
+}
+
+internal void
+UpdateTrackRouter(TrackRouter *Router, const TrackNetwork *Network)
+{
+    for (u32 ClusterIndex : Router->DirtyClusters)
+    {
+        RebuildTrackCluster(Router, Network, ClusterIndex);
+    }
+
+    Router->DirtyClusters.clear();
+}
+
+internal u32
+GetTrackRouteHeuristic(u32 Tile, u32 Goal, u32 WorldSize)
+{
+    const i32 DeltaI = (i32)(Tile / WorldSize) - (i32)(Goal / WorldSize);
+    const i32 DeltaJ = (i32)(Tile % WorldSize) - (i32)(Goal % WorldSize);
+
+    return (u32)(abs(DeltaI) + abs(DeltaJ));
+}
+
+internal bool
+IsCheaperTrackOpen(const TrackRouteOpen &A, const TrackRouteOpen &B)
+{
+    // Min heap on the estimate, ties go to the node furthest along
+    return (A.Estimate != B.Estimate) ? A.Estimate > B.Estimate : A.Cost < B.Cost;
+}
+
+internal TrackCluster *
+GetTrackSearchCluster(TrackRouter *Router, u32 ClusterIndex)
+{
+    TrackCluster *Cluster = &Router->Clusters[ClusterIndex];
+
+    if (Cluster->SearchStamp != Router->SearchStamp)
+    {
+        Cluster->SearchStamp = Router->SearchStamp;
+        Cluster->Cost.assign(Cluster->Portals.size(), 0xFFFFFFFF);
+        Cluster->Parent.resize(Cluster->Portals.size());
+    }
+
+    return Cluster;
+}
+
+internal void
+OpenTrackNode(TrackRouter *Router, u32 Node, u32 Cost, u32 Parent, u32 Goal)
+{
+    if (Node == TRACK_NODE_GOAL)
+    {
+        if (Cost < Router->GoalCost)
+        {
+            Router->GoalCost = Cost;
+            Router->GoalParent = Parent;
+            Router->Open.push_back((TrackRouteOpen){Cost, Cost, Node});
+            std::push_heap(Router->Open.begin(), Router->Open.end(), IsCheaperTrackOpen);
+        }
+        return;
+    }
+
+    TrackCluster *Cluster = GetTrackSearchCluster(Router, Node >> TRACK_NODE_PORTAL_BITS);
+    const u32 Portal = Node & ((1 << TRACK_NODE_PORTAL_BITS) - 1);
+
+    if (Cost < Cluster->Cost[Portal])
+    {
+        Cluster->Cost[Portal] = Cost;
+        Cluster->Parent[Portal] = Parent;
+
+        const u32 Estimate = Cost + GetTrackRouteHeuristic(Cluster->Portals[Portal], Goal, Router->WorldSize);
+        Router->Open.push_back((TrackRouteOpen){Estimate, Cost, Node});
+        std::push_heap(Router->Open.begin(), Router->Open.end(), IsCheaperTrackOpen);
+    }
+}
+
+// A* over the portals, the nodes of the route end up in AbstractRoute from start to goal
+internal bool
+SearchTrackPortals(TrackRouter *Router, const TrackNetwork *Network, u32 Start, u32 Goal)
+{
+    const u32 WorldSize = Router->WorldSize;
+    const u32 StartCluster = GetTrackClusterIndex(Router, Start / WorldSize, Start % WorldSize);
+    const u32 GoalCluster = GetTrackClusterIndex(Router, Goal / WorldSize, Goal % WorldSize);
+
+    Router->SearchStamp++;
+    Router->Open.clear();
+    Router->GoalCost = 0xFFFFFFFF;
+    Router->GoalParent = TRACK_NODE_START;
+
+    // Goal to its portals first, the start search below overwrites the search arrays
+    SearchTrackCluster(Router, Goal / WorldSize, Goal % WorldSize);
+    GetTrackPortalDistances(Router, &Router->Clusters[GoalCluster], WorldSize, &Router->GoalDistances);
+
+    SearchTrackCluster(Router, Start / WorldSize, Start % WorldSize);
+    GetTrackPortalDistances(Router, &Router->Clusters[StartCluster], WorldSize, &Router->StartDistances);
+
+    if (StartCluster == GoalCluster)
+    {
+        const u16 Direct = GetTrackSearchDistance(Router, Goal / WorldSize, Goal % WorldSize);
+
+        if (Direct != TRACK_UNREACHABLE)
+        {
+            OpenTrackNode(Router, TRACK_NODE_GOAL, Direct, TRACK_NODE_START, Goal);
+        }
+    }
+
+    for (usize p = 0; p < Router->StartDistances.size(); ++p)
+    {
+        if (Router->StartDistances[p] != TRACK_UNREACHABLE)
+        {
+            OpenTrackNode(Router, (StartCluster << TRACK_NODE_PORTAL_BITS) | (u32)p, Router->StartDistances[p], TRACK_NODE_START, Goal);
+        }
+    }
+
+    while (!Router->Open.empty())
+    {
+        std::pop_heap(Router->Open.begin(), Router->Open.end(), IsCheaperTrackOpen);
+        const TrackRouteOpen Current = Router->Open.back();
+        Router->Open.pop_back();
+
+        if (Current.Node == TRACK_NODE_GOAL)
+        {
+            break;
+        }
+
+        const u32 ClusterIndex = Current.Node >> TRACK_NODE_PORTAL_BITS;
+        const u32 Portal = Current.Node & ((1 << TRACK_NODE_PORTAL_BITS) - 1);
+        const TrackCluster *Cluster = GetTrackSearchCluster(Router, ClusterIndex);
+
+        // Stale entry, the node was opened again with a lower cost
+        if (Current.Cost > Cluster->Cost[Portal])
+        {
+            continue;
+        }
+
+        // Other portals of the same cluster
+        for (u32 Edge = Cluster->EdgeBegin[Portal]; Edge < Cluster->EdgeBegin[Portal + 1]; ++Edge)
+        {
+            OpenTrackNode(Router, (ClusterIndex << TRACK_NODE_PORTAL_BITS) | Cluster->EdgeTarget[Edge], Current.Cost + Cluster->EdgeCost[Edge], Current.Node, Goal);
+        }
+
+        // Linked portals of the clusters next to it
+        const u32 Tile = Cluster->Portals[Portal];
+        const u32 TileI = Tile / WorldSize;
+        const u32 TileJ = Tile % WorldSize;
+        const u8 Links = Network->Pieces[FindTrackPiece(Network, TileI, TileJ)].Links;
+
+        for (u32 e = 0; e < 4; ++e)
+        {
+            if ((Links & (1 << e)) == 0)
+            {
+                continue;
+            }
+
+            const u32 NextI = (u32)((i64)TileI + TrackEdgeOffsetI[e]);
+            const u32 NextJ = (u32)((i64)TileJ + TrackEdgeOffsetJ[e]);
+            const u32 NextCluster = GetTrackClusterIndex(Router, NextI, NextJ);
+
+            if (NextCluster == ClusterIndex)
+            {
+                continue;
+            }
+
+            const std::vector<u32> *NextPortals = &Router->Clusters[NextCluster].Portals;
+            const auto Found = std::lower_bound(NextPortals->begin(), NextPortals->end(), NextI * WorldSize + NextJ);
+
+            if (Found != NextPortals->end() && *Found == NextI * WorldSize + NextJ)
+            {
+                OpenTrackNode(Router, (NextCluster << TRACK_NODE_PORTAL_BITS) | (u32)(Found - NextPortals->begin()), Current.Cost + 1, Current.Node, Goal);
+            }
+        }
+
+        // Straight to the goal from a portal of its cluster
+        if (ClusterIndex == GoalCluster && Router->GoalDistances[Portal] != TRACK_UNREACHABLE)
+        {
+            OpenTrackNode(Router, TRACK_NODE_GOAL, Current.Cost + Router->GoalDistances[Portal], Current.Node, Goal);
+        }
+    }
+
+    if (Router->GoalCost == 0xFFFFFFFF)
+    {
+        return false;
+    }
+
+    Router->AbstractRoute.clear();
+
+    for (u32 Node = Router->GoalParent; Node != TRACK_NODE_START;)
+    {
+        Router->AbstractRoute.push_back(Node);
+
+        const TrackCluster *Cluster = &Router->Clusters[Node >> TRACK_NODE_PORTAL_BITS];
+        Node = Cluster->Parent[Node & ((1 << TRACK_NODE_PORTAL_BITS) - 1)];
+    }
+
+    std::reverse(Router->AbstractRoute.begin(), Router->AbstractRoute.end());
+
+    return true;
+}
+
+// Appends the tiles after From up to To, both in the same cluster and connected inside it
+internal void
+AppendTrackClusterRoute(TrackRouter *Router, const TrackNetwork *Network, u32 From, u32 To, std::vector<u32> *Tiles)
+{
+    const u32 WorldSize = Router->WorldSize;
+
+    const u32 ClusterI = (From / WorldSize / TRACK_CLUSTER_SIZE) * TRACK_CLUSTER_SIZE;
+    const u32 ClusterJ = (From % WorldSize / TRACK_CLUSTER_SIZE) * TRACK_CLUSTER_SIZE;
+
+    u16 Local = (u16)((From / WorldSize - ClusterI) * TRACK_CLUSTER_SIZE + (From % WorldSize - ClusterJ));
+
+    // Search from the end, so walking the parents goes from From to To
+    SearchTrackCluster(Router, To / WorldSize, To % WorldSize, Local);
+
+    Assert(Router->BfsVisited[Local] == Router->BfsStamp);
+
+    while (Router->BfsDistance[Local] != 0)
+    {
+        Local = Router->BfsParent[Local];
+        Tiles->push_back((ClusterI + Local / TRACK_CLUSTER_SIZE) * WorldSize + ClusterJ + Local % TRACK_CLUSTER_SIZE);
+    }
+}
+
+internal u32
+GetTrackNodeTile(const TrackRouter *Router, u32 Node)
+{
+    return Router->Clusters[Node >> TRACK_NODE_PORTAL_BITS].Portals[Node & ((1 << TRACK_NODE_PORTAL_BITS) - 1)];
+}
+
+internal void
+TouchTrackRouteEntry(TrackRouter *Router, u32 Index)
+{
+    TrackRouteEntry *Entry = &Router->Cache[Index];
+
+    if (Router->CacheHead == Index)
+    {
+        return;
+    }
+
+    // Unlink, then put it in front
+    Router->Cache[Entry->Prev].Next = Entry->Next;
+    if (Entry->Next != TRACK_NO_ENTRY)
+    {
+        Router->Cache[Entry->Next].Prev = Entry->Prev;
+    }
+    else
+    {
+        Router->CacheTail = Entry->Prev;
+    }
+
+    Entry->Prev = TRACK_NO_ENTRY;
+    Entry->Next = Router->CacheHead;
+    Router->Cache[Router->CacheHead].Prev = Index;
+    Router->CacheHead = Index;
+}
+
+internal bool
+IsTrackRouteEntryValid(const TrackRouter *Router, const TrackRouteEntry *Entry)
+{
+    for (usize c = 0; c < Entry->Clusters.size(); ++c)
+    {
+        const TrackCluster *Cluster = &Router->Clusters[Entry->Clusters[c]];
+
+        if (Cluster->Dirty || Cluster->Version != Entry->Versions[c])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Shortest route between two pieces as the world tiles from From to To. NULL when there is no
+// piece on one of the tiles or they are not connected. The route stays valid until the next call
+internal const std::vector<u32> *
+FindTrackRoute(TrackRouter *Router, const TrackNetwork *Network, u32 FromI, u32 FromJ, u32 ToI, u32 ToJ)
+{
+    if (FindTrackPiece(Network, FromI, FromJ) == TRACK_NO_PIECE || FindTrackPiece(Network, ToI, ToJ) == TRACK_NO_PIECE)
+    {
+        return NULL;
+    }
+
+    const u32 WorldSize = Router->WorldSize;
+    const u32 Start = FromI * WorldSize + FromJ;
+    const u32 Goal = ToI * WorldSize + ToJ;
+    const u64 Key = ((u64)Start << 32) | Goal;
+
+    const auto Cached = Router->CacheIndex.find(Key);
+
+    if (Cached != Router->CacheIndex.end() && IsTrackRouteEntryValid(Router, &Router->Cache[Cached->second]))
+    {
+        TouchTrackRouteEntry(Router, Cached->second);
+        Router->CacheHits++;
+
+        return &Router->Cache[Cached->second].Tiles;
+    }
+
+    UpdateTrackRouter(Router, Network);
+
+    Router->Searches++;
+
+    if (!SearchTrackPortals(Router, Network, Start, Goal))
+    {
+        return NULL;
+    }
+
+    // Reuse the stale entry for this key, or the least recently used one
+    u32 Index = Router->CacheTail;
+
+    if (Cached != Router->CacheIndex.end())
+    {
+        Index = Cached->second;
+    }
+    else if (Router->Cache[Index].Key != ~0ull)
+    {
+        Router->CacheIndex.erase(Router->Cache[Index].Key);
+    }
+
+    TrackRouteEntry *Entry = &Router->Cache[Index];
+    Entry->Key = Key;
+    Entry->Tiles.clear();
+    Entry->Clusters.clear();
+    Entry->Versions.clear();
+
+    Router->CacheIndex[Key] = Index;
+    TouchTrackRouteEntry(Router, Index);
+
+    // Fill in the tiles between the nodes, consecutive portals are either in the same cluster
+    // or linked over a cluster border
+    Entry->Tiles.push_back(Start);
+
+    u32 Previous = Start;
+    for (u32 Node : Router->AbstractRoute)
+    {
+        const u32 Tile = GetTrackNodeTile(Router, Node);
+
+        if (GetTrackClusterIndex(Router, Previous / WorldSize, Previous % WorldSize) == (Node >> TRACK_NODE_PORTAL_BITS))
+        {
+            AppendTrackClusterRoute(Router, Network, Previous, Tile, &Entry->Tiles);
+        }
+        else
+        {
+            Entry->Tiles.push_back(Tile);
+        }
+
+        Previous = Tile;
+    }
+
+    AppendTrackClusterRoute(Router, Network, Previous, Goal, &Entry->Tiles);
+
+    // The route only depends on the clusters it passes through
+    for (u32 Tile : Entry->Tiles)
+    {
+        const u32 ClusterIndex = GetTrackClusterIndex(Router, Tile / WorldSize, Tile % WorldSize);
+
+        if (Entry->Clusters.empty() || Entry->Clusters.back() != ClusterIndex)
+        {
+            Entry->Clusters.push_back(ClusterIndex);
+            Entry->Versions.push_back(Router->Clusters[ClusterIndex].Version);
+        }
+    }
+
+    return &Entry->Tiles;
+}
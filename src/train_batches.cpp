@@ -0,0 +1,107 @@
+// Train batches ---------------------------------------------
+// Per model list of the transforms of the carriages in view, rebuilt every frame from the
+// newest snapshot of the simulation thread (see sim_thread.cpp), between the poses before and
+// after its tick. Like the track pieces, every model mesh is one DrawMeshInstanced call. The
+// transforms live in the frame arena and are only valid until its next reset.
+const f32 TRAIN_MODEL_SCALE = 11.0f; // The carriage models are ~2.7 units long, a bit shorter than TRAIN_CARRIAGE_SPACING
+const f32 TRAIN_Y = 5.0f;            // Wheels on the rails, above the ground elevation
+const f32 TRAIN_CULL_EXTENT = 24.0f; // Half the size of the box a carriage is culled with
+
+struct TrainBatches
+{
+    FrameArray<Matrix> Transforms[TRAIN_MODEL_COUNT];
+    Matrix Basis[TRAIN_MODEL_COUNT]; // Model transform and scale
+    usize InViewCount;
+};
+
+internal void
+InitTrainBatches(TrainBatches *Batches, const Model *Models)
+{
+    for (u32 m = 0; m < TRAIN_MODEL_COUNT; ++m)
+    {
+        const Matrix Scale = MatrixScale(TRAIN_MODEL_SCALE, TRAIN_MODEL_SCALE, TRAIN_MODEL_SCALE);
+        Batches->Basis[m] = MatrixMultiply(Models[m].transform, Scale);
+    }
+
+    Batches->InViewCount = 0;
+}
+
+internal void
+FreeTrainBatches(TrainBatches *Batches)
+{
+    for (u32 m = 0; m < TRAIN_MODEL_COUNT; ++m)
+    {
+        Batches->Transforms[m] = {0};
+    }
+
+    Batches->InViewCount = 0;
+}
+
+// Blend is how far from the poses before the snapshot's tick to the ones after it to draw them
+internal void
+BuildTrainBatches(TrainBatches *Batches, const TrainSnapshot *Snapshot, f32 Blend, const Frustum *frustum, FrameArena *Arena)
+{
+    ProfileZone("BuildTrainBatches");
+
+    for (u32 m = 0; m < TRAIN_MODEL_COUNT; ++m)
+    {
+        Batches->Transforms[m] = MakeFrameArray<Matrix>(Arena, Batches->Transforms[m].Count);
+    }
+
+    for (usize c = 0; c < GetTrainSnapshotCarriageCount(Snapshot); ++c)
+    {
+        Vector3 Position = GetTrainSnapshotPosition(Snapshot, c, Blend);
+        Position.y += TRAIN_Y;
+        const BoundingBox Box = {Vector3SubtractValue(Position, TRAIN_CULL_EXTENT), Vector3AddValue(Position, TRAIN_CULL_EXTENT)};
+
+        if (!IsBoxInFrustum(frustum, &Box))
+        {
+            continue;
+        }
+
+        // Turn the model's +z to the direction of travel
+        const Vector2 Direction = GetTrainSnapshotDirection(Snapshot, c, Blend);
+
+        Matrix Rotation = MatrixIdentity();
+        Rotation.m0 = Direction.y;
+        Rotation.m2 = -Direction.x;
+        Rotation.m8 = Direction.x;
+        Rotation.m10 = Direction.y;
+
+        Matrix Transform = MatrixMultiply(Batches->Basis[Snapshot->Model[c]], Rotation);
+        Transform.m12 += Position.x;
+        Transform.m13 += Position.y;
+        Transform.m14 += Position.z;
+
+        AppendFrameArray(&Batches->Transforms[Snapshot->Model[c]], Transform);
+    }
+
+    Batches->InViewCount = 0;
+    for (u32 m = 0; m < TRAIN_MODEL_COUNT; ++m)
+    {
+        Batches->InViewCount += Batches->Transforms[m].Count;
+    }
+}
+
+internal void
+DrawTrainBatches(const TrainBatches *Batches, const Model *Models, Shader shader)
+{
+    for (u32 m = 0; m < TRAIN_MODEL_COUNT; ++m)
+    {
+        const FrameArray<Matrix> *Transforms = &Batches->Transforms[m];
+
+        if (Transforms->Count == 0)
+        {
+            continue;
+        }
+
+        for (i32 i = 0; i < Models[m].meshCount; ++i)
+        {
+            Material MeshMaterial = Models[m].materials[Models[m].meshMaterial[i]];
+            MeshMaterial.shader = shader;
+
+            ProfileZone("DrawMeshInstanced");
+            DrawMeshInstanced(Models[m].meshes[i], MeshMaterial, Transforms->Items, (i32)Transforms->Count);
+        }
+    }
+}
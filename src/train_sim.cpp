@@ -0,0 +1,757 @@
+// Train simulation ------------------------------------------
+// Trains drive over the track network (see track_network.cpp), every carriage on its own:
+//  - a carriage is on a path through a piece, from the edge it came in through to the edge it
+//    leaves through, at a distance along that path
+//  - every tick the leading carriage moves first, the others move the same distance behind it.
+//    The way out of a piece only depends on the piece and the way in, so the carriages follow
+//    the leading one exactly without knowing about each other
+//  - a train that runs into the end of the track stops, turns around and drives back
+//
+// Trains only drive on blocks they hold (see track_blocks.cpp), from the one under the last
+// carriage to far enough ahead to brake before the end of the last one. A tick has three
+// parallel steps, every one of them only reads what the ones before wrote:
+//  1. every train asks for the free blocks it needs ahead, the requests are atomic minimums
+//  2. every train takes the blocks it won, drives as far as its blocks reach and gives back
+//     the blocks behind it. A train that lost a block waits for the winner or the owner
+//  3. trains that wait on each other in a circle are found by following who waits for whom,
+//     the one with the lowest index turns around and gives back the blocks ahead of it
+// Requests are ordered by how long a train has been waiting, so a waiting train gets the next
+// free block before the ones that just arrived.
+//
+// The state is kept in flat arrays per field (structure of arrays), a tick walks them in
+// order and never allocates. Trains only write their own state and the blocks they won or
+// hold, so the tick runs them in parallel over the job system, and the result is the same no
+// matter how many workers ran it.
+//
+// The paths are in tile units, relative to the center of their tile. A path is a curve from
+// the middle of one edge over the tile center to the middle of another edge: a straight line
+// between opposite edges, a bend between neighbouring ones. The curves are measured once at
+// startup into arc-length tables, placing a carriage is a lookup into the table of its path.
+const u32 TRAIN_PATH_COUNT = 16;         // Entry edge * 4 + exit edge, the 4 with entry == exit are unused
+const u32 TRAIN_ARC_SAMPLES = 32;        // Samples per path, evenly spaced along its length
+const f32 TRAIN_CARRIAGE_SPACING = 1.0f; // Tiles between carriages of a train
+const f32 TRAIN_ACCELERATION = 0.5f;     // Tiles per second per second
+const f32 TRAIN_BRAKING = 4.0f;          // Tiles per second per second
+const f32 TRAIN_BLOCK_MARGIN = 0.05f;    // Tiles a train stays away from the end of its last block
+const f32 TRAIN_STOP_DISTANCE = 0.001f;  // Tiles left to the margin that count as stopped
+const u32 TRAIN_MAX_LOOKAHEAD = 16;      // Blocks a train asks for ahead of it, caps the speed to ~10 tiles per second
+const u32 TRAIN_MAX_BLOCKS = 64;         // Blocks a train can hold, under it and ahead of it
+const u32 TRAIN_MAX_CARRIAGES = 32;      // Fits in TRAIN_MAX_BLOCKS with the lookahead, even through bends
+const u32 TRAIN_DEADLOCK_DEPTH = 64;     // Longest circle of waiting trains that is found
+const u32 TRAIN_NO_EDGE = 0xFF;
+const u32 TRAIN_NOT_WAITING = 0xFFFFFFFF;
+
+// Handles into TrainModels
+enum TrainModelHandle : u8
+{
+    TRAIN_MODEL_LOCOMOTIVE,
+    TRAIN_MODEL_CARRIAGE_BOX,
+    TRAIN_MODEL_CARRIAGE_COAL,
+    TRAIN_MODEL_CARRIAGE_TANK,
+
+    TRAIN_MODEL_COUNT
+};
+
+const char *TrainModelPaths[TRAIN_MODEL_COUNT] = {
+    "./resources/models/GLB format/train-locomotive-a.glb",
+    "./resources/models/GLB format/train-carriage-box.glb",
+    "./resources/models/GLB format/train-carriage-coal.glb",
+    "./resources/models/GLB format/train-carriage-tank.glb",
+};
+
+struct TrainPathTable
+{
+    f32 Length; // Tiles
+    f32 X[TRAIN_ARC_SAMPLES + 1];
+    f32 Z[TRAIN_ARC_SAMPLES + 1];
+    f32 DirectionX[TRAIN_ARC_SAMPLES + 1];
+    f32 DirectionZ[TRAIN_ARC_SAMPLES + 1];
+};
+
+struct TrainSim
+{
+    TrainPathTable Paths[TRAIN_PATH_COUNT];
+
+    // Per train, the consist is CarriageCount carriages from FirstCarriage on, the locomotive
+    // first. A reversed train drives with its last carriage in front
+    std::vector<u32> FirstCarriage;
+    std::vector<u16> CarriageCount;
+    std::vector<f32> Speed;    // Tiles per second
+    std::vector<f32> MaxSpeed;
+    std::vector<u8> Reversed;
+
+    // Per train, the blocks it holds from the back to the front, a ring of TRAIN_MAX_BLOCKS
+    std::vector<u32> Blocks;
+    std::vector<u8> BlockFirst;
+    std::vector<u8> BlockCount;
+
+    // Per train, the blocks it asked for this tick, TRAIN_MAX_LOOKAHEAD each
+    std::vector<u32> WantBlocks;
+    std::vector<f32> WantLengths;
+    std::vector<u8> WantCount;
+    std::vector<u8> EndOfTrack; // The blocks asked for end where the track ends
+
+    std::vector<u32> WaitingFor; // Train that holds or won the block it needs, TRAIN_NOT_WAITING
+    std::vector<u32> Waited;     // Ticks in a row it had to wait
+    std::vector<u8> Deadlocked;
+
+    // Per carriage
+    std::vector<u32> Tile;     // World tile, I * WorldSize + J
+    std::vector<u8> Path;      // Entry edge * 4 + exit edge, edges as in TrackEdgeOffsetI/J
+    std::vector<f32> Distance; // Tiles along the path
+    std::vector<u8> Model;     // TrainModelHandle
+
+    // Per carriage, where it is after the last tick, in world units
+    std::vector<f32> PositionX;
+    std::vector<f32> PositionY; // Elevation of the ground under the carriage
+    std::vector<f32> PositionZ;
+    std::vector<f32> DirectionX;
+    std::vector<f32> DirectionZ;
+
+    f32 TileSize;
+    u64 Ticks;
+    u64 Deadlocks; // Circles of waiting trains broken up
+};
+
+internal Vector2
+GetTrainPathPoint(u32 Entry, u32 Exit, f32 t)
+{
+    // Quadratic Bezier from the entry edge over the center to the exit edge
+    const Vector2 From = {TrackEdgeOffsetI[Entry] * 0.5f, TrackEdgeOffsetJ[Entry] * 0.5f};
+    const Vector2 To = {TrackEdgeOffsetI[Exit] * 0.5f, TrackEdgeOffsetJ[Exit] * 0.5f};
+
+    const f32 u = 1.0f - t;
+
+    return (Vector2){u * u * From.x + t * t * To.x, u * u * From.y + t * t * To.y};
+}
+
+internal void
+BuildTrainPathTable(TrainPathTable *Table, u32 Entry, u32 Exit)
+{
+    // Measure the curve finely, then pick the samples at even steps of length from it
+    const u32 Steps = 1024;
+    f32 Lengths[Steps + 1];
+    Vector2 Points[Steps + 1];
+
+    Points[0] = GetTrainPathPoint(Entry, Exit, 0.0f);
+    Lengths[0] = 0.0f;
+
+    for (u32 s = 1; s <= Steps; ++s)
+    {
+        Points[s] = GetTrainPathPoint(Entry, Exit, (f32)s / (f32)Steps);
+        Lengths[s] = Lengths[s - 1] + Vector2Distance(Points[s - 1], Points[s]);
+    }
+
+    Table->Length = Lengths[Steps];
+
+    u32 Step = 1;
+    for (u32 a = 0; a <= TRAIN_ARC_SAMPLES; ++a)
+    {
+        const f32 Target = Table->Length * (f32)a / (f32)TRAIN_ARC_SAMPLES;
+
+        while (Step < Steps && Lengths[Step] < Target)
+        {
+            ++Step;
+        }
+
+        const f32 Span = Lengths[Step] - Lengths[Step - 1];
+        const f32 Blend = (Span > 0.0f) ? (Target - Lengths[Step - 1]) / Span : 0.0f;
+        const Vector2 Point = Vector2Lerp(Points[Step - 1], Points[Step], Blend);
+        const Vector2 Direction = Vector2Normalize(Vector2Subtract(Points[Step], Points[Step - 1]));
+
+        Table->X[a] = Point.x;
+        Table->Z[a] = Point.y;
+        Table->DirectionX[a] = Direction.x;
+        Table->DirectionZ[a] = Direction.y;
+    }
+}
+
+internal void
+InitTrainSim(TrainSim *Sim, f32 TileSize)
+{
+    for (u32 Entry = 0; Entry < 4; ++Entry)
+    {
+        for (u32 Exit = 0; Exit < 4; ++Exit)
+        {
+            if (Entry != Exit)
+            {
+                BuildTrainPathTable(&Sim->Paths[Entry * 4 + Exit], Entry, Exit);
+            }
+        }
+    }
+
+    Sim->TileSize = TileSize;
+    Sim->Ticks = 0;
+    Sim->Deadlocks = 0;
+}
+
+internal void
+FreeTrainSim(TrainSim *Sim)
+{
+    *Sim = {};
+}
+
+internal usize
+GetTrainCount(const TrainSim *Sim)
+{
+    return Sim->FirstCarriage.size();
+}
+
+internal usize
+GetTrainCarriageCount(const TrainSim *Sim)
+{
+    return Sim->Tile.size();
+}
+
+// Edge a carriage leaves a piece through when it came in through Entry: straight on when the
+// piece goes that way, else the first other edge. TRAIN_NO_EDGE when the track ends here
+internal u32
+GetTrainExitEdge(u8 Edges, u32 Entry)
+{
+    const u32 Straight = (Entry + 2) & 3;
+
+    if (Edges & (1 << Straight))
+    {
+        return Straight;
+    }
+
+    for (u32 e = 0; e < 4; ++e)
+    {
+        if (e != Entry && (Edges & (1 << e)))
+        {
+            return e;
+        }
+    }
+
+    return TRAIN_NO_EDGE;
+}
+
+// Moves Tile and Path on to the path behind the exit edge, false at the end of the track
+internal bool
+GetNextTrainPath(const TrackNetwork *Network, u32 *Tile, u8 *Path)
+{
+    const u32 Exit = *Path & 3;
+    const u32 TileI = *Tile / Network->WorldSize;
+    const u32 TileJ = *Tile % Network->WorldSize;
+    const u32 Current = FindTrackPiece(Network, TileI, TileJ);
+
+    if (Current == TRACK_NO_PIECE || (Network->Pieces[Current].Links & (1 << Exit)) == 0)
+    {
+        return false;
+    }
+
+    const u32 Next = FindTrackPiece(Network, (i64)TileI + TrackEdgeOffsetI[Exit], (i64)TileJ + TrackEdgeOffsetJ[Exit]);
+    const u32 Entry = (Exit + 2) & 3;
+    const u32 NextExit = GetTrainExitEdge(Network->Pieces[Next].Edges, Entry);
+
+    if (NextExit == TRAIN_NO_EDGE)
+    {
+        return false;
+    }
+
+    *Tile = Network->Pieces[Next].Tile;
+    *Path = (u8)(Entry * 4 + NextExit);
+
+    return true;
+}
+
+// Moves a carriage Advance tiles along the track, returns how far it got before the track ended
+internal f32
+AdvanceTrainCarriage(TrainSim *Sim, const TrackNetwork *Network, usize Carriage, f32 Advance)
+{
+    u32 Tile = Sim->Tile[Carriage];
+    u8 Path = Sim->Path[Carriage];
+    f32 Distance = Sim->Distance[Carriage];
+    f32 Moved = 0.0f;
+
+    for (;;)
+    {
+        const f32 Remaining = Sim->Paths[Path].Length - Distance;
+
+        if (Advance < Remaining)
+        {
+            Distance += Advance;
+            Moved += Advance;
+            break;
+        }
+
+        if (!GetNextTrainPath(Network, &Tile, &Path))
+        {
+            Moved += Remaining;
+            Distance = Sim->Paths[Path].Length;
+            break;
+        }
+
+        Advance -= Remaining;
+        Moved += Remaining;
+        Distance = 0.0f;
+    }
+
+    Sim->Tile[Carriage] = Tile;
+    Sim->Path[Carriage] = Path;
+    Sim->Distance[Carriage] = Distance;
+
+    return Moved;
+}
+
+// Same spot, driving the other way
+internal void
+ReverseTrainCarriage(TrainSim *Sim, usize Carriage)
+{
+    const u8 Path = Sim->Path[Carriage];
+    const u8 Reversed = (u8)((Path & 3) * 4 + (Path >> 2));
+
+    Sim->Path[Carriage] = Reversed;
+    Sim->Distance[Carriage] = Sim->Paths[Reversed].Length - Sim->Distance[Carriage];
+}
+
+internal void
+PlaceTrainCarriage(TrainSim *Sim, const TrackNetwork *Network, usize Carriage)
+{
+    const TrainPathTable *Table = &Sim->Paths[Sim->Path[Carriage]];
+
+    const f32 Sample = Min(Sim->Distance[Carriage] / Table->Length, 1.0f) * TRAIN_ARC_SAMPLES;
+    const u32 a = Min((u32)Sample, TRAIN_ARC_SAMPLES - 1);
+    const f32 Blend = Sample - (f32)a;
+
+    const f32 X = Table->X[a] + (Table->X[a + 1] - Table->X[a]) * Blend;
+    const f32 Z = Table->Z[a] + (Table->Z[a + 1] - Table->Z[a]) * Blend;
+    const f32 DirectionX = Table->DirectionX[a] + (Table->DirectionX[a + 1] - Table->DirectionX[a]) * Blend;
+    const f32 DirectionZ = Table->DirectionZ[a] + (Table->DirectionZ[a + 1] - Table->DirectionZ[a]) * Blend;
+
+    const f32 HalfWorld = Network->WorldSize / 2.0f;
+    const u32 Tile = Sim->Tile[Carriage];
+
+    Sim->PositionX[Carriage] = ((f32)(Tile / Network->WorldSize) - HalfWorld + 0.5f + X) * Sim->TileSize;
+    Sim->PositionZ[Carriage] = ((f32)(Tile % Network->WorldSize) - HalfWorld + 0.5f + Z) * Sim->TileSize;
+    Sim->PositionY[Carriage] = GetGroundElevation(Tile / Network->WorldSize, Tile % Network->WorldSize);
+
+    const f32 InverseLength = 1.0f / sqrtf(DirectionX * DirectionX + DirectionZ * DirectionZ);
+    Sim->DirectionX[Carriage] = DirectionX * InverseLength;
+    Sim->DirectionZ[Carriage] = DirectionZ * InverseLength;
+}
+
+// Carriage driving in front and the one at the back
+internal usize
+GetTrainFront(const TrainSim *Sim, usize Train)
+{
+    return Sim->Reversed[Train] ? Sim->FirstCarriage[Train] + Sim->CarriageCount[Train] - 1 : Sim->FirstCarriage[Train];
+}
+
+internal usize
+GetTrainBack(const TrainSim *Sim, usize Train)
+{
+    return Sim->Reversed[Train] ? Sim->FirstCarriage[Train] : Sim->FirstCarriage[Train] + Sim->CarriageCount[Train] - 1;
+}
+
+internal u32
+GetTrainCarriageBlock(const TrainSim *Sim, const TrackNetwork *Network, usize Carriage)
+{
+    return GetTrackBlock(Network, Sim->Tile[Carriage] / Network->WorldSize, Sim->Tile[Carriage] % Network->WorldSize);
+}
+
+// Held blocks of a train, k = 0 is the one at the back
+internal u32 *
+GetTrainBlock(TrainSim *Sim, usize Train, u32 k)
+{
+    return &Sim->Blocks[Train * TRAIN_MAX_BLOCKS + (Sim->BlockFirst[Train] + k) % TRAIN_MAX_BLOCKS];
+}
+
+internal void
+PushTrainBlock(TrainSim *Sim, usize Train, u32 Block)
+{
+    Assert(Sim->BlockCount[Train] < TRAIN_MAX_BLOCKS);
+
+    *GetTrainBlock(Sim, Train, Sim->BlockCount[Train]) = Block;
+    Sim->BlockCount[Train]++;
+}
+
+// Lower keys win, trains that waited longer come first and the train index breaks ties
+internal u64
+GetTrainRequestKey(const TrainSim *Sim, usize Train)
+{
+    return ((u64)(0xFFFFFFFF - Sim->Waited[Train]) << 32) | (u64)Train;
+}
+
+internal void
+ResizeTrainCarriages(TrainSim *Sim, usize Count)
+{
+    Sim->Tile.resize(Count);
+    Sim->Path.resize(Count);
+    Sim->Distance.resize(Count);
+    Sim->Model.resize(Count);
+    Sim->PositionX.resize(Count);
+    Sim->PositionY.resize(Count);
+    Sim->PositionZ.resize(Count);
+    Sim->DirectionX.resize(Count);
+    Sim->DirectionZ.resize(Count);
+}
+
+// A locomotive on the piece on world tile (I, J) and Carriages - 1 carriages behind it. Fails
+// when there is no piece there, not enough track behind it for the carriages or another train
+// holds one of the blocks it would be on
+internal bool
+SpawnTrain(TrainSim *Sim, const TrackNetwork *Network, TrackBlocks *Blocks, u32 I, u32 J, u32 Carriages, f32 MaxSpeed)
+{
+    const u32 Index = FindTrackPiece(Network, I, J);
+
+    if (Index == TRACK_NO_PIECE || Carriages == 0 || Carriages > TRAIN_MAX_CARRIAGES)
+    {
+        return false;
+    }
+
+    SyncTrackBlocks(Blocks, Network);
+
+    const u8 Edges = Network->Pieces[Index].Edges;
+
+    u32 Exit = 0;
+    while ((Edges & (1 << Exit)) == 0)
+    {
+        ++Exit;
+    }
+
+    const u32 Entry = GetTrainExitEdge(Edges, Exit);
+    const u8 Backwards = (u8)(Exit * 4 + Entry);
+    const usize First = Sim->Tile.size();
+    const usize Train = GetTrainCount(Sim);
+
+    // Put all carriages on the middle of the piece facing backwards, and drive each one back to
+    // its spot in the consist
+    ResizeTrainCarriages(Sim, First + Carriages);
+
+    for (u32 c = 0; c < Carriages; ++c)
+    {
+        Sim->Tile[First + c] = Network->Pieces[Index].Tile;
+        Sim->Path[First + c] = Backwards;
+        Sim->Distance[First + c] = Sim->Paths[Backwards].Length / 2.0f;
+        Sim->Model[First + c] = (c == 0) ? (u8)TRAIN_MODEL_LOCOMOTIVE : (u8)(TRAIN_MODEL_CARRIAGE_BOX + (c - 1) % 3);
+
+        const f32 Behind = c * TRAIN_CARRIAGE_SPACING;
+
+        if (AdvanceTrainCarriage(Sim, Network, First + c, Behind) < Behind)
+        {
+            ResizeTrainCarriages(Sim, First);
+            return false;
+        }
+
+        ReverseTrainCarriage(Sim, First + c);
+    }
+
+    // The blocks from the last carriage up to the locomotive have to be free
+    u32 SpawnBlocks[TRAIN_MAX_BLOCKS];
+    u32 BlockCount = 0;
+
+    u32 Tile = Sim->Tile[First + Carriages - 1];
+    u8 Path = Sim->Path[First + Carriages - 1];
+
+    for (;;)
+    {
+        const u32 Block = GetTrackBlock(Network, Tile / Network->WorldSize, Tile % Network->WorldSize);
+
+        if (BlockCount == TRAIN_MAX_BLOCKS - TRAIN_MAX_LOOKAHEAD || GetTrackBlockOwner(Blocks, Block) != TRACK_BLOCK_FREE)
+        {
+            ResizeTrainCarriages(Sim, First);
+            return false;
+        }
+
+        SpawnBlocks[BlockCount++] = Block;
+
+        if (Tile == Sim->Tile[First])
+        {
+            break;
+        }
+
+        const bool OnTrack = GetNextTrainPath(Network, &Tile, &Path);
+        Assert(OnTrack);
+    }
+
+    for (u32 b = 0; b < BlockCount; ++b)
+    {
+        SetTrackBlockOwner(Blocks, SpawnBlocks[b], (u32)Train + 1);
+    }
+
+    for (u32 c = 0; c < Carriages; ++c)
+    {
+        PlaceTrainCarriage(Sim, Network, First + c);
+    }
+
+    Sim->FirstCarriage.push_back((u32)First);
+    Sim->CarriageCount.push_back((u16)Carriages);
+    Sim->Speed.push_back(0.0f);
+    Sim->MaxSpeed.push_back(MaxSpeed);
+    Sim->Reversed.push_back(0);
+
+    Sim->Blocks.resize((Train + 1) * TRAIN_MAX_BLOCKS);
+    Sim->BlockFirst.push_back(0);
+    Sim->BlockCount.push_back(0);
+    Sim->WantBlocks.resize((Train + 1) * TRAIN_MAX_LOOKAHEAD);
+    Sim->WantLengths.resize((Train + 1) * TRAIN_MAX_LOOKAHEAD);
+    Sim->WantCount.push_back(0);
+    Sim->EndOfTrack.push_back(0);
+    Sim->WaitingFor.push_back(TRAIN_NOT_WAITING);
+    Sim->Waited.push_back(0);
+    Sim->Deadlocked.push_back(0);
+
+    for (u32 b = 0; b < BlockCount; ++b)
+    {
+        PushTrainBlock(Sim, Train, SpawnBlocks[b]);
+    }
+
+    return true;
+}
+
+// Turns the train around where it is. The blocks ahead of the carriage in front are given back,
+// the train keeps the ones it is on
+internal void
+ReverseTrain(TrainSim *Sim, const TrackNetwork *Network, TrackBlocks *Blocks, usize Train)
+{
+    const u32 FrontBlock = GetTrainCarriageBlock(Sim, Network, GetTrainFront(Sim, Train));
+
+    while (Sim->BlockCount[Train] > 0 && *GetTrainBlock(Sim, Train, Sim->BlockCount[Train] - 1) != FrontBlock)
+    {
+        SetTrackBlockOwner(Blocks, *GetTrainBlock(Sim, Train, Sim->BlockCount[Train] - 1), TRACK_BLOCK_FREE);
+        Sim->BlockCount[Train]--;
+    }
+
+    // The back is the front now
+    for (u32 k = 0; k < Sim->BlockCount[Train] / 2; ++k)
+    {
+        std::swap(*GetTrainBlock(Sim, Train, k), *GetTrainBlock(Sim, Train, Sim->BlockCount[Train] - 1 - k));
+    }
+
+    const usize First = Sim->FirstCarriage[Train];
+    const usize Last = First + Sim->CarriageCount[Train] - 1;
+
+    for (usize c = First; c <= Last; ++c)
+    {
+        ReverseTrainCarriage(Sim, c);
+        PlaceTrainCarriage(Sim, Network, c);
+    }
+
+    Sim->Reversed[Train] ^= 1;
+    Sim->Speed[Train] = 0.0f;
+}
+
+// First step of a tick: find the blocks the train needs to be able to stop in time, and ask for
+// the free ones. Only reads the owners, the requests are atomic
+internal void
+RequestTrainBlocks(TrainSim *Sim, const TrackNetwork *Network, TrackBlocks *Blocks, usize Train, f32 DeltaTime)
+{
+    const usize Front = GetTrainFront(Sim, Train);
+    const u32 Owner = (u32)Train + 1;
+    const u64 Key = GetTrainRequestKey(Sim, Train);
+
+    const f32 Speed = Min(Sim->Speed[Train] + TRAIN_ACCELERATION * DeltaTime, Sim->MaxSpeed[Train]);
+    const f32 Needed = Speed * Speed / (2.0f * TRAIN_BRAKING) + Speed * DeltaTime + TRAIN_BLOCK_MARGIN;
+
+    u32 Tile = Sim->Tile[Front];
+    u8 Path = Sim->Path[Front];
+    f32 Ahead = Sim->Paths[Path].Length - Sim->Distance[Front];
+
+    u32 *Want = &Sim->WantBlocks[Train * TRAIN_MAX_LOOKAHEAD];
+    f32 *WantLength = &Sim->WantLengths[Train * TRAIN_MAX_LOOKAHEAD];
+    u8 Count = 0;
+
+    Sim->EndOfTrack[Train] = 0;
+    Sim->WaitingFor[Train] = TRAIN_NOT_WAITING;
+
+    while (Ahead < Needed && Count < TRAIN_MAX_LOOKAHEAD)
+    {
+        if (!GetNextTrainPath(Network, &Tile, &Path))
+        {
+            Sim->EndOfTrack[Train] = 1;
+            break;
+        }
+
+        const u32 Block = GetTrackBlock(Network, Tile / Network->WorldSize, Tile % Network->WorldSize);
+        const u32 BlockOwner = GetTrackBlockOwner(Blocks, Block);
+
+        if (BlockOwner != TRACK_BLOCK_FREE && BlockOwner != Owner)
+        {
+            Sim->WaitingFor[Train] = BlockOwner - 1;
+            break;
+        }
+
+        if (BlockOwner == TRACK_BLOCK_FREE)
+        {
+            RequestTrackBlock(Blocks, Block, Key);
+        }
+
+        Want[Count] = Block;
+        WantLength[Count] = Sim->Paths[Path].Length;
+        Count++;
+
+        Ahead += Sim->Paths[Path].Length;
+    }
+
+    Sim->WantCount[Train] = Count;
+}
+
+// Second step: take the blocks the train won, drive as far as they reach and give back the
+// blocks behind the last carriage. Every block has at most one winner, so no two trains write
+// the same owner
+internal void
+MoveTrain(TrainSim *Sim, const TrackNetwork *Network, TrackBlocks *Blocks, usize Train, f32 DeltaTime)
+{
+    const usize Front = GetTrainFront(Sim, Train);
+    const u32 Owner = (u32)Train + 1;
+    const u64 Key = GetTrainRequestKey(Sim, Train);
+
+    const u32 *Want = &Sim->WantBlocks[Train * TRAIN_MAX_LOOKAHEAD];
+    const f32 *WantLength = &Sim->WantLengths[Train * TRAIN_MAX_LOOKAHEAD];
+
+    f32 Clearance = Sim->Paths[Sim->Path[Front]].Length - Sim->Distance[Front];
+    bool AllWon = true;
+
+    for (u32 w = 0; w < Sim->WantCount[Train]; ++w)
+    {
+        if (GetTrackBlockOwner(Blocks, Want[w]) != Owner)
+        {
+            const u64 Request = GetTrackBlockRequest(Blocks, Want[w]);
+
+            if (Request != Key)
+            {
+                Sim->WaitingFor[Train] = (u32)(Request & 0xFFFFFFFF);
+                AllWon = false;
+                break;
+            }
+
+            SetTrackBlockOwner(Blocks, Want[w], Owner);
+            PushTrainBlock(Sim, Train, Want[w]);
+        }
+
+        Clearance += WantLength[w];
+    }
+
+    // Never closer to the end of the last held block than the margin, and slow enough to stop
+    // there. Braking only gets there in the limit, the last bit is a full stop
+    const f32 Allowed = Max(Clearance - TRAIN_BLOCK_MARGIN, 0.0f);
+    const bool Stopped = (Allowed < TRAIN_STOP_DISTANCE);
+
+    f32 Speed = Min(Sim->Speed[Train] + TRAIN_ACCELERATION * DeltaTime, Sim->MaxSpeed[Train]);
+    Speed = Stopped ? 0.0f : Min(Speed, sqrtf(2.0f * TRAIN_BRAKING * Allowed));
+    Sim->Speed[Train] = Speed;
+
+    const f32 Advance = Min(Speed * DeltaTime, Allowed);
+
+    // The carriage in front finds out how far the train gets, the rest follow
+    const f32 Moved = AdvanceTrainCarriage(Sim, Network, Front, Advance);
+
+    const usize First = Sim->FirstCarriage[Train];
+    const usize Last = First + Sim->CarriageCount[Train] - 1;
+
+    for (usize c = First; c <= Last; ++c)
+    {
+        if (c != Front)
+        {
+            AdvanceTrainCarriage(Sim, Network, c, Moved);
+        }
+
+        PlaceTrainCarriage(Sim, Network, c);
+    }
+
+    // Blocks the last carriage left
+    const u32 BackBlock = GetTrainCarriageBlock(Sim, Network, GetTrainBack(Sim, Train));
+
+    while (Sim->BlockCount[Train] > 1 && *GetTrainBlock(Sim, Train, 0) != BackBlock)
+    {
+        SetTrackBlockOwner(Blocks, *GetTrainBlock(Sim, Train, 0), TRACK_BLOCK_FREE);
+        Sim->BlockFirst[Train] = (u8)((Sim->BlockFirst[Train] + 1) % TRAIN_MAX_BLOCKS);
+        Sim->BlockCount[Train]--;
+    }
+
+    Sim->Waited[Train] = (Sim->WaitingFor[Train] != TRAIN_NOT_WAITING) ? Min(Sim->Waited[Train] + 1, 0xFFFFFFFF - 1) : 0;
+
+    // End of the track, turn around
+    if (Sim->EndOfTrack[Train] && AllWon && Stopped)
+    {
+        ReverseTrain(Sim, Network, Blocks, Train);
+    }
+}
+
+// Third step: a stopped train waiting for a stopped train, that waits for a stopped train ...
+// that waits for the first one will never move again. The train with the lowest index in the
+// circle finds out it is in one and turns around
+internal void
+FindTrainDeadlock(TrainSim *Sim, TrackBlocks *Blocks, usize Train)
+{
+    for (u32 w = 0; w < Sim->WantCount[Train]; ++w)
+    {
+        ClearTrackBlockRequest(Blocks, Sim->WantBlocks[Train * TRAIN_MAX_LOOKAHEAD + w]);
+    }
+
+    Sim->Deadlocked[Train] = 0;
+
+    if (Sim->Speed[Train] != 0.0f || Sim->WaitingFor[Train] == TRAIN_NOT_WAITING)
+    {
+        return;
+    }
+
+    u32 Waiter = Sim->WaitingFor[Train];
+    usize Lowest = Train;
+
+    for (u32 Step = 0; Step < TRAIN_DEADLOCK_DEPTH; ++Step)
+    {
+        if (Waiter == Train)
+        {
+            Sim->Deadlocked[Train] = (Lowest == Train);
+            return;
+        }
+
+        if (Sim->Speed[Waiter] != 0.0f || Sim->WaitingFor[Waiter] == TRAIN_NOT_WAITING)
+        {
+            return;
+        }
+
+        Lowest = Min(Lowest, (usize)Waiter);
+        Waiter = Sim->WaitingFor[Waiter];
+    }
+}
+
+internal void
+TickTrainSim(TrainSim *Sim, const TrackNetwork *Network, TrackBlocks *Blocks, f32 DeltaTime)
+{
+    ProfileZone("TickTrainSim");
+
+    SyncTrackBlocks(Blocks, Network);
+
+    const usize TrainCount = GetTrainCount(Sim);
+
+    // Every step reads what the step before wrote, so the result does not depend on how the
+    // trains are spread over the workers
+    ParallelFor(TrainCount, 64, [&](usize Begin, usize End, u32 Worker)
+                {
+                    for (usize Train = Begin; Train < End; ++Train)
+                    {
+                        RequestTrainBlocks(Sim, Network, Blocks, Train, DeltaTime);
+                    }
+                });
+
+    ParallelFor(TrainCount, 64, [&](usize Begin, usize End, u32 Worker)
+                {
+                    for (usize Train = Begin; Train < End; ++Train)
+                    {
+                        MoveTrain(Sim, Network, Blocks, Train, DeltaTime);
+                    }
+                });
+
+    ParallelFor(TrainCount, 64, [&](usize Begin, usize End, u32 Worker)
+                {
+                    for (usize Train = Begin; Train < End; ++Train)
+                    {
+                        FindTrainDeadlock(Sim, Blocks, Train);
+                    }
+                });
+
+    // Deadlocks are rare, the ones found are broken one by one on the thread that ticks
+    for (usize Train = 0; Train < TrainCount; ++Train)
+    {
+        if (Sim->Deadlocked[Train])
+        {
+            ReverseTrain(Sim, Network, Blocks, Train);
+            Sim->Deadlocks++;
+        }
+    }
+
+    Sim->Ticks++;
+}